@@ -70,8 +70,12 @@
 
 #define DEBUG 0        // Set to 1 to activate debug code
 #define UNO 1          // Set to 0 if your not using the UNO bootloader (i.e using Duemilanove)
+#define FRAMES 0       // Set to 1 to send measurements to USB as binary frames in stead of text lines
+
+#define NODE_ID 30     // Node id of the CentralNode
 
 #include <JeeLib.h>
+#include <util/crc16.h>
 #include <Metro.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
@@ -196,6 +200,74 @@ void showStringln (PGM_P s) {
 }
 
 
+// Binary frame on USB: 0xA5 <type> <node id> <n> <n fields, LSB first> <CRC16, LSB first>
+// Fields are int16, or int32 when bit 7 of <n> is set (a value does not fit in an int16).
+// The CRC (_crc16_update, starting at ~0) is over <type> up to the last field.
+// jnread decodes a frame into the same line as printed without FRAMES (see jnread/frame.h).
+void sendFrame(char type, byte node, const long *v, byte n) {
+  byte buf[4 + 4*8 + 2];
+  byte len = 0, wide = 0, i;
+  uint16_t crc = ~0;
+
+  for (i = 0; i < n; i++) {
+    if (v[i] < -32768L || v[i] > 32767L) wide = 0x80;
+  }
+  buf[len++] = 0xA5; buf[len++] = type; buf[len++] = node; buf[len++] = n | wide;
+  for (i = 0; i < n; i++) {
+    buf[len++] = v[i]; buf[len++] = v[i] >> 8;
+    if (wide) {
+      buf[len++] = v[i] >> 16; buf[len++] = v[i] >> 24;
+    }
+  }
+  for (i = 1; i < len; i++) crc = _crc16_update(crc, buf[i]);
+  buf[len++] = crc; buf[len++] = crc >> 8;
+  Serial.write(buf, len);
+}
+
+
+// Keep the values of a sensor payload that are sent on to the GLCDNode and shown on the LCD
+void updateSensorState() {
+  switch (s_data.type) {
+  case 'e': watt = (int)s_data.var1; break;
+  case 'i': itemp = (int)s_data.var1; itemp_float = (float)s_data.var1/10; break;
+  case 's': swatt = (int)s_data.var1; break;
+  }
+}
+
+
+// Send a sensor payload as frame, returns false for an unknown type (reported as text)
+boolean sendSensorFrame(byte node) {
+  long v[3] = { s_data.var1, s_data.var2, s_data.var3 };
+  byte n;
+
+  switch (s_data.type) {
+  case 'a': case 'i': n = 1; break;
+  case 'e': case 'g': case 'w': n = 2; break;
+  case 'b': case 's': n = 3; break;
+  default: return false;
+  }
+  sendFrame(s_data.type, node, v, n);
+  return true;
+}
+
+
+// Send a status payload as frame, returns false for an unknown type (reported as text)
+boolean sendStatusFrame(byte node) {
+  long v[8] = { l_data.minA, l_data.maxA, l_data.minB, l_data.maxB,
+                l_data.minC, l_data.maxC, l_data.minD, l_data.maxD };
+  byte n;
+
+  switch (l_data.type) {
+  case 'l': n = 8; break;
+  case 'x': case 'y': n = 2; break;
+  case 'z': n = 4; break;
+  default: return false;
+  }
+  sendFrame(l_data.type, node, v, n);
+  return true;
+}
+
+
 void send_eeprom_update() {
   showString(PSTR("Sending: "));
   showString(PSTR("Command= "));
@@ -256,18 +328,28 @@ void readTempPres() {
   sensors.requestTemperatures(); // Send the command to get temperatures
   otemp=(int) (10*sensors.getTempCByIndex(0));
   otemp_float=(float)otemp/10;
-  showString(PSTR("o "));
-  Serial.print(otemp);
-  showStringln(PSTR(" ")); // extra space at the end is needed
+  if (FRAMES) {
+    long v = otemp;
+    sendFrame('o', NODE_ID, &v, 1);
+  } else {
+    showString(PSTR("o "));
+    Serial.print(otemp);
+    showStringln(PSTR(" ")); // extra space at the end is needed
+  }
   
   psensor.measure(BMP085::TEMP);
   psensor.measure(BMP085::PRES);
   psensor.calculate(bmptemp, bmppres);
   opres=(int) (bmppres/10);
   opres_float=(float)opres/10;
-  showString(PSTR("p "));
-  Serial.print(opres);
-  showStringln(PSTR(" ")); // extra space at the end is needed
+  if (FRAMES) {
+    long v = opres;
+    sendFrame('p', NODE_ID, &v, 1);
+  } else {
+    showString(PSTR("p "));
+    Serial.print(opres);
+    showStringln(PSTR(" ")); // extra space at the end is needed
+  }
 }
 
 
@@ -275,10 +357,15 @@ void sendTime() {
   s_data.type='t';
   s_data.var1=dt.hour;
   s_data.var2=dt.min;
-  Serial.print("t ");
-  Serial.print(dt.hour); Serial.print(":"); if (dt.min < 10) Serial.print("0"); Serial.print(dt.min); Serial.print("  ");
-  Serial.print(dt.day); Serial.print("-"); Serial.print(dt.month); Serial.print("-20"); Serial.print(dt.year);
-  Serial.println();
+  if (FRAMES) {
+    long v[5] = { dt.hour, dt.min, dt.day, dt.month, dt.year };
+    sendFrame('t', NODE_ID, v, 5);
+  } else {
+    Serial.print("t ");
+    Serial.print(dt.hour); Serial.print(":"); if (dt.min < 10) Serial.print("0"); Serial.print(dt.min); Serial.print("  ");
+    Serial.print(dt.day); Serial.print("-"); Serial.print(dt.month); Serial.print("-20"); Serial.print(dt.year);
+    Serial.println();
+  }
   // The time data is send whenever other data (temp, pressure, electr, solar) is send to GLCDnode.
   // So this send command is (and remains) commented out!
   //rf12_sendNow(0, &s_data, sizeof s_data);
@@ -286,7 +373,7 @@ void sendTime() {
 
 
 void init_rf12 () {
-  rf12_initialize(30, RF12_868MHZ, 5); // 868 Mhz, net group 5, node 30
+  rf12_initialize(NODE_ID, RF12_868MHZ, 5); // 868 Mhz, net group 5, node 30
 }
 
 
@@ -310,10 +397,14 @@ void setup () {
 }
 
 void loop () {
+  boolean framed;
+
   if (rf12_recvDone() && rf12_crc == 0) {
     if (rf12_len == sizeof (s_payload_t)) {
       s_data = *(s_payload_t*) rf12_data;
-      switch (s_data.type)
+      updateSensorState();
+      framed = FRAMES && sendSensorFrame(rf12_hdr & RF12_HDR_MASK);
+      if (!framed) switch (s_data.type)
       {
       case 'a':  // Appliance power measurement
         {
@@ -335,7 +426,6 @@ void loop () {
         {
           showString(PSTR("e "));
           Serial.print(s_data.var1);
-          watt = (int)s_data.var1;
           showString(PSTR(" "));
           Serial.print(s_data.var2);
           break;
@@ -360,8 +450,6 @@ void loop () {
         {
           showString(PSTR("i "));
           Serial.print(s_data.var1);
-          itemp=(int)s_data.var1;
-          itemp_float=(float)s_data.var1/10;
           showString(PSTR(" "));
           break;
         }
@@ -369,7 +457,6 @@ void loop () {
         {
           showString(PSTR("s "));
           Serial.print(s_data.var1);
-          swatt = (int)s_data.var1;
           showString(PSTR(" "));
           Serial.print(s_data.var2);
           showString(PSTR(" "));
@@ -408,10 +495,11 @@ void loop () {
       if (RF12_WANTS_ACK) {
         rf12_sendStart(RF12_ACK_REPLY, 0, 0);
       }
-      Serial.println("");
+      if (!framed) Serial.println("");
     } else if (rf12_len == sizeof (l_payload_t)) {
       l_data = *(l_payload_t*) rf12_data;
-      switch (l_data.type)
+      framed = FRAMES && sendStatusFrame(rf12_hdr & RF12_HDR_MASK);
+      if (!framed) switch (l_data.type)
       {
       case 'l':  // display sensor settings
         {
@@ -473,7 +561,7 @@ void loop () {
       if (RF12_WANTS_ACK) {
         rf12_sendStart(RF12_ACK_REPLY, 0, 0);
       }
-      Serial.println("");
+      if (!framed) Serial.println("");
     }
   }
 
@@ -46,6 +46,16 @@ const int UNO = 1;    // Set to 0 if your not using the UNO bootloader (i.e usin
 #include <avr/wdt.h>  // All Jeenodes have the UNO bootloader
 ISR(WDT_vect) { Sleepy::watchdogEvent(); }
 
+#define SAMPLE_RING 64  // samples waiting for loop(), a power of 2 (64 = 128 ms)
+#define SAMPLE_MS 2     // Timer2 takes a sample every 2 ms
+#define PULSE_MS 20     // an indicator LED is on for 20 ms per rotation
+#define EDGE_RES 16     // times of the marks in 1/16 ms
+#define WATT_T (6000000L*EDGE_RES)  // watt * time of a rotation: my kwh meter says 600 rotations per kwh
+#define MIN_SPAN 160    // smallest size of a mark the trigger values follow, the readings differ 60 between them
+#define EEPROM_DELTA 50 // write the trigger values to eeprom when the size of a mark moved this much
+#define BASE_OFFSET 150 // trigger value in eeprom away from the mark: this far from the base
+#define MARK_OFFSET 75  // trigger value in eeprom to the mark: this far from the mark
+
 #define SENSOR_EEPROM_ADDR 0x60  //96 = 0x60
 
 // **** START of var declarations ****
@@ -78,14 +88,34 @@ typedef struct { char command[5];
 } eeprom_command_t;  // EEprom command payload, size = 7 bytes
 eeprom_command_t change_eeprom;
 
+// pulses of the indicator LEDs: flashd() switches a LED on, pulse_off() switches it off in loop()
+typedef struct { Port *led;
+  boolean on;
+  unsigned long onMs;  // millis() when switched on
+} pulse_t;
+pulse_t electr_pulse = { &electr_led, 0, 0 };
+pulse_t gas_pulse = { &gas_led, 0, 0 };
+pulse_t water_pulse = { &water_led, 0, 0 };
+
+// samples taken by the interrupts: the Timer2 ISR starts a scan of the four sensors every 2 ms,
+// the ADC ISR reads them one after the other and puts them in the ring for loop()
+typedef struct { byte tick;  // low byte of the Timer2 tick of the sample
+  int left; int right; int gas; int water;
+} sample_t;
+sample_t sampleRing[SAMPLE_RING];
+volatile byte sampleHead = 0;        // written by the ADC ISR
+volatile byte sampleTail = 0;        // written by loop()
+volatile byte sampleTicks = 0;       // Timer2 ticks
+volatile byte scanChannel = 0;       // ADC channel of the scan: AIO1-AIO4 = ADC0-ADC3
+int scan[4];
+volatile unsigned long samplesLost = 0;  // the ring was full
+unsigned long sampleMs = 0;          // time of the sample loop() processes, like millis()
+byte sampleTick = 0;
+
 // timers
-Metro sampleMetro = Metro(2);            // Sample the sensors every 2 ms
 Metro wdtMetro = Metro(1000);            // reset watchdog timer every 1 sec
-Metro EeepromMetro = Metro(604800000);   // write mean measured electricity sensor trigger values to eeprom every 1 week
-Metro GeepromMetro = Metro(604800000);   // write mean measured gas sensor trigger values to eeprom every 1 week
-Metro WeepromMetro = Metro(604800000);   // write mean measured water sensor trigger values to eeprom every 1 week
-//Metro EeepromMetro = Metro(86400000);   // write mean measured electricity sensor trigger values to eeprom every day
-//Metro GeepromMetro = Metro(86400000);   // write mean measured gas sensor trigger values to eeprom every day
+Metro trackMetro = Metro(1000);          // set the trigger values from the followed sensor levels every 1 sec
+Metro eepromMetro = Metro(3600000);      // shrink unseen marks, write moved sensor trigger values to eeprom every 1 hour
 
 // vars read from eeprom
 int minLeft;
@@ -139,10 +169,13 @@ long gas_ltr = 0;
 long w_rotations = 0;
 long water_ltr = 0;
 
-unsigned long Ms = 0;         // timestamp of current peak
-unsigned long prevMs = 0;     // timestamp of last peak
-unsigned long prevprevMs = 0; // timestamp of 2nd last peak
-long rotationMs = 0;
+unsigned long edgeT = 0;         // timestamp of current peak (1/16 ms)
+unsigned long prevEdgeT = 0;     // timestamp of last peak
+unsigned long prevprevEdgeT = 0; // timestamp of 2nd last peak
+unsigned long rotationT = 0;     // time of the last rotation (1/16 ms), 0 = not known (first peak after boot)
+int prevLeft = 0;                // reading of the left sensor in the sample before
+long sentWatt = 0;               // power sent last
+unsigned long boundT = 0;        // time after the last peak the power is at most 3/4 of sentWatt, 0 = none
 
 // vars for sending/displaying readings
 int e_onceDone = 0;
@@ -168,32 +201,15 @@ char b;
 int do_write = 0;
 int do_report = 0;
 
-// vars for updating sensor trigger values in eeprom
-typedef struct { int e_minL, e_maxL;
-  int e_minR, e_maxR;
-} Eset;
-
-typedef struct { int g_min, g_max;
-} Gset;
-
-typedef struct { int w_min, w_max;
-} Wset;
-
-Eset Evalues[10];
-Gset Gvalues[10];
-Wset Wvalues[10];
-boolean do_save_Evalues = 0;
-boolean do_save_Gvalues = 0;
-boolean do_save_Wvalues = 0;
-int Ecounter;
-char Ei;
-int Gcounter;
-char Gi;
-int Wcounter;
-char Wi;
-int meanMinL, meanMaxL, meanMinR, meanMaxR;
-int meanMinG, meanMaxG;
-int meanMinW, meanMaxW;
+// vars for following the sensors: the reading away from the mark (base) follows the sunlight on the sensor,
+// the size of the mark is measured each time it passed, it fades with the led of the sensor.
+// Trigger values: to the mark at 3/4 of the span, away from it at 3/8 of the span. The span is the size
+// of the mark, it shrinks while no mark passes, in case the mark faded below the trigger value.
+typedef struct { int base16;  // reading away from the mark (1/16)
+  int mark16;                 // reading at the mark minus base (1/16), < 0 when the mark reads lower
+  int span16;                 // mark16, shrunk since the last mark passed
+} track_t;
+track_t trackLeft, trackRight, trackGas, trackWater;
 
 // **** END of var declarations ****
 
@@ -338,10 +354,283 @@ void interpret_command() {
 }
 
 
-void flashd(Port light) {
-  light.digiWrite(1);
-  delay(20);
-  light.digiWrite(0);
+// a mark comes to the sensor, with this reading at its lowest (electricity) or highest (gas, water)
+// since the last one: the base level
+void track_base(track_t &t, int light) {
+  t.base16=t.base16+((long)light*16-t.base16)/4;
+}
+
+
+// a reading between the marks further away from the mark than the base: follow it in half a second
+// (1/256 per sample), the meter may not turn for hours while the sun comes on the sensor
+void track_away(track_t &t, int light) {
+  int away=light*16-t.base16;
+
+  if ( (t.mark16 > 0) ? (away < 0) : (away > 0) ) t.base16=t.base16+away/256;
+}
+
+
+// every second between the marks: follow the reading towards the mark too, slowly (1/512 per second,
+// 8 minutes) as the sun comes on the sensor, a mark passing in seconds hardly moves the base
+void track_drift(track_t &t, boolean state, int light) {
+  if (state == 0) t.base16=t.base16+(light*16-t.base16)/512;
+}
+
+
+// a mark passed the sensor, with this reading at its highest (electricity) or lowest (gas, water)
+void track_mark(track_t &t, int light) {
+  t.mark16=t.mark16+((long)light*16-t.base16-t.mark16)/4;
+  t.span16=t.mark16;
+}
+
+
+// the trigger values in eeprom are as the weekly mean of the peaks set them: BASE_OFFSET from the base
+// to the mark and MARK_OFFSET from the mark back; dir is 1 when the mark reads higher (electricity),
+// -1 when it reads lower (gas, water)
+void track_set(track_t &t, int toMark, int fromMark, int dir) {
+  t.base16=constrain((long)(fromMark-dir*BASE_OFFSET)*16, 0, 16368);
+  t.mark16=constrain((long)(toMark+dir*MARK_OFFSET)*16-t.base16, -16368, 16368);
+  t.span16=t.mark16;
+}
+
+
+int trigger(track_t &t, int eighths) {
+  return (t.base16+(long)t.span16*eighths/8)/16;
+}
+
+
+// the trigger values to save in eeprom, with the size of the mark as it was measured
+int saved_from(track_t &t, int dir) {
+  return t.base16/16+dir*BASE_OFFSET;
+}
+
+
+int saved_to(track_t &t, int dir) {
+  return (t.base16+t.mark16)/16-dir*MARK_OFFSET;
+}
+
+
+// the size of the mark moved from the one of the trigger values in eeprom, a moved base is followed
+// again at the first mark after a reset
+boolean moved(track_t &t, int toMark, int fromMark, int dir) {
+  return abs(t.mark16/16-(toMark-fromMark)-dir*(MARK_OFFSET+BASE_OFFSET)) >= EEPROM_DELTA;
+}
+
+
+// no mark passed a sensor for a while, its mark may have faded more than a mark follows: let the span
+// shrink a bit (1/512 per hour, to MIN_SPAN). Slowly, gas and water meters stand still for nights and
+// holidays and sunlight may move the reading towards the mark then. Only while the sensor sees the base,
+// a meter that stopped with its mark half at the sensor would count it when the trigger value reaches
+// the reading.
+void shrink(track_t &t, boolean state, int light) {
+  if ( (state == 0)&&(abs(t.span16) > MIN_SPAN*16)&&(abs(light*16-t.base16) < abs(t.span16)/8) ) {
+    t.span16-=t.span16/512;
+  }
+}
+
+
+void shrink_spans() {
+  shrink(trackLeft, stateLeft, lightLeft);
+  shrink(trackRight, stateRight, lightRight);
+  shrink(trackGas, stateGas, lightGas);
+  shrink(trackWater, stateWater, lightWater);
+}
+
+
+// to the mark at 3/4 of the span, away from it at 3/8
+void set_triggers() {
+  maxLeft=trigger(trackLeft, 6);
+  minLeft=trigger(trackLeft, 3);
+  maxRight=trigger(trackRight, 6);
+  minRight=trigger(trackRight, 3);
+  minGas=trigger(trackGas, 6);
+  maxGas=trigger(trackGas, 3);
+  minWater=trigger(trackWater, 6);
+  maxWater=trigger(trackWater, 3);
+}
+
+
+void track_eeprom() {
+  track_set(trackLeft, maxLeft, minLeft, 1);
+  track_set(trackRight, maxRight, minRight, 1);
+  track_set(trackGas, minGas, maxGas, -1);
+  track_set(trackWater, minWater, maxWater, -1);
+  set_triggers();
+}
+
+
+// write the trigger values of a meter to eeprom when the size of one of its marks moved, and report them
+void save_triggers() {
+  boolean e_moved=moved(trackLeft, rconfig.e_maxL, rconfig.e_minL, 1) || moved(trackRight, rconfig.e_maxR, rconfig.e_minR, 1);
+  boolean g_moved=moved(trackGas, rconfig.g_min, rconfig.g_max, -1);
+  boolean w_moved=moved(trackWater, rconfig.w_min, rconfig.w_max, -1);
+
+  if (!e_moved && !g_moved && !w_moved) {
+    return;
+  }
+  // fill all eeprom trigger values, the ones of the meters that did not move remain unchanged
+  wconfig.e_minL=e_moved ? saved_from(trackLeft, 1) : rconfig.e_minL;
+  wconfig.e_maxL=e_moved ? saved_to(trackLeft, 1) : rconfig.e_maxL;
+  wconfig.e_minR=e_moved ? saved_from(trackRight, 1) : rconfig.e_minR;
+  wconfig.e_maxR=e_moved ? saved_to(trackRight, 1) : rconfig.e_maxR;
+  wconfig.g_min=g_moved ? saved_to(trackGas, -1) : rconfig.g_min;
+  wconfig.g_max=g_moved ? saved_from(trackGas, -1) : rconfig.g_max;
+  wconfig.w_min=w_moved ? saved_to(trackWater, -1) : rconfig.w_min;
+  wconfig.w_max=w_moved ? saved_from(trackWater, -1) : rconfig.w_max;
+  write_eeprom();
+  read_eeprom();
+  set_triggers();  // read_eeprom() set the saved ones, the followed ones differ
+  if (e_moved) {
+    // Send the adjusted electricity sensor trigger values
+    l_data.type='z'; // type is electricity sensor trigger values
+    l_data.minA=wconfig.e_minL; l_data.maxA=wconfig.e_maxL;
+    l_data.minB=wconfig.e_minR; l_data.maxB=wconfig.e_maxR;
+    rf12_sendNow(0, &l_data, sizeof l_data);
+  }
+  if (g_moved) {
+    // Send the adjusted gas sensor trigger values
+    l_data.type='y'; // type is gas sensor trigger values
+    l_data.minA=wconfig.g_min; l_data.maxA=wconfig.g_max;
+    rf12_sendNow(0, &l_data, sizeof l_data);
+  }
+  if (w_moved) {
+    // Send the adjusted water sensor trigger values
+    l_data.type='x'; // type is water sensor trigger values
+    l_data.minA=wconfig.w_min; l_data.maxA=wconfig.w_max;
+    rf12_sendNow(0, &l_data, sizeof l_data);
+  }
+  #if DEBUG
+  Serial.print("Adjusted sensor trigger values: L:");
+  Serial.print(wconfig.e_minL);
+  Serial.print("->");
+  Serial.print(wconfig.e_maxL);
+  Serial.print(" R:");
+  Serial.print(wconfig.e_minR);
+  Serial.print("->");
+  Serial.print(wconfig.e_maxR);
+  Serial.print(" G:");
+  Serial.print(wconfig.g_min);
+  Serial.print("->");
+  Serial.print(wconfig.g_max);
+  Serial.print(" W:");
+  Serial.print(wconfig.w_min);
+  Serial.print("->");
+  Serial.print(wconfig.w_max);
+  Serial.println("");
+  #endif
+}
+
+
+void flashd(pulse_t &pulse) {
+  pulse.led->digiWrite(1);
+  pulse.on=1;
+  pulse.onMs=millis();
+}
+
+
+void pulse_off(pulse_t &pulse) {
+  if ( (pulse.on) && (millis()-pulse.onMs >= PULSE_MS) ) {  // overflow safe
+    pulse.led->digiWrite(0);
+    pulse.on=0;
+  }
+}
+
+
+ISR(TIMER2_COMPA_vect) {
+  sampleTicks++;
+  scanChannel=0;
+  ADMUX=_BV(REFS0);  // AVcc as reference, ADC0
+  ADCSRA|=_BV(ADSC);
+}
+
+
+ISR(ADC_vect) {
+  byte next;
+
+  scan[scanChannel]=ADC;
+  if (++scanChannel < 4) {
+    ADMUX=_BV(REFS0) | scanChannel;
+    ADCSRA|=_BV(ADSC);
+  } else {
+    next=(sampleHead+1) & (SAMPLE_RING-1);
+    if (next == sampleTail) {  // loop() is too far behind, drop the sample
+      samplesLost++;
+    } else {
+      sampleRing[sampleHead].tick=sampleTicks;
+      sampleRing[sampleHead].left=scan[0];
+      sampleRing[sampleHead].right=scan[1];
+      sampleRing[sampleHead].gas=scan[2];
+      sampleRing[sampleHead].water=scan[3];
+      sampleHead=next;
+    }
+  }
+}
+
+
+void start_sampling() {
+  sampleMs=millis();
+  // Timer2 in CTC mode, 16 MHz / 128 / 250: a compare match every 2 ms
+  TCCR2A=_BV(WGM21);
+  TCCR2B=_BV(CS22) | _BV(CS20);
+  OCR2A=249;
+  TIMSK2=_BV(OCIE2A);
+  // ADC on with a 125 kHz clock (16 MHz / 128), 104 us per conversion, interrupt when done
+  ADCSRA=_BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+
+// take the next sample from the ring, its time follows from the ticks, also over dropped samples
+boolean get_sample() {
+  sample_t *s;
+
+  if (sampleTail == sampleHead) {
+    return 0;
+  }
+  s=&sampleRing[sampleTail];
+  prevLeft=lightLeft;
+  sampleMs=sampleMs+(byte)(s->tick-sampleTick)*SAMPLE_MS;
+  sampleTick=s->tick;
+  lightLeft=s->left;
+  lightRight=s->right;
+  lightGas=s->gas;
+  lightWater=s->water;
+  sampleTail=(sampleTail+1) & (SAMPLE_RING-1);
+  return 1;
+}
+
+
+// time the light crossed the trigger value between the sample before and this one,
+// interpolated on the straight line between both readings
+unsigned long crossing_time(int before, int now, int trigger) {
+  unsigned long t=sampleMs*EDGE_RES;
+
+  if ( (now > before) && (trigger >= before) && (trigger < now) ) {
+    t=t-(long)(now-trigger)*SAMPLE_MS*EDGE_RES/(now-before);
+  }
+  return t;
+}
+
+
+// send the power, with the time of the mark after which it is less than 3/4 of it
+void send_power(long w) {
+  s_data.type='e'; // type is electricity data
+  s_data.var1=w;
+  s_data.var2=e_rotations;
+  rf12_sendNow(0, &s_data, sizeof s_data);
+  sentWatt=w;
+  if (labs(w) >= 5) {
+    boundT=WATT_T/3*4/labs(w);
+  } else {
+    boundT=0;  // the disc (nearly) stands still
+  }
+}
+
+
+// a reading is found that loop() has not reported yet
+boolean reading_due() {
+  return ((e_onceDone == 1)&&(e_onceDisplayed == 0)&&(maxLeft-minLeft > 50))
+    || ((g_onceDone == 1)&&(g_onceDisplayed == 0)&&(maxGas-minGas > 50))
+    || ((w_onceDone == 1)&&(w_onceDisplayed == 0)&&(maxWater-minWater > 50));
 }
 
 
@@ -364,22 +653,19 @@ void setup() {
   portWater.mode(INPUT);
   water_led.mode(OUTPUT);
 
-  // initialise min-max values for sensors
+  // initialise min-max values for sensors, they are followed from there
   read_eeprom();
+  track_eeprom();
+
+  start_sampling();
   
   if (UNO) wdt_enable(WDTO_8S);  // set timeout to 8 seconds
 }
 
 
 void loop() {
-  // take a reading from the sensors 
-  if ( sampleMetro.check() ) {
-    // read sensors
-    lightLeft=portLeft.anaRead();
-    lightRight=portRight.anaRead();
-    lightGas=portGas.anaRead();
-    lightWater=portWater.anaRead();
-
+  // process the samples taken since the last loop(), a new reading is reported before the next sample
+  while ( !reading_due() && get_sample() ) {
     // to monitor changing peak & valley sizes, we follow the sizes continuously
     // the found sizes serve as the target for the next detection
     
@@ -442,39 +728,34 @@ void loop() {
       e_report_direction=e_direction;  // direction power calculations is the current direction
       if ( e_onceDone == 0) {
         if (direction_changed) {
-          // calculate time between the last two peaks, now and prevprevMs (because of direction change)
+          // calculate time between the last two peaks, now and prevprevEdgeT (because of direction change)
           //   timed only once during stateLeft = 1
-          Ms=millis(); // 4 bytes, 32 bits, = 49.7 days
-          if (Ms < prevprevMs) {	// Overflow protection (use preprevMs because of direction change)
-            rotationMs=(4294967295-prevprevMs)+Ms;
-          } else {
-            rotationMs=Ms-prevprevMs;             
-          }
-          prevprevMs=prevMs;
-          prevMs=Ms;
+          edgeT=crossing_time(prevLeft, lightLeft, maxLeft); // 4 bytes, 32 bits, = 3.1 days
+          // unsigned subtraction is right over the overflow (use prevprevEdgeT because of direction change)
+          rotationT = (prevprevEdgeT != 0) ? (unsigned long)(edgeT - prevprevEdgeT) : 0;
+          prevprevEdgeT=prevEdgeT;
+          prevEdgeT=edgeT;
           e_onceDone=1;
           e_onceDisplayed=0;
           direction_changed=0;
           e_report_direction=e_prev_direction;  // direction for power calculations is the previous direction,
           //   because no full rotation has been made the timing is of.
-          //   To compensate, prevprevMs is used. To display a sensible
+          //   To compensate, prevprevEdgeT is used. To display a sensible
           //   powervalue, the previous direction is used here.
         } else {
-          // calculate time between the last two peaks, now and prevMs timed only once during stateLeft = 1
-          Ms=millis(); // 4 bytes, 32 bits, = 49.7 days
-          if (Ms < prevMs) {	// Overflow protection
-            rotationMs=(4294967295-prevMs)+Ms;
-          } else {
-            rotationMs=Ms-prevMs;             
-          }
-          prevprevMs=prevMs;
-          prevMs=Ms;
+          // calculate time between the last two peaks, now and prevEdgeT timed only once during stateLeft = 1
+          edgeT=crossing_time(prevLeft, lightLeft, maxLeft); // 4 bytes, 32 bits, = 3.1 days
+          // unsigned subtraction is right over the overflow
+          rotationT = (prevEdgeT != 0) ? (unsigned long)(edgeT - prevEdgeT) : 0;
+          prevprevEdgeT=prevEdgeT;
+          prevEdgeT=edgeT;
           e_onceDone=1;
           e_onceDisplayed=0;
         }
       }
       mminLeft=currMinLeft;  // going to minimum, reset minimum value of left sensor
       currMinLeft=1024;
+      track_base(trackLeft, mminLeft);
     } else if ( (stateLeft == 1) && (lightLeft < minLeft) ) {  // the mark is not at the left sensor, light below threshold
       stateLeft=0;
       #if DEBUG                    
@@ -482,6 +763,7 @@ void loop() {
       #endif
       mmaxLeft=currMaxLeft;  // going to a maximum, reset maximum value of left sensor
       currMaxLeft=0;
+      track_mark(trackLeft, mmaxLeft);
       e_onceDone=0; // reset e_onceDone in a minimum
     }
     
@@ -492,6 +774,7 @@ void loop() {
       #endif
       mminRight=currMinRight;  // going to a minimum, reset minimum value of right sensor
       currMinRight=1024;
+      track_base(trackRight, mminRight);
     } else if ( (stateRight == 1) && (lightRight < minRight) ) {  // the mark is not at the right sensor, light above threshold
       stateRight=0;
       #if DEBUG                    
@@ -499,6 +782,7 @@ void loop() {
       #endif
       mmaxRight=currMaxRight;  // going to a maximum, reset maximum value of right sensor
       currMaxRight=0;
+      track_mark(trackRight, mmaxRight);
     }
     
     //
@@ -513,6 +797,7 @@ void loop() {
       #endif
       mmaxGas=currMaxGas;  // going to a maximum, reset maximum value of Gas sensor
       currMaxGas=0;
+      track_base(trackGas, mmaxGas);
       // Set appropriate values only once in during stateGas = 1
       if (g_onceDone == 0) {
         g_onceDone=1;
@@ -525,6 +810,7 @@ void loop() {
       #endif
       mminGas=currMinGas;  // going to a minimum, reset minimum value of Gas sensor
       currMinGas=1024;
+      track_mark(trackGas, mminGas);
       g_onceDone=0; // reset g_onceDone in a minimum
     }
 
@@ -540,6 +826,7 @@ void loop() {
       #endif
       mmaxWater=currMaxWater;  // going to a maximum, reset maximum value of Water sensor
       currMaxWater=0;
+      track_base(trackWater, mmaxWater);
       // Set appropriate values only once in during stateWater = 1
       if (w_onceDone == 0) {
         w_onceDone=1;
@@ -552,33 +839,47 @@ void loop() {
       #endif
       mminWater=currMinWater;  // going to a minimum, reset minimum value of Water sensor
       currMinWater=1024;
+      track_mark(trackWater, mminWater);
       w_onceDone=0; // reset w_onceDone in a minimum
     }
-  } /* if ( sampleMetro.check() ) */
+
+    // follow the readings away from the marks
+    if (stateLeft == 0) track_away(trackLeft, lightLeft);
+    if (stateRight == 0) track_away(trackRight, lightRight);
+    if (stateGas == 0) track_away(trackGas, lightGas);
+    if (stateWater == 0) track_away(trackWater, lightWater);
+  } /* while ( get_sample() ) */
+
+  // switch the indicator LEDs off when their pulse is over
+  pulse_off(electr_pulse);
+  pulse_off(gas_pulse);
+  pulse_off(water_pulse);
 
   
   
   // Electricity:
+  // the first peak after boot only starts the timing, its rotation time is not known
+  if ((e_onceDone == 1)&&(e_onceDisplayed == 0)&&(rotationT == 0) ) {
+    e_onceDisplayed=1;
+  }
   // print current status when in maximum and not displayed before in this maximum
   if ((e_onceDone == 1)&&(e_onceDisplayed == 0)&&(maxLeft-minLeft > 50) ) {
-    watt=e_report_direction*6000000/rotationMs; // my kwh meter says 600 rotations per kwh
+    watt=e_report_direction*(long)(WATT_T/rotationT);
     // count rotations only if the number of watts is sensible
     if ((watt > -600)&&(watt < 7500)) {
       e_rotations=e_rotations+e_direction; // = +1 when e_direction=1, = -1 when e_direction=-1
-      flashd(electr_led);
+      flashd(electr_pulse);
     }
-    s_data.type='e'; // type is electricity data
-    s_data.var1=watt;
-    s_data.var2=e_rotations;
-    rf12_sendNow(0, &s_data, sizeof s_data);
+    send_power(watt);
     #if DEBUG                    
     Serial.print("e ");
     Serial.print(watt);
     Serial.print(" Watt, count=");
     Serial.print(e_rotations);
     Serial.print(", time=");
-    Serial.print(rotationMs);
-    Serial.print(" ms");
+    Serial.print(rotationT/EDGE_RES);
+    Serial.print(" ms, lost samples=");
+    Serial.print(samplesLost);
     Serial.print(",   measured min-max: L:");
     Serial.print(mminLeft);
     Serial.print("->");
@@ -590,60 +891,27 @@ void loop() {
     Serial.println("");
     #endif
     e_onceDisplayed=1;
-    
-    if (do_save_Evalues) {
-      #if DEBUG
-      Serial.print("Enter do_save_Evalues "); Serial.println(Ecounter);
-      #endif
-      Evalues[Ecounter].e_minL=mminLeft;  Evalues[Ecounter].e_maxL=mmaxLeft;
-      Evalues[Ecounter].e_minR=mminRight; Evalues[Ecounter].e_maxR=mmaxRight;
-      Ecounter++;
-      if (Ecounter > 9) {
-        do_save_Evalues=0;
-        meanMinL=0; meanMaxL=0; meanMinR=0; meanMaxR=0;
-        for (Ei=0; Ei < 10; Ei++) {
-          meanMinL+=Evalues[Ei].e_minL; meanMaxL+=Evalues[Ei].e_maxL;
-          meanMinR+=Evalues[Ei].e_minR; meanMaxR+=Evalues[Ei].e_maxR;
-        }
-        meanMinL=meanMinL/10; meanMaxL=meanMaxL/10; meanMinR=meanMinR/10; meanMaxR=meanMaxR/10;
-        // fill all eeprom trigger values
-        wconfig.e_minL=meanMinL+150;
-        wconfig.e_maxL=meanMaxL-75;
-        wconfig.e_minR=meanMinR+150;
-        wconfig.e_maxR=meanMaxR-75;
-        wconfig.g_min=rconfig.g_min;
-        wconfig.g_max=rconfig.g_max;
-        wconfig.w_min=rconfig.w_min;
-        wconfig.w_max=rconfig.w_max;
-        write_eeprom();
-        read_eeprom();
-        // Send the adjusted electricity sensor trigger values
-        l_data.type='z'; // type is electricity sensor trigger values
-        l_data.minA=wconfig.e_minL; l_data.maxA=wconfig.e_maxL;
-        l_data.minB=wconfig.e_minR; l_data.maxB=wconfig.e_maxR;
-        rf12_sendNow(0, &l_data, sizeof l_data);
-        #if DEBUG                    
-        Serial.print("z ");
-        Serial.print("Adjusted electricity sensor trigger values: L:");
-        Serial.print(wconfig.e_minL);
-        Serial.print("->");
-        Serial.print(wconfig.e_maxL);
-        Serial.print(" R:");
-        Serial.print(wconfig.e_minR);
-        Serial.print("->");
-        Serial.print(wconfig.e_maxR);
-        Serial.println("");
-        #endif
-      }
-    }
   }
   
+  // Electricity:
+  // no peak for longer than the last rotation took: the disc turns slower, the power is at most what one
+  // rotation in the time since the last peak gives. Sent each time it is 3/4 of the power sent before.
+  if ( (boundT != 0)&&(sampleMs*EDGE_RES-prevEdgeT >= boundT)&&(maxLeft-minLeft > 50) ) {
+    watt=e_report_direction*(WATT_T/(sampleMs*EDGE_RES-prevEdgeT));
+    send_power(watt);
+    #if DEBUG
+    Serial.print("e ");
+    Serial.print(watt);
+    Serial.println(" Watt at most");
+    #endif
+  }
+
   // Gas:
   // print current status when in maximum and not displayed before in this maximum
   if ((g_onceDone == 1)&&(g_onceDisplayed == 0)&&(maxGas-minGas > 50) ) {
     gas_ltr=gas_ltr+10;
     g_rotations++;
-    flashd(gas_led);
+    flashd(gas_pulse);
     s_data.type='g'; // type is gas data
     s_data.var1=gas_ltr;
     s_data.var2=g_rotations;
@@ -660,45 +928,6 @@ void loop() {
     Serial.println("");
     #endif
     g_onceDisplayed=1;
-    
-    if (do_save_Gvalues) {
-      #if DEBUG
-      Serial.print("Enter do_save_Gvalues "); Serial.println(Gcounter);
-      #endif
-      Gvalues[Gcounter].g_min=mminGas;  Gvalues[Gcounter].g_max=mmaxGas;
-      Gcounter++;
-      if (Gcounter > 9) {
-        do_save_Gvalues=0;
-        meanMinG=0; meanMaxG=0;
-        for (Gi=0; Gi < 10; Gi++) {
-          meanMinG+=Gvalues[Gi].g_min; meanMaxG+=Gvalues[Gi].g_max;
-        }
-        meanMinG=meanMinG/10; meanMaxG=meanMaxG/10;
-        // fill all eeprom trigger values
-        wconfig.e_minL=rconfig.e_minL;
-        wconfig.e_maxL=rconfig.e_maxL;
-        wconfig.e_minR=rconfig.e_minR;
-        wconfig.e_maxR=rconfig.e_maxR;
-        wconfig.g_min=meanMinG+75;
-        wconfig.g_max=meanMaxG-150;
-        wconfig.w_min=rconfig.w_min;
-        wconfig.w_max=rconfig.w_max;
-        write_eeprom();
-        read_eeprom();
-        // Send the adjusted gas sensor trigger values
-        l_data.type='y'; // type is gas sensor trigger values
-        l_data.minA=wconfig.g_min; l_data.maxA=wconfig.g_max;
-        rf12_sendNow(0, &l_data, sizeof l_data);
-        #if DEBUG                    
-        Serial.print("y ");
-        Serial.print("Adjusted gas sensor trigger values: ");
-        Serial.print(wconfig.g_min);
-        Serial.print("->");
-        Serial.print(wconfig.g_max);
-        Serial.println("");
-        #endif
-      }
-    }
   }
 
   // Water:
@@ -706,7 +935,7 @@ void loop() {
   if ((w_onceDone == 1)&&(w_onceDisplayed == 0)&&(maxWater-minWater > 50) ) {
     water_ltr=water_ltr+1;
     w_rotations++;
-    flashd(water_led);
+    flashd(water_pulse);
     s_data.type='w'; // type is water data
     s_data.var1=water_ltr;
     s_data.var2=w_rotations;
@@ -723,45 +952,6 @@ void loop() {
     Serial.println("");
     #endif
     w_onceDisplayed=1;
-    
-    if (do_save_Wvalues) {
-      #if DEBUG
-      Serial.print("Enter do_save_Wvalues "); Serial.println(Wcounter);
-      #endif
-      Wvalues[Wcounter].w_min=mminWater;  Wvalues[Wcounter].w_max=mmaxWater;
-      Wcounter++;
-      if (Wcounter > 9) {
-        do_save_Wvalues=0;
-        meanMinW=0; meanMaxW=0;
-        for (Wi=0; Wi < 10; Wi++) {
-          meanMinW+=Wvalues[Wi].w_min; meanMaxW+=Wvalues[Wi].w_max;
-        }
-        meanMinW=meanMinW/10; meanMaxW=meanMaxW/10;
-        // fill all eeprom trigger values
-        wconfig.e_minL=rconfig.e_minL;
-        wconfig.e_maxL=rconfig.e_maxL;
-        wconfig.e_minR=rconfig.e_minR;
-        wconfig.e_maxR=rconfig.e_maxR;
-        wconfig.g_min=rconfig.g_min;
-        wconfig.g_max=rconfig.g_max;
-        wconfig.w_min=meanMinW+75;
-        wconfig.w_max=meanMaxW-150;
-        write_eeprom();
-        read_eeprom();
-        // Send the adjusted water sensor trigger values
-        l_data.type='x'; // type is water sensor trigger values
-        l_data.minA=wconfig.w_min; l_data.maxA=wconfig.w_max;
-        rf12_sendNow(0, &l_data, sizeof l_data);
-        #if DEBUG                    
-        Serial.print("x ");
-        Serial.print("Adjusted water sensor trigger values: ");
-        Serial.print(wconfig.w_min);
-        Serial.print("->");
-        Serial.print(wconfig.w_max);
-        Serial.println("");
-        #endif
-      }
-    }
   }
   
   // receive command for changing eeprom values or report settings
@@ -775,6 +965,7 @@ void loop() {
     if (do_write) {
       write_eeprom();
       read_eeprom();
+      track_eeprom();
       do_write=0;
     }
     if (do_report) {
@@ -787,19 +978,17 @@ void loop() {
     if (UNO) wdt_reset();
   }
   
-  if ( EeepromMetro.check() ) {
-    do_save_Evalues=1;
-    Ecounter=0;
-  }
-  
-  if ( GeepromMetro.check() ) {
-    do_save_Gvalues=1;
-    Gcounter=0;
+  if ( trackMetro.check() ) {
+    track_drift(trackLeft, stateLeft, lightLeft);
+    track_drift(trackRight, stateRight, lightRight);
+    track_drift(trackGas, stateGas, lightGas);
+    track_drift(trackWater, stateWater, lightWater);
+    set_triggers();
   }
 
-  if ( WeepromMetro.check() ) {
-    do_save_Wvalues=1;
-    Wcounter=0;
+  if ( eepromMetro.check() ) {
+    shrink_spans();
+    save_triggers();
   }
 }
 
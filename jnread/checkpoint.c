@@ -0,0 +1,156 @@
+/*
+#################################################################################
+# checkpoint.c - Crash-safe storage of the counter values (ACTUAL_LOG)         #
+#                                                                               #
+# See checkpoint.h for the interface.                                           #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+#define CP_LINE_LEN 2048
+
+
+/* FUNCTION to compute the checksum (32 bit FNV-1a) of a string */
+static unsigned long cp_checksum(const char *s, size_t len)
+{
+  unsigned long h = 2166136261UL;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    h ^= (unsigned char)s[i];
+    h = (h * 16777619UL) & 0xffffffffUL;
+  }
+  return(h);
+}
+
+
+/* FUNCTION to validate and parse one checkpoint file, returns 0 when valid
+*  The values are only changed when the file is valid, *found is set to the
+*  no. of values in the file (at most n).
+*/
+static int cp_parse(const char *path, long *values, int n, int *found)
+{
+  char line[CP_LINE_LEN], *p, *end, *star;
+  long v[CP_MAX_VALUES];
+  unsigned long sum;
+  FILE *fp;
+  int i, checked = 0;
+
+  if (n > CP_MAX_VALUES || (fp = fopen(path, "r")) == NULL) {
+    return(1);
+  }
+  if (fgets(line, sizeof(line), fp) == NULL) {
+    fclose(fp);
+    return(1);
+  }
+  fclose(fp);
+  if ((star = strchr(line, '*')) != NULL) {
+    errno = 0;
+    sum = strtoul(star + 1, &end, 16);
+    if (errno != 0 || end == star + 1 || cp_checksum(line, star - line) != sum) {
+      return(1);
+    }
+    *star = '\0';
+    checked = 1;
+  } else if (strchr(line, '\n') == NULL) {
+    return(1);    // old format, but truncated
+  }
+  /* there may be fewer values (a meter was added), only with a checksum
+  *  also more (a meter was removed)
+  */
+  p = line;
+  for (i = 0; i < n; i++) {
+    while (*p == ' ') {
+      p++;
+    }
+    if ((*p == '\0' || *p == '\n') && i > 0) {
+      break;
+    }
+    errno = 0;
+    v[i] = strtol(p, &end, 10);
+    if (errno != 0 || end == p) {
+      return(1);
+    }
+    p = end;
+  }
+  while (*p == ' ' || *p == '\n') {
+    p++;
+  }
+  if (*p != '\0' && !checked) {
+    return(1);    // more values than expected
+  }
+  memcpy(values, v, i * sizeof(long));
+  *found = i;
+  return(0);
+}
+
+
+/* FUNCTION to read the checkpoint, see checkpoint.h for the results */
+int checkpoint_read(const char *path, long *values, int n, int *found)
+{
+  char prev[CP_LINE_LEN];
+
+  if (access(path, F_OK) != 0) {
+    return(CP_MISSING);
+  }
+  if (cp_parse(path, values, n, found) == 0) {
+    return(CP_OK);
+  }
+  snprintf(prev, sizeof(prev), "%s.prev", path);
+  if (cp_parse(prev, values, n, found) == 0) {
+    return(CP_PREV);
+  }
+  return(CP_CORRUPT);
+}
+
+
+/* FUNCTION to write the checkpoint atomically, returns 0 when written */
+int checkpoint_write(const char *path, const long *values, int n)
+{
+  char line[CP_LINE_LEN], tmp[CP_LINE_LEN], prev[CP_LINE_LEN], dir[CP_LINE_LEN];
+  int len = 0, fd, i;
+
+  for (i = 0; i < n && len < CP_LINE_LEN - 32; i++) {
+    len += snprintf(line + len, sizeof(line) - len, "%ld ", values[i]);
+  }
+  len += snprintf(line + len, sizeof(line) - len, "* %08lx\n", cp_checksum(line, len));
+
+  snprintf(tmp, sizeof(tmp), "%s.new", path);
+  snprintf(prev, sizeof(prev), "%s.prev", path);
+  if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+    return(1);
+  }
+  if (write(fd, line, len) != len || fsync(fd) != 0) {
+    close(fd);
+    unlink(tmp);
+    return(1);
+  }
+  close(fd);
+
+  /* keep the current checkpoint as fallback, then replace it */
+  unlink(prev);
+  link(path, prev);   // fails harmlessly for the very first checkpoint
+  if (rename(tmp, path) != 0) {
+    unlink(tmp);
+    return(1);
+  }
+  /* make the rename itself durable */
+  snprintf(dir, sizeof(dir), "%s", path);
+  if ((fd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+  return(0);
+}
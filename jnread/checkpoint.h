@@ -0,0 +1,32 @@
+/*
+#################################################################################
+# checkpoint.h - Crash-safe storage of the counter values (ACTUAL_LOG)         #
+#                                                                               #
+# The values are written as one line "<v0> <v1> ... * <checksum>" to a         #
+# temporary file that is fsync'ed and renamed over the checkpoint, so a crash  #
+# leaves either the old or the new checkpoint. The previous checkpoint is kept #
+# as <file>.prev and used when the checkpoint itself does not validate.        #
+# Old checkpoints without a checksum are still accepted. A checkpoint may have #
+# fewer values than asked for (the others are left as they are, *found tells   #
+# how many were read), one with a checksum also more (those are ignored).      #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+/* Results of checkpoint_read() */
+#define CP_OK 0
+#define CP_MISSING 1     // no checkpoint file
+#define CP_CORRUPT 2     // checkpoint (and .prev) did not validate
+#define CP_PREV 3        // checkpoint did not validate, .prev was used
+
+#define CP_MAX_VALUES 128
+
+int checkpoint_read(const char *path, long *values, int n, int *found);
+int checkpoint_write(const char *path, const long *values, int n);
+
+#endif
@@ -0,0 +1,87 @@
+/*
+#################################################################################
+# config.c - Runtime configuration file                                         #
+#                                                                               #
+# See config.h for the interface.                                               #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "config.h"
+
+
+/* FUNCTION to strip the spaces at both ends of s */
+static char *config_trim(char *s)
+{
+  char *end;
+
+  while (isspace((unsigned char)*s)) {
+    s++;
+  }
+  end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1])) {
+    end--;
+  }
+  *end = '\0';
+  return(s);
+}
+
+
+/* FUNCTION to read the config file and give every setting to set() */
+int config_read(const char *path, config_fn set)
+{
+  char line[CONFIG_LINE_LEN], section[64] = "", *p, *eq, *end;
+  FILE *fp;
+  int n = 0, errors = 0;
+
+  if ((fp = fopen(path, "r")) == NULL) {
+    return(CONFIG_MISSING);
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    n++;
+    if (strchr(line, '\n') == NULL && !feof(fp)) {
+      fprintf(stderr, "%s:%d: line too long\n", path, n);
+      errors++;
+      while (fgets(line, sizeof(line), fp) != NULL && strchr(line, '\n') == NULL);
+      continue;
+    }
+    p = config_trim(line);
+    if (*p == '\0' || *p == '#' || *p == ';') {
+      continue;
+    }
+    if (*p == '[') {
+      if ((end = strchr(p, ']')) == NULL || end[1] != '\0' || end - p - 1 >= (int)sizeof(section)) {
+        fprintf(stderr, "%s:%d: bad section \"%s\"\n", path, n, p);
+        errors++;
+        continue;
+      }
+      *end = '\0';
+      snprintf(section, sizeof(section), "%s", config_trim(p + 1));
+      if (set(section, NULL, NULL) != 0) {
+        fprintf(stderr, "%s:%d: unknown section [%s]\n", path, n, section);
+        errors++;
+      }
+      continue;
+    }
+    if ((eq = strchr(p, '=')) == NULL) {
+      fprintf(stderr, "%s:%d: no \"=\" in \"%s\"\n", path, n, p);
+      errors++;
+      continue;
+    }
+    *eq = '\0';
+    p = config_trim(p);
+    if (set(section, p, config_trim(eq + 1)) != 0) {
+      fprintf(stderr, "%s:%d: unknown key or bad value for \"%s\"%s%s\n", path, n, p,
+      section[0] != '\0' ? " in " : "", section);
+      errors++;
+    }
+  }
+  fclose(fp);
+  return(errors > 0 ? CONFIG_ERROR : CONFIG_OK);
+}
@@ -0,0 +1,32 @@
+/*
+#################################################################################
+# config.h - Runtime configuration file                                         #
+#                                                                               #
+# A text file with one setting per line, "key = value", and sections that       #
+# start with a line "[name]" (e.g. one [meter] section per meter). Empty lines  #
+# and lines that start with '#' or ';' are skipped, spaces around the key and   #
+# the value are ignored. The keys themselves are up to the caller: every        #
+# setting is given to a function, that returns 0 when it knows the key and the  #
+# value is valid; the start of a section is given as key NULL. Errors are       #
+# reported as "<file>:<line>: <text>".                                          #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define CONFIG_LINE_LEN 512
+
+/* Results of config_read() */
+#define CONFIG_OK 0
+#define CONFIG_MISSING 1   // no config file
+#define CONFIG_ERROR 2     // error in the file (reported on stderr)
+
+typedef int (*config_fn)(const char *section, const char *key, const char *value);
+
+int config_read(const char *path, config_fn set);
+
+#endif
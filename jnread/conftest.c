@@ -0,0 +1,287 @@
+/*
+#################################################################################
+# conftest.c - Test of the config file                                          #
+#                                                                               #
+# - config.c: comments, empty lines and the spaces around keys and values are  #
+#   skipped, a value may have '=' and spaces in it, every section starts with  #
+#   key NULL; a bad section, a line without '=', a line too long and a key    #
+#   the caller does not know are reported with their line no. and make the    #
+#   result CONFIG_ERROR, a missing file is CONFIG_MISSING                       #
+# - jnread: a log is replayed with a config of two e-meters, one named on the  #
+#   second port: both have their series with their own readings, a type      #
+#   without a meter has none; query lists them from the history_dir of the   #
+#   config given with -c; a config with errors stops jnread with the line no.  #
+#   of every error                                                              #
+# Usage: conftest. Exits with 1 when a check fails.                            #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "config.h"
+#include "tsdb.h"
+#include "testutil.h"
+
+#define MAX_SEEN 16
+
+/* the settings config_read() gave */
+static struct {
+  char section[64];
+  char key[64];                 // "" for the start of a section
+  char value[CONFIG_LINE_LEN];
+} seen[MAX_SEEN];
+static int n_seen;
+
+static char dir[64];
+
+
+static int set(const char *section, const char *key, const char *value)
+{
+  if (n_seen < MAX_SEEN) {
+    snprintf(seen[n_seen].section, sizeof(seen[n_seen].section), "%s", section);
+    snprintf(seen[n_seen].key, sizeof(seen[n_seen].key), "%s", key != NULL ? key : "");
+    snprintf(seen[n_seen].value, sizeof(seen[n_seen].value), "%s", value != NULL ? value : "");
+    n_seen++;
+  }
+  if (key == NULL) {
+    return(strcmp(section, "meter") != 0);
+  }
+  return(strcmp(key, "unknown") == 0);
+}
+
+
+static int is_seen(int i, const char *section, const char *key, const char *value)
+{
+  return(i < n_seen && strcmp(seen[i].section, section) == 0 && strcmp(seen[i].key, key) == 0 &&
+         strcmp(seen[i].value, value) == 0);
+}
+
+
+static void write_file(const char *path, const char *text)
+{
+  FILE *fp;
+
+  if ((fp = fopen(path, "w")) == NULL || fputs(text, fp) == EOF || fclose(fp) != 0) {
+    perror(path);
+    exit(1);
+  }
+}
+
+
+/* FUNCTION to read a config with stderr to the file err, returns the result */
+static int read_with_errors(const char *path, const char *err, char *text, size_t size)
+{
+  FILE *fp;
+  int fd, saved, rc;
+  size_t n;
+
+  fflush(stderr);
+  saved = dup(2);
+  fd = open(err, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  dup2(fd, 2);
+  close(fd);
+  n_seen = 0;
+  rc = config_read(path, set);
+  fflush(stderr);
+  dup2(saved, 2);
+  close(saved);
+  text[0] = '\0';
+  if ((fp = fopen(err, "r")) != NULL) {
+    n = fread(text, 1, size - 1, fp);
+    text[n] = '\0';
+    fclose(fp);
+  }
+  return(rc);
+}
+
+
+static void test_config_read(void)
+{
+  char path[128], err[128], text[2048];
+  int rc, n;
+
+  snprintf(path, sizeof(path), "%s/test.conf", dir);
+  snprintf(err, sizeof(err), "%s/stderr", dir);
+  write_file(path,
+             "# a comment\n"
+             "; also a comment\n"
+             "\n"
+             "  port   =   /dev/ttyUSB0  \n"
+             "title = a = b c\n"
+             "empty =\n"
+             "[ meter ]\n"
+             "type=e\n"
+             "[meter]\n"
+             "\ttype = g\n");
+  rc = read_with_errors(path, err, text, sizeof(text));
+  check(rc == CONFIG_OK && text[0] == '\0', "read: result, errors", rc, strlen(text));
+  check(n_seen == 7, "read: settings", n_seen, 7);
+  check(is_seen(0, "", "port", "/dev/ttyUSB0") && is_seen(1, "", "title", "a = b c") && is_seen(2, "", "empty", ""),
+        "read: spaces stripped, '=' in a value", 3, 0);
+  check(is_seen(3, "meter", "", "") && is_seen(4, "meter", "type", "e") &&
+        is_seen(5, "meter", "", "") && is_seen(6, "meter", "type", "g"), "read: sections, their keys", 4, 0);
+
+  /* line 6 is longer than CONFIG_LINE_LEN */
+  n = snprintf(text, sizeof(text), "port = a\n[meter\nno equal sign\nunknown = 1\n[other]\n");
+  memset(text + n, 'x', CONFIG_LINE_LEN + 8);
+  snprintf(text + n + CONFIG_LINE_LEN + 8, sizeof(text) - n - CONFIG_LINE_LEN - 8, "\nafter = long line\n");
+  write_file(path, text);
+  rc = read_with_errors(path, err, text, sizeof(text));
+  check(rc == CONFIG_ERROR, "errors: result", rc, CONFIG_ERROR);
+  check(strstr(text, "test.conf:2: bad section") != NULL, "errors: bad section, line 2", strlen(text), 0);
+  check(strstr(text, "test.conf:3: no \"=\"") != NULL, "errors: no '=', line 3", strlen(text), 0);
+  check(strstr(text, "test.conf:4: unknown key or bad value for \"unknown\"") != NULL, "errors: unknown key, line 4",
+        strlen(text), 0);
+  check(strstr(text, "test.conf:5: unknown section [other]") != NULL, "errors: unknown section, line 5", strlen(text), 0);
+  check(strstr(text, "test.conf:6: line too long") != NULL, "errors: line too long, line 6", strlen(text), 0);
+  check(n_seen > 0 && strcmp(seen[n_seen - 1].key, "after") == 0 && strcmp(seen[n_seen - 1].value, "long line") == 0,
+        "errors: the line after a long line is read", n_seen, 0);
+
+  snprintf(path, sizeof(path), "%s/missing.conf", dir);
+  check(config_read(path, set) == CONFIG_MISSING, "missing file", 0, 0);
+}
+
+
+/* FUNCTION to run ./jnread with a config, returns the exit status */
+static int run_jnread(const char *conf, const char *log, const char *err)
+{
+  pid_t pid;
+  int status = -1, fd;
+
+  fflush(stdout);   // else the child writes the results so far again
+  if ((pid = fork()) == 0) {
+    if ((fd = open(err, O_WRONLY | O_CREAT | O_TRUNC, 0644)) >= 0) {
+      dup2(fd, 2);
+      close(fd);
+    }
+    execl("./jnread", "jnread", "-c", conf, "--replay", log, "--output", dir, "--stub-sinks", (char *)NULL);
+    perror("./jnread");
+    _exit(127);
+  }
+  if (pid > 0) {
+    waitpid(pid, &status, 0);
+  }
+  return(status);
+}
+
+
+/* FUNCTION to get the last value of a series in the output, -1 when none */
+static long last_value(const char *series)
+{
+  struct tsdb ts;
+  char base[128];
+  time_t t;
+  long v = -1;
+
+  snprintf(base, sizeof(base), "%s/%s", dir, series);
+  if (tsdb_open(&ts, base, 0, 0) != 0) {
+    return(-1);
+  }
+  if (tsdb_at(&ts, (time_t)1L << 40, &t, &v) != 0) {
+    v = -1;
+  }
+  tsdb_close(&ts);
+  return(v);
+}
+
+
+static void test_meters(void)
+{
+  char conf[128], log[128], err[128], text[2048], path[128];
+  FILE *fp;
+  size_t n;
+  pid_t pid;
+  int status;
+
+  snprintf(conf, sizeof(conf), "%s/jnread.conf", dir);
+  snprintf(log, sizeof(log), "%s/all.log", dir);
+  snprintf(err, sizeof(err), "%s/stderr", dir);
+  write_file(conf,
+             "udp =\n"
+             "mqtt =\n"
+             "[meter]\n"
+             "type = e\n"
+             "idx = 96\n"
+             "\n"
+             "[meter]\n"
+             "type = e\n"
+             "name = garage\n"
+             "port = 1\n"
+             "cfactor = 375\n");
+  write_file(log,
+             "16-10-26,12:00:00 e 2607 1200001\r\n"
+             "16-10-26,12:00:02 #1 e 500 3000\r\n"
+             "16-10-26,12:00:05 g 80010 8001\r\n");
+  status = run_jnread(conf, log, err);
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "jnread: replay with two e-meters", status, 0);
+  check(last_value("electricity_power") == 2607, "jnread: power of the main meter", last_value("electricity_power"), 2607);
+  check(last_value("electricity_power_garage") == 500, "jnread: power of the named meter on port 1",
+        last_value("electricity_power_garage"), 500);
+  snprintf(path, sizeof(path), "%s/gas.tsi", dir);
+  check(access(path, F_OK) != 0, "jnread: no series of a type without a meter", access(path, F_OK), -1);
+
+  /* query reads the history_dir of the config given with -c */
+  snprintf(text, sizeof(text), "history_dir = %s\n", dir);
+  write_file(conf, text);
+  fflush(stdout);
+  if ((pid = fork()) == 0) {
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+      _exit(127);
+    }
+    execl("./jnread", "jnread", "-c", conf, "query", "-l", (char *)NULL);
+    perror("./jnread");
+    _exit(127);
+  }
+  status = -1;
+  if (pid > 0) {
+    waitpid(pid, &status, 0);
+  }
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "jnread: query in the history_dir of -c", status, 0);
+
+  write_file(conf,
+             "bogus = 1\n"
+             "[meter]\n"
+             "type = e\n"
+             "port = x\n"
+             "[metre]\n");
+  status = run_jnread(conf, log, err);
+  text[0] = '\0';
+  if ((fp = fopen(err, "r")) != NULL) {
+    n = fread(text, 1, sizeof(text) - 1, fp);
+    text[n] = '\0';
+    fclose(fp);
+  }
+  check(WIFEXITED(status) && WEXITSTATUS(status) != 0, "jnread: stops on a bad config", status, 0);
+  check(strstr(text, "jnread.conf:1:") != NULL && strstr(text, "jnread.conf:4:") != NULL &&
+        strstr(text, "jnread.conf:5:") != NULL, "jnread: every error with its line", strlen(text), 0);
+}
+
+
+int main(void)
+{
+  char cmd[160];
+
+  snprintf(dir, sizeof(dir), "/tmp/conftest.%d", (int)getpid());
+  snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s", dir, dir);
+  if (system(cmd) != 0) {
+    fprintf(stderr, "Can't make %s\n", dir);
+    return(1);
+  }
+
+  test_config_read();
+  test_meters();
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  if (system(cmd) != 0) {
+    fprintf(stderr, "Can't remove %s\n", dir);
+  }
+  return(test_failed);
+}
@@ -0,0 +1,123 @@
+/*
+#################################################################################
+# dedup.c - Readings of redundant CentralNodes (gateways) counted once          #
+#                                                                               #
+# See dedup.h for the interface.                                                #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <string.h>
+
+#include "dedup.h"
+
+#define GET(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#define INC(var) __atomic_store_n(&(var), GET(var) + 1, __ATOMIC_RELAXED)
+
+/* a reading that is in the window */
+struct recent {
+  time_t t;                     // when it was first received, 0 = free
+  unsigned int seen;            // gateways that delivered it
+  struct message m;
+};
+
+static struct recent recent[DEDUP_MAX_KEYS][DEDUP_RECENT];
+static int next[DEDUP_MAX_KEYS];                // slot of the next new reading
+static unsigned int gateways[DEDUP_MAX_KEYS];   // gateways that delivered the key
+static struct dedup_stats stats[DEDUP_MAX_PORTS];
+static int window = 0;
+
+
+/* FUNCTION to set the window (s), 0 = no deduplication */
+void dedup_init(int seconds)
+{
+  window = seconds;
+  memset(recent, 0, sizeof(recent));
+  memset(next, 0, sizeof(next));
+  memset(gateways, 0, sizeof(gateways));
+}
+
+
+/* FUNCTION to free a reading that leaves the window, the gateways of its key
+*  that did not deliver it missed it
+*/
+static void dedup_expire(int key, struct recent *r)
+{
+  unsigned int missed = gateways[key] & ~r->seen;
+  int p;
+
+  for (p = 0; missed != 0; p++, missed >>= 1) {
+    if (missed & 1) {
+      INC(stats[p].missed);
+    }
+  }
+  r->t = 0;
+}
+
+
+static int dedup_same(const struct message *a, const struct message *b)
+{
+  return(a->type == b->type && a->n == b->n &&
+  memcmp(a->value, b->value, a->n * sizeof(a->value[0])) == 0);
+}
+
+
+/* FUNCTION to check a reading of a key from a gateway at time t
+*  Returns 1 when another gateway delivered it already (skip it), else 0.
+*/
+int dedup_check(int key, int port, const struct message *m, time_t t)
+{
+  struct recent *r;
+  int i;
+
+  if (key < 0 || key >= DEDUP_MAX_KEYS || port < 0 || port >= DEDUP_MAX_PORTS) {
+    return(0);
+  }
+  INC(stats[port].readings);
+  gateways[key] |= 1u << port;
+  if (window <= 0) {
+    INC(stats[port].first);
+    return(0);
+  }
+  for (i = 0; i < DEDUP_RECENT; i++) {
+    r = &recent[key][i];
+    if (r->t == 0) {
+      continue;
+    }
+    if (t - r->t > window || t < r->t) {
+      dedup_expire(key, r);   // out of the window (or the clock went back)
+      continue;
+    }
+    if (!(r->seen & (1u << port)) && dedup_same(&r->m, m)) {
+      r->seen |= 1u << port;
+      INC(stats[port].duplicates);
+      return(1);
+    }
+  }
+  /* a new reading, in place of the oldest */
+  r = &recent[key][next[key]];
+  if (r->t != 0) {
+    dedup_expire(key, r);
+  }
+  next[key] = (next[key] + 1) % DEDUP_RECENT;
+  r->t = t;
+  r->seen = 1u << port;
+  r->m = *m;
+  INC(stats[port].first);
+  return(0);
+}
+
+
+void dedup_get_stats(int port, struct dedup_stats *st)
+{
+  memset(st, 0, sizeof(*st));
+  if (port < 0 || port >= DEDUP_MAX_PORTS) {
+    return;
+  }
+  st->readings = GET(stats[port].readings);
+  st->first = GET(stats[port].first);
+  st->duplicates = GET(stats[port].duplicates);
+  st->missed = GET(stats[port].missed);
+}
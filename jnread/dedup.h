@@ -0,0 +1,46 @@
+/*
+#################################################################################
+# dedup.h - Readings of redundant CentralNodes (gateways) counted once          #
+#                                                                               #
+# With more CentralNodes in reach of the same JeeNodes, every reading arrives   #
+# once per gateway. A reading of a key (a meter) with the same type and values  #
+# as one from another gateway less than the window ago is a duplicate. The      #
+# last DEDUP_RECENT readings per key are kept, the gateways of a key are those  #
+# that delivered a reading of it, so a meter of a single port is never          #
+# deduplicated. Per gateway is counted:                                         #
+#   readings    the readings it delivered                                       #
+#   first       of those, the ones that were used (it was the first)            #
+#   duplicates  of those, the ones another gateway delivered before             #
+#   missed      readings of its keys that only other gateways delivered         #
+# The loss of a gateway is missed / (readings + missed). The RFM12B has no      #
+# RSSI per packet, so this loss is the measure of the reception of a gateway.   #
+# dedup_check() is called by one thread, the stats can be read by any.          #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <time.h>
+
+#include "parse.h"
+
+#define DEDUP_MAX_KEYS 32       /* keys (meters) */
+#define DEDUP_MAX_PORTS 8       /* gateways */
+#define DEDUP_RECENT 16         /* readings kept per key */
+
+struct dedup_stats {
+  unsigned long readings;
+  unsigned long first;
+  unsigned long duplicates;
+  unsigned long missed;
+};
+
+void dedup_init(int window);
+int dedup_check(int key, int port, const struct message *m, time_t t);
+void dedup_get_stats(int port, struct dedup_stats *st);
+
+#endif
@@ -0,0 +1,188 @@
+/*
+#################################################################################
+# deduptest.c - Test of the deduplication of redundant CentralNodes             #
+#                                                                               #
+# - dedup.c, with a window of 2 s and two gateways for a meter: a reading that  #
+#   the other gateway delivered within the window is a duplicate, also at the  #
+#   edge of the window, not after it; the same values later are a new reading; #
+#   a reading only one gateway delivered counts as missed for the other when   #
+#   it leaves the window; a clock that goes back starts again; a meter of one  #
+#   gateway and a window of 0 are never deduplicated; per gateway the first    #
+#   and duplicate readings add up to its readings                               #
+# - jnread: a log with every reading from two ports is replayed, each reading  #
+#   is stored once                                                              #
+# Usage: deduptest. Exits with 1 when a check fails.                           #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "dedup.h"
+#include "tsdb.h"
+#include "testutil.h"
+
+#define WINDOW 2
+
+static char dir[64];
+
+
+static struct message reading(long power, long count)
+{
+  struct message m;
+
+  memset(&m, 0, sizeof(m));
+  m.type = 'e';
+  m.n = 2;
+  m.value[0] = power;
+  m.value[1] = count;
+  return(m);
+}
+
+
+static void test_dedup(void)
+{
+  struct message a = reading(2607, 1200001), b = reading(2610, 1200002), c = reading(2615, 1200003),
+    d = reading(2620, 1200004), e = reading(2625, 1200005), f = reading(2630, 1200006);
+  struct dedup_stats s0, s1, s2;
+  int r[3];
+
+  dedup_init(WINDOW);
+  /* key 0 from gateways 0 and 1 */
+  r[0] = dedup_check(0, 0, &a, 100);
+  r[1] = dedup_check(0, 1, &a, 101);
+  check(r[0] == 0 && r[1] == 1, "first, duplicate from the other gateway", r[0], r[1]);
+  r[0] = dedup_check(0, 0, &b, 103);
+  r[1] = dedup_check(0, 1, &b, 103 + WINDOW);
+  check(r[0] == 0 && r[1] == 1, "duplicate at the edge of the window", r[0], r[1]);
+  /* gateway 1 misses c, the missed reading is counted when it expires */
+  r[0] = dedup_check(0, 0, &c, 110);
+  dedup_get_stats(1, &s1);
+  check(r[0] == 0 && s1.missed == 0, "reading of one gateway, not yet missed", r[0], s1.missed);
+  r[0] = dedup_check(0, 0, &d, 120);
+  r[1] = dedup_check(0, 1, &d, 121);
+  dedup_get_stats(1, &s1);
+  check(r[0] == 0 && r[1] == 1 && s1.missed == 1, "missed by gateway 1 after the window", r[1], s1.missed);
+  /* gateway 0 misses e */
+  r[0] = dedup_check(0, 1, &e, 123);
+  r[1] = dedup_check(0, 1, &a, 130);
+  r[2] = dedup_check(0, 0, &a, 130);
+  dedup_get_stats(0, &s0);
+  check(r[0] == 0 && r[1] == 0 && r[2] == 1 && s0.missed == 1, "same values later: a new reading", r[1], r[2]);
+  /* after the window no duplicate */
+  r[0] = dedup_check(0, 0, &f, 140);
+  r[1] = dedup_check(0, 1, &f, 141 + WINDOW);
+  check(r[0] == 0 && r[1] == 0, "no duplicate after the window", r[0], r[1]);
+  /* the clock goes back: the readings leave the window */
+  r[0] = dedup_check(0, 0, &b, 50);
+  r[1] = dedup_check(0, 1, &b, 50);
+  check(r[0] == 0 && r[1] == 1, "clock back: first, duplicate", r[0], r[1]);
+
+  dedup_get_stats(0, &s0);
+  dedup_get_stats(1, &s1);
+  /* 0: a b c d a f b, 1: a b d e a f b */
+  check(s0.readings == 7 && s0.first == 6 && s0.duplicates == 1, "gateway 0: readings, duplicates", s0.readings, s0.duplicates);
+  check(s1.readings == 7 && s1.first == 3 && s1.duplicates == 4, "gateway 1: readings, duplicates", s1.readings, s1.duplicates);
+  check(s0.first + s0.duplicates == s0.readings && s1.first + s1.duplicates == s1.readings,
+        "first + duplicates = readings", s0.first + s0.duplicates, s1.first + s1.duplicates);
+  /* e and the f of gateway 1 were missed by 0, c and the f of gateway 0 by 1 */
+  check(s0.missed == 2 && s1.missed == 2, "gateway 0, 1: missed", s0.missed, s1.missed);
+
+  /* key 1 only from gateway 2: the same reading again is not a duplicate */
+  r[0] = dedup_check(1, 2, &a, 200);
+  r[1] = dedup_check(1, 2, &a, 200);
+  r[2] = dedup_check(1, 2, &a, 201);
+  dedup_get_stats(2, &s2);
+  check(r[0] + r[1] + r[2] == 0 && s2.first == 3, "one gateway: never a duplicate", r[0] + r[1] + r[2], s2.first);
+
+  dedup_init(0);
+  r[0] = dedup_check(0, 0, &a, 300);
+  r[1] = dedup_check(0, 1, &a, 300);
+  check(r[0] == 0 && r[1] == 0, "window 0: no deduplication", r[0], r[1]);
+}
+
+
+static void add_sample(void *arg, time_t t, long v)
+{
+  (*(long *)arg)++;
+}
+
+/* FUNCTION to count the samples of a series in the output */
+static long samples(const char *series)
+{
+  struct tsdb ts;
+  char base[128];
+  long n = 0;
+
+  snprintf(base, sizeof(base), "%s/%s", dir, series);
+  if (tsdb_open(&ts, base, 0, 0) != 0) {
+    return(-1);
+  }
+  tsdb_scan(&ts, 0, (time_t)1L << 40, add_sample, &n);
+  tsdb_close(&ts);
+  return(n);
+}
+
+
+static void test_replay(void)
+{
+  char log[128], conf[128];
+  FILE *fp;
+  pid_t pid;
+  int status = -1;
+
+  snprintf(log, sizeof(log), "%s/all.log", dir);
+  snprintf(conf, sizeof(conf), "%s/jnread.conf", dir);
+  if ((fp = fopen(conf, "w")) == NULL) {
+    perror(conf);
+    return;
+  }
+  fprintf(fp, "dedup_window = %d\nudp =\nmqtt =\n", WINDOW);
+  fclose(fp);
+  if ((fp = fopen(log, "w")) == NULL) {
+    perror(log);
+    return;
+  }
+  fprintf(fp, "16-10-26,12:00:00 e 2607 1200001\r\n16-10-26,12:00:01 #1 e 2607 1200001\r\n"
+          "16-10-26,12:00:10 #1 e 2610 1200002\r\n16-10-26,12:00:10 e 2610 1200002\r\n"
+          "16-10-26,12:00:20 e 2615 1200003\r\n");
+  fclose(fp);
+  if ((pid = fork()) == 0) {
+    execl("./jnread", "jnread", "-c", conf, "--replay", log, "--output", dir, "--stub-sinks", (char *)NULL);
+    perror("./jnread");
+    _exit(127);
+  }
+  if (pid > 0) {
+    waitpid(pid, &status, 0);
+  }
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "jnread: replay from two ports", status, 0);
+  check(samples("electricity_power") == 3, "jnread: every reading stored once", samples("electricity_power"), 3);
+}
+
+
+int main(void)
+{
+  char cmd[160];
+
+  snprintf(dir, sizeof(dir), "/tmp/deduptest.%d", (int)getpid());
+  snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s", dir, dir);
+  if (system(cmd) != 0) {
+    fprintf(stderr, "Can't make %s\n", dir);
+    return(1);
+  }
+
+  test_dedup();
+  test_replay();
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  if (system(cmd) != 0) {
+    fprintf(stderr, "Can't remove %s\n", dir);
+  }
+  return(test_failed);
+}
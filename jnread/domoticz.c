@@ -0,0 +1,511 @@
+/*
+#################################################################################
+# domoticz.c - In-process publisher for Domoticz udevice updates               #
+#                                                                               #
+# Replaces the "curl" processes that were started with system() for every      #
+# update. See domoticz.h for the interface.                                     #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "domoticz.h"
+
+
+/*#### COALESCING QUEUE #####################################################*/
+
+/* One slot per idx: a newer value for an idx replaces a pending one (last
+*  value wins) and a slot is sent at most once per interval.
+*/
+struct dz_update {
+  char idx[DZ_IDX_LEN];
+  char svalue[DZ_SVALUE_LEN];
+};
+
+struct dz_slot {
+  struct dz_update u;
+  int pending;              // a value is waiting to be sent
+  long interval_ms;         // min. time between two updates of this idx
+  long last_sent;           // time (ms) of the last send of this idx
+  long pending_since;       // time (ms) the waiting value became pending
+};
+
+static struct dz_slot slots[DZ_SLOTS];
+static int n_slots = 0;
+static int q_count = 0;         // no. of pending slots
+static int running = 0;
+static pthread_mutex_t q_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t q_cond;
+static pthread_t worker;
+static struct dz_stats stats;
+
+static char host[128];
+static char port[16];
+static int sock = -1;
+static time_t next_connect = 0;
+
+
+static long now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec * 1000L + ts.tv_nsec / 1000000L);
+}
+
+
+/* FUNCTION to find the slot of an idx, creating it when needed (lock held) */
+static struct dz_slot *dz_slot(const char *idx)
+{
+  int i;
+
+  for (i = 0; i < n_slots; i++) {
+    if (strcmp(slots[i].u.idx, idx) == 0) {
+      return(&slots[i]);
+    }
+  }
+  if (n_slots == DZ_SLOTS) {
+    return(NULL);
+  }
+  memset(&slots[n_slots], 0, sizeof(slots[n_slots]));
+  snprintf(slots[n_slots].u.idx, sizeof(slots[n_slots].u.idx), "%s", idx);
+  slots[n_slots].last_sent = -DZ_MAX_INTERVAL;
+  return(&slots[n_slots++]);
+}
+
+
+/* FUNCTION to set the min. interval (s) between two updates of an idx
+*  The interval is clamped to 0..DZ_MAX_INTERVAL. Returns 1 when the queue
+*  has no slot left for the idx.
+*/
+int domoticz_set_interval(const char *idx, int seconds)
+{
+  struct dz_slot *sl;
+
+  if (seconds < 0) {
+    seconds = 0;
+  } else if (seconds > DZ_MAX_INTERVAL / 1000) {
+    seconds = DZ_MAX_INTERVAL / 1000;
+  }
+  pthread_mutex_lock(&q_lock);
+  if ((sl = dz_slot(idx)) != NULL) {
+    sl->interval_ms = seconds * 1000L;
+  }
+  pthread_mutex_unlock(&q_lock);
+  return(sl == NULL);
+}
+
+
+/* FUNCTION to put an update in the queue, never blocks
+*  Returns 0 when queued, 1 when the update had to be dropped
+*/
+int domoticz_update(const char *idx, const char *fmt, ...)
+{
+  struct dz_slot *sl;
+  va_list ap;
+
+  pthread_mutex_lock(&q_lock);
+  if (!running) {
+    pthread_mutex_unlock(&q_lock);
+    return(1);
+  }
+  if ((sl = dz_slot(idx)) == NULL) {
+    stats.dropped++;
+    pthread_mutex_unlock(&q_lock);
+    return(1);
+  }
+  if (sl->pending) {
+    stats.coalesced++;  // the waiting value is superseded
+  } else {
+    sl->pending = 1;
+    sl->pending_since = now_ms();
+    q_count++;
+  }
+  va_start(ap, fmt);
+  vsnprintf(sl->u.svalue, sizeof(sl->u.svalue), fmt, ap);
+  va_end(ap);
+  stats.queued++;
+  pthread_cond_signal(&q_cond);
+  pthread_mutex_unlock(&q_lock);
+  return(0);
+}
+
+
+void domoticz_get_stats(struct dz_stats *st)
+{
+  pthread_mutex_lock(&q_lock);
+  *st = stats;
+  st->depth = q_count;
+  pthread_mutex_unlock(&q_lock);
+}
+
+
+/*#### HTTP CONNECTION ######################################################*/
+
+static void dz_close(void)
+{
+  if (sock >= 0) {
+    close(sock);
+    sock = -1;
+  }
+}
+
+
+/* FUNCTION to wait until the socket is ready, returns 0 when ready */
+static int dz_wait(short events)
+{
+  struct pollfd pfd;
+  int rc;
+
+  pfd.fd = sock;
+  pfd.events = events;
+  do {
+    rc = poll(&pfd, 1, DZ_TIMEOUT_MS);
+  } while (rc < 0 && errno == EINTR);
+  if (rc <= 0) {
+    return(1);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to (re)connect to the server, returns 0 when connected */
+static int dz_connect(void)
+{
+  struct addrinfo hints, *res, *ai;
+  int err;
+  socklen_t len = sizeof(err);
+
+  if (sock >= 0) {
+    return(0);
+  }
+  if (time(NULL) < next_connect) {
+    return(1);
+  }
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, port, &hints, &res) != 0) {
+    next_connect = time(NULL) + DZ_RETRY_WAIT;
+    return(1);
+  }
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    if ((sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) {
+      continue;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    if (errno == EINPROGRESS && dz_wait(POLLOUT) == 0 &&
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+      break;
+    }
+    dz_close();
+  }
+  freeaddrinfo(res);
+  if (sock < 0) {
+    next_connect = time(NULL) + DZ_RETRY_WAIT;
+    return(1);
+  }
+  pthread_mutex_lock(&q_lock);
+  stats.connects++;
+  pthread_mutex_unlock(&q_lock);
+  return(0);
+}
+
+
+static int dz_send_all(const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    n = send(sock, buf, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN && dz_wait(POLLOUT) == 0) {
+        continue;
+      }
+      return(1);
+    }
+    buf += n;
+    len -= n;
+  }
+  return(0);
+}
+
+
+/* FUNCTION to receive more response data, returns no. of bytes or <=0 */
+static int dz_recv(char *buf, size_t len)
+{
+  ssize_t n;
+
+  for (;;) {
+    n = recv(sock, buf, len, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && errno == EAGAIN) {
+      if (dz_wait(POLLIN) != 0) {
+        return(-1);
+      }
+      continue;
+    }
+    return((int)n);
+  }
+}
+
+
+/* FUNCTION to read one complete response, returns the HTTP status or -1
+*  The body is read and discarded so the connection can be reused.
+*  *keep is cleared when the server wants to close the connection.
+*/
+static int dz_read_response(int *keep)
+{
+  char buf[4096];
+  char *eoh, *p, *q;
+  int have = 0, n, status;
+  long body = -1;   // -1 = until close
+  int chunked = 0;
+
+  for (;;) {
+    if (have == sizeof(buf) - 1) {
+      return(-1);
+    }
+    if ((n = dz_recv(buf + have, sizeof(buf) - 1 - have)) <= 0) {
+      return(-1);
+    }
+    have += n;
+    buf[have] = '\0';
+    if ((eoh = strstr(buf, "\r\n\r\n")) != NULL) {
+      break;
+    }
+  }
+  if (sscanf(buf, "HTTP/%*d.%*d %d", &status) != 1) {
+    return(-1);
+  }
+  *keep = (strncmp(buf, "HTTP/1.1", 8) == 0);
+  for (p = strstr(buf, "\r\n"); p != NULL && p < eoh; p = strstr(p + 2, "\r\n")) {
+    if (strncasecmp(p + 2, "Content-Length:", 15) == 0) {
+      body = atol(p + 17);
+    } else if (strncasecmp(p + 2, "Transfer-Encoding:", 18) == 0) {
+      chunked = (strstr(p + 20, "chunked") != NULL);
+    } else if (strncasecmp(p + 2, "Connection:", 11) == 0) {
+      q = p + 13;
+      q += strspn(q, " \t");
+      if (strncasecmp(q, "close", 5) == 0) {
+        *keep = 0;
+      } else if (strncasecmp(q, "keep-alive", 10) == 0) {
+        *keep = 1;
+      }
+    }
+  }
+  /* the part of the body already received */
+  have -= (eoh + 4) - buf;
+  memmove(buf, eoh + 4, have);
+  buf[have] = '\0';
+
+  if (chunked) {
+    /* not interested in the content, only in the terminating 0-size chunk */
+    while (strstr(buf, "0\r\n\r\n") == NULL) {
+      if (have > 8) {
+        memmove(buf, buf + have - 8, 8);
+        have = 8;
+      }
+      if ((n = dz_recv(buf + have, sizeof(buf) - 1 - have)) <= 0) {
+        return(-1);
+      }
+      have += n;
+      buf[have] = '\0';
+    }
+  } else if (body >= 0) {
+    body -= have;
+    while (body > 0) {
+      if ((n = dz_recv(buf, sizeof(buf))) <= 0) {
+        return(-1);
+      }
+      body -= n;
+    }
+  } else {
+    while (dz_recv(buf, sizeof(buf)) > 0);
+    *keep = 0;
+  }
+  return(status);
+}
+
+
+/* FUNCTION to deliver one update, returns 0 when the server accepted it */
+static int dz_deliver(struct dz_update *u)
+{
+  char req[512];
+  int len, attempt, status, keep;
+
+  if (host[0] == '\0') {
+    return(0);    // stub: no server (benchmarking)
+  }
+  len = snprintf(req, sizeof(req),
+  "GET /json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%s HTTP/1.1\r\n"
+  "Host: %s:%s\r\n"
+  "Accept: application/json\r\n"
+  "Connection: keep-alive\r\n\r\n", u->idx, u->svalue, host, port);
+
+  /* a kept-alive connection may have been closed by the server meanwhile,
+  *  so a failure on a reused connection gets one retry on a fresh one
+  */
+  for (attempt = 0; attempt < 2; attempt++) {
+    int reused = (sock >= 0);
+
+    if (dz_connect() != 0) {
+      return(1);
+    }
+    keep = 0;
+    if (dz_send_all(req, len) == 0 && (status = dz_read_response(&keep)) > 0) {
+      if (!keep) {
+        dz_close();
+      }
+      return(status == 200 ? 0 : 1);
+    }
+    dz_close();
+    if (!reused) {
+      next_connect = time(NULL) + DZ_RETRY_WAIT;
+      return(1);
+    }
+  }
+  return(1);
+}
+
+
+/*#### WORKER THREAD ########################################################*/
+
+/* FUNCTION to take the longest waiting slot that is due (lock held)
+*  Returns NULL and sets *wait_ms when nothing is due yet.
+*/
+static struct dz_slot *dz_next_due(long now, long *wait_ms)
+{
+  struct dz_slot *best = NULL;
+  long due;
+  int i;
+
+  *wait_ms = -1;
+  for (i = 0; i < n_slots; i++) {
+    if (!slots[i].pending) {
+      continue;
+    }
+    due = slots[i].last_sent + slots[i].interval_ms;
+    if (due <= now || !running) {
+      if (best == NULL || slots[i].pending_since < best->pending_since) {
+        best = &slots[i];
+      }
+    } else if (*wait_ms < 0 || due - now < *wait_ms) {
+      *wait_ms = due - now;
+    }
+  }
+  return(best);
+}
+
+
+static void *dz_worker(void *arg)
+{
+  struct dz_slot *sl;
+  struct dz_update u;
+  struct timespec ts;
+  long now, wait_ms;
+  int rc;
+
+  pthread_mutex_lock(&q_lock);
+  while (running || q_count > 0) {
+    now = now_ms();
+    if ((sl = dz_next_due(now, &wait_ms)) == NULL) {
+      if (wait_ms < 0) {
+        pthread_cond_wait(&q_cond, &q_lock);
+      } else {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += wait_ms / 1000;
+        ts.tv_nsec += (wait_ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+          ts.tv_sec++;
+          ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&q_cond, &q_lock, &ts);
+      }
+      continue;
+    }
+    u = sl->u;
+    sl->pending = 0;
+    sl->last_sent = now;
+    q_count--;
+    pthread_mutex_unlock(&q_lock);
+
+    rc = dz_deliver(&u);
+
+    pthread_mutex_lock(&q_lock);
+    if (rc == 0) {
+      stats.sent++;
+    } else {
+      stats.failed++;
+    }
+  }
+  pthread_mutex_unlock(&q_lock);
+  dz_close();
+  return(NULL);
+}
+
+
+/* FUNCTION to start the publisher for server "host:port"
+*  With an empty server the updates are accepted but not sent (stub).
+*/
+int domoticz_start(const char *server)
+{
+  const char *colon;
+  pthread_condattr_t attr;
+
+  if ((colon = strrchr(server, ':')) != NULL) {
+    snprintf(host, sizeof(host), "%.*s", (int)(colon - server), server);
+    snprintf(port, sizeof(port), "%s", colon + 1);
+  } else {
+    snprintf(host, sizeof(host), "%s", server);
+    snprintf(port, sizeof(port), "80");
+  }
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&q_cond, &attr);
+  running = 1;
+  if (pthread_create(&worker, NULL, dz_worker, NULL) != 0) {
+    running = 0;
+    return(1);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to stop the publisher, pending updates are still sent
+*  (without waiting for their interval)
+*/
+void domoticz_stop(void)
+{
+  if (!running) {
+    return;
+  }
+  pthread_mutex_lock(&q_lock);
+  running = 0;
+  pthread_cond_signal(&q_cond);
+  pthread_mutex_unlock(&q_lock);
+  pthread_join(worker, NULL);
+}
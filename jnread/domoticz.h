@@ -0,0 +1,49 @@
+/*
+#################################################################################
+# domoticz.h - In-process publisher for Domoticz udevice updates               #
+#                                                                               #
+# Updates are put in a queue with one slot per idx and sent by a worker thread  #
+# over a keep-alive HTTP/1.1 connection, so the USB read loop never waits on    #
+# the network. A newer value for an idx replaces a value still waiting (last    #
+# value wins) and each idx is sent at most once per its configured interval.   #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef DOMOTICZ_H
+#define DOMOTICZ_H
+
+/* Size of the outbound queue (no. of different idx): an e-meter has two idx,
+*  so 2 per meter for the MAX_METERS (32) of jnread.c
+*/
+#define DZ_SLOTS 64
+/* Upper limit (ms) for the min. interval between updates of an idx */
+#define DZ_MAX_INTERVAL 86400000L
+/* Max. length of the idx and svalue of an update */
+#define DZ_IDX_LEN 8
+#define DZ_SVALUE_LEN 48
+/* Timeout (ms) for connecting, sending and receiving a response */
+#define DZ_TIMEOUT_MS 5000
+/* Wait (s) before reconnecting after a failed connect */
+#define DZ_RETRY_WAIT 10
+
+struct dz_stats {
+  unsigned long queued;     // updates accepted in the queue
+  unsigned long sent;       // updates answered by the server
+  unsigned long coalesced;  // updates replaced by a newer value of the same idx
+  unsigned long dropped;    // updates dropped because the queue was full
+  unsigned long failed;     // updates that could not be delivered
+  unsigned long connects;   // number of (re)connects to the server
+  int depth;                // updates waiting in the queue now
+};
+
+int domoticz_start(const char *server);
+int domoticz_set_interval(const char *idx, int seconds);
+int domoticz_update(const char *idx, const char *fmt, ...)
+  __attribute__ ((format (printf, 2, 3)));
+void domoticz_get_stats(struct dz_stats *st);
+void domoticz_stop(void);
+
+#endif
@@ -0,0 +1,286 @@
+/*
+#################################################################################
+# dztest.c - Test of the Domoticz publisher against a local stub server        #
+#                                                                               #
+# Runs a stub HTTP server on 127.0.0.1 in a thread and sends updates through   #
+# domoticz.c, one at a time, while the server answers:                          #
+# - keep-alive: all updates go over one connection                              #
+# - "Connection: close" (with the usual space): the next update goes over a     #
+#   new connection, none is sent on the one the server closed                   #
+# - chunked: the body in chunks, the last chunk in a later segment, the        #
+#   connection is kept                                                          #
+# - a close in the middle of a request: the update is sent again on a fresh    #
+#   connection without a failure                                                #
+# - a burst of updates for one idx within its interval: one request with the   #
+#   last value, the others counted as coalesced                                 #
+# Usage: dztest. Exits with 1 when a check fails.                              #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "domoticz.h"
+#include "testutil.h"
+
+#define STUB_CONNS 8
+#define BODY "{\"status\":\"OK\"}"
+#define BURST 20                /* updates of the burst for one idx */
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+enum stub_mode { KEEP, CLOSE, CHUNKED, DROP };
+
+struct stub_conn {
+  int fd;
+  int said_close;           // the server answered "Connection: close"
+  int have;
+  char buf[1024];
+};
+
+/* what the stub server saw */
+static struct {
+  volatile enum stub_mode mode;
+  volatile int accepts;     // connections accepted
+  volatile int requests;    // requests received
+  volatile int reused;      // requests on a connection the server said to close
+  char last[256];           // request line of the last request
+  volatile int stop;
+} stub;
+
+
+
+static void stub_send(int fd, const char *s)
+{
+  if (send(fd, s, strlen(s), MSG_NOSIGNAL) < 0) {
+    perror("stub send");
+  }
+}
+
+
+static void stub_drop(struct stub_conn *c)
+{
+  close(c->fd);
+  c->fd = -1;
+}
+
+
+/* FUNCTION to answer a complete request as the mode says */
+static void stub_answer(struct stub_conn *c)
+{
+  struct timespec pause = { 0, 50000000L };
+
+  snprintf(stub.last, sizeof(stub.last), "%.*s", (int)strcspn(c->buf, "\r\n"), c->buf);
+  stub.requests++;
+  if (c->said_close) {
+    stub.reused++;
+    stub_drop(c);
+    return;
+  }
+  switch (stub.mode) {
+  case KEEP:
+    stub_send(c->fd, "HTTP/1.1 200 OK\r\nContent-Length: 15\r\n\r\n" BODY);
+    break;
+  case CLOSE:
+    /* the connection stays open here, to see whether the client still uses it */
+    stub_send(c->fd, "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 15\r\n\r\n" BODY);
+    c->said_close = 1;
+    break;
+  case CHUNKED:
+    stub_send(c->fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nf\r\n" BODY "\r\n");
+    nanosleep(&pause, NULL);
+    stub_send(c->fd, "0\r\n\r\n");
+    break;
+  case DROP:
+    stub.mode = KEEP;       // once
+    stub_drop(c);
+    break;
+  }
+}
+
+
+static void *stub_server(void *arg)
+{
+  struct stub_conn conn[STUB_CONNS];
+  struct pollfd pfd[STUB_CONNS + 1];
+  int lfd = *(int *)arg, i, n, fd;
+  char *eoh;
+
+  for (i = 0; i < STUB_CONNS; i++) {
+    conn[i].fd = -1;
+  }
+  while (!stub.stop) {
+    pfd[0].fd = lfd;
+    pfd[0].events = POLLIN;
+    for (i = 0; i < STUB_CONNS; i++) {
+      pfd[i + 1].fd = conn[i].fd;
+      pfd[i + 1].events = POLLIN;
+    }
+    if (poll(pfd, STUB_CONNS + 1, 100) <= 0) {
+      continue;
+    }
+    if (pfd[0].revents & POLLIN) {
+      fd = accept(lfd, NULL, NULL);
+      for (i = 0; i < STUB_CONNS && conn[i].fd >= 0; i++);
+      if (fd >= 0 && i < STUB_CONNS) {
+        memset(&conn[i], 0, sizeof(conn[i]));
+        conn[i].fd = fd;
+        stub.accepts++;
+      } else if (fd >= 0) {
+        close(fd);
+      }
+    }
+    for (i = 0; i < STUB_CONNS; i++) {
+      if (conn[i].fd < 0 || pfd[i + 1].fd != conn[i].fd || !(pfd[i + 1].revents & (POLLIN | POLLHUP))) {
+        continue;
+      }
+      n = recv(conn[i].fd, conn[i].buf + conn[i].have, sizeof(conn[i].buf) - 1 - conn[i].have, 0);
+      if (n <= 0) {
+        stub_drop(&conn[i]);
+        continue;
+      }
+      conn[i].have += n;
+      conn[i].buf[conn[i].have] = '\0';
+      if ((eoh = strstr(conn[i].buf, "\r\n\r\n")) != NULL) {
+        conn[i].have = 0;
+        stub_answer(&conn[i]);
+      } else if (conn[i].have == sizeof(conn[i].buf) - 1) {
+        stub_drop(&conn[i]);
+      }
+    }
+  }
+  for (i = 0; i < STUB_CONNS; i++) {
+    if (conn[i].fd >= 0) {
+      close(conn[i].fd);
+    }
+  }
+  return(NULL);
+}
+
+
+/* FUNCTION to wait until more than done updates were answered or failed */
+static void update_wait(struct dz_stats *st, unsigned long done)
+{
+  int i;
+
+  for (i = 0; i < 1000; i++) {
+    pause_ms(10);
+    domoticz_get_stats(st);
+    if (st->sent + st->failed > done) {
+      return;
+    }
+  }
+  fprintf(stderr, "No answer after %lu updates\n", done);
+}
+
+
+/* FUNCTION to send one update and wait until it was answered or failed */
+static void update(int idx, struct dz_stats *st)
+{
+  char s[DZ_IDX_LEN];
+
+  domoticz_get_stats(st);
+  snprintf(s, sizeof(s), "%d", idx);
+  domoticz_update(s, "%d;%d", idx, idx * 10);
+  update_wait(st, st->sent + st->failed);
+}
+
+
+int main(void)
+{
+  struct sockaddr_in sa;
+  socklen_t len = sizeof(sa);
+  struct dz_stats st, before;
+  pthread_t server;
+  char addr[32];
+  int lfd, one = 1, idx = 1, i, accepts, requests;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+      setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+      bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(lfd, 8) < 0 ||
+      getsockname(lfd, (struct sockaddr *)&sa, &len) < 0) {
+    perror("stub server");
+    return(1);
+  }
+  pthread_create(&server, NULL, stub_server, &lfd);
+  snprintf(addr, sizeof(addr), "127.0.0.1:%d", ntohs(sa.sin_port));
+  if (domoticz_start(addr) != 0) {
+    fprintf(stderr, "Cannot start the publisher\n");
+    return(1);
+  }
+
+  stub.mode = KEEP;
+  for (i = 0; i < 3; i++) {
+    update(idx++, &st);
+  }
+  check(st.sent == 3 && st.failed == 0, "keep-alive: updates sent, failed", st.sent, st.failed);
+  check(stub.accepts == 1, "keep-alive: connections", stub.accepts, 1);
+
+  stub.mode = CLOSE;
+  accepts = stub.accepts;
+  for (i = 0; i < 3; i++) {
+    update(idx++, &st);
+  }
+  check(st.sent == 6 && st.failed == 0, "close: updates sent, failed", st.sent, st.failed);
+  check(stub.reused == 0, "close: requests on a closed connection", stub.reused, 0);
+  check(stub.accepts - accepts == 2, "close: new connections", stub.accepts - accepts, 2);
+
+  stub.mode = CHUNKED;
+  accepts = stub.accepts;
+  for (i = 0; i < 3; i++) {
+    update(idx++, &st);
+  }
+  check(st.sent == 9 && st.failed == 0, "chunked: updates sent, failed", st.sent, st.failed);
+  check(stub.accepts - accepts == 1, "chunked: new connections", stub.accepts - accepts, 1);
+
+  stub.mode = DROP;
+  accepts = stub.accepts;
+  update(idx++, &st);
+  check(st.sent == 10 && st.failed == 0, "closed mid-request: updates sent, failed", st.sent, st.failed);
+  check(stub.accepts - accepts == 1, "closed mid-request: new connections", stub.accepts - accepts, 1);
+  check(stub.requests == 11, "requests received by the server", stub.requests, 11);
+
+  /* after the first update of idx 500 the burst is within its interval */
+  stub.mode = KEEP;
+  domoticz_set_interval("500", 1);
+  update(500, &st);
+  before = st;
+  requests = stub.requests;
+  for (i = 1; i <= BURST; i++) {
+    domoticz_update("500", "500;%d", i);
+  }
+  pause_ms(300);
+  check(stub.requests == requests, "burst: requests within the interval", stub.requests - requests, 0);
+  update_wait(&st, before.sent + before.failed);
+  pause_ms(1500);
+  domoticz_get_stats(&st);
+  check(stub.requests - requests == 1, "burst: updates queued, requests", BURST, stub.requests - requests);
+  check(strstr(stub.last, "idx=500&nvalue=0&svalue=500;" STR(BURST) " ") != NULL,
+        "burst: the last value sent", strlen(stub.last), 0);
+  check(st.coalesced - before.coalesced == BURST - 1 && st.sent - before.sent == 1,
+        "burst: coalesced, sent", st.coalesced - before.coalesced, st.sent - before.sent);
+  check(st.queued - before.queued == (st.coalesced - before.coalesced) + (st.sent - before.sent) && st.depth == 0,
+        "burst: queued = coalesced + sent", st.queued - before.queued, st.depth);
+
+  domoticz_stop();
+  stub.stop = 1;
+  pthread_join(server, NULL);
+  close(lfd);
+  return(test_failed);
+}
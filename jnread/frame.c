@@ -0,0 +1,150 @@
+/*
+#################################################################################
+# frame.c - Binary frames from the CentralNode                                  #
+#                                                                               #
+# See frame.h for the interface.                                                #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "frame.h"
+#include "parse.h"
+
+
+/* FUNCTION to add a byte to the CRC, the same as _crc16_update() of avr-libc */
+unsigned short frame_crc16(unsigned short crc, unsigned char b)
+{
+  int i;
+
+  crc ^= b;
+  for (i = 0; i < 8; i++) {
+    crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : (crc >> 1);
+  }
+  return(crc);
+}
+
+
+/* FUNCTION to make a frame in buf (FRAME_MAX bytes), returns its length */
+int frame_encode(unsigned char *buf, char type, int node, const long *value, int n)
+{
+  unsigned short crc = ~0;
+  int len = 0, wide = 0, i;
+
+  for (i = 0; i < n; i++) {
+    if (value[i] < -32768 || value[i] > 32767) {
+      wide = FRAME_WIDE;
+    }
+  }
+  buf[len++] = FRAME_SYNC;
+  buf[len++] = type;
+  buf[len++] = node;
+  buf[len++] = n | wide;
+  for (i = 0; i < n; i++) {
+    buf[len++] = value[i] & 0xff;
+    buf[len++] = (value[i] >> 8) & 0xff;
+    if (wide) {
+      buf[len++] = (value[i] >> 16) & 0xff;
+      buf[len++] = (value[i] >> 24) & 0xff;
+    }
+  }
+  for (i = 1; i < len; i++) {
+    crc = frame_crc16(crc, buf[i]);
+  }
+  buf[len++] = crc & 0xff;
+  buf[len++] = crc >> 8;
+  return(len);
+}
+
+
+/* types the CentralNode prints with a space at the end */
+#define TRAILING_SPACE "iop"
+
+/* FUNCTION to render the values as the CentralNode prints the type (so
+*  the logs are the same as without frames), returns the length of the line
+*/
+static int frame_line(char type, const long *value, int n, char *line, int max)
+{
+  const struct msg_desc *d = parse_desc(type);
+  const char *l;
+  int len, i = 0;
+
+  len = snprintf(line, max, "%c", type);
+  if (type == 't' && n == 5) {
+    /* the minutes with two digits and two spaces before the date */
+    len += snprintf(line + len, max - len, " %ld:%02ld  %ld-%ld-20%ld",
+                    value[0], value[1], value[2], value[3], value[4]);
+  } else if (d != NULL && d->n == n) {
+    for (l = d->layout; *l != '\0' && len < max - 1; l++) {
+      if (*l == '#') {
+        len += snprintf(line + len, max - len, "%ld", value[i++]);
+      } else {
+        line[len++] = *l;
+      }
+    }
+  } else {
+    /* unknown layout: the values only, the parser will not accept it */
+    for (i = 0; i < n && len < max - 1; i++) {
+      len += snprintf(line + len, max - len, " %ld", value[i]);
+    }
+  }
+  if (strchr(TRAILING_SPACE, type) != NULL && len < max - 1) {
+    line[len++] = ' ';
+  }
+  if (len > max - 3) {
+    len = max - 3;
+  }
+  line[len++] = '\r';
+  line[len++] = '\n';
+  line[len] = '\0';
+  return(len);
+}
+
+
+/* FUNCTION to decode the frame at the start of buf (avail bytes, buf[0] is
+*  the sync byte) into an ASCII line. Returns the length of the line and sets
+*  used to the size of the frame, or FRAME_MORE, or FRAME_BAD (used = 1, so
+*  the search for the next sync byte continues after this one).
+*/
+int frame_decode(const unsigned char *buf, int avail, int *used, char *line, int max)
+{
+  long value[FRAME_MAX_FIELDS];
+  unsigned short crc = ~0;
+  int n, width, len, i;
+
+  *used = 1;
+  if (avail < FRAME_HEADER) {
+    return(FRAME_MORE);
+  }
+  n = buf[3] & ~FRAME_WIDE;
+  width = (buf[3] & FRAME_WIDE) ? 4 : 2;
+  if (n > FRAME_MAX_FIELDS || buf[1] < 'a' || buf[1] > 'z') {
+    return(FRAME_BAD);
+  }
+  len = FRAME_HEADER + width * n + 2;
+  if (avail < len) {
+    return(FRAME_MORE);
+  }
+  for (i = 1; i < len - 2; i++) {
+    crc = frame_crc16(crc, buf[i]);
+  }
+  if (buf[len - 2] != (crc & 0xff) || buf[len - 1] != (crc >> 8)) {
+    return(FRAME_BAD);
+  }
+  for (i = 0; i < n; i++) {
+    const unsigned char *f = buf + FRAME_HEADER + width * i;
+
+    if (width == 4) {
+      value[i] = (int)((unsigned int)f[0] | (unsigned int)f[1] << 8 |
+                       (unsigned int)f[2] << 16 | (unsigned int)f[3] << 24);
+    } else {
+      value[i] = (short)(f[0] | f[1] << 8);
+    }
+  }
+  *used = len;
+  return(frame_line(buf[1], value, n, line, max));
+}
@@ -0,0 +1,38 @@
+/*
+#################################################################################
+# frame.h - Binary frames from the CentralNode                                  #
+#                                                                               #
+# With FRAMES set in CentralNode.ino every message is written to USB as a       #
+# binary frame instead of an ASCII line:                                        #
+#   0xa5 <type> <node id> <n> <n fields, LSB first> <CRC16, LSB first>          #
+# The fields are int16, or int32 when FRAME_WIDE is set in <n> (when a value   #
+# does not fit in an int16).                                                    #
+# The CRC is _crc16_update() of avr-libc (as SensorNode uses for the EEPROM),   #
+# starting at ~0, over type up to the last field. A frame is decoded into the   #
+# ASCII line the CentralNode would have printed, so the rest of jnread and      #
+# the logs stay the same. The sync byte never occurs in ASCII text, so frames   #
+# and lines can be mixed on the port and are told apart per message.            #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#define FRAME_SYNC 0xa5
+#define FRAME_HEADER 4          /* sync, type, node id, no. of fields */
+#define FRAME_MAX_FIELDS 8
+#define FRAME_WIDE 0x80         /* in <n>: the fields are int32, else int16 */
+#define FRAME_MAX (FRAME_HEADER + 4 * FRAME_MAX_FIELDS + 2)
+
+/* results of frame_decode() besides the length of the line */
+#define FRAME_MORE 0            /* the frame is not complete yet */
+#define FRAME_BAD -1            /* not a frame: wrong no. of fields or CRC */
+
+unsigned short frame_crc16(unsigned short crc, unsigned char b);
+int frame_encode(unsigned char *buf, char type, int node, const long *value, int n);
+int frame_decode(const unsigned char *buf, int avail, int *used, char *line, int max);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+#################################################################################
+# html.c - Rendering of the html page with the actual values                   #
+#                                                                               #
+# See html.h for the interface.                                                 #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "html.h"
+
+
+/* The page template, the arguments are filled in by html_render() */
+static const char html_template[] =
+  "<HTML><HEAD><TITLE>JJ Home data</TITLE><META HTTP-EQUIV=\"refresh\" CONTENT=\"30\"><LINK REL=\"shortcut icon\" HREF=\"favicon.ico\"></HEAD>"
+  "<BODY BGCOLOR=#000066 TEXT=#E8EEFD LINK=#FFFFFF VLINK=#C6FDF4 ALINK=#0BBFFF BACKGROUND=$BGIMG>"
+  "<FONT FACE=\"Arial\" SIZE=3>"
+  "<TABLE WIDTH=500 BORDER=1 CELLPADDING=2 CELLSPACING=0 BGCOLOR=#1A689D BORDERCOLOR=#0DD3EA>"
+  "<TR><TD COLSPAN=3><FONT SIZE=4 COLOR=#00FF00><CENTER>%s</CENTER></FONT></TD></TR>"
+  "<TR><TD ROWSPAN=2><CENTER><IMG BORDER=0 SRC=\"pictures/electricity-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Actual power usage (W)</TD><TD><FONT SIZE=4>%d W</FONT></TD>"
+  "<TR><TD>Electricity usage today (kWh)</TD><TD><FONT SIZE=4>%3.3f kWh</FONT></TD></TR>"
+  "<TR><TD ROWSPAN=3><CENTER><IMG BORDER=0 SRC=\"pictures/solar-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Actual solar power (W)</TD><TD><FONT SIZE=4>%d W</FONT></TD>"
+  "<TR><TD>Solar power today (kWh)</TD><TD><FONT SIZE=4>%3.3f kWh</FONT></TD></TR>"
+  "<TR><TD>Running time today (hh:mm)</TD><TD><FONT SIZE=4>%02u:%02u</FONT></TD></TR>"
+  "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/gas-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Gas usage today (m&sup3;)</TD><TD><FONT SIZE=4>%6.3f m&sup3;</FONT></TD></TR>"
+  "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/water-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Water usage today (L)</TD><TD><FONT SIZE=4>%d L</FONT></TD></TR>"
+  "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/temp_inside-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Inside temperature</TD><TD><FONT SIZE=4>%2.1f &deg;C</FONT></TD></TR>"
+  "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/temp_outside-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Outside temperature</TD><TD><FONT SIZE=4>%2.1f &deg;C</FONT></TD></TR>"
+  "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/pressure-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Barometric pressure</TD><TD><FONT SIZE=4>%4.1f hPa</FONT></TD></TR>"
+  "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_day.png\"></TD>"
+  "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_week.png\"></TD>"
+  "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_month.png\"></TD>"
+  "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_year.png\"></TD>"
+  "</FONT></TABLE></BODY></HTML>";
+
+
+/* FUNCTION to render the page into buf, returns the length or -1 */
+int html_render(char *buf, size_t size, const struct html_values *v)
+{
+  int len;
+
+  len = snprintf(buf, size, html_template,
+  v->datetime,
+  v->watt,
+  (float)v->e_today/1000,
+  v->swatt,
+  (float)v->s_today/1000,
+  v->s_runtime/60, v->s_runtime%60,
+  (float)v->g_today/1000,
+  v->w_today,
+  (float)v->itemperature/10,
+  (float)v->otemperature/10,
+  (float)v->opressure/10);
+  if (len < 0 || (size_t)len >= size) {
+    return(-1);
+  }
+  return(len);
+}
+
+
+/* FUNCTION to write the page with one write to tmpfile and rename it */
+int html_write(const char *tmpfile, const char *htmlfile, const struct html_values *v)
+{
+  char buf[HTML_BUF_SIZE];
+  int len, fd;
+  size_t done = 0;
+  ssize_t n;
+
+  if ((len = html_render(buf, sizeof(buf), v)) < 0) {
+    return(1);
+  }
+  if ((fd = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+    return(1);
+  }
+  while (done < (size_t)len) {
+    n = write(fd, buf + done, len - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      close(fd);
+      unlink(tmpfile);
+      return(1);
+    }
+    done += n;
+  }
+  close(fd);
+  return(rename(tmpfile, htmlfile) != 0);
+}
+
+
+/* FUNCTION to write the page only when a displayed value or the minute
+*  changed since the last written page (the date/time itself is not compared)
+*/
+int html_update(const char *tmpfile, const char *htmlfile, const struct html_values *v)
+{
+  static struct html_values last;
+  static int written = 0;
+  struct html_values cmp;
+
+  cmp = *v;
+  memcpy(cmp.datetime, last.datetime, sizeof(cmp.datetime));
+  if (written && memcmp(&cmp, &last, sizeof(cmp)) == 0) {
+    return(0);
+  }
+  if (html_write(tmpfile, htmlfile, v) != 0) {
+    return(1);
+  }
+  last = *v;
+  written = 1;
+  return(0);
+}
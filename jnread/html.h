@@ -0,0 +1,41 @@
+/*
+#################################################################################
+# html.h - Rendering of the html page with the actual values                   #
+#                                                                               #
+# The page is rendered from one template into a buffer and written with a     #
+# single write to a temporary file that is then renamed over the page.         #
+# html_update() only does so when a displayed value or the minute changed.     #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef HTML_H
+#define HTML_H
+
+#include <stddef.h>
+
+#define HTML_BUF_SIZE 4096
+
+/* The values displayed on the page */
+struct html_values {
+  char datetime[32];
+  int minute;
+  int watt;
+  int e_today;
+  int swatt;
+  unsigned int s_today;
+  unsigned int s_runtime;
+  unsigned int g_today;
+  unsigned int w_today;
+  int itemperature;
+  int otemperature;
+  int opressure;
+};
+
+int html_render(char *buf, size_t size, const struct html_values *v);
+int html_write(const char *tmpfile, const char *htmlfile, const struct html_values *v);
+int html_update(const char *tmpfile, const char *htmlfile, const struct html_values *v);
+
+#endif
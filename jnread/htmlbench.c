@@ -0,0 +1,149 @@
+/*
+#################################################################################
+# htmlbench.c - Microbenchmark for the html page creation per USB line         #
+#                                                                               #
+# Compares the cost per processed line of:                                     #
+#   old:    20x sprintf + append_to_file() (fopen/fputs/fclose) + rename       #
+#   write:  html_write(), one rendered buffer, one write + rename              #
+#   update: html_update(), as write but only when a value/minute changed       #
+# The update run uses a line stream in which 1 of every CHANGE_EVERY lines     #
+# changes a displayed value.                                                   #
+#                                                                               #
+# Usage: htmlbench [directory] [lines]   (default: /tmp, 10000 lines)          #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "html.h"
+
+#define CHANGE_EVERY 4
+
+char ahtml[256];
+char thtml[256];
+char htmlstring[255];
+
+
+/* The original implementation, kept here to compare against */
+int append_to_file(char filename[], char str2log[])
+{
+  FILE *afp;
+
+  if ((afp = fopen(filename, "a")) == NULL) {
+    return(1);
+  }
+  fputs(str2log, afp);
+  fclose(afp);
+  return(0);
+}
+
+void old_create_html_page(const struct html_values *v) {
+  sprintf(htmlstring, "<HTML><HEAD><TITLE>JJ Home data</TITLE><META HTTP-EQUIV=\"refresh\" CONTENT=\"30\"><LINK REL=\"shortcut icon\" HREF=\"favicon.ico\"></HEAD>");
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<BODY BGCOLOR=#000066 TEXT=#E8EEFD LINK=#FFFFFF VLINK=#C6FDF4 ALINK=#0BBFFF BACKGROUND=$BGIMG>");
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<FONT FACE=\"Arial\" SIZE=3>");
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TABLE WIDTH=500 BORDER=1 CELLPADDING=2 CELLSPACING=0 BGCOLOR=#1A689D BORDERCOLOR=#0DD3EA>");
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD COLSPAN=3><FONT SIZE=4 COLOR=#00FF00><CENTER>%s</CENTER></FONT></TD></TR>", v->datetime);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD ROWSPAN=2><CENTER><IMG BORDER=0 SRC=\"pictures/electricity-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Actual power usage (W)</TD><TD><FONT SIZE=4>%d W</FONT></TD>", v->watt);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD>Electricity usage today (kWh)</TD><TD><FONT SIZE=4>%3.3f kWh</FONT></TD></TR>", (float)v->e_today/1000);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD ROWSPAN=3><CENTER><IMG BORDER=0 SRC=\"pictures/solar-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Actual solar power (W)</TD><TD><FONT SIZE=4>%d W</FONT></TD>", v->swatt);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD>Solar power today (kWh)</TD><TD><FONT SIZE=4>%3.3f kWh</FONT></TD></TR>", (float)v->s_today/1000);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD>Running time today (hh:mm)</TD><TD><FONT SIZE=4>%02u:%02u</FONT></TD></TR>", v->s_runtime/60, v->s_runtime%60);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/gas-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Gas usage today (m&sup3;)</TD><TD><FONT SIZE=4>%6.3f m&sup3;</FONT></TD></TR>", (float)v->g_today/1000);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/water-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Water usage today (L)</TD><TD><FONT SIZE=4>%d L</FONT></TD></TR>", v->w_today);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/temp_inside-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Inside temperature</TD><TD><FONT SIZE=4>%2.1f &deg;C</FONT></TD></TR>", (float)v->itemperature/10);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/temp_outside-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Outside temperature</TD><TD><FONT SIZE=4>%2.1f &deg;C</FONT></TD></TR>", (float)v->otemperature/10);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/pressure-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Barometric pressure</TD><TD><FONT SIZE=4>%4.1f hPa</FONT></TD></TR>", (float)v->opressure/10);
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_day.png\"></TD>");
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_week.png\"></TD>");
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_month.png\"></TD>");
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_year.png\"></TD>");
+  append_to_file(thtml, htmlstring);
+  sprintf(htmlstring, "</FONT></TABLE></BODY></HTML>");
+  append_to_file(thtml, htmlstring);
+  rename(thtml, ahtml);
+}
+
+
+double now_us()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+
+/* FUNCTION to set the values as they would be after line i */
+void next_values(struct html_values *v, int i)
+{
+  snprintf(v->datetime, sizeof(v->datetime), "Fri Oct 16 12:%02d:%02d CEST 2026", (i / 60) % 60, i % 60);
+  v->minute = (i / 60) % 60;
+  if (i % CHANGE_EVERY == 0) {
+    v->watt = 300 + i % 500;
+    v->e_today = 1000 + i;
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  const char *dir = (argc > 1) ? argv[1] : "/tmp";
+  int lines = (argc > 2) ? atoi(argv[2]) : 10000;
+  struct html_values v;
+  double t0, t_old, t_write, t_update;
+  int i;
+
+  snprintf(ahtml, sizeof(ahtml), "%s/htmlbench.html", dir);
+  snprintf(thtml, sizeof(thtml), "%s/htmlbench.new", dir);
+  memset(&v, 0, sizeof(v));
+
+  t0 = now_us();
+  for (i = 0; i < lines; i++) {
+    next_values(&v, i);
+    old_create_html_page(&v);
+  }
+  t_old = now_us() - t0;
+
+  t0 = now_us();
+  for (i = 0; i < lines; i++) {
+    next_values(&v, i);
+    html_write(thtml, ahtml, &v);
+  }
+  t_write = now_us() - t0;
+
+  t0 = now_us();
+  for (i = 0; i < lines; i++) {
+    next_values(&v, i);
+    html_update(thtml, ahtml, &v);
+  }
+  t_update = now_us() - t0;
+
+  unlink(ahtml);
+  printf("html page per line (%d lines in %s):\n", lines, dir);
+  printf("  old    (20x fopen/fclose) : %8.2f us\n", t_old / lines);
+  printf("  write  (1 write + rename) : %8.2f us\n", t_write / lines);
+  printf("  update (only when changed): %8.2f us  (1 of %d lines changes a value)\n", t_update / lines, CHANGE_EVERY);
+  return(0);
+}
@@ -0,0 +1,409 @@
+/*
+#################################################################################
+# httpd.c - Small local HTTP server for status information of jnread           #
+#                                                                               #
+# See httpd.h for the interface.                                                #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "httpd.h"
+
+struct route {
+  char path[64];
+  httpd_handler handler;
+};
+
+struct conn {
+  int fd;
+  time_t since;
+  char req[HTTPD_REQ_SIZE];
+  size_t req_len;
+  struct httpd_req hreq;    // the parsed request (pointing into req)
+  int route;                // of the request, -1 = none
+  int status;               // when there is no route
+  time_t deadline;          // end of the wait of the handler, 0 = not waiting
+  char *out;                // response being written, NULL while reading
+  size_t out_len;
+  size_t out_done;
+};
+
+static struct route routes[HTTPD_MAX_ROUTES];
+static int n_routes = 0;
+static struct conn conns[HTTPD_MAX_CONN];
+static int listen_fd = -1;
+static int wake_fd[2] = { -1, -1 };
+static pthread_t thread;
+
+
+/* FUNCTION to register the handler for a path (before httpd_start) */
+int httpd_route(const char *path, httpd_handler handler)
+{
+  if (n_routes == HTTPD_MAX_ROUTES) {
+    return(1);
+  }
+  snprintf(routes[n_routes].path, sizeof(routes[n_routes].path), "%s", path);
+  routes[n_routes].handler = handler;
+  n_routes++;
+  return(0);
+}
+
+
+/* FUNCTION to call the handlers that wait for a change again (from any thread) */
+void httpd_wake(void)
+{
+  char c = 1;
+
+  if (wake_fd[1] >= 0 && write(wake_fd[1], &c, 1) < 0) {
+    return;   // full: a wake is pending already
+  }
+}
+
+
+/* FUNCTION to add text to the body of a response */
+int httpd_printf(struct httpd_resp *resp, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  for (;;) {
+    va_start(ap, fmt);
+    n = vsnprintf(resp->body + resp->len, resp->size - resp->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+      return(1);
+    }
+    if ((size_t)n < resp->size - resp->len) {
+      resp->len += n;
+      return(0);
+    }
+    char *p = realloc(resp->body, resp->size * 2 + n);
+    if (p == NULL) {
+      return(1);
+    }
+    resp->body = p;
+    resp->size = resp->size * 2 + n;
+  }
+}
+
+
+/* FUNCTION to get the value of a request header, NULL when not present */
+const char *httpd_header(const struct httpd_req *req, const char *name, char *value, size_t size)
+{
+  const char *p = req->headers;
+  size_t nlen = strlen(name);
+  size_t vlen;
+
+  while (p != NULL && *p != '\0') {
+    if (strncasecmp(p, name, nlen) == 0 && p[nlen] == ':') {
+      p += nlen + 1;
+      while (*p == ' ') {
+        p++;
+      }
+      vlen = strcspn(p, "\r\n");
+      if (vlen >= size) {
+        vlen = size - 1;
+      }
+      memcpy(value, p, vlen);
+      value[vlen] = '\0';
+      return(value);
+    }
+    if ((p = strstr(p, "\r\n")) != NULL) {
+      p += 2;
+    }
+  }
+  return(NULL);
+}
+
+
+static void conn_close(struct conn *c)
+{
+  close(c->fd);
+  free(c->out);
+  c->fd = -1;
+  c->out = NULL;
+}
+
+
+static const char *status_text(int status)
+{
+  switch (status) {
+  case 200: return("OK");
+  case 304: return("Not Modified");
+  case 400: return("Bad Request");
+  case 404: return("Not Found");
+  case 405: return("Method Not Allowed");
+  default: return("Internal Server Error");
+  }
+}
+
+
+/* FUNCTION to format the header block of a response into buf (as snprintf),
+*  returns its length
+*/
+static int format_headers(char *buf, size_t size, const struct httpd_resp *resp)
+{
+  return(snprintf(buf, size,
+  "HTTP/1.1 %d %s\r\n"
+  "Content-Type: %s\r\n"
+  "Content-Length: %zu\r\n"
+  "%s"
+  "Connection: close\r\n\r\n", resp->status, status_text(resp->status),
+  resp->content_type, resp->len, resp->headers));
+}
+
+
+/* FUNCTION to prepare the response, or to keep waiting when the handler
+*  waits for a change
+*/
+static void conn_respond(struct conn *c, time_t now)
+{
+  struct httpd_req *req = &c->hreq;
+  struct httpd_resp resp;
+  int n;
+
+  memset(&resp, 0, sizeof(resp));
+  resp.size = 1024;
+  resp.body = malloc(resp.size);
+  resp.body[0] = '\0';
+  resp.content_type = "text/plain; charset=utf-8";
+  resp.status = c->status;
+  if (c->route >= 0) {
+    resp.status = 200;
+    req->timed_out = (c->deadline != 0 && now >= c->deadline);
+    routes[c->route].handler(req, &resp);
+    if (resp.wait > 0 && !req->timed_out) {
+      if (c->deadline == 0) {
+        c->deadline = now + (resp.wait < HTTPD_MAX_WAIT ? resp.wait : HTTPD_MAX_WAIT);
+      }
+      free(resp.body);
+      return;
+    }
+  }
+  c->deadline = 0;
+  if (resp.status == 304) {
+    resp.len = 0;
+  } else if (resp.status != 200 && resp.len == 0) {
+    httpd_printf(&resp, "%d %s\n", resp.status, status_text(resp.status));
+  }
+
+  /* the headers of the handler have no limit here, so measure first */
+  n = format_headers(NULL, 0, &resp);
+  c->out = malloc(n + resp.len + 1);
+  format_headers(c->out, n + 1, &resp);
+  if (strcmp(req->method, "HEAD") == 0) {
+    resp.len = 0;       // headers as for GET, no body
+  }
+  memcpy(c->out + n, resp.body, resp.len);
+  c->out_len = n + resp.len;
+  c->out_done = 0;
+  free(resp.body);
+}
+
+
+/* FUNCTION to handle a complete request */
+static void conn_request(struct conn *c, time_t now)
+{
+  struct httpd_req *req = &c->hreq;
+  char *eol;
+  int i;
+
+  memset(req, 0, sizeof(*req));
+  c->route = -1;
+  c->deadline = 0;
+  eol = strstr(c->req, "\r\n");
+  *eol = '\0';
+  req->headers = eol + 2;
+  if (sscanf(c->req, "%7s %127s", req->method, req->path) != 2) {
+    c->status = 400;
+  } else if (strcmp(req->method, "GET") != 0 && strcmp(req->method, "HEAD") != 0) {
+    c->status = 405;
+  } else {
+    if ((req->query = strchr(req->path, '?')) != NULL) {
+      *req->query++ = '\0';
+    } else {
+      req->query = req->path + strlen(req->path);
+    }
+    c->status = 404;
+    for (i = 0; i < n_routes; i++) {
+      if (strcmp(routes[i].path, req->path) == 0) {
+        c->route = i;
+        break;
+      }
+    }
+  }
+  conn_respond(c, now);
+}
+
+
+/* FUNCTION to handle activity on a connection */
+static void conn_event(struct conn *c, time_t now)
+{
+  char buf[256];
+  ssize_t n;
+
+  if (c->deadline != 0) {
+    /* waiting: only see if the client went away */
+    n = read(c->fd, buf, sizeof(buf));
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+      conn_close(c);
+    }
+    return;
+  }
+  if (c->out == NULL) {
+    n = read(c->fd, c->req + c->req_len, sizeof(c->req) - 1 - c->req_len);
+    if (n <= 0) {
+      if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+      }
+      conn_close(c);
+      return;
+    }
+    c->req_len += n;
+    c->req[c->req_len] = '\0';
+    if (strstr(c->req, "\r\n\r\n") != NULL) {
+      conn_request(c, now);
+    } else if (c->req_len == sizeof(c->req) - 1) {
+      conn_close(c);    // request too big
+      return;
+    }
+  }
+  if (c->out != NULL) {
+    n = send(c->fd, c->out + c->out_done, c->out_len - c->out_done, MSG_NOSIGNAL);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+      return;
+    }
+    if (n <= 0 || (c->out_done += n) == c->out_len) {
+      conn_close(c);
+    }
+  }
+}
+
+
+static void *httpd_loop(void *arg)
+{
+  struct pollfd pfd[HTTPD_MAX_CONN + 2];
+  int map[HTTPD_MAX_CONN + 2];
+  char buf[64];
+  int i, n, fd;
+  time_t now;
+
+  for (;;) {
+    n = 0;
+    now = time(NULL);
+    for (i = 0; i < HTTPD_MAX_CONN; i++) {
+      if (conns[i].fd >= 0 && conns[i].deadline != 0 && now >= conns[i].deadline) {
+        conns[i].since = now;
+        conn_respond(&conns[i], now);
+      }
+      if (conns[i].fd >= 0 && conns[i].deadline == 0 && now - conns[i].since > HTTPD_TIMEOUT) {
+        conn_close(&conns[i]);
+      }
+      if (conns[i].fd >= 0) {
+        pfd[n].fd = conns[i].fd;
+        pfd[n].events = conns[i].out ? POLLOUT : POLLIN;
+        map[n++] = i;
+      }
+    }
+    pfd[n].fd = listen_fd;
+    pfd[n].events = POLLIN;
+    map[n++] = -1;
+    pfd[n].fd = wake_fd[0];
+    pfd[n].events = POLLIN;
+    map[n++] = -2;
+    if (poll(pfd, n, 1000) <= 0) {
+      continue;
+    }
+    now = time(NULL);
+    for (i = 0; i < n; i++) {
+      if (pfd[i].revents == 0) {
+        continue;
+      }
+      if (map[i] >= 0) {
+        conn_event(&conns[map[i]], now);
+        continue;
+      }
+      if (map[i] == -2) {
+        /* a change: the waiting handlers again */
+        while (read(wake_fd[0], buf, sizeof(buf)) > 0);
+        for (fd = 0; fd < HTTPD_MAX_CONN; fd++) {
+          if (conns[fd].fd >= 0 && conns[fd].deadline != 0) {
+            conns[fd].since = now;
+            conn_respond(&conns[fd], now);
+          }
+        }
+        continue;
+      }
+      while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        int j;
+
+        for (j = 0; j < HTTPD_MAX_CONN && conns[j].fd >= 0; j++);
+        if (j == HTTPD_MAX_CONN) {
+          close(fd);    // too busy
+          continue;
+        }
+        conns[j].fd = fd;
+        conns[j].since = now;
+        conns[j].req_len = 0;
+        conns[j].out = NULL;
+        conns[j].deadline = 0;
+      }
+    }
+  }
+  return(NULL);
+}
+
+
+/* FUNCTION to start the server on addr:port */
+int httpd_start(const char *addr, int port)
+{
+  struct sockaddr_in sin;
+  int i, on = 1;
+
+  for (i = 0; i < HTTPD_MAX_CONN; i++) {
+    conns[i].fd = -1;
+  }
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(port);
+  if (inet_pton(AF_INET, addr, &sin.sin_addr) != 1) {
+    return(1);
+  }
+  if ((listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+    return(1);
+  }
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(listen_fd, (struct sockaddr *)&sin, sizeof(sin)) != 0 || listen(listen_fd, 16) != 0) {
+    close(listen_fd);
+    listen_fd = -1;
+    return(1);
+  }
+  if (pipe2(wake_fd, O_NONBLOCK | O_CLOEXEC) != 0) {
+    close(listen_fd);
+    listen_fd = -1;
+    return(1);
+  }
+  if (pthread_create(&thread, NULL, httpd_loop, NULL) != 0) {
+    return(1);
+  }
+  pthread_detach(thread);
+  return(0);
+}
@@ -0,0 +1,55 @@
+/*
+#################################################################################
+# httpd.h - Small local HTTP server for status information of jnread           #
+#                                                                               #
+# Runs in its own thread with a poll() loop. Every request is answered by the  #
+# handler registered for its path, after which the connection is closed.       #
+# A handler can wait for a change (long-poll) by setting resp->wait: the       #
+# connection is kept open without a response and the handler is called again  #
+# after every httpd_wake() and, with req->timed_out set, when the wait is     #
+# over, then it has to answer.                                                  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef HTTPD_H
+#define HTTPD_H
+
+#include <stddef.h>
+
+#define HTTPD_MAX_CONN 64       /* connections handled at the same time */
+#define HTTPD_REQ_SIZE 2048     /* max. size of a request (headers) */
+#define HTTPD_MAX_ROUTES 8
+#define HTTPD_TIMEOUT 5         /* close a connection idle for this long (s) */
+#define HTTPD_MAX_WAIT 60       /* max. wait of a handler for a change (s) */
+
+struct httpd_req {
+  char method[8];
+  char path[128];
+  char *query;              // after the '?', "" when none
+  const char *headers;      // all header lines
+  int timed_out;            // the wait of the handler is over
+};
+
+struct httpd_resp {
+  int status;
+  const char *content_type;
+  char headers[256];        // extra header lines, each ending in \r\n
+  char *body;
+  size_t len;
+  size_t size;
+  int wait;                 // s, > 0: no response yet, call the handler again
+};
+
+typedef void (*httpd_handler)(const struct httpd_req *req, struct httpd_resp *resp);
+
+int httpd_start(const char *addr, int port);
+int httpd_route(const char *path, httpd_handler handler);
+void httpd_wake(void);
+int httpd_printf(struct httpd_resp *resp, const char *fmt, ...)
+  __attribute__ ((format (printf, 2, 3)));
+const char *httpd_header(const struct httpd_req *req, const char *name, char *value, size_t size);
+
+#endif
@@ -0,0 +1,330 @@
+/*
+#################################################################################
+# jngen.c - Generator of synthetic JeeNode traffic for benchmarking jnread     #
+#                                                                               #
+# Writes lines as the CentralNode prints them on USB (a/e/g/w/i/o/p/s) with    #
+# a configurable mix and rate. Counters behave like real meters.               #
+#                                                                               #
+# Usage: jngen [options] [-t command [args]]                                  #
+#   -n <lines>    no. of lines (default 100000)                                #
+#   -m <mix>      weights per type (default e=60,g=10,w=10,s=5,i=5,o=5,p=4,a=1) #
+#   -r <rate>     lines per second, 0 = as fast as possible (default 0)        #
+#   -l            prefix every line with the time as in ALL_LOG (for replay),  #
+#                 the lines are 1/rate s apart (1 s when rate is 0)            #
+#   -s <seed>     seed for the random numbers (default 1)                      #
+#   -b            write binary frames (as CentralNode.ino with FRAMES 1)       #
+#   -c <n>        corrupt one bit in 1 of every n lines/frames                 #
+#   -t command    create a pty, start command with the pty appended as last    #
+#                 argument and write the lines to the pty. All arguments after #
+#                 -t are the command, e.g.                                     #
+#                 jngen -r 5000 -t ./jnread --output /tmp/b --bench -p         #
+#   -G <n>        n gateways (CentralNodes) that get the same lines: n ptys,   #
+#                 the others are appended as "-p <pty>" (with -t)              #
+#   -L <percent>  every gateway loses this percentage of the lines             #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "parse.h"
+#include "frame.h"
+
+#define MAX_TYPES 8
+#define MAX_GATEWAYS 4
+
+struct mixitem {
+  char type;
+  int weight;
+};
+
+struct mixitem mix[MAX_TYPES];
+int n_mix = 0;
+int total_weight = 0;
+unsigned long rnd_state = 1;
+unsigned long loss_state = 88172645463325252UL;   // apart, same lines with loss
+
+/* node ids of the JeeNodes that send the types */
+#define NODE_SENSOR 3
+#define NODE_GLCD 4
+#define NODE_SOLAR 5
+#define NODE_APPLIANCE 6
+#define NODE_CENTRAL 30
+
+/* meter state */
+long e_count = 120000, g_count = 8000, w_count = 30000;
+long s_today = 0, s_runtime = 0;
+
+
+unsigned long xorshift(unsigned long *state)
+{
+  /* xorshift64 */
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return(*state);
+}
+
+
+unsigned long rnd(void)
+{
+  return(xorshift(&rnd_state));
+}
+
+
+int parse_mix(char *spec)
+{
+  char *item, *save = NULL;
+  char type;
+  int weight;
+
+  n_mix = 0;
+  total_weight = 0;
+  for (item = strtok_r(spec, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+    if (sscanf(item, "%c=%d", &type, &weight) != 2 || strchr("aegwiops", type) == NULL ||
+        weight < 0 || n_mix == MAX_TYPES) {
+      return(1);
+    }
+    mix[n_mix].type = type;
+    mix[n_mix].weight = weight;
+    total_weight += weight;
+    n_mix++;
+  }
+  return(total_weight == 0);
+}
+
+
+/* FUNCTION to make the next line, returns its length */
+int next_line(char *buf, size_t size)
+{
+  long pick = rnd() % total_weight;
+  int i;
+
+  for (i = 0; i < n_mix - 1 && pick >= mix[i].weight; i++) {
+    pick -= mix[i].weight;
+  }
+  switch (mix[i].type) {
+  case 'a':
+    return(snprintf(buf, size, "a %ld\r\n", 50 + rnd() % 2000));
+  case 'e':
+    e_count++;
+    return(snprintf(buf, size, "e %ld %ld\r\n", 150 + rnd() % 3000, e_count));
+  case 'g':
+    g_count++;
+    return(snprintf(buf, size, "g %ld %ld\r\n", g_count * 10, g_count));
+  case 'w':
+    w_count++;
+    return(snprintf(buf, size, "w %ld %ld\r\n", w_count, w_count));
+  case 'i':
+    return(snprintf(buf, size, "i %ld \r\n", 180 + rnd() % 60));
+  case 'o':
+    return(snprintf(buf, size, "o %ld \r\n", -50 + (long)(rnd() % 300)));
+  case 'p':
+    return(snprintf(buf, size, "p %ld \r\n", 9900 + rnd() % 400));
+  default:
+    s_today += 1;
+    s_runtime = (s_today / 10) % 1440;
+    return(snprintf(buf, size, "s %ld %ld %ld\r\n", rnd() % 3500, s_today, s_runtime));
+  }
+}
+
+
+/* FUNCTION to make a binary frame of a line, returns its length */
+int line_to_frame(const char *line, unsigned char *buf)
+{
+  struct message m;
+  int node;
+
+  parse_line(line, &m);
+  switch (m.type) {
+  case 'a': node = NODE_APPLIANCE; break;
+  case 'i': node = NODE_GLCD; break;
+  case 's': node = NODE_SOLAR; break;
+  case 'o': case 'p': case 't': node = NODE_CENTRAL; break;
+  default: node = NODE_SENSOR;
+  }
+  return(frame_encode(buf, m.type, node, m.value, m.n));
+}
+
+
+long now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec * 1000000000L + ts.tv_nsec);
+}
+
+
+int write_all(int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    if ((n = write(fd, buf, len)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return(1);
+    }
+    buf += n;
+    len -= n;
+  }
+  return(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+  long lines = 100000, i;
+  double rate = 0;
+  int logformat = 0, binary = 0, opt, len, status = 0;
+  int master[MAX_GATEWAYS], slave, gateways = 1, g;
+  double loss = 0;
+  long corrupt = 0;
+  char defmix[] = "e=60,g=10,w=10,s=5,i=5,o=5,p=4,a=1";
+  char buf[128], line[96], ptyname[MAX_GATEWAYS][64], **cmd = NULL;
+  time_t logtime;
+  struct tm tm;
+  struct termios tio;
+  long t0, due;
+  pid_t child = 0;
+  FILE *out = stdout;
+
+  parse_mix(defmix);
+  while ((opt = getopt(argc, argv, "+n:m:r:ls:bc:G:L:t")) != -1) {
+    switch (opt) {
+    case 'n': lines = atol(optarg); break;
+    case 'm':
+      if (parse_mix(optarg) != 0) {
+        fprintf(stderr, "Wrong mix: %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'r': rate = atof(optarg); break;
+    case 'l': logformat = 1; break;
+    case 's': rnd_state = strtoul(optarg, NULL, 10) | 1; break;
+    case 'b': binary = 1; break;
+    case 'c': corrupt = atol(optarg); break;
+    case 'G': gateways = atoi(optarg); break;
+    case 'L': loss = atof(optarg); break;
+    case 't': cmd = &argv[optind]; break;
+    default:
+      fprintf(stderr, "Usage: %s [-n lines] [-m mix] [-r rate] [-l] [-s seed] [-b] [-c n] [-G n] [-L percent] [-t command [args]]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    if (cmd != NULL) {
+      break;
+    }
+  }
+
+  if (gateways < 1 || gateways > MAX_GATEWAYS || (gateways > 1 && cmd == NULL)) {
+    fprintf(stderr, "1 to %d gateways, more than 1 only with -t\n", MAX_GATEWAYS);
+    exit(EXIT_FAILURE);
+  }
+  master[0] = -1;
+  if (cmd != NULL) {
+    for (g = 0; g < gateways; g++) {
+      if (*cmd == NULL || openpty(&master[g], &slave, ptyname[g], NULL, NULL) != 0) {
+        fprintf(stderr, "Can't create pty\n");
+        exit(EXIT_FAILURE);
+      }
+      /* raw already, so nothing is echoed before the reader configures it */
+      tcgetattr(slave, &tio);
+      cfmakeraw(&tio);
+      tcsetattr(slave, TCSANOW, &tio);
+      close(slave);   // the pty stays until the master is closed
+    }
+    if ((child = fork()) == 0) {
+      char **args;
+      int n = 0;
+
+      while (cmd[n] != NULL) n++;
+      args = calloc(n + 2 * gateways, sizeof(char *));
+      memcpy(args, cmd, n * sizeof(char *));
+      args[n++] = ptyname[0];
+      for (g = 1; g < gateways; g++) {
+        args[n++] = "-p";
+        args[n++] = ptyname[g];
+      }
+      for (g = 0; g < gateways; g++) {
+        close(master[g]);
+      }
+      execvp(args[0], args);
+      perror("execvp");
+      _exit(127);
+    }
+    usleep(300000);   // give the reader time to open the pty
+  }
+
+  /* virtual time for the log format: start of today */
+  logtime = time(NULL);
+  localtime_r(&logtime, &tm);
+  tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+  logtime = mktime(&tm);
+
+  t0 = now_ns();
+  for (i = 0; i < lines; i++) {
+    len = next_line(line, sizeof(line));
+    if (logformat) {
+      time_t t = logtime + (time_t)(rate > 0 ? i / rate : i);
+
+      localtime_r(&t, &tm);
+      strftime(buf, sizeof(buf), "%d-%m-%y,%H:%M:%S ", &tm);
+      strcat(buf, line);
+      len = strlen(buf);
+    } else if (binary) {
+      len = line_to_frame(line, (unsigned char *)buf);
+    } else {
+      memcpy(buf, line, len + 1);
+    }
+    if (corrupt > 0 && i % corrupt == corrupt - 1) {
+      buf[rnd() % len] ^= 1 << (rnd() % 8);
+    }
+    if (master[0] >= 0) {
+      if (rate > 0) {
+        due = t0 + (long)(i * 1e9 / rate);
+        while (now_ns() < due) {
+          usleep(50);
+        }
+      }
+      for (g = 0; g < gateways; g++) {
+        if (loss > 0 && xorshift(&loss_state) % 1000000 < loss * 10000) {
+          continue;   // this gateway did not receive it
+        }
+        if (write_all(master[g], buf, len) != 0) {
+          break;
+        }
+      }
+      if (g < gateways) {
+        break;
+      }
+    } else {
+      fwrite(buf, 1, len, out);
+    }
+  }
+
+  if (master[0] >= 0) {
+    for (g = 0; g < gateways; g++) {
+      tcdrain(master[g]);
+    }
+    usleep(200000);   // let the reader take the last lines before the hangup
+    for (g = 0; g < gateways; g++) {
+      close(master[g]);
+    }
+    waitpid(child, &status, 0);
+    return(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+  }
+  return(0);
+}
@@ -61,6 +61,35 @@
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "domoticz.h"
+#include "logfile.h"
+#include "html.h"
+#include "checkpoint.h"
+#include "serial.h"
+#include "timing.h"
+#include "metrics.h"
+#include "rra.h"
+#include "spsc.h"
+#include "sink.h"
+#include "udp.h"
+#include "mqtt.h"
+#include "parse.h"
+#include "tsdb.h"
+#include "query.h"
+#include "rollup.h"
+#include "snapshot.h"
+#include "sse.h"
+#include "config.h"
+#include "dedup.h"
+
+#ifdef HAVE_LIBRRD
+#include <rrd.h>
+#endif
 
 
 /*#### DEFINITIONS ##########################################################*/
@@ -68,26 +97,72 @@
 /* Turn debugging on or off */
 #define DEBUG 0
 
-/* Port where JeeNode is connected */
+/* Port where JeeNode is connected (can be overruled with option -p, with
+*  several -p or "port" lines in the config file more JeeNodes are read)
+*/
 #define PORT "/dev/ttyUSB0"
+#define BAUD 57600
+/* Max. wait (ms) for a line, after which buffered logs are flushed if due */
+#define READ_TIMEOUT 1000
 /*#define PORT "/dev/ttyUSB1" */
 /*#define PORT "/dev/jeenode1" */
+/* With more CentralNodes in reach of the same JeeNodes (more ports), the
+*  readings of a meter with the same values from another port less than
+*  DEDUP_WINDOW (s) apart are counted once, 0 = off
+*/
+#define DEDUP_WINDOW 2
 
 /* Location of logfiles */
 #define ALL_LOG "/opt/jnread/log/jnread_jos.log"
 #define ACTUAL_LOG "/opt/jnread/log/jnread_actual.log"
 #define MIDNIGHT_LOG "/opt/jnread/log/jnread_midnight.log"
 
-/* Location to RRD solar database */
+/* Checkpointing of ACTUAL_LOG: when values changed, write at most once every
+*  CHECKPOINT_INTERVAL (s) or after CHECKPOINT_CHANGES changed lines.
+*  The rotation counts are absolute values sent by the SensorNode, so after a
+*  restart the next message corrects them; only the start counts set at
+*  midnight must survive, those are checkpointed immediately.
+*/
+#define CHECKPOINT_INTERVAL 300
+#define CHECKPOINT_CHANGES 500
+
+/* Buffering of ALL_LOG: flush after LOG_FLUSH_BYTES or LOG_FLUSH_INTERVAL (s) */
+#define LOG_FLUSH_BYTES 4096
+#define LOG_FLUSH_INTERVAL 10
+/* Rotation of ALL_LOG: on size (bytes, 0=never) and/or at the change of date.
+*  On size LOG_KEEP files are kept (.1 is the newest), the oldest is removed.
+*  Without rotation here, an external logrotate can send SIGHUP to reopen.
+*/
+#define LOG_MAX_SIZE 0
+#define LOG_KEEP 5
+#define LOG_ROTATE_DAILY 0
+
+/* Location to RRD solar database, updated with librrd when built with
+*  HAVE_LIBRRD (make HAVE_LIBRRD=1), otherwise by running rrdtool
+*/
 #define RRD_DB "/opt/jnread/rrd/solar_power.rrd"
+/* Directory for the round robin archives of all series (<name>.rra) */
+#define RRA_DIR "/opt/jnread/rrd"
+/* Directory for the history of all series (<name>.tsd & <name>.tsi), see
+*  "jnread query"
+*/
+#define HISTORY_DIR "/opt/jnread/history"
 
 /* Location to write the html output */
 #define ACTUALHTML "/opt/jnread/www/index.html"
 /* Temporary output file for html creation */
 #define TMPHTML "/opt/jnread/www/tmphtml.new"
+/* Location to write the JSON snapshot of the actual values and its
+*  temporary file (also served as /current.json by the stats endpoint)
+*/
+#define ACTUALJSON "/opt/jnread/www/current.json"
+#define TMPJSON "/opt/jnread/www/tmpjson.new"
 
 /* C factor for electricity meter (no. of rotations/kWh) */
 #define CFACTOR 600
+/* C factor for gas and water meter (L per rotation of the LS digit) */
+#define G_CFACTOR 10
+#define W_CFACTOR 1
 
 /* Settings for updating counters on the Domoticz server */
 #define DOMOTICZ_SERVER "ha01:8080"
@@ -100,13 +175,57 @@
 #define O_IDX "93"
 #define P_IDX "95"
 #define A_IDX "102"
+/* Min. interval (s) between two updates of the same idx, per sensor type.
+*  Only the newest value of an idx is sent (counters are absolute values,
+*  so skipping superseded ones keeps them exact).
+*/
+#define E_INTERVAL 10
+#define S_INTERVAL 10
+#define G_INTERVAL 10
+#define W_INTERVAL 10
+#define A_INTERVAL 10
+#define T_INTERVAL 0     /* temperatures and pressure */
+
+/* Export of all series as line protocol over UDP to "host:port" (e.g. Telegraf),
+*  "" = off (can be overruled with option --udp)
+*/
+#define UDP_EXPORT ""
+/* MQTT broker "host[:port]" to publish all series to as <MQTT_TOPIC>/<series>
+*  (retained), "" = off (can be overruled with option --mqtt); both can be set
+*  in the config file (keys mqtt and mqtt_topic)
+*/
+#define MQTT_BROKER ""
+#define MQTT_TOPIC "jnread"
+/* Live stream of the readings (server-sent events) for browsers on
+*  http://<host>:LIVE_PORT/ (the page) and /events (the stream), 0 = off
+*  (can be overruled with option --live)
+*/
+#define LIVE_ADDR "0.0.0.0"
+#define LIVE_PORT 8098
+
+/* Stats endpoint: http://STATS_ADDR:STATS_PORT/metrics (Prometheus), / (text)
+*  and /current.json (the actual values, see snapshot.h), STATS_PORT 0 = off
+*/
+#define STATS_ADDR "127.0.0.1"
+#define STATS_PORT 8099
+
+/* Config file with the settings of a site (see jnread.conf.example): these
+*  overrule the settings above and the options overrule the file (can be
+*  overruled with option -c). Without the file the settings above are used,
+*  with a meter of every type.
+*/
+#define CONFIG_FILE "/opt/jnread/jnread.conf"
+/* Max. no. of meters and of their series */
+#define MAX_METERS 32
+#define SR_MAX (2*MAX_METERS)
 
 
 /*#### FUNCTIONS ############################################################*/
 
 /* FUNCTION to fill the array from ACTUAL_LOG file */
 /* NEW Read ACTUAL_LOG to initialise variables
-* Internally the array "long actual[9]" above is used, values are:
+* Internally the array "long actual[]" is used, the first values are those
+* of the main meters:
 *  0=rotationcount electricity
 *  1=rotation start count electricity
 *  2=Electricity usage today (in Wh !! (=*1000))
@@ -118,115 +237,397 @@
 *  8=Water usage today (in L)
 *  9=Solar runtime today (in minutes)
 * 10=Solar electricity production today (in Wh !! (=*1000))
+* followed by those of the other meters in the order of the config file,
+* e, g & w: rotationcount, rotation start count, usage today,
+* s: runtime today, production today.
 */
 /* global vars used by this function */
-long actual[11];
+long actual[CP_MAX_VALUES];
+int n_actual=11;		// no. of values in use
+int actual_found=0;		// no. of values in the checkpoint
 
 int read_actual(char filename[])
 {
-  FILE *rfp;
-  int i;
+  int rc;
 
-  if ((rfp = fopen(filename, "r")) == NULL) {
-    return(1);
+  rc = checkpoint_read(filename, actual, n_actual, &actual_found);
+  if (rc == CP_PREV) {
+    fprintf(stderr, "%s is corrupt, using %s.prev\n", filename, filename);
+    rc = CP_OK;
   }
-  for (i=0; i<11; i++) {
-    fscanf(rfp, "%ld", &actual[i]);
+  return(rc);
+}
+
+
+/* FUNCTION to write the array to ACTUAL_LOG file when a checkpoint is due,
+*  the file is written by the checkpoint thread (only the newest matters)
+*/
+/* global vars used by this function */
+long saved_actual[CP_MAX_VALUES];
+time_t last_checkpoint=0;
+int checkpoint_changes=0;
+
+struct checkpoint_item {
+  const char *filename;
+  int n;
+  long values[CP_MAX_VALUES];
+};
+
+void checkpoint_consume(void *item)
+{
+  struct checkpoint_item *ci = item;
+  TIMING_START(t_checkpoint);
+
+  if (checkpoint_write(ci->filename, ci->values, ci->n) != 0) {
+    fprintf(stderr, "Can't write %s\n", ci->filename);
   }
-  fclose(rfp);
+  TIMING_STOP(t_checkpoint, ST_CHECKPOINT);
 }
 
+struct sink checkpoint_sink = {
+  .name = "checkpoint",
+  .policy = SINK_LATEST,
+  .item_size = sizeof(struct checkpoint_item),
+  .slots = 4,
+  .consume = checkpoint_consume
+};
 
-/* FUNCTION to write string to ACTUAL_LOG file */
-int write_actual(char filename[])
+void write_actual(char filename[], time_t now, int force)
 {
-  FILE *wfp;
-  int i;
+  struct checkpoint_item ci;
 
-  if ((wfp = fopen(filename, "w")) == NULL) {
-    return(1);
+  if (memcmp(actual, saved_actual, n_actual * sizeof(long)) == 0) {
+    return;
   }
-  for (i=0; i<11; i++) {
-    fprintf(wfp, "%ld ", actual[i]);
+  checkpoint_changes++;
+  if (!force && now - last_checkpoint < CHECKPOINT_INTERVAL &&
+      checkpoint_changes < CHECKPOINT_CHANGES) {
+    return;
   }
-  fprintf(wfp, "\n");
-  fclose(wfp);
+  ci.filename = filename;
+  ci.n = n_actual;
+  memcpy(ci.values, actual, n_actual * sizeof(long));
+  sink_put(&checkpoint_sink, &ci);
+  memcpy(saved_actual, actual, n_actual * sizeof(long));
+  last_checkpoint = now;
+  checkpoint_changes = 0;
 }
 
 
-/* FUNCTION to append string to file */
-int append_to_file(char filename[], char str2log[])
+/* FUNCTIONs for the meters: every message goes to the meter of its type
+*  (and port), which keeps its own counters. The first meter of a type
+*  without a name is the main meter: it has the series with the names of
+*  old, its values are on the html page and in the first 11 values of
+*  actual[]. The series of the other meters get "_<name>" appended.
+*/
+/* global vars used by these functions */
+struct meter {
+  char type;			// type of its messages
+  char name[24];		// "" = the main meter of its type
+  int port;			// no. of its port (0 = the first), -1 = any port
+  double cfactor;		// e: no. of rotations/kWh, g & w: L per rotation
+  char idx[8];			// Domoticz idx, "" = not sent
+  char idx_counter[8];		// e: Domoticz idx of the counter
+  int interval;			// min. interval (s) between two updates of an idx
+  int sr[2];			// its series, -1 = none
+  int slot;			// its first value in actual[], -1 = none
+  int seed;			// take the start count from the first message
+  int value;			// power (W), temperature or pressure (*10)
+  unsigned int rotations;	// no. rotations since start of JeeNode
+  unsigned int start_rotations;	// no. rotations at midnight
+  int today;			// usage today in Wh or L (e: < 0 when more went back), s: production in Wh
+  unsigned int runtime;		// s: solar production runtime today
+};
+struct meter meters[MAX_METERS];
+int n_meters=0;
+struct meter *main_meters[26];	// per type, a meter of zeros when there is none
+struct meter no_meter;
+signed char meter_of[SERIAL_MAX_PORTS][26];	// per port & type, -1 = none
+
+/* the series of a meter per type (in this order) */
+const struct meter_series {
+  char type;
+  const char *name;
+  long scale;			// the history is in 1/scale units
+  int kind;
+} meter_series[] = {
+  { 'e', "electricity_power", 1, ROLLUP_GAUGE },	// W
+  { 'e', "electricity_energy", 1000, ROLLUP_COUNTER },	// Wh, counter (back on solar power)
+  { 's', "solar_power", 1, ROLLUP_GAUGE },		// W
+  { 's', "solar_energy", 1, ROLLUP_RESET },		// Wh today, counter (from 0 every day)
+  { 'a', "appliance_power", 1, ROLLUP_GAUGE },		// W
+  { 'g', "gas", 1, ROLLUP_COUNTER },			// L, counter
+  { 'w', "water", 1, ROLLUP_COUNTER },			// L, counter
+  { 'i', "inside_temperature", 10, ROLLUP_GAUGE },	// degrees C
+  { 'o', "outside_temperature", 10, ROLLUP_GAUGE },	// degrees C
+  { 'p', "outside_pressure", 10, ROLLUP_GAUGE },	// hPa
+  { '\0', NULL, 0, 0 }
+};
+char series_name[SR_MAX][64];
+long history_scale[SR_MAX];
+int series_kind[SR_MAX];
+int n_series=0;
+
+/* a new meter with the defaults of its type, NULL when there is no room or
+*  the type has no meters
+*/
+struct meter *add_meter(char type)
 {
-  FILE *afp;
+  struct meter *m;
+  int i;
 
-  if ((afp = fopen(filename, "a")) == NULL) {
-    return(1);
+  for (i=0; meter_series[i].type != '\0' && meter_series[i].type != type; i++);
+  if (meter_series[i].type == '\0' || n_meters == MAX_METERS) {
+    return(NULL);
   }
-  fputs(str2log, afp);
-  fclose(afp);
+  m = &meters[n_meters++];
+  memset(m, 0, sizeof(*m));
+  m->type = type;
+  m->port = -1;
+  m->slot = -1;
+  switch (type) {
+  case 'a':
+    strcpy(m->idx, A_IDX);
+    m->interval = A_INTERVAL;
+    break;
+  case 'e':
+    m->cfactor = CFACTOR;
+    strcpy(m->idx, E_IDX_actual);
+    strcpy(m->idx_counter, E_IDX_counter);
+    m->interval = E_INTERVAL;
+    break;
+  case 'g':
+    m->cfactor = G_CFACTOR;
+    strcpy(m->idx, G_IDX);
+    m->interval = G_INTERVAL;
+    break;
+  case 'w':
+    m->cfactor = W_CFACTOR;
+    strcpy(m->idx, W_IDX);
+    m->interval = W_INTERVAL;
+    break;
+  case 's':
+    strcpy(m->idx, S_IDX);
+    m->interval = S_INTERVAL;
+    break;
+  case 'i':
+    strcpy(m->idx, I_IDX);
+    m->interval = T_INTERVAL;
+    break;
+  case 'o':
+    strcpy(m->idx, O_IDX);
+    m->interval = T_INTERVAL;
+    break;
+  case 'p':
+    strcpy(m->idx, P_IDX);
+    m->interval = T_INTERVAL;
+    break;
+  }
+  return(m);
 }
 
+/* the meters (when the config file has none), their series, their values in
+*  actual[] and the meter of every port & type; returns 0 when all is right
+*/
+int setup_meters()
+{
+  struct meter *m;
+  const char *types = "esagwiop";
+  int i, j, k, p, slot=11;
 
-/* FUNCTIONs to set all the needed measurement vars from the array */
-/* global vars used by these functions */
-unsigned int e_today;		      // electricity usage today in Wh 
-unsigned int e_start_rotations;       // no. rotations at midnight 
-unsigned int e_rotations;	      // no. rotations since start of JeeNode 
-unsigned int g_today;		      // gas usage today in L 
-unsigned int g_start_rotations;	      // no. LS digit rotations at midnight 
-unsigned int g_rotations;	      // no. LS digit rotations since start of JeeNode
-unsigned int w_today;		      // water usage today in L 
-unsigned int w_start_rotations;	      // no. rotations at midnight 
-unsigned int w_rotations;	      // no. rotations since start of JeeNode
-unsigned int s_today;		      // solar electricity production today in Wh 
-unsigned int s_runtime;               // solar production runtime today
+  if (n_meters == 0) {
+    for (i=0; types[i] != '\0'; i++) {
+      add_meter(types[i]);
+    }
+  }
+  memset(meter_of, -1, sizeof(meter_of));
+  for (i=0; i<26; i++) {
+    main_meters[i] = &no_meter;
+  }
+  for (i=0; i<n_meters; i++) {
+    m = &meters[i];
+    if (m->name[0] == '\0') {
+      if (main_meters[m->type - 'a'] != &no_meter) {
+        fprintf(stderr, "The second meter of type %c needs a name\n", m->type);
+        return(1);
+      }
+      main_meters[m->type - 'a'] = m;
+    }
+    for (j=0; j<i; j++) {
+      if (meters[j].type == m->type && strcmp(meters[j].name, m->name) == 0 && m->name[0] != '\0') {
+        fprintf(stderr, "Two meters of type %c named %s\n", m->type, m->name);
+        return(1);
+      }
+    }
+    /* its series */
+    m->sr[0] = m->sr[1] = -1;
+    for (j=0, k=0; meter_series[j].type != '\0'; j++) {
+      if (meter_series[j].type != m->type) {
+        continue;
+      }
+      if (n_series == SR_MAX) {
+        fprintf(stderr, "Too many series, max. %d\n", SR_MAX);
+        return(1);
+      }
+      snprintf(series_name[n_series], sizeof(series_name[n_series]), "%s%s%s",
+      meter_series[j].name, m->name[0] != '\0' ? "_" : "", m->name);
+      history_scale[n_series] = meter_series[j].scale;
+      series_kind[n_series] = meter_series[j].kind;
+      m->sr[k++] = n_series++;
+    }
+  }
+  /* the values in actual[]: the main meters at their old place, the others
+  *  after those
+  */
+  for (i=0; i<n_meters; i++) {
+    m = &meters[i];
+    if (m->name[0] == '\0') {
+      switch (m->type) {
+      case 'e': m->slot = 0; break;
+      case 'g': m->slot = 3; break;
+      case 'w': m->slot = 6; break;
+      case 's': m->slot = 9; break;
+      }
+    } else if (strchr("egw", m->type) != NULL) {
+      m->slot = slot;
+      slot += 3;
+    } else if (m->type == 's') {
+      m->slot = slot;
+      slot += 2;
+    }
+  }
+  if (slot > CP_MAX_VALUES) {
+    fprintf(stderr, "Too many counters, max. %d values\n", CP_MAX_VALUES);
+    return(1);
+  }
+  n_actual = slot;
+  /* the meter of every port & type: one for that port first, then one for
+  *  any port
+  */
+  for (k=0; k<2; k++) {
+    for (i=0; i<n_meters; i++) {
+      for (p=0; p<SERIAL_MAX_PORTS; p++) {
+        if ((k == 0 ? meters[i].port == p : meters[i].port < 0) && meter_of[p][meters[i].type - 'a'] < 0) {
+          meter_of[p][meters[i].type - 'a'] = i;
+        }
+      }
+    }
+  }
+  return(0);
+}
 
+/* FUNCTIONs to set the counters of the meters from the array and back */
 void set_measurement_vars()
 {
-  e_rotations        = actual[0];
-  e_start_rotations  = actual[1];
-  e_today            = actual[2];
-  g_rotations        = actual[3];
-  g_start_rotations  = actual[4];
-  g_today            = actual[5];
-  w_rotations        = actual[6];
-  w_start_rotations  = actual[7];
-  w_today            = actual[8];
-  s_runtime          = actual[9];
-  s_today            = actual[10];
+  struct meter *m;
+  int i;
+
+  for (i=0; i<n_meters; i++) {
+    m = &meters[i];
+    if (m->slot < 0) {
+      continue;
+    }
+    if (m->type == 's') {
+      m->runtime = actual[m->slot];
+      m->today = actual[m->slot+1];
+    } else {
+      m->rotations = actual[m->slot];
+      m->start_rotations = actual[m->slot+1];
+      m->today = actual[m->slot+2];
+    }
+    /* a meter that is new in the checkpoint takes its start count from its
+    *  first message
+    */
+    m->seed = (m->slot >= actual_found);
+  }
 }
 
 
 void set_actual_array()
 {
-  actual[0] = e_rotations;
-  actual[1] = e_start_rotations;
-  actual[2] = e_today;
-  actual[3] = g_rotations;
-  actual[4] = g_start_rotations;
-  actual[5] = g_today;
-  actual[6] = w_rotations;
-  actual[7] = w_start_rotations;
-  actual[8] = w_today;
-  actual[9] = s_runtime;
-  actual[10] = s_today;
+  struct meter *m;
+  int i;
+
+  for (i=0; i<n_meters; i++) {
+    m = &meters[i];
+    if (m->slot < 0) {
+      continue;
+    }
+    if (m->type == 's') {
+      actual[m->slot] = m->runtime;
+      actual[m->slot+1] = m->today;
+    } else {
+      actual[m->slot] = m->rotations;
+      actual[m->slot+1] = m->start_rotations;
+      actual[m->slot+2] = m->today;
+    }
+  }
+}
+
+/* FUNCTION to update a meter with its message */
+void meter_update(struct meter *m, const struct message *msg)
+{
+  m->value = msg->value[0];
+  switch (m->type) {
+  case 'e':
+  case 'g':
+  case 'w':
+    m->rotations = msg->value[1];
+    if (m->seed) {
+      m->start_rotations = m->rotations;
+      m->seed = 0;
+    }
+    if (m->type == 'e') {
+      m->today = ((int)(m->rotations - m->start_rotations) * 1000.0) / m->cfactor;
+    } else {
+      m->today = (m->rotations - m->start_rotations) * m->cfactor;
+    }
+    break;
+  case 's':
+    m->today = msg->value[1];
+    m->runtime = msg->value[2];
+    break;
+  }
+  #if DEBUG
+  printf("type %c %s, value %d, rotations %u, today %d, runtime %u\n", m->type, m->name,
+  m->value, m->rotations, m->today, m->runtime);
+  #endif
+}
+
+/* FUNCTION to find the meter of a message of a port, -1 = none */
+int find_meter(int port, char type)
+{
+  if (port < 0 || port >= SERIAL_MAX_PORTS || type < 'a' || type > 'z') {
+    return(-1);
+  }
+  return(meter_of[port][type - 'a']);
+}
+
+/* FUNCTION to reset the daily counters of a meter (a new day) */
+void meter_midnight(struct meter *m)
+{
+  m->today = 0;
+  m->start_rotations = m->rotations;
+  m->runtime = 0;
 }
 
 
-/* FUNCTION set_time_vars - set time variables */
+/* FUNCTION set_time_vars - set time variables (to the time now or, when
+*  replaying, to the time recorded in the log) */
 /* global vars used by this function */
 int hours, minutes;
+int day=-1;			// local date (yyyymmdd), -1 = not known
 //char wday[3];
 //char today[10];
 char logdatetime[17],prevlogdatetime[17];
 char htmldatetime[32];
+time_t date_time;
 
-void set_time_vars() {
+void set_time_vars(time_t t) {
   char date_time_str[200];
-  time_t date_time;
   struct tm *l_date_time;
 
-  date_time = time(NULL);
+  date_time = t;
   l_date_time = localtime(&date_time);
   if (l_date_time == NULL) {
     perror("Can't get localtime");
@@ -237,6 +638,7 @@ void set_time_vars() {
   hours=atoi(date_time_str);
   strftime(date_time_str, sizeof(date_time_str), "%M", l_date_time);
   minutes=atoi(date_time_str);
+  day = (l_date_time->tm_year+1900)*10000 + (l_date_time->tm_mon+1)*100 + l_date_time->tm_mday;
   //strftime(wday, sizeof(date_time_str), "%a", l_date_time);
   //strftime(today, sizeof(date_time_str), "%d-%m-%Y", l_date_time);
   /*  Time/date var for logging purposes */
@@ -247,269 +649,1440 @@ void set_time_vars() {
 }
 
 
-/* FUNCTIONs to open USB port and read line from USB port */
+/* FUNCTIONs to open the USB ports and read a line from any of them */
 /* global vars used by this functions */
-FILE *usb_fp;
+char ports[SERIAL_MAX_PORTS][128] = { PORT };
+int n_ports=1;
+int baud=BAUD;
+int dedup_window=DEDUP_WINDOW;	// window (s) for the same reading from another port
+struct serial usb[SERIAL_MAX_PORTS];
 
-int open_usb(char usbdevice[])
+int open_usb()
 {
-  char setting_string[255];
+  int i, rc=0;
 
-  sprintf(setting_string, "stty -F %s -hupcl -clocal ignbrk -icrnl -ixon"
-  " -opost -onlcr -isig -icanon time 50 -iexten -echo -echoe -echok"
-  " -echoctl -echoke 57600 -crtscts", usbdevice);
-  system(setting_string);
-  if ((usb_fp = fopen(usbdevice, "r+")) == NULL) {
-    return(1);
+  for (i=0; i<n_ports; i++) {
+    switch (serial_open(&usb[i], ports[i], baud)) {
+    case 0:
+      break;
+    case SERIAL_BAD_BAUD:
+      fprintf(stderr, "Baud rate %d is not supported\n", baud);
+      return(SERIAL_BAD_BAUD);
+    default:
+      fprintf(stderr, "Can't open %s yet, will keep trying\n", ports[i]);
+      rc = 1;
+    }
   }
-  //fclose(fp);
+  return(rc);
 }
 
-int get_usb_line(char *line, int max)
+int get_usb_line(char *line, int max, int *port)
 {
-  if (fgets(line, max, usb_fp) == NULL)
-  return 0;
-  else
-  return strlen(line);
+  return(serial_poll(usb, n_ports, line, max, port, READ_TIMEOUT));
+}
+
+
+/* FUNCTIONs to handle signals: SIGUSR1 = report the statistics,
+*  SIGHUP = reopen the logfiles, SIGTERM/SIGINT = flush & stop
+*/
+/* global vars used by these functions */
+volatile sig_atomic_t report_stats=0;
+volatile sig_atomic_t reopen_logs=0;
+volatile sig_atomic_t stop_requested=0;
+
+void signal_handler(int sig)
+{
+  if (sig == SIGUSR1) report_stats=1;
+  if (sig == SIGHUP) reopen_logs=1;
+  if (sig == SIGTERM || sig == SIGINT) stop_requested=1;
 }
 
 /* FUNCTION to create the html pages with relevant data */
 /* global vars used by this functions */
-char ahtml[]=ACTUALHTML;	// File with the actual html page
-char thtml[]=TMPHTML; 		// File with the temporary html page
-char htmlstring[255];		// The string to be written to the htmlfile
-int watt=0;
-int swatt=0;
-int itemperature=0;
-int otemperature=0;
-int opressure=0;
-
-void create_html_page() {
-  #if DEBUG
-  printf("watt %d, e_today %d, g_today %d,  w_today %d, itemp %d, otemp %d opres %d, swatt %d, s_today %d, s_runtime %d\n",
-  watt,    e_today,    g_today,i    w_today, itemperature,otemperature,opressure,swatt,s_today,    s_runtime);
-  #endif
-  /* Create HTML page */
-  sprintf(htmlstring, "<HTML><HEAD><TITLE>JJ Home data</TITLE><META HTTP-EQUIV=\"refresh\" CONTENT=\"30\"><LINK REL=\"shortcut icon\" HREF=\"favicon.ico\"></HEAD>");
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<BODY BGCOLOR=#000066 TEXT=#E8EEFD LINK=#FFFFFF VLINK=#C6FDF4 ALINK=#0BBFFF BACKGROUND=$BGIMG>");
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<FONT FACE=\"Arial\" SIZE=3>");
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TABLE WIDTH=500 BORDER=1 CELLPADDING=2 CELLSPACING=0 BGCOLOR=#1A689D BORDERCOLOR=#0DD3EA>");
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD COLSPAN=3><FONT SIZE=4 COLOR=#00FF00><CENTER>%s</CENTER></FONT></TD></TR>", htmldatetime);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD ROWSPAN=2><CENTER><IMG BORDER=0 SRC=\"pictures/electricity-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Actual power usage (W)</TD><TD><FONT SIZE=4>%d W</FONT></TD>", watt);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD>Electricity usage today (kWh)</TD><TD><FONT SIZE=4>%3.3f kWh</FONT></TD></TR>", (float)e_today/1000);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD ROWSPAN=3><CENTER><IMG BORDER=0 SRC=\"pictures/solar-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Actual solar power (W)</TD><TD><FONT SIZE=4>%d W</FONT></TD>", swatt);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD>Solar power today (kWh)</TD><TD><FONT SIZE=4>%3.3f kWh</FONT></TD></TR>", (float)s_today/1000);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD>Running time today (hh:mm)</TD><TD><FONT SIZE=4>%02u:%02u</FONT></TD></TR>", s_runtime/60, s_runtime%60);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/gas-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Gas usage today (m&sup3;)</TD><TD><FONT SIZE=4>%6.3f m&sup3;</FONT></TD></TR>", (float)g_today/1000);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/water-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Water usage today (L)</TD><TD><FONT SIZE=4>%d L</FONT></TD></TR>", w_today);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/temp_inside-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Inside temperature</TD><TD><FONT SIZE=4>%2.1f &deg;C</FONT></TD></TR>", (float)itemperature/10);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/temp_outside-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Outside temperature</TD><TD><FONT SIZE=4>%2.1f &deg;C</FONT></TD></TR>", (float)otemperature/10);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD><CENTER><IMG BORDER=0 SRC=\"pictures/pressure-button.png\" WIDTH=90 HEIGHT=50></CENTER></TD><TD>Barometric pressure</TD><TD><FONT SIZE=4>%4.1f hPa</FONT></TD></TR>", (float)opressure/10);
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_day.png\"></TD>");
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_week.png\"></TD>");
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_month.png\"></TD>");
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "<TR><TD COLSPAN=3><IMG SRC=\"graph/solar_power_last_year.png\"></TD>");
-  append_to_file(thtml, htmlstring);
-  sprintf(htmlstring, "</FONT></TABLE></BODY></HTML>");
-  append_to_file(thtml, htmlstring);
-  rename(thtml, ahtml);
+char ahtml[256]=ACTUALHTML;	// File with the actual html page
+char thtml[256]=TMPHTML; 	// File with the temporary html page
+char ajson[256]=ACTUALJSON;	// File with the JSON snapshot
+char tjson[256]=TMPJSON;	// File with the temporary JSON snapshot
+
+void create_html_page(struct html_values *hv) {
+  struct meter *e=main_meters['e'-'a'], *s=main_meters['s'-'a'];
+  struct meter *g=main_meters['g'-'a'], *w=main_meters['w'-'a'];
+
+  /* Values for the HTML page of the main meters, written by the html
+  *  output (only rewritten when a value or the minute changed)
+  */
+  memset(hv, 0, sizeof(*hv));
+  strcpy(hv->datetime, htmldatetime);
+  hv->minute = minutes;
+  hv->watt = e->value;
+  hv->e_today = e->today;
+  hv->swatt = s->value;
+  hv->s_today = s->today;
+  hv->s_runtime = s->runtime;
+  hv->g_today = g->today;
+  hv->w_today = w->today;
+  hv->itemperature = main_meters['i'-'a']->value;
+  hv->otemperature = main_meters['o'-'a']->value;
+  hv->opressure = main_meters['p'-'a']->value;
+}
+
+
+/* FUNCTION to set the file paths, all in outdir when given (replay) */
+/* global vars used by this function */
+char log_file[256]=ALL_LOG;	// The logfile
+char mlog[256]=MIDNIGHT_LOG;	// The midnight logfile
+char alog[256]=ACTUAL_LOG;	// File with the last actual values
+char rra_dir[256]=RRA_DIR;	// Directory with the round robin archives
+char history_dir[256]=HISTORY_DIR;	// Directory with the time-series stores
+
+int put_in_dir(char *path, size_t size, const char *outdir)
+{
+  char name[256];
+  const char *p = strrchr(path, '/');
+
+  snprintf(name, sizeof(name), "%s", p != NULL ? p+1 : path);
+  return(snprintf(path, size, "%s/%s", outdir, name) >= (int)size);
+}
+
+void set_paths(char *outdir)
+{
+  if (outdir == NULL) {
+    return;
+  }
+  put_in_dir(log_file, sizeof(log_file), outdir);
+  put_in_dir(mlog, sizeof(mlog), outdir);
+  put_in_dir(alog, sizeof(alog), outdir);
+  put_in_dir(ahtml, sizeof(ahtml), outdir);
+  put_in_dir(thtml, sizeof(thtml), outdir);
+  put_in_dir(ajson, sizeof(ajson), outdir);
+  put_in_dir(tjson, sizeof(tjson), outdir);
+  snprintf(rra_dir, sizeof(rra_dir), "%s", outdir);
+  snprintf(history_dir, sizeof(history_dir), "%s", outdir);
+}
+
+
+/* FUNCTION to update the RRD solar database (for the existing graphs) */
+/* global vars used by this function */
+char rrd_db[256]=RRD_DB; 	// RRD database file
+char systemstr[320];		// line to be executed by OS
+int stub_sinks=0;		// do everything for Domoticz & RRD except sending
+int publish=1;			// send to Domoticz & RRD (not when replaying)
+char udp_target[128]=UDP_EXPORT;	// line protocol export, "" = off
+char mqtt_broker[128]=MQTT_BROKER;	// MQTT broker, "" = off
+char mqtt_topic[128]=MQTT_TOPIC;	// MQTT topic of the series
+char domoticz_server[128]=DOMOTICZ_SERVER;	// Domoticz server
+int live_port=LIVE_PORT;	// port of the live stream, 0 = off
+int stats_port=STATS_PORT;	// port of the stats endpoint, 0 = off
+
+void update_rrd_db(int value)
+{
+#ifdef HAVE_LIBRRD
+  char update[32];
+  const char *argv[1] = { update };
+
+  snprintf(update, sizeof(update), "N:%d", value);
+  if (!stub_sinks && rrd_update_r(rrd_db, NULL, 1, argv) != 0) {
+    fprintf(stderr, "Can't update %s: %s\n", rrd_db, rrd_get_error());
+    rrd_clear_error();
+  }
+#else
+  sprintf(systemstr, "rrdtool update %s N:%d", rrd_db, value);
+  if (!stub_sinks) system(systemstr);
+#endif
+}
+
+
+/* FUNCTIONs to keep the history of all series in round robin archives */
+/* global vars used by these functions */
+struct rra_file series[SR_MAX];
+
+void open_series()
+{
+  char path[sizeof(rra_dir) + sizeof(series_name[0]) + 8];	// "<dir>/<name>.rra"
+  int i;
+
+  for (i=0; i<n_series; i++) {
+    if (snprintf(path, sizeof(path), "%s/%s.rra", rra_dir, series_name[i]) >= (int)sizeof(path)) {
+      fprintf(stderr, "Path too long, no history for %s\n", series_name[i]);
+      series[i].fd = -1;	// not open, as after a failed rra_open()
+      continue;
+    }
+    if (rra_open(&series[i], path, rra_default, RRA_MAX_ARCHIVES) != 0) {
+      fprintf(stderr, "Can't open %s, no history for %s\n", path, series_name[i]);
+    }
+  }
+}
+
+void close_series()
+{
+  int i;
+
+  for (i=0; i<n_series; i++) {
+    rra_close(&series[i]);
+  }
+}
+
+/* FUNCTIONs of the outputs: every message is dispatched to each output that
+*  is used, in its own thread with its own queue, and every output batches
+*  its work in its own way (Domoticz coalesces per idx, UDP and MQTT send
+*  what is in the queue at once, the html page is only written for the
+*  newest values).
+*/
+/* global vars used by these functions */
+struct output {
+  time_t t;			// time of the message
+  char type;			// type of the message, '\0' = not a measurement
+  int meter;			// its meter, -1 = none
+  int item2;
+  long item3;
+  long item4;
+  struct html_values hv;	// values for the html page after the message
+};
+
+/* the series in a message and their values, returns the no. of series */
+int output_series(const struct output *o, int sr[2], double value[2])
+{
+  const struct meter *m;
+
+  if (o->meter < 0) {
+    return(0);
+  }
+  m = &meters[o->meter];
+  sr[0] = m->sr[0];
+  sr[1] = m->sr[1];
+  switch (m->type) {
+  case 'a':
+    value[0] = o->item2;
+    return(1);
+  case 'e':
+    value[0] = o->item2;
+    value[1] = (o->item3*1000.0)/m->cfactor;
+    return(2);
+  case 'g':
+  case 'w':
+    value[0] = o->item3*m->cfactor;
+    return(1);
+  case 'i':
+  case 'o':
+  case 'p':
+    value[0] = o->item2/10.0;
+    return(1);
+  case 's':
+    value[0] = o->item2;
+    value[1] = o->item3;
+    return(2);
+  }
+  return(0);
+}
+
+/* Domoticz: the updates are coalesced and sent by the Domoticz worker */
+int domoticz_open()
+{
+  int i;
+
+  if (!publish) {
+    return(1);
+  }
+  if (domoticz_start(stub_sinks ? "" : domoticz_server) != 0) {
+    fprintf(stderr, "Can't start Domoticz publisher\n");
+    return(1);
+  }
+  for (i=0; i<n_meters; i++) {
+    if ((meters[i].idx[0] != '\0' && domoticz_set_interval(meters[i].idx, meters[i].interval) != 0) ||
+        (meters[i].idx_counter[0] != '\0' &&
+         domoticz_set_interval(meters[i].idx_counter, meters[i].interval) != 0)) {
+      fprintf(stderr, "Too many Domoticz idx, max. %d\n", DZ_SLOTS);
+      domoticz_stop();
+      return(1);
+    }
+  }
+  return(0);
+}
+
+void domoticz_consume(void *item)
+{
+  struct output *o = item;
+  const struct meter *m;
+  TIMING_START(t_domoticz);
+
+  if (o->meter < 0 || meters[o->meter].idx[0] == '\0') {
+    TIMING_STOP(t_domoticz, ST_DOMOTICZ);
+    return;
+  }
+  m = &meters[o->meter];
+  switch (m->type) {
+  case 'a':
+    domoticz_update(m->idx, "%d", o->item2);
+    break;
+  case 'e':
+    domoticz_update(m->idx, "%d", o->item2);
+    // The "(e_rotations*1000)/cfactor" in the line below is needed to be able to set the "Energy counter divider" in Domoticz on 1000 (and not 600)
+    if (m->idx_counter[0] != '\0') {
+      domoticz_update(m->idx_counter, "%d", (int)((o->item3*1000.0)/m->cfactor));
+    }
+    break;
+  case 'g':
+  case 'w':
+    domoticz_update(m->idx, "%d", (int)o->item3);
+    break;
+  case 'i':
+  case 'o':
+    domoticz_update(m->idx, "%2.1f", (float)o->item2/10.0f);
+    break;
+  case 'p':
+    domoticz_update(m->idx, "%4.1f;5", (float)o->item2/10.0f);
+    break;
+  case 's':
+    domoticz_update(m->idx, "%d;%d", o->item2, (int)o->item3);
+    break;
+  }
+  TIMING_STOP(t_domoticz, ST_DOMOTICZ);
+}
+
+struct sink domoticz_output = {
+  .name = "domoticz",
+  .policy = SINK_DROP,
+  .item_size = sizeof(struct output),
+  .slots = 1024,
+  .consume = domoticz_consume,
+  .open = domoticz_open,
+  .close = domoticz_stop
+};
+
+/* RRD: the round robin archives and the RRD solar database */
+void rrd_consume(void *item)
+{
+  struct output *o = item;
+  int sr[2], i, n;
+  double value[2];
+  TIMING_START(t_rrd);
+
+  n = output_series(o, sr, value);
+  for (i=0; i<n; i++) {
+    rra_update(&series[sr[i]], o->t, value[i]);
+  }
+  if (n > 0 && meters[o->meter].type == 's' && meters[o->meter].name[0] == '\0' && publish) {
+    update_rrd_db(o->item2);   // the main solar meter
+  }
+  TIMING_STOP(t_rrd, ST_RRD);
+}
+
+struct sink rrd_output = {
+  .name = "rrd",
+  .policy = SINK_DROP,
+  .item_size = sizeof(struct output),
+  .slots = 1024,
+  .consume = rrd_consume
+};
+
+/* html: the page and the JSON snapshot with the newest values */
+void html_consume(void *item)
+{
+  struct output *o = item;
+  TIMING_START(t_html);
+
+  html_update(thtml, ahtml, &o->hv);
+  snapshot_update(tjson, ajson, &o->hv, o->t);
+  TIMING_STOP(t_html, ST_HTML);
+}
+
+struct sink html_output = {
+  .name = "html",
+  .policy = SINK_LATEST,
+  .item_size = sizeof(struct output),
+  .slots = 4,
+  .consume = html_consume
+};
+
+/* UDP: a line protocol line per message, sent per datagram */
+int udp_output_open()
+{
+  if (udp_target[0] == '\0') {
+    return(1);
+  }
+  if (udp_open(udp_target) != 0) {
+    fprintf(stderr, "Can't export to %s\n", udp_target);
+    return(1);
+  }
+  return(0);
+}
+
+void udp_consume(void *item)
+{
+  struct output *o = item;
+  int sr[2], n;
+  double value[2];
+  TIMING_START(t_udp);
+
+  n = output_series(o, sr, value);
+  if (n == 1) {
+    udp_line("jnread,type=%c %s=%g %ld000000000", o->type,
+    series_name[sr[0]], value[0], (long)o->t);
+  } else if (n == 2) {
+    udp_line("jnread,type=%c %s=%g,%s=%.3f %ld000000000", o->type,
+    series_name[sr[0]], value[0], series_name[sr[1]], value[1], (long)o->t);
+  }
+  TIMING_STOP(t_udp, ST_UDP);
+}
+
+struct sink udp_output = {
+  .name = "udp",
+  .policy = SINK_DROP,
+  .item_size = sizeof(struct output),
+  .slots = 1024,
+  .consume = udp_consume,
+  .open = udp_output_open,
+  .flush = udp_flush,
+  .close = udp_close
+};
+
+/* MQTT: every series as a retained topic, published per batch */
+int mqtt_output_open()
+{
+  return(mqtt_open(mqtt_broker, "jnread"));
+}
+
+void mqtt_consume(void *item)
+{
+  struct output *o = item;
+  char topic[192], payload[32];
+  int sr[2], i, n;
+  double value[2];
+  TIMING_START(t_mqtt);
+
+  n = output_series(o, sr, value);
+  for (i=0; i<n; i++) {
+    snprintf(topic, sizeof(topic), "%s/%s", mqtt_topic, series_name[sr[i]]);
+    snprintf(payload, sizeof(payload), "%.10g", value[i]);
+    mqtt_publish(topic, payload, 1);
+  }
+  TIMING_STOP(t_mqtt, ST_MQTT);
+}
+
+struct sink mqtt_output = {
+  .name = "mqtt",
+  .policy = SINK_DROP,
+  .item_size = sizeof(struct output),
+  .slots = 1024,
+  .consume = mqtt_consume,
+  .idle = mqtt_idle,
+  .open = mqtt_output_open,
+  .flush = mqtt_flush,
+  .close = mqtt_close
+};
+
+/* Live stream: every reading as an event with the values of its series */
+int sse_output_open()
+{
+  if (live_port == 0) {
+    return(1);
+  }
+  if (sse_start(LIVE_ADDR, live_port) != 0) {
+    fprintf(stderr, "Can't start the live stream on %s:%d\n", LIVE_ADDR, live_port);
+    return(1);
+  }
+  return(0);
+}
+
+void sse_consume(void *item)
+{
+  struct output *o = item;
+  char data[SSE_EVENT_SIZE];
+  int sr[2], i, n, len;
+  double value[2];
+  TIMING_START(t_sse);
+
+  n = output_series(o, sr, value);
+  len = snprintf(data, sizeof(data), "{\"time\":%ld,\"type\":\"%c\"", (long)o->t, o->type);
+  for (i=0; i<n && len < (int)sizeof(data); i++) {
+    len += snprintf(data + len, sizeof(data) - len, ",\"%s\":%.10g", series_name[sr[i]], value[i]);
+  }
+  if (len < (int)sizeof(data)) {
+    len += snprintf(data + len, sizeof(data) - len, "}");
+  }
+  // a cut off event is no JSON, better none
+  if (n > 0 && len < (int)sizeof(data)) sse_publish(o->meter, data);
+  TIMING_STOP(t_sse, ST_SSE);
+}
+
+struct sink sse_output = {
+  .name = "sse",
+  .policy = SINK_DROP,
+  .item_size = sizeof(struct output),
+  .slots = 1024,
+  .consume = sse_consume,
+  .open = sse_output_open
+};
+
+/* History: every sample in the time-series store of its series, in
+*  1/scale units (scale 10: 0.1 degrees), and in the minute, hour, day and
+*  month rollups of its series (<name>.rollup)
+*/
+struct tsdb history[SR_MAX];
+struct rollup rollups[SR_MAX];
+
+/* the rollups of all series in history_dir, returns the no. opened */
+int open_rollups(int mode)
+{
+  char path[512];
+  int i, n=0;
+
+  for (i=0; i<n_series; i++) {
+    snprintf(path, sizeof(path), "%s/%s.rollup", history_dir, series_name[i]);
+    if (rollup_open(&rollups[i], path, series_kind[i], mode) != 0) {
+      fprintf(stderr, "Can't open %s, no rollups for %s\n", path, series_name[i]);
+      continue;
+    }
+    n++;
+  }
+  return(n);
+}
+
+int history_open()
+{
+  char base[512];
+  int i, n=0;
+
+  mkdir(history_dir, 0755);
+  for (i=0; i<n_series; i++) {
+    snprintf(base, sizeof(base), "%s/%s", history_dir, series_name[i]);
+    if (tsdb_open(&history[i], base, history_scale[i], 1) != 0) {
+      fprintf(stderr, "Can't open %s.tsd, no history for %s\n", base, series_name[i]);
+      continue;
+    }
+    n++;
+  }
+  n += open_rollups(ROLLUP_LIVE);
+  return(n == 0);
+}
+
+void history_consume(void *item)
+{
+  struct output *o = item;
+  int sr[2], i, n;
+  double value[2];
+  TIMING_START(t_history);
+
+  n = output_series(o, sr, value);
+  for (i=0; i<n; i++) {
+    tsdb_append(&history[sr[i]], o->t, value[i]);
+    rollup_add(&rollups[sr[i]], o->t, value[i]);
+  }
+  TIMING_STOP(t_history, ST_HISTORY);
+}
+
+/* the blocks are written when full, or some minutes after their first sample */
+void history_flush()
+{
+  time_t now = time(NULL);
+  int i;
+
+  for (i=0; i<n_series; i++) {
+    tsdb_flush_due(&history[i], now);
+  }
+}
+
+void history_close()
+{
+  int i;
+
+  for (i=0; i<n_series; i++) {
+    tsdb_close(&history[i]);
+    rollup_close(&rollups[i]);
+  }
+}
+
+struct sink history_output = {
+  .name = "history",
+  .policy = SINK_DROP,
+  .item_size = sizeof(struct output),
+  .slots = 1024,
+  .consume = history_consume,
+  .idle = history_flush,
+  .open = history_open,
+  .flush = history_flush,
+  .close = history_close
+};
+
+/* the registry of all outputs */
+struct sink *outputs[] = {
+  &domoticz_output, &rrd_output, &html_output, &udp_output, &mqtt_output, &history_output,
+  &sse_output, NULL
+};
+
+void put_output(struct output *o)
+{
+  int i;
+
+  for (i=0; outputs[i]!=NULL; i++) {
+    sink_put(outputs[i], o);
+  }
+}
+
+
+/* FUNCTIONs to write the logfiles, done by the log thread */
+/* global vars used by these functions */
+struct logfile all_log;		// The logfile, kept open
+struct logfile midnight_log;	// The midnight logfile, kept open
+
+struct log_item {
+  struct logfile *lf;
+  time_t t;
+  int reopen;			// reopen the file instead of writing text
+  char text[256];
+};
+
+void log_consume(void *item)
+{
+  struct log_item *li = item;
+  TIMING_START(t_log);
+
+  if (li->reopen) {
+    log_reopen(li->lf);
+  } else {
+    log_write(li->lf, li->text, li->t);
+  }
+  TIMING_STOP(t_log, ST_LOG);
+}
+
+void log_idle()
+{
+  log_flush_due(&all_log, time(NULL));
+}
+
+struct sink log_sink = {
+  .name = "log",
+  .policy = SINK_BLOCK,
+  .item_size = sizeof(struct log_item),
+  .slots = 4096,
+  .consume = log_consume,
+  .idle = log_idle
+};
+
+void put_log(struct logfile *lf, char *text)
+{
+  struct log_item li;
+
+  li.lf = lf;
+  li.t = date_time;
+  li.reopen = 0;
+  snprintf(li.text, sizeof(li.text), "%s", text);
+  sink_put(&log_sink, &li);
+}
+
+void reopen_log(struct logfile *lf)
+{
+  struct log_item li;
+
+  memset(&li, 0, sizeof(li));
+  li.lf = lf;
+  li.reopen = 1;
+  sink_put(&log_sink, &li);
+}
+
+
+/* FUNCTION to process one line from the JeeNode
+*  Used for lines read from the port and for lines replayed from a log,
+*  the time vars must already be set to the time of the line. Writing the
+*  logs and checkpoint is left to the sink threads, the message is given
+*  to the outputs.
+*/
+/* global vars used by this function */
+char logstring[255];		// The string to be written to the logfile
+int prev_day=-1;			// date of the previous line
+
+void process_line(int port, char *usb_line)
+{
+  struct message msg;		// the parsed line
+  struct output out;		// the message for the outputs
+  struct meter *e=main_meters['e'-'a'], *s=main_meters['s'-'a'];
+  struct meter *g=main_meters['g'-'a'], *w=main_meters['w'-'a'];
+  int i, rc;
+  TIMING_START(t_line);
+
+  /* the lines of another port than the first are logged with its no. */
+  if (port > 0) {
+    snprintf(logstring, sizeof(logstring), "%s #%d %s", logdatetime, port, usb_line);
+  } else {
+    snprintf(logstring, sizeof(logstring), "%s %s", logdatetime, usb_line);
+  }
+  put_log(&all_log, logstring);
+  /* process the line */
+  TIMING_START(t_parse);
+  out.type = '\0';
+  out.meter = -1;
+  rc = parse_line(usb_line, &msg);	// first, it sets msg.type
+  if (metrics_message(msg.type, rc) == 0) {
+    out.type = msg.type;   // unknown or malformed: only logged
+    out.meter = find_meter(port, msg.type);
+  }
+  out.item2 = msg.value[0];
+  out.item3 = msg.value[1];
+  out.item4 = msg.value[2];
+  TIMING_STOP(t_parse, ST_PARSE);
+  if (out.meter >= 0 && dedup_check(out.meter, port, &msg, date_time)) {
+    TIMING_STOP(t_line, ST_LINE);
+    return;   // the same reading from another CentralNode, only logged
+  }
+  if (out.meter >= 0) {
+    meter_update(&meters[out.meter], &msg);
+  }
+  set_actual_array();
+  write_actual(alog, date_time, 0);
+
+  /*  Reset the daily counters of all meters, because of a new day, set
+  *  their start rotations to the number of rotations now, because of a new
+  *  day. The first message of a new date does this, also when there was
+  *  none around midnight (or jnread was not running).
+  */
+  if ( (prev_day >= 0) && (day != prev_day) ) {
+    // Data for daily log (of the main meters): Date, Time, Imported energy (Wh), Gas usage (L), Water usage (L), Solar production (Wh), Solar runtime (mins), Used energy (Wh)(=Imported energy+Solar production)
+    sprintf(logstring, "%s,%d,%d,%d,%d,%d,%d\n", prevlogdatetime, e->today, g->today, w->today, s->today, s->runtime, e->today+s->today);
+    put_log(&midnight_log, logstring);
+    sprintf(logstring, "Midnight reset of the counters\n");
+    put_log(&all_log, logstring);
+    for (i=0; i<n_meters; i++) {
+      meter_midnight(&meters[i]);
+    }
+    set_actual_array();
+    write_actual(alog, date_time, 1);
+  }
+  prev_day = day;
+
+  out.t = date_time;
+  create_html_page(&out.hv);
+  put_output(&out);
+  TIMING_STOP(t_line, ST_LINE);
+}
+
+
+/* FUNCTIONs to read the input in the reader thread
+*  Every line goes with the time it was read (or, when replaying, the time
+*  recorded in the log) through the lines queue to the processing thread.
+*  The reader waits when that queue is full, so no line is lost.
+*/
+/* global vars used by these functions */
+struct line_item {
+  time_t t;			// time of the line
+  long read_ns;			// when it was read (for the latency)
+  int port;			// no. of the port it was read from
+  char line[128];
+};
+struct spsc lines;		// reader -> processing thread
+pthread_t reader;
+int reader_started=0;
+int reader_stop=0;		// set by the processing thread
+int reader_done=0;		// set by the reader at the end of the input
+int bench=0;			// report the timings at the end (stop at hangup)
+long replay_skipped=0;		// replayed lines without a time
+
+int put_line(struct line_item *li)
+{
+  li->read_ns = timing_now();
+  while (spsc_push_wait(&lines, li, 200) != 0) {
+    if (__atomic_load_n(&reader_stop, __ATOMIC_ACQUIRE)) return(1);
+  }
+  return(0);
+}
+
+void *read_usb(void *arg)
+{
+  struct line_item li;
+  int gbytes;			// bytes read from usb port
+  int port=0;			// port of the line
+  int i, open;
+
+  while (!__atomic_load_n(&reader_stop, __ATOMIC_ACQUIRE)) {
+    TIMING_START(t_read);
+    gbytes=get_usb_line(li.line, sizeof(li.line), &port);
+    TIMING_STOP(t_read, ST_READ);
+    if (gbytes==0) {
+      for (i=0, open=0; i<n_ports; i++) {
+        if (usb[i].fd >= 0 || usb[i].lines == 0) open++;
+      }
+      if (bench && open == 0) {
+        break;   // benchmark input is done
+      }
+      continue;
+    }
+    li.t = time(NULL);
+    li.port = port;
+    if (put_line(&li) != 0) break;
+  }
+  __atomic_store_n(&reader_done, 1, __ATOMIC_RELEASE);
+  return(NULL);
+}
+
+/* The time of a line "dd-mm-yy,hh:mm:ss [#<port> ]<line from JeeNode>" in
+*  ALL_LOG format and its port (0 when not there), returns where the line
+*  from the JeeNode starts or 0 when the line has another format (like
+*  "Midnight reset of the counters").
+*/
+int log_line_time(const char *line, time_t *t, int *port)
+{
+  struct tm tm;
+  int n=0, m=0;
+
+  memset(&tm, 0, sizeof(tm));
+  if (sscanf(line, "%d-%d-%d,%d:%d:%d %n", &tm.tm_mday, &tm.tm_mon, &tm.tm_year,
+      &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &n) != 6 || n == 0 || line[n] == '\0') {
+    return(0);
+  }
+  *port = 0;
+  if (line[n] == '#' && sscanf(line + n, "#%d %n", port, &m) == 1 && m > 0) {
+    n += m;
+  }
+  tm.tm_mon -= 1;
+  tm.tm_year += 100;
+  tm.tm_isdst = -1;
+  *t = mktime(&tm);
+  return(n);
+}
+
+/* Replay a log file in ALL_LOG format at full speed: every line is
+*  processed with its recorded time, other lines are skipped.
+*/
+void *read_replay(void *arg)
+{
+  FILE *rfp = arg;
+  char line[300];
+  struct line_item li;
+  int n;
+
+  while (!__atomic_load_n(&reader_stop, __ATOMIC_ACQUIRE) && fgets(line, sizeof(line), rfp) != NULL) {
+    if ((n = log_line_time(line, &li.t, &li.port)) == 0) {
+      replay_skipped++;
+      continue;
+    }
+    snprintf(li.line, sizeof(li.line), "%s", line + n);
+    if (put_line(&li) != 0) break;
+  }
+  fclose(rfp);
+  __atomic_store_n(&reader_done, 1, __ATOMIC_RELEASE);
+  return(NULL);
+}
+
+int start_reader(void *(*read_fn)(void *), void *arg)
+{
+  sigset_t all, old;
+  int rc;
+
+  /* signals are handled by the processing (main) thread only */
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+  rc = pthread_create(&reader, NULL, read_fn, arg);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  reader_started = (rc == 0);
+  return(rc != 0);
+}
+
+
+/* FUNCTION to process the next line from the reader, waiting at most
+*  timeout_ms for it. Returns 0 when a line was processed.
+*/
+/* global vars used by this function */
+long lines_done=0;		// no. of lines processed
+
+int process_next(int timeout_ms)
+{
+  struct line_item li;
+
+  if (spsc_pop(&lines, &li, timeout_ms) != 0) {
+    return(1);
+  }
+  set_time_vars(li.t);
+  process_line(li.port, li.line);
+  lines_done++;
+  TIMING_STOP(li.read_ns, ST_LATENCY);
+  return(0);
+}
+
+
+/* FUNCTION to save the state and stop: the lines read so far are processed
+*  and every sink finishes its queue
+*/
+/* global vars used by this function */
+long start_ns;			// start of processing (for --bench)
+char *replay_file=NULL;		// log to replay instead of reading the port
+
+void stop(int status)
+{
+  double secs;
+  int i;
+
+  if (reader_started) {
+    __atomic_store_n(&reader_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(reader, NULL);
+    while (process_next(0) == 0);
+  }
+  set_actual_array();
+  write_actual(alog, date_time, 1);
+  for (i=0; outputs[i]!=NULL; i++) {
+    sink_stop(outputs[i]);
+  }
+  sink_stop(&checkpoint_sink);
+  sink_stop(&log_sink);
+  log_close(&all_log);
+  log_close(&midnight_log);
+  close_series();
+  secs = (timing_now() - start_ns) / 1e9;
+  if (replay_file != NULL) {
+    fprintf(stderr, "Replayed %ld lines (%ld skipped) in %.3f s: %.0f lines/sec\n",
+    lines_done, replay_skipped, secs, secs > 0 ? lines_done / secs : 0);
+  }
+  if (bench) {
+    metrics_report(stderr, lines_done, secs);
+  }
+  exit(status);
+}
+
+
+/* FUNCTION to add a queue to the stats endpoint */
+void add_queue(const char *name, const struct spsc *q)
+{
+  if (metrics_add_queue(name, q) != 0) {
+    fprintf(stderr, "Too many queues, max. %d: no stats for %s\n", METRICS_QUEUES, name);
+  }
+}
+
+
+/* FUNCTION to report the statistics (on SIGUSR1) */
+void print_stats()
+{
+  struct dz_stats dz;
+  struct udp_stats udp;
+  struct mqtt_stats mq;
+  struct tsdb_stats ts;
+  struct sse_stats live;
+  struct dedup_stats gw;
+  struct sink *sinks[] = { &log_sink, &checkpoint_sink };
+  int i;
+
+  domoticz_get_stats(&dz);
+  udp_get_stats(&udp);
+  mqtt_get_stats(&mq);
+  for (i=0; i<n_ports; i++) {
+    fprintf(stderr, "%s USB %s: bytes %lu, lines %lu, too long %lu, reconnects %lu, frames %lu, bad frames %lu, broken lines %lu\n",
+    logdatetime, ports[i], usb[i].bytes, usb[i].lines, usb[i].too_long, usb[i].reconnects, usb[i].frames,
+    usb[i].bad_frames, usb[i].broken);
+    dedup_get_stats(i, &gw);
+    fprintf(stderr, "%s Gateway %s: readings %lu, first %lu, duplicates %lu, missed %lu, loss %.2f%%\n",
+    logdatetime, ports[i], gw.readings, gw.first, gw.duplicates, gw.missed,
+    gw.readings + gw.missed > 0 ? 100.0 * gw.missed / (gw.readings + gw.missed) : 0.0);
+  }
+  fprintf(stderr, "%s Domoticz: queued %lu, sent %lu, coalesced %lu, dropped %lu, failed %lu, connects %lu, queue depth %d\n",
+  logdatetime, dz.queued, dz.sent, dz.coalesced, dz.dropped, dz.failed, dz.connects, dz.depth);
+  if (udp_output.started) {
+    fprintf(stderr, "%s UDP: lines %lu, datagrams %lu, failed %lu\n",
+    logdatetime, udp.lines, udp.datagrams, udp.failed);
+  }
+  if (mqtt_output.started) {
+    fprintf(stderr, "%s MQTT: published %lu, dropped %lu, connects %lu\n",
+    logdatetime, mq.published, mq.dropped, mq.connects);
+  }
+  if (history_output.started) {
+    tsdb_get_stats(&ts);
+    fprintf(stderr, "%s History: samples %lu, rejected %lu, blocks %lu, bytes %lu, failed %lu\n",
+    logdatetime, ts.samples, ts.rejected, ts.blocks, ts.bytes, ts.failed);
+  }
+  if (sse_output.started) {
+    sse_get_stats(&live);
+    fprintf(stderr, "%s Live: clients %lu, connects %lu, rejected %lu, lagged %lu, events %lu\n",
+    logdatetime, live.clients, live.connects, live.rejected, live.lagged, live.events);
+  }
+  fprintf(stderr, "%s Queue lines: depth %u, full %lu\n", logdatetime, spsc_depth(&lines), lines.full);
+  for (i=0; i<2; i++) {
+    fprintf(stderr, "%s Queue %s: depth %u, full %lu, dropped %lu\n", logdatetime, sinks[i]->name,
+    spsc_depth(&sinks[i]->q), sinks[i]->q.full, sinks[i]->q.dropped);
+  }
+  for (i=0; outputs[i]!=NULL; i++) {
+    if (outputs[i]->started) {
+      fprintf(stderr, "%s Output %s: depth %u, full %lu, dropped %lu\n", logdatetime, outputs[i]->name,
+      spsc_depth(&outputs[i]->q), outputs[i]->q.full, outputs[i]->q.dropped);
+    }
+  }
+}
+
+
+/* FUNCTION to (re)compute the rollups of all series from a log in ALL_LOG
+*  format, e.g. for the days jnread was not running (run it when jnread is
+*  stopped, both write the same files). Only the rollups are
+*  written, the buckets in the log are made again from its samples.
+*  Returns the exit status.
+*/
+int backfill(const char *filename)
+{
+  FILE *bfp;
+  char line[300];
+  struct message msg;
+  struct output o;
+  int sr[2], i, n, port;
+  double value[2];
+  long lines=0, samples=0;
+  double secs;
+
+  if ((bfp = fopen(filename, "r")) == NULL) {
+    fprintf(stderr, "Can't open %s\n", filename);
+    return(EXIT_FAILURE);
+  }
+  mkdir(history_dir, 0755);
+  if (open_rollups(ROLLUP_BACKFILL) == 0) {
+    fclose(bfp);
+    return(EXIT_FAILURE);
+  }
+  start_ns = timing_now();
+  memset(&o, 0, sizeof(o));
+  while (fgets(line, sizeof(line), bfp) != NULL) {
+    if ((n = log_line_time(line, &o.t, &port)) == 0 || parse_line(line + n, &msg) != PARSE_OK) {
+      continue;
+    }
+    lines++;
+    o.type = msg.type;
+    o.meter = find_meter(port, msg.type);
+    o.item2 = msg.value[0];
+    o.item3 = msg.value[1];
+    o.item4 = msg.value[2];
+    n = output_series(&o, sr, value);
+    for (i=0; i<n; i++) {
+      rollup_add(&rollups[sr[i]], o.t, value[i]);
+    }
+    samples += n;
+  }
+  fclose(bfp);
+  for (i=0; i<n_series; i++) {
+    rollup_close(&rollups[i]);
+  }
+  secs = (timing_now() - start_ns) / 1e9;
+  fprintf(stderr, "Backfilled %ld samples of %ld messages in %.3f s\n", samples, lines, secs);
+  return(EXIT_SUCCESS);
+}
+
+
+/* FUNCTIONs to read the config file, see jnread.conf.example for the keys */
+/* global vars used by these functions */
+const struct setting {
+  const char *key;
+  char *str;			// a string setting
+  size_t size;
+  int *num;			// or a number setting
+} settings[] = {
+  { "baud", NULL, 0, &baud },
+  { "dedup_window", NULL, 0, &dedup_window },
+  { "all_log", log_file, sizeof(log_file), NULL },
+  { "actual_log", alog, sizeof(alog), NULL },
+  { "midnight_log", mlog, sizeof(mlog), NULL },
+  { "html", ahtml, sizeof(ahtml), NULL },
+  { "json", ajson, sizeof(ajson), NULL },
+  { "rrd_db", rrd_db, sizeof(rrd_db), NULL },
+  { "rra_dir", rra_dir, sizeof(rra_dir), NULL },
+  { "history_dir", history_dir, sizeof(history_dir), NULL },
+  { "domoticz", domoticz_server, sizeof(domoticz_server), NULL },
+  { "udp", udp_target, sizeof(udp_target), NULL },
+  { "mqtt", mqtt_broker, sizeof(mqtt_broker), NULL },
+  { "mqtt_topic", mqtt_topic, sizeof(mqtt_topic), NULL },
+  { "live_port", NULL, 0, &live_port },
+  { "stats_port", NULL, 0, &stats_port },
+  { NULL, NULL, 0, NULL }
+};
+int config_ports=0;		// no. of ports in the file (replace the default)
+struct meter *config_meter=NULL;	// meter of the [meter] section
+
+/* a setting of a [meter] section, the type comes first */
+int config_meter_set(const char *key, const char *value)
+{
+  struct meter *m = config_meter;
+  char *end;
+  long n;
+  double d;
+
+  if (strcmp(key, "type") == 0) {
+    if (m != NULL || value[0] == '\0' || value[1] != '\0') {
+      return(1);
+    }
+    config_meter = add_meter(value[0]);
+    return(config_meter == NULL);
+  }
+  if (m == NULL) {
+    return(1);
+  }
+  if (strcmp(key, "name") == 0) {
+    if (strlen(value) >= sizeof(m->name) || strspn(value, "abcdefghijklmnopqrstuvwxyz0123456789_") != strlen(value)) {
+      return(1);
+    }
+    strcpy(m->name, value);
+  } else if (strcmp(key, "port") == 0) {
+    n = strtol(value, &end, 10);
+    if (strcmp(value, "any") == 0) {
+      m->port = -1;
+    } else if (end == value || *end != '\0' || n < 0 || n >= SERIAL_MAX_PORTS) {
+      return(1);
+    } else {
+      m->port = n;
+    }
+  } else if (strcmp(key, "cfactor") == 0) {
+    d = strtod(value, &end);
+    if (end == value || *end != '\0' || !(d > 0)) {
+      return(1);
+    }
+    m->cfactor = d;
+  } else if (strcmp(key, "idx") == 0 || strcmp(key, "idx_counter") == 0) {
+    if (strlen(value) >= sizeof(m->idx)) {
+      return(1);
+    }
+    strcpy(key[3] == '\0' ? m->idx : m->idx_counter, value);
+  } else if (strcmp(key, "interval") == 0) {
+    n = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || n < 0) {
+      return(1);
+    }
+    m->interval = n;
+  } else {
+    return(1);
+  }
+  return(0);
+}
+
+/* a setting (section is "" before the first section), returns 0 when right */
+int config_set(const char *section, const char *key, const char *value)
+{
+  const struct setting *st;
+  char *end;
+  long n;
+
+  if (key == NULL) {
+    config_meter = NULL;
+    return(strcmp(section, "meter") != 0);
+  }
+  if (section[0] != '\0') {
+    return(config_meter_set(key, value));
+  }
+  if (strcmp(key, "port") == 0) {
+    if (config_ports == SERIAL_MAX_PORTS || strlen(value) >= sizeof(ports[0])) {
+      return(1);
+    }
+    strcpy(ports[config_ports++], value);
+    n_ports = config_ports;
+    return(0);
+  }
+  for (st=settings; st->key != NULL; st++) {
+    if (strcmp(key, st->key) != 0) {
+      continue;
+    }
+    if (st->num != NULL) {
+      n = strtol(value, &end, 10);
+      if (end == value || *end != '\0' || n < 0 || n > 1000000) {
+        return(1);
+      }
+      if (st->num == &baud && !serial_baud_ok(n)) {
+        return(1);    // the port can not be set to this rate
+      }
+      *st->num = n;
+      return(0);
+    }
+    if (strlen(value) >= st->size) {
+      return(1);
+    }
+    strcpy(st->str, value);
+    /* the temporary files are next to the files */
+    if (st->str == ahtml) return(snprintf(thtml, sizeof(thtml), "%s.new", ahtml) >= (int)sizeof(thtml));
+    if (st->str == ajson) return(snprintf(tjson, sizeof(tjson), "%s.new", ajson) >= (int)sizeof(tjson));
+    return(0);
+  }
+  return(1);
+}
+
+/* the config file, returns 0 when it was read or is not there (and need
+*  not be)
+*/
+int read_config(const char *filename, int must_exist)
+{
+  switch (config_read(filename, config_set)) {
+  case CONFIG_MISSING:
+    if (must_exist) {
+      fprintf(stderr, "Can't open %s\n", filename);
+      return(1);
+    }
+    break;
+  case CONFIG_ERROR:
+    return(1);
+  }
+  return(0);
 }
 
 
 /*#### MAIN #################################################################*/
 
-/* Initialise some variables */
-int prev_hours=0;
+void usage(char *prog)
+{
+  fprintf(stderr, "Usage: %s [-c config] [-p port]... [--output <directory>] [--bench] [--stub-sinks]\n", prog);
+  fprintf(stderr, "       %s --replay <logfile> --output <directory> [--bench] [--stub-sinks]\n", prog);
+  fprintf(stderr, "  (both also [--udp <host:port>] [--mqtt <host[:port]>] [--live <port>])\n");
+  fprintf(stderr, "       %s [-c config] --backfill <logfile> [--output <directory>]\n", prog);
+  fprintf(stderr, "       %s [-c config] query [options] <series>   (the history, \"query -h\" for the options)\n", prog);
+  fprintf(stderr, "  -c, --config  the config file (default %s)\n", CONFIG_FILE);
+  fprintf(stderr, "  -p            port of a JeeNode, more -p for more JeeNodes (instead of the\n");
+  fprintf(stderr, "                ports of the config file)\n");
+  fprintf(stderr, "  --output      write all files in <directory>\n");
+  fprintf(stderr, "  --bench       report the time per stage and the messages at the end\n");
+  fprintf(stderr, "                (stops when the port hangs up)\n");
+  fprintf(stderr, "  --stub-sinks  do not send to Domoticz and rrdtool (also when replaying)\n");
+  fprintf(stderr, "  --udp         export all series as line protocol to UDP <host:port>\n");
+  fprintf(stderr, "  --mqtt        publish all series to the MQTT broker <host[:port]>\n");
+  fprintf(stderr, "  --live        port of the live stream of readings, 0 = off (not when replaying)\n");
+  fprintf(stderr, "  --backfill    make the minute/hour/day/month rollups again from a log\n");
+  exit(EXIT_FAILURE);
+}
 
 int main(int argc, char *argv[])
 {
   char *prog = argv[0]; 	// program name for errors
-  char log[]=ALL_LOG;		// The logfile
-  char mlog[]=MIDNIGHT_LOG;	// The midnight logfile
-  char logstring[255];		// The string to be written to the logfile
-  char alog[]=ACTUAL_LOG;	// File with the last actual values
-  char usb_line[128];		// line read from usb port
-  char rrd_db[]=RRD_DB; 	// RRD database file
-  char systemstr[255];          // line to be executed by OS
-  int gbytes;			// bytes read from usb port
-  char type; int item2; long item3; long item4; // items in USB message
-  int i;			// counter
+  char *config_file = CONFIG_FILE;	// config file
+  int config_opt=0;		// config file given with -c
+  int ports_opt=0;		// no. of ports given with -p
+  char *outdir = NULL;		// output directory when replaying
+  int opt;			// command line option
+  int i;
+  FILE *rfp;			// log to replay
+  char *backfill_file = NULL;	// log to backfill the rollups from
+  struct stat st;
+  int done;			// reader is at the end of the input
+  struct sigaction sa;		// signal handling
+  static struct option long_options[] = {
+    { "replay", required_argument, NULL, 'r' },
+    { "output", required_argument, NULL, 'o' },
+    { "bench", no_argument, NULL, 'b' },
+    { "stub-sinks", no_argument, NULL, 'S' },
+    { "udp", required_argument, NULL, 'U' },
+    { "mqtt", required_argument, NULL, 'M' },
+    { "backfill", required_argument, NULL, 'B' },
+    { "live", required_argument, NULL, 'L' },
+    { "config", required_argument, NULL, 'c' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  /* Queries on the history are a subcommand (in history_dir of the config
+  *  file, which may be given before it)
+  */
+  i = 1;
+  if (argc > 3 && (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "--config") == 0)) {
+    config_file = argv[2];
+    config_opt = 1;
+    i = 3;
+  }
+  if (argc > i && strcmp(argv[i], "query") == 0) {
+    if (read_config(config_file, config_opt) != 0) {
+      return(EXIT_FAILURE);
+    }
+    return(query_main(argc - i, argv + i, history_dir));
+  }
+
+  /* The config file first, the other options overrule it */
+  opterr = 0;
+  while ((opt = getopt_long(argc, argv, "c:p:r:o:", long_options, NULL)) != -1) {
+    if (opt == 'c') {
+      config_file = optarg;
+      config_opt = 1;
+    }
+  }
+  if (read_config(config_file, config_opt) != 0) {
+    exit(EXIT_FAILURE);
+  }
+  opterr = 1;
+  optind = 1;
 
-  /* Read values from the ACTUAL_LOG file and fill the vars */
-  if ((read_actual(alog)) == 1) {
+  /* Command line options */
+  while ((opt = getopt_long(argc, argv, "c:p:r:o:", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 'c':
+      break;
+    case 'p':
+      if (ports_opt == SERIAL_MAX_PORTS) {
+        usage(prog);
+      }
+      snprintf(ports[ports_opt++], sizeof(ports[0]), "%s", optarg);
+      n_ports = ports_opt;
+      break;
+    case 'r':
+      replay_file = optarg;
+      break;
+    case 'o':
+      outdir = optarg;
+      break;
+    case 'b':
+      bench = 1;
+      break;
+    case 'S':
+      stub_sinks = 1;
+      break;
+    case 'U':
+      snprintf(udp_target, sizeof(udp_target), "%s", optarg);
+      break;
+    case 'M':
+      snprintf(mqtt_broker, sizeof(mqtt_broker), "%s", optarg);
+      break;
+    case 'B':
+      backfill_file = optarg;
+      break;
+    case 'L':
+      live_port = atoi(optarg);
+      break;
+    default:
+      usage(prog);
+    }
+  }
+  /* a replay never writes to the live files */
+  if (replay_file != NULL && outdir == NULL) {
+    usage(prog);
+  }
+  if (setup_meters() != 0) {
+    exit(EXIT_FAILURE);
+  }
+  dedup_init(dedup_window);
+  set_paths(outdir);
+  if (backfill_file != NULL) {
+    return(backfill(backfill_file));
+  }
+
+  /* Read values from the ACTUAL_LOG file and fill the vars,
+  *  output to an empty directory starts from the first messages (as do
+  *  meters that are not in the file yet)
+  */
+  switch (read_actual(alog)) {
+  case CP_MISSING:
+    if (outdir != NULL) {
+      break;
+    }
     fprintf(stderr, "Can't open %s\n", alog);
     exit(EXIT_FAILURE);
+  case CP_CORRUPT:
+    fprintf(stderr, "%s is corrupt, not starting with wrong counters\n", alog);
+    exit(EXIT_FAILURE);
   }
+  memcpy(saved_actual, actual, sizeof(actual));
   //for (i=0; i<9; i++) {
   //    printf("%2d= %d\n",i, actual[i]);
   //}
   set_measurement_vars();
 
-  set_time_vars();
-
-  /*  read line from port and process only lines that start with:
-  *     a: for appliance data
-  * 	e: for electricity data
-  * 	g: for gas data
-  * 	i: for inside temperature data
-  * 	o: for outside temperature data
-  * 	p: for outside pressure data
-  * 	s: for solar production data
-  * 	w: for water data
+  /* The date of the counters is the date of the last checkpoint, so a new
+  *  date since then resets them (a replay starts at its first line)
   */
-  open_usb(PORT);
-  while (1) {
-    gbytes=get_usb_line(usb_line, 128);  
-    //printf("%d bytes: ", gbytes);
-    //for (i=0; i<gbytes; i++) {
-    //  printf("%c", usb_line[i]);
-    //}
-    if (gbytes!=0) {
-      set_time_vars();
-      sprintf(logstring, "%s %s", logdatetime, usb_line);
-      append_to_file(log, logstring);
-      /* process the line */
-      sscanf(usb_line, "%c %d %ld %ld", &type, &item2, &item3, &item4);
-      switch (type) {
-      case 'a':
-        #if DEBUG
-        printf("type %c, watt %d\n", type, item2);
-        #endif
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d\"", DOMOTICZ_SERVER, A_IDX, item2);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d\"", N_DOMOTICZ_SERVER, N_A_IDX, item2);
-        //system(systemstr);
-        break;
-      case 'e':
-        watt=item2;
-        e_rotations=item3;
-        #if DEBUG
-        printf("type %c, watt %d, e_rotations %d\n", type, watt, e_rotations);
-        #endif
-        e_today = ((e_rotations-e_start_rotations)*1000)/CFACTOR;
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d\"", DOMOTICZ_SERVER, E_IDX_actual, watt);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d;%d\"", N_DOMOTICZ_SERVER, N_E_IDX_actual, watt);
-        //system(systemstr);
-        // The "(e_rotations*1000)/600" in the line below is needed to be able to set the "Energy counter divider" in Domoticz on 1000 (and not 600)
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d\"", DOMOTICZ_SERVER, E_IDX_counter, (e_rotations*1000)/600);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d;%d\"", N_DOMOTICZ_SERVER, N_E_IDX_counter, (e_rotations*1000)/600);
-        //system(systemstr);
-        break;
-      case 'g':
-        g_rotations=item3;
-        #if DEBUG
-        printf("type %c, g_rotations %d\n", type, g_rotations);
-        #endif
-        g_today = (g_rotations-g_start_rotations)*10;
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d\"", DOMOTICZ_SERVER, G_IDX, g_rotations);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d\"", N_DOMOTICZ_SERVER, N_G_IDX, g_rotations);
-        //system(systemstr);
-        //sleep(1);
-        break;
-      case 'w':
-        w_rotations=item3;
-        #if DEBUG
-        printf("type %c, w_rotations %d\n", type, w_rotations);
-        #endif
-        w_today = (w_rotations-w_start_rotations)*1;
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d\"", DOMOTICZ_SERVER, W_IDX, w_rotations);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d\"", N_DOMOTICZ_SERVER, N_W_IDX, w_rotations);
-        //system(systemstr);
-        //sleep(1);
-        break;
-      case 'i':
-        itemperature=item2;
-        #if DEBUG
-        printf("type %c, itemperature %d\n", type, itemperature);
-        #endif
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%2.1f\"", DOMOTICZ_SERVER, I_IDX, (float)itemperature/10.0f);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%2.1f\"", N_DOMOTICZ_SERVER, N_I_IDX, (float)itemperature/10.0f);
-        //system(systemstr);
-        break;
-      case 'o':
-        otemperature=item2;
-        #if DEBUG
-        printf("type %c, otemperature %d\n", type, otemperature);
-        #endif
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%2.1f\"", DOMOTICZ_SERVER, O_IDX, (float)otemperature/10.0f);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%2.1f\"", N_DOMOTICZ_SERVER, N_O_IDX, (float)otemperature/10.0f);
-        //system(systemstr);
-        break;
-      case 'p':
-        opressure=item2;
-        #if DEBUG
-        printf("type %c, opressure %d\n", type, opressure);
-        #endif
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%4.1f;5\"", DOMOTICZ_SERVER, P_IDX, (float)opressure/10.0f);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%4.1f;5\"", N_DOMOTICZ_SERVER, N_P_IDX, (float)opressure/10.0f);
-        //system(systemstr);
-        break;
-      case 's':
-        swatt=item2;
-        s_today=item3;
-        s_runtime=item4;
-        #if DEBUG
-        printf("type %c, swatt %d, s_today %d, s_runtime %d\n", type, swatt, s_today, s_runtime);
-        #endif
-        sprintf(systemstr, "rrdtool update %s N:%d", rrd_db, swatt);
-        system(systemstr);
-        sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d;%d\"", DOMOTICZ_SERVER, S_IDX, swatt, s_today);
-        system(systemstr);
-        //sprintf(systemstr, "curl -s -i -H \"Accept: application/json\" \"http://%s/json.htm?type=command&param=udevice&idx=%s&nvalue=0&svalue=%d;%d\"", N_DOMOTICZ_SERVER, N_S_IDX, swatt, s_today);
-        //system(systemstr);
-        break;
-      }
-      set_actual_array();
-      write_actual(alog);
-      
-      /*  Reset the daily counter e_today, g_today and w_today, because of a new day,
-      *  set e_start_rotations, g_start_rotations and w_start_rotations to the number of
-      *  rotations now, because of a new day
-      */
-      if ( (prev_hours == 23) && (hours == 00) ) {
-        // Data for daily log: Date, Time, Imported energy (Wh), Gas usage (L), Water usage (L), Solar production (Wh), Solar runtime (mins), Used energy (Wh)(=Imported energy+Solar production)
-        sprintf(logstring, "%s,%d,%d,%d,%d,%d,%d\n", prevlogdatetime, e_today, g_today, w_today, s_today, s_runtime, e_today+s_today);
-        append_to_file(mlog, logstring);
-        sprintf(logstring, "Midnight reset of the counters\n");
-        append_to_file(log, logstring);
-        e_today = 0;
-        e_start_rotations = e_rotations;
-        g_today = 0;
-        g_start_rotations = g_rotations;
-        s_today = 0;
-        s_runtime = 0;
-        w_today = 0;
-        w_start_rotations = w_rotations;
+  if (replay_file == NULL && stat(alog, &st) == 0) {
+    set_time_vars(st.st_mtime);
+    prev_day = day;
+  } else {
+    set_time_vars(time(NULL));
+  }
 
-      }
-      prev_hours = hours;
+  /* Open the logfiles, ALL_LOG is buffered, MIDNIGHT_LOG is written through */
+  if (log_open(&all_log, log_file, LOG_FLUSH_BYTES, LOG_FLUSH_INTERVAL) != 0) {
+    fprintf(stderr, "Can't open %s\n", log_file);
+    exit(EXIT_FAILURE);
+  }
+  all_log.max_size = LOG_MAX_SIZE;
+  all_log.keep = LOG_KEEP;
+  all_log.rotate_daily = LOG_ROTATE_DAILY;
+  if (log_open(&midnight_log, mlog, 0, 0) != 0) {
+    fprintf(stderr, "Can't open %s\n", mlog);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Open (or create) the round robin archives, jnread also runs without */
+  open_series();
+
+  /* Signal handling, only in this (the processing) thread */
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = signal_handler;
+  sigaction(SIGUSR1, &sa, NULL);
+  sigaction(SIGHUP, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGINT, &sa, NULL);
+
+  /* Start the sink threads and the queue from the reader, a replay fills
+  *  the archives and exports so the outputs may not drop anything, it only
+  *  publishes to Domoticz & RRD when stubbed
+  */
+  if (replay_file != NULL) {
+    for (i=0; outputs[i]!=NULL; i++) {
+      if (outputs[i]->policy == SINK_DROP) outputs[i]->policy = SINK_BLOCK;
+    }
+    publish = stub_sinks;
+    live_port = 0;
+  }
+  if (spsc_init(&lines, sizeof(struct line_item), 1024) != 0 ||
+      sink_start(&log_sink) != 0 || sink_start(&checkpoint_sink) != 0) {
+    fprintf(stderr, "Can't start the sink threads\n");
+    exit(EXIT_FAILURE);
+  }
+  add_queue("lines", &lines);
+  add_queue(log_sink.name, &log_sink.q);
+  add_queue(checkpoint_sink.name, &checkpoint_sink.q);
+
+  /* Start the outputs, those that are not configured are not started */
+  for (i=0; outputs[i]!=NULL; i++) {
+    if (sink_start(outputs[i]) == 0) {
+      add_queue(outputs[i]->name, &outputs[i]->q);
+    }
+  }
+
+  start_ns = timing_now();
+  if (replay_file != NULL) {
+    if ((rfp = fopen(replay_file, "r")) == NULL) {
+      fprintf(stderr, "Can't open %s\n", replay_file);
+      stop(EXIT_FAILURE);
+    }
+    if (start_reader(read_replay, rfp) != 0) {
+      fprintf(stderr, "Can't start the reader thread\n");
+      stop(EXIT_FAILURE);
+    }
+  } else {
+    /* Start the stats endpoint, jnread also runs without it */
+    snapshot_route();
+    if (stats_port != 0 && metrics_start(STATS_ADDR, stats_port, usb, n_ports) != 0) {
+      fprintf(stderr, "Can't start stats endpoint on %s:%d\n", STATS_ADDR, stats_port);
+    }
 
-      create_html_page();
+    /*  read lines from port in the reader thread, only lines that start with
+    *  these are processed:
+    *     a: for appliance data
+    * 	e: for electricity data
+    * 	g: for gas data
+    * 	i: for inside temperature data
+    * 	o: for outside temperature data
+    * 	p: for outside pressure data
+    * 	s: for solar production data
+    * 	w: for water data
+    */
+    if (open_usb() == SERIAL_BAD_BAUD) {
+      stop(EXIT_FAILURE);
+    }
+    if (start_reader(read_usb, NULL) != 0) {
+      fprintf(stderr, "Can't start the reader thread\n");
+      stop(EXIT_FAILURE);
+    }
+  }
+
+  /* Process the lines from the reader until the input ends or a signal */
+  while (1) {
+    done = __atomic_load_n(&reader_done, __ATOMIC_ACQUIRE);
+    if (process_next(200) != 0 && done) {
+      stop(EXIT_SUCCESS);
+    }
+    for (i=0; outputs[i]!=NULL; i++) {
+      sink_retry(outputs[i]);
+    }
+    sink_retry(&checkpoint_sink);
+    if (report_stats) {
+      report_stats=0;
+      print_stats();
+    }
+    if (reopen_logs) {
+      reopen_logs=0;
+      reopen_log(&all_log);
+      reopen_log(&midnight_log);
+    }
+    if (stop_requested) {
+      stop(EXIT_SUCCESS);
     }
   }
 }
@@ -0,0 +1,178 @@
+/*
+#################################################################################
+# logfile.c - Buffered log writer with persistent file descriptors             #
+#                                                                               #
+# Replaces the fopen/fputs/fclose per line of append_to_file() for the logs    #
+# that get a line for every USB message. See logfile.h for the interface.      #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "logfile.h"
+
+
+static int log_date(time_t t)
+{
+  struct tm tm;
+
+  localtime_r(&t, &tm);
+  return((tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday);
+}
+
+
+static int log_open_fd(struct logfile *lf)
+{
+  struct stat st;
+
+  if ((lf->fd = open(lf->path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644)) < 0) {
+    return(1);
+  }
+  if (fstat(lf->fd, &st) == 0) {
+    lf->size = st.st_size + lf->len;
+    /* an existing file keeps the date of its last change */
+    lf->day = (st.st_size > 0) ? log_date(st.st_mtime) : 0;
+  }
+  return(0);
+}
+
+
+/* FUNCTION to open a log file for appending */
+int log_open(struct logfile *lf, const char *path, size_t flush_bytes, int flush_interval)
+{
+  memset(lf, 0, sizeof(*lf));
+  snprintf(lf->path, sizeof(lf->path), "%s", path);
+  lf->flush_bytes = (flush_bytes < LOG_BUF_SIZE) ? flush_bytes : LOG_BUF_SIZE;
+  lf->flush_interval = flush_interval;
+  return(log_open_fd(lf));
+}
+
+
+/* FUNCTION to write the waiting bytes to the file */
+int log_flush(struct logfile *lf)
+{
+  size_t done = 0;
+  ssize_t n;
+
+  if (lf->fd < 0 && log_open_fd(lf) != 0) {
+    return(1);
+  }
+  while (done < lf->len) {
+    n = write(lf->fd, lf->buf + done, lf->len - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* keep what could not be written, it is tried again next flush */
+      memmove(lf->buf, lf->buf + done, lf->len - done);
+      lf->len -= done;
+      return(1);
+    }
+    done += n;
+  }
+  lf->len = 0;
+  return(0);
+}
+
+
+/* FUNCTION to flush when the oldest waiting data is too old */
+int log_flush_due(struct logfile *lf, time_t now)
+{
+  if (lf->len > 0 && now - lf->first_write >= lf->flush_interval) {
+    return(log_flush(lf));
+  }
+  return(0);
+}
+
+
+/* FUNCTION to close the log file and open it again (after it was moved) */
+int log_reopen(struct logfile *lf)
+{
+  log_flush(lf);
+  if (lf->fd >= 0) {
+    close(lf->fd);
+    lf->fd = -1;
+  }
+  return(log_open_fd(lf));
+}
+
+
+/* FUNCTION to move the log file aside and start a new one
+*  On size the older files shift first (.1 to .2 and so on), the one at
+*  .<keep> is removed.
+*/
+static void log_rotate(struct logfile *lf, int by_date)
+{
+  char oldpath[300], newpath[300];
+  int i;
+
+  log_flush(lf);
+  if (by_date) {
+    snprintf(newpath, sizeof(newpath), "%s.%d", lf->path, lf->day);
+  } else {
+    for (i = lf->keep - 1; i >= 1; i--) {
+      snprintf(oldpath, sizeof(oldpath), "%s.%d", lf->path, i);
+      snprintf(newpath, sizeof(newpath), "%s.%d", lf->path, i + 1);
+      rename(oldpath, newpath);
+    }
+    snprintf(newpath, sizeof(newpath), "%s.1", lf->path);
+  }
+  rename(lf->path, newpath);
+  log_reopen(lf);
+}
+
+
+/* FUNCTION to append a string to the log file */
+int log_write(struct logfile *lf, const char *str, time_t now)
+{
+  size_t n = strlen(str);
+  int today;
+
+  if (lf->rotate_daily) {
+    today = log_date(now);
+    if (lf->day != 0 && lf->day != today) {
+      log_rotate(lf, 1);
+    }
+    lf->day = today;
+  }
+  if (lf->max_size > 0 && lf->size + (off_t)n > lf->max_size && lf->size > 0) {
+    log_rotate(lf, 0);
+  }
+  if (lf->len + n > LOG_BUF_SIZE && log_flush(lf) != 0 && lf->len + n > LOG_BUF_SIZE) {
+    return(1);
+  }
+  if (n > LOG_BUF_SIZE) {
+    /* does not fit in the buffer, write directly */
+    lf->size += n;
+    return(write(lf->fd, str, n) == (ssize_t)n ? 0 : 1);
+  }
+  if (lf->len == 0) {
+    lf->first_write = now;
+  }
+  memcpy(lf->buf + lf->len, str, n);
+  lf->len += n;
+  lf->size += n;
+  if (lf->len >= lf->flush_bytes) {
+    return(log_flush(lf));
+  }
+  return(log_flush_due(lf, now));
+}
+
+
+/* FUNCTION to flush and close the log file */
+void log_close(struct logfile *lf)
+{
+  log_flush(lf);
+  if (lf->fd >= 0) {
+    close(lf->fd);
+    lf->fd = -1;
+  }
+}
@@ -0,0 +1,46 @@
+/*
+#################################################################################
+# logfile.h - Buffered log writer with persistent file descriptors             #
+#                                                                               #
+# The file stays open and writes are collected in a buffer that is flushed    #
+# when it holds flush_bytes or when flush_interval seconds have passed.        #
+# Optionally the file is rotated on size (to <file>.1, the older ones shift   #
+# to .2 .. .<keep>) or at the change of date (to <file>.YYYYMMDD).             #
+# log_reopen() is meant for SIGHUP handling.                                    #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#define LOG_BUF_SIZE 16384
+
+struct logfile {
+  char path[256];
+  int fd;
+  char buf[LOG_BUF_SIZE];
+  size_t len;               // bytes waiting in buf
+  size_t flush_bytes;       // flush when this many bytes are waiting (0=always)
+  int flush_interval;       // flush when the oldest data is this old (s)
+  time_t first_write;       // time the oldest waiting data was written
+  off_t size;               // size of the file incl. waiting bytes
+  off_t max_size;           // rotate when the file gets bigger (0=never)
+  int keep;                 // no. of files kept by size rotation (.1 .. .keep)
+  int rotate_daily;         // rotate at the change of date
+  int day;                  // date (yyyymmdd) of the data in the file
+};
+
+int log_open(struct logfile *lf, const char *path, size_t flush_bytes, int flush_interval);
+int log_write(struct logfile *lf, const char *str, time_t now);
+int log_flush_due(struct logfile *lf, time_t now);
+int log_flush(struct logfile *lf);
+int log_reopen(struct logfile *lf);
+void log_close(struct logfile *lf);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+#################################################################################
+# logtest.c - Test of the buffered log writer                                   #
+#                                                                               #
+# - the buffer: nothing is written before flush_bytes or flush_interval, then  #
+#   all of it                                                                   #
+# - rotation on size: past max_size the file moves to .1 and the older ones    #
+#   shift, KEEP files are kept and none is bigger than max_size; together      #
+#   they hold the newest lines without a gap                                    #
+# - rotation at the change of date: the file moves to .<yyyymmdd> of its data  #
+# - log_reopen() after the file was moved away: a new file is started         #
+# Usage: logtest. Exits with 1 when a check fails.                             #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "logfile.h"
+#include "testutil.h"
+
+#define KEEP 3
+#define LINE_LEN 100
+#define LINES_PER_FILE 10
+#define LINES 60
+
+static char dir[64];
+static char path[128];
+
+
+static long file_size(const char *name)
+{
+  struct stat st;
+
+  return(stat(name, &st) == 0 ? st.st_size : -1);
+}
+
+
+/* FUNCTION to write line no. i, LINE_LEN bytes */
+static int write_line(struct logfile *lf, int i, time_t now)
+{
+  char line[LINE_LEN + 1];
+
+  snprintf(line, sizeof(line), "%06d %-*s\n", i, LINE_LEN - 8, "x");
+  return(log_write(lf, line, now));
+}
+
+
+/* FUNCTION to check that a file holds the lines from first on, returns
+*  the no. after the last one or -1
+*/
+static int lines_from(const char *name, int first)
+{
+  char line[LINE_LEN + 2];
+  FILE *fp;
+  int i = first;
+
+  if ((fp = fopen(name, "r")) == NULL) {
+    return(-1);
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (atoi(line) != i++ || strlen(line) != LINE_LEN) {
+      i = -1;
+      break;
+    }
+  }
+  fclose(fp);
+  return(i);
+}
+
+
+static void test_buffer(void)
+{
+  struct logfile lf;
+  time_t now = 1000000;
+
+  unlink(path);
+  log_open(&lf, path, 4096, 60);
+  write_line(&lf, 0, now);
+  check(file_size(path) == 0, "buffer: nothing written yet", file_size(path), 0);
+  log_flush_due(&lf, now + 59);
+  check(file_size(path) == 0, "buffer: not before the interval", file_size(path), 0);
+  log_flush_due(&lf, now + 60);
+  check(file_size(path) == LINE_LEN, "buffer: written after the interval", file_size(path), LINE_LEN);
+  for (now += 61; file_size(path) == LINE_LEN && lf.len < 4096; now++) {
+    write_line(&lf, 1, now);
+  }
+  check(lf.len == 0 && file_size(path) == (4096 / LINE_LEN + 2) * LINE_LEN, "buffer: written at flush_bytes",
+        file_size(path), lf.len);
+  log_close(&lf);
+  unlink(path);
+}
+
+
+static void test_size(void)
+{
+  char name[160];
+  struct logfile lf;
+  time_t now = 1000000;
+  int i, next, bad = 0;
+
+  log_open(&lf, path, 0, 0);
+  lf.max_size = LINES_PER_FILE * LINE_LEN;
+  lf.keep = KEEP;
+  for (i = 0; i < LINES; i++) {
+    write_line(&lf, i, now);
+  }
+  log_close(&lf);
+  /* the newest lines: .KEEP .. .1 and the file itself */
+  next = LINES - (KEEP + 1) * LINES_PER_FILE;
+  for (i = KEEP; i >= 0 && next >= 0; i--) {
+    if (i > 0) {
+      snprintf(name, sizeof(name), "%s.%d", path, i);
+    } else {
+      snprintf(name, sizeof(name), "%s", path);
+    }
+    if (file_size(name) != LINES_PER_FILE * LINE_LEN) {
+      bad++;
+    }
+    next = lines_from(name, next);
+  }
+  check(next == LINES, "size: newest lines in .3 .2 .1 and the file", next, LINES);
+  check(bad == 0, "size: files not bigger than max_size", bad, 0);
+  snprintf(name, sizeof(name), "%s.%d", path, KEEP + 1);
+  check(file_size(name) == -1, "size: no more than KEEP files", file_size(name), -1);
+  for (i = 1; i <= KEEP; i++) {
+    snprintf(name, sizeof(name), "%s.%d", path, i);
+    unlink(name);
+  }
+  unlink(path);
+}
+
+
+static void test_date_reopen(void)
+{
+  char name[160], moved[160];
+  struct logfile lf;
+  struct tm tm;
+  time_t day1, day2;
+
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = 2026 - 1900;
+  tm.tm_mon = 9;
+  tm.tm_mday = 16;
+  tm.tm_hour = 23;
+  tm.tm_min = 59;
+  tm.tm_isdst = -1;
+  day1 = mktime(&tm);
+  day2 = day1 + 120;
+
+  log_open(&lf, path, 0, 0);
+  lf.rotate_daily = 1;
+  write_line(&lf, 0, day1);
+  write_line(&lf, 1, day1 + 30);
+  write_line(&lf, 2, day2);
+  snprintf(name, sizeof(name), "%s.20261016", path);
+  check(lines_from(name, 0) == 2 && lines_from(path, 2) == 3, "date: the lines of the day before moved",
+        lines_from(name, 0), lines_from(path, 2));
+
+  snprintf(moved, sizeof(moved), "%s.moved", path);
+  rename(path, moved);
+  log_reopen(&lf);
+  write_line(&lf, 3, day2);
+  log_close(&lf);
+  check(lines_from(moved, 2) == 3 && lines_from(path, 3) == 4, "reopen: a new file after a move",
+        lines_from(moved, 2), lines_from(path, 3));
+  unlink(name);
+  unlink(moved);
+  unlink(path);
+}
+
+
+int main(void)
+{
+  setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+  tzset();
+  snprintf(dir, sizeof(dir), "/tmp/logtest.%d", (int)getpid());
+  mkdir(dir, 0755);
+  snprintf(path, sizeof(path), "%s/jnread_jos.log", dir);
+
+  test_buffer();
+  test_size();
+  test_date_reopen();
+
+  rmdir(dir);
+  return(test_failed);
+}
@@ -0,0 +1,305 @@
+/*
+#################################################################################
+# metrics.c - Counters of jnread and the stats endpoint                         #
+#                                                                               #
+# See metrics.h for the interface.                                              #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metrics.h"
+#include "httpd.h"
+#include "timing.h"
+#include "domoticz.h"
+#include "udp.h"
+#include "mqtt.h"
+#include "tsdb.h"
+#include "sse.h"
+#include "dedup.h"
+
+#define N_TYPES (sizeof(MSG_TYPES) - 1)
+#define GET(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#define INC(var) __atomic_store_n(&(var), GET(var) + 1, __ATOMIC_RELAXED)
+
+/* the reasons of parse errors, PARSE_MISSING..PARSE_RANGE */
+#define N_REASONS 3
+static const char *reason_name[N_REASONS] = { "missing", "syntax", "range" };
+
+/* written by the main loop only, read by the http thread */
+static unsigned long messages[N_TYPES];
+static unsigned long parse_errors[N_TYPES][N_REASONS];
+static unsigned long ignored;       // lines that are not a known message
+static const struct serial *usb;
+static int n_usb = 0;
+static const char *queue_name[METRICS_QUEUES];
+static const struct spsc *queue[METRICS_QUEUES];
+static int n_queues = 0;
+static long start_ns;
+
+
+/* FUNCTION to count a message with the result of parse_line(),
+*  returns 0 when the message can be used, 1 when it has to be skipped
+*/
+int metrics_message(char type, int result)
+{
+  const char *p;
+  int i;
+
+  if (result == PARSE_UNKNOWN || type == '\0' || (p = strchr(MSG_TYPES, type)) == NULL) {
+    INC(ignored);
+    return(1);
+  }
+  i = p - MSG_TYPES;
+  if (result != PARSE_OK) {
+    INC(parse_errors[i][result - PARSE_MISSING]);
+    return(1);
+  }
+  INC(messages[i]);
+  return(0);
+}
+
+
+static void summary(struct httpd_resp *resp, const char *name, const char *help, int stage)
+{
+  const struct histogram *h = &stage_hist[stage];
+
+  httpd_printf(resp, "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+  httpd_printf(resp, "%s{quantile=\"0.5\"} %.9f\n", name, timing_percentile(h, 50) / 1e9);
+  httpd_printf(resp, "%s{quantile=\"0.99\"} %.9f\n", name, timing_percentile(h, 99) / 1e9);
+  httpd_printf(resp, "%s_sum %.9f\n%s_count %lu\n", name, GET(h->sum) / 1e9, name, GET(h->count));
+}
+
+
+/* FUNCTION to serve /metrics in the Prometheus text format */
+static void get_metrics(const struct httpd_req *req, struct httpd_resp *resp)
+{
+  struct dz_stats dz;
+  struct udp_stats udp;
+  struct mqtt_stats mq;
+  struct tsdb_stats ts;
+  struct sse_stats live;
+  struct dedup_stats gw;
+  unsigned int i, j;
+
+  resp->content_type = "text/plain; version=0.0.4; charset=utf-8";
+
+  summary(resp, "jnread_read_seconds", "Time waiting for and reading a line from the JeeNode.", ST_READ);
+  summary(resp, "jnread_line_seconds", "Time processing one line in the processing thread.", ST_LINE);
+  summary(resp, "jnread_latency_seconds", "Time from reading a line until it is processed.", ST_LATENCY);
+  httpd_printf(resp, "# HELP jnread_stage_seconds Time per stage of processing a line or sink.\n"
+  "# TYPE jnread_stage_seconds summary\n");
+  for (i = ST_PARSE; i < ST_LATENCY; i++) {
+    const struct histogram *h = &stage_hist[i];
+
+    httpd_printf(resp, "jnread_stage_seconds{stage=\"%s\",quantile=\"0.5\"} %.9f\n",
+    stage_name[i], timing_percentile(h, 50) / 1e9);
+    httpd_printf(resp, "jnread_stage_seconds{stage=\"%s\",quantile=\"0.99\"} %.9f\n",
+    stage_name[i], timing_percentile(h, 99) / 1e9);
+    httpd_printf(resp, "jnread_stage_seconds_sum{stage=\"%s\"} %.9f\n", stage_name[i], GET(h->sum) / 1e9);
+    httpd_printf(resp, "jnread_stage_seconds_count{stage=\"%s\"} %lu\n", stage_name[i], GET(h->count));
+  }
+
+  httpd_printf(resp, "# HELP jnread_messages_total Messages processed per type.\n"
+  "# TYPE jnread_messages_total counter\n");
+  for (i = 0; i < N_TYPES; i++) {
+    httpd_printf(resp, "jnread_messages_total{type=\"%c\"} %lu\n", MSG_TYPES[i], GET(messages[i]));
+  }
+  httpd_printf(resp, "# HELP jnread_parse_errors_total Malformed messages skipped, per type and reason.\n"
+  "# TYPE jnread_parse_errors_total counter\n");
+  for (i = 0; i < N_TYPES; i++) {
+    for (j = 0; j < N_REASONS; j++) {
+      httpd_printf(resp, "jnread_parse_errors_total{type=\"%c\",reason=\"%s\"} %lu\n",
+      MSG_TYPES[i], reason_name[j], GET(parse_errors[i][j]));
+    }
+  }
+  httpd_printf(resp, "# HELP jnread_ignored_lines_total Lines that are not a known message.\n"
+  "# TYPE jnread_ignored_lines_total counter\njnread_ignored_lines_total %lu\n", GET(ignored));
+
+  httpd_printf(resp, "# HELP jnread_queue_depth Items waiting in a queue between threads.\n"
+  "# TYPE jnread_queue_depth gauge\n");
+  for (i = 0; i < (unsigned int)n_queues; i++) {
+    httpd_printf(resp, "jnread_queue_depth{queue=\"%s\"} %u\n", queue_name[i], spsc_depth(queue[i]));
+  }
+  httpd_printf(resp, "# HELP jnread_queue_items_total Items put in a queue.\n"
+  "# TYPE jnread_queue_items_total counter\n");
+  for (i = 0; i < (unsigned int)n_queues; i++) {
+    httpd_printf(resp, "jnread_queue_items_total{queue=\"%s\"} %lu\n", queue_name[i], GET(queue[i]->pushed));
+  }
+  httpd_printf(resp, "# HELP jnread_queue_full_total Times a queue was found full.\n"
+  "# TYPE jnread_queue_full_total counter\n");
+  for (i = 0; i < (unsigned int)n_queues; i++) {
+    httpd_printf(resp, "jnread_queue_full_total{queue=\"%s\"} %lu\n", queue_name[i], GET(queue[i]->full));
+  }
+  httpd_printf(resp, "# HELP jnread_queue_dropped_total Items dropped because a queue was full.\n"
+  "# TYPE jnread_queue_dropped_total counter\n");
+  for (i = 0; i < (unsigned int)n_queues; i++) {
+    httpd_printf(resp, "jnread_queue_dropped_total{queue=\"%s\"} %lu\n", queue_name[i], GET(queue[i]->dropped));
+  }
+
+  if (n_usb > 0) {
+    httpd_printf(resp, "# HELP jnread_usb_bytes_total Bytes read from the JeeNode.\n"
+    "# TYPE jnread_usb_bytes_total counter\n");
+    for (i = 0; i < (unsigned int)n_usb; i++) {
+      httpd_printf(resp, "jnread_usb_bytes_total{port=\"%s\"} %lu\n", usb[i].device, GET(usb[i].bytes));
+    }
+    httpd_printf(resp, "# HELP jnread_usb_lines_total Lines read from the JeeNode.\n"
+    "# TYPE jnread_usb_lines_total counter\n");
+    for (i = 0; i < (unsigned int)n_usb; i++) {
+      httpd_printf(resp, "jnread_usb_lines_total{port=\"%s\"} %lu\n", usb[i].device, GET(usb[i].lines));
+    }
+    httpd_printf(resp, "# HELP jnread_usb_too_long_total Lines discarded because they were too long.\n"
+    "# TYPE jnread_usb_too_long_total counter\n");
+    for (i = 0; i < (unsigned int)n_usb; i++) {
+      httpd_printf(resp, "jnread_usb_too_long_total{port=\"%s\"} %lu\n", usb[i].device, GET(usb[i].too_long));
+    }
+    httpd_printf(resp, "# HELP jnread_usb_frames_total Binary frames per result.\n"
+    "# TYPE jnread_usb_frames_total counter\n");
+    for (i = 0; i < (unsigned int)n_usb; i++) {
+      httpd_printf(resp, "jnread_usb_frames_total{port=\"%s\",result=\"ok\"} %lu\n", usb[i].device, GET(usb[i].frames));
+      httpd_printf(resp, "jnread_usb_frames_total{port=\"%s\",result=\"bad\"} %lu\n", usb[i].device, GET(usb[i].bad_frames));
+    }
+    httpd_printf(resp, "# HELP jnread_usb_broken_lines_total Lines cut off by a binary frame.\n"
+    "# TYPE jnread_usb_broken_lines_total counter\n");
+    for (i = 0; i < (unsigned int)n_usb; i++) {
+      httpd_printf(resp, "jnread_usb_broken_lines_total{port=\"%s\"} %lu\n", usb[i].device, GET(usb[i].broken));
+    }
+    httpd_printf(resp, "# HELP jnread_usb_reconnects_total Times the port was reopened.\n"
+    "# TYPE jnread_usb_reconnects_total counter\n");
+    for (i = 0; i < (unsigned int)n_usb; i++) {
+      httpd_printf(resp, "jnread_usb_reconnects_total{port=\"%s\"} %lu\n", usb[i].device, GET(usb[i].reconnects));
+    }
+    httpd_printf(resp, "# HELP jnread_gateway_readings_total Readings per gateway (port): first (used), duplicate or missed.\n"
+    "# TYPE jnread_gateway_readings_total counter\n");
+    for (i = 0; i < (unsigned int)n_usb; i++) {
+      dedup_get_stats(i, &gw);
+      httpd_printf(resp, "jnread_gateway_readings_total{port=\"%s\",result=\"first\"} %lu\n", usb[i].device, gw.first);
+      httpd_printf(resp, "jnread_gateway_readings_total{port=\"%s\",result=\"duplicate\"} %lu\n", usb[i].device, gw.duplicates);
+      httpd_printf(resp, "jnread_gateway_readings_total{port=\"%s\",result=\"missed\"} %lu\n", usb[i].device, gw.missed);
+    }
+  }
+
+  domoticz_get_stats(&dz);
+  httpd_printf(resp, "# HELP jnread_domoticz_updates_total Domoticz updates per result.\n"
+  "# TYPE jnread_domoticz_updates_total counter\n");
+  httpd_printf(resp, "jnread_domoticz_updates_total{result=\"queued\"} %lu\n", dz.queued);
+  httpd_printf(resp, "jnread_domoticz_updates_total{result=\"sent\"} %lu\n", dz.sent);
+  httpd_printf(resp, "jnread_domoticz_updates_total{result=\"coalesced\"} %lu\n", dz.coalesced);
+  httpd_printf(resp, "jnread_domoticz_updates_total{result=\"dropped\"} %lu\n", dz.dropped);
+  httpd_printf(resp, "jnread_domoticz_updates_total{result=\"failed\"} %lu\n", dz.failed);
+  httpd_printf(resp, "# HELP jnread_domoticz_connects_total Connections made to Domoticz.\n"
+  "# TYPE jnread_domoticz_connects_total counter\njnread_domoticz_connects_total %lu\n", dz.connects);
+  httpd_printf(resp, "# HELP jnread_domoticz_queue_depth Updates waiting to be sent.\n"
+  "# TYPE jnread_domoticz_queue_depth gauge\njnread_domoticz_queue_depth %d\n", dz.depth);
+
+  udp_get_stats(&udp);
+  httpd_printf(resp, "# HELP jnread_udp_lines_total Line protocol lines exported.\n"
+  "# TYPE jnread_udp_lines_total counter\njnread_udp_lines_total %lu\n", udp.lines);
+  httpd_printf(resp, "# HELP jnread_udp_datagrams_total Datagrams per result.\n"
+  "# TYPE jnread_udp_datagrams_total counter\n");
+  httpd_printf(resp, "jnread_udp_datagrams_total{result=\"sent\"} %lu\n", udp.datagrams);
+  httpd_printf(resp, "jnread_udp_datagrams_total{result=\"failed\"} %lu\n", udp.failed);
+
+  mqtt_get_stats(&mq);
+  httpd_printf(resp, "# HELP jnread_mqtt_messages_total MQTT messages per result.\n"
+  "# TYPE jnread_mqtt_messages_total counter\n");
+  httpd_printf(resp, "jnread_mqtt_messages_total{result=\"published\"} %lu\n", mq.published);
+  httpd_printf(resp, "jnread_mqtt_messages_total{result=\"dropped\"} %lu\n", mq.dropped);
+  httpd_printf(resp, "# HELP jnread_mqtt_connects_total Connections made to the MQTT broker.\n"
+  "# TYPE jnread_mqtt_connects_total counter\njnread_mqtt_connects_total %lu\n", mq.connects);
+
+  tsdb_get_stats(&ts);
+  httpd_printf(resp, "# HELP jnread_history_samples_total Samples for the history per result.\n"
+  "# TYPE jnread_history_samples_total counter\n");
+  httpd_printf(resp, "jnread_history_samples_total{result=\"stored\"} %lu\n", ts.samples);
+  httpd_printf(resp, "jnread_history_samples_total{result=\"rejected\"} %lu\n", ts.rejected);
+  httpd_printf(resp, "# HELP jnread_history_blocks_total Blocks written to the history per result.\n"
+  "# TYPE jnread_history_blocks_total counter\n");
+  httpd_printf(resp, "jnread_history_blocks_total{result=\"written\"} %lu\n", ts.blocks);
+  httpd_printf(resp, "jnread_history_blocks_total{result=\"failed\"} %lu\n", ts.failed);
+  httpd_printf(resp, "# HELP jnread_history_bytes_total Bytes written to the history.\n"
+  "# TYPE jnread_history_bytes_total counter\njnread_history_bytes_total %lu\n", ts.bytes);
+
+  sse_get_stats(&live);
+  httpd_printf(resp, "# HELP jnread_live_clients Clients of the live stream now.\n"
+  "# TYPE jnread_live_clients gauge\njnread_live_clients %lu\n", live.clients);
+  httpd_printf(resp, "# HELP jnread_live_connects_total Live streams per result.\n"
+  "# TYPE jnread_live_connects_total counter\n");
+  httpd_printf(resp, "jnread_live_connects_total{result=\"started\"} %lu\n", live.connects);
+  httpd_printf(resp, "jnread_live_connects_total{result=\"rejected\"} %lu\n", live.rejected);
+  httpd_printf(resp, "jnread_live_connects_total{result=\"lagged\"} %lu\n", live.lagged);
+  httpd_printf(resp, "# HELP jnread_live_events_total Events sent to the live stream.\n"
+  "# TYPE jnread_live_events_total counter\njnread_live_events_total %lu\n", live.events);
+}
+
+
+/* FUNCTION to print the timings and the messages per type */
+void metrics_report(FILE *fp, long lines, double secs)
+{
+  unsigned int i;
+
+  timing_report(fp, lines, secs);
+  fprintf(fp, "%-12s %10s %10s %10s %10s\n", "type", "messages", reason_name[0], reason_name[1], reason_name[2]);
+  for (i = 0; i < N_TYPES; i++) {
+    fprintf(fp, "%-12c %10lu %10lu %10lu %10lu\n", MSG_TYPES[i], GET(messages[i]),
+    GET(parse_errors[i][0]), GET(parse_errors[i][1]), GET(parse_errors[i][2]));
+  }
+  fprintf(fp, "%-12s %10lu\n", "ignored", GET(ignored));
+  fprintf(fp, "%-12s %10s %10s %10s %10s\n", "queue", "depth", "items", "full", "dropped");
+  for (i = 0; i < (unsigned int)n_queues; i++) {
+    fprintf(fp, "%-12s %10u %10lu %10lu %10lu\n", queue_name[i], spsc_depth(queue[i]),
+    GET(queue[i]->pushed), GET(queue[i]->full), GET(queue[i]->dropped));
+  }
+}
+
+
+/* FUNCTION to add a queue to the statistics, returns 1 when there is no
+*  room for it (METRICS_QUEUES)
+*/
+int metrics_add_queue(const char *name, const struct spsc *q)
+{
+  if (n_queues == METRICS_QUEUES) {
+    return(1);
+  }
+  queue_name[n_queues] = name;
+  queue[n_queues] = q;
+  n_queues++;
+  return(0);
+}
+
+
+/* FUNCTION to serve / as a readable report */
+static void get_report(const struct httpd_req *req, struct httpd_resp *resp)
+{
+  char *text = NULL;
+  size_t size = 0;
+  FILE *fp;
+
+  if ((fp = open_memstream(&text, &size)) == NULL) {
+    resp->status = 500;
+    return;
+  }
+  metrics_report(fp, GET(stage_hist[ST_LINE].count), (timing_now() - start_ns) / 1e9);
+  fclose(fp);
+  httpd_printf(resp, "%s", text);
+  free(text);
+}
+
+
+/* FUNCTION to start the stats endpoint on addr:port, with the statistics of
+*  the n ports in sp
+*/
+int metrics_start(const char *addr, int port, const struct serial *sp, int n)
+{
+  usb = sp;
+  n_usb = n;
+  start_ns = timing_now();
+  httpd_route("/metrics", get_metrics);
+  httpd_route("/", get_report);
+  return(httpd_start(addr, port));
+}
@@ -0,0 +1,31 @@
+/*
+#################################################################################
+# metrics.h - Counters of jnread and the stats endpoint                         #
+#                                                                               #
+# Counts the messages per type and the malformed lines per reason, and       #
+# serves these with the stage timings, queue, USB and Domoticz statistics:    #
+#   /metrics  Prometheus text format                                            #
+#   /         readable report (like --bench prints at the end)                 #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+#include "serial.h"
+#include "spsc.h"
+#include "parse.h"
+
+#define METRICS_QUEUES 16     /* lines, log, checkpoint and every output */
+
+int metrics_message(char type, int result);
+void metrics_report(FILE *fp, long lines, double secs);
+int metrics_add_queue(const char *name, const struct spsc *q);
+int metrics_start(const char *addr, int port, const struct serial *sp, int n);
+
+#endif
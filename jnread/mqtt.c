@@ -0,0 +1,308 @@
+/*
+#################################################################################
+# mqtt.c - Minimal MQTT 3.1.1 publisher                                        #
+#                                                                               #
+# See mqtt.h for the interface.                                                 #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "mqtt.h"
+
+/* packet types (first byte) */
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PINGREQ 0xc0
+#define MQTT_DISCONNECT 0xe0
+
+static char host[128];
+static char port[16];
+static char client[24];
+static int sock = -1;
+static time_t next_connect = 0;
+static time_t last_write = 0;
+static unsigned char buf[MQTT_BUF_SIZE];
+static size_t len = 0;
+static unsigned long pending = 0;   // messages in buf
+static struct mqtt_stats stats;
+
+#define ADD(var, n) __atomic_store_n(&(var), (var) + (n), __ATOMIC_RELAXED)
+
+
+static void mqtt_disconnect(void)
+{
+  if (sock >= 0) {
+    close(sock);
+    sock = -1;
+  }
+}
+
+
+/* FUNCTION to wait until the socket is ready, returns 0 when ready */
+static int mqtt_wait(short events)
+{
+  struct pollfd pfd;
+  int rc;
+
+  pfd.fd = sock;
+  pfd.events = events;
+  do {
+    rc = poll(&pfd, 1, MQTT_TIMEOUT_MS);
+  } while (rc < 0 && errno == EINTR);
+  return(rc <= 0);
+}
+
+
+/* FUNCTION to write a complete buffer, returns 0 when written */
+static int mqtt_write(const unsigned char *p, size_t n)
+{
+  ssize_t done;
+
+  while (n > 0) {
+    done = send(sock, p, n, MSG_NOSIGNAL);
+    if (done < 0 && (errno == EAGAIN || errno == EINTR)) {
+      if (mqtt_wait(POLLOUT) != 0) {
+        return(1);
+      }
+      continue;
+    }
+    if (done <= 0) {
+      return(1);
+    }
+    p += done;
+    n -= done;
+  }
+  last_write = time(NULL);
+  return(0);
+}
+
+
+/* FUNCTION to encode the remaining length, returns the no. of bytes */
+static int mqtt_length(unsigned char *p, size_t n)
+{
+  int i = 0;
+
+  do {
+    p[i] = n % 128;
+    n /= 128;
+    if (n > 0) {
+      p[i] |= 0x80;
+    }
+    i++;
+  } while (n > 0);
+  return(i);
+}
+
+
+/* FUNCTION to read and ignore what the broker sent (PINGRESP),
+*  returns 1 when the connection was closed
+*/
+static int mqtt_drain(void)
+{
+  unsigned char in[256];
+  ssize_t n;
+
+  while ((n = recv(sock, in, sizeof(in), MSG_DONTWAIT)) > 0);
+  if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+    mqtt_disconnect();
+    return(1);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to connect and send CONNECT, returns 0 when accepted */
+static int mqtt_connect(void)
+{
+  struct addrinfo hints, *res, *ai;
+  unsigned char pkt[64], ack[4];
+  size_t clen = strlen(client);
+  int err, n, got = 0;
+  socklen_t elen = sizeof(err);
+
+  if (sock >= 0) {
+    return(0);
+  }
+  if (time(NULL) < next_connect) {
+    return(1);
+  }
+  next_connect = time(NULL) + MQTT_RETRY_WAIT;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, port, &hints, &res) != 0) {
+    return(1);
+  }
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    if ((sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)) < 0) {
+      continue;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    if (errno == EINPROGRESS && mqtt_wait(POLLOUT) == 0 &&
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &elen) == 0 && err == 0) {
+      break;
+    }
+    mqtt_disconnect();
+  }
+  freeaddrinfo(res);
+  if (sock < 0) {
+    return(1);
+  }
+
+  /* CONNECT: protocol "MQTT" level 4, clean session, keep alive, client id */
+  n = 0;
+  pkt[n++] = MQTT_CONNECT;
+  pkt[n++] = 12 + clen;
+  memcpy(pkt + n, "\0\4MQTT\4\2", 8);
+  n += 8;
+  pkt[n++] = MQTT_KEEPALIVE >> 8;
+  pkt[n++] = MQTT_KEEPALIVE & 0xff;
+  pkt[n++] = clen >> 8;
+  pkt[n++] = clen & 0xff;
+  memcpy(pkt + n, client, clen);
+  n += clen;
+  if (mqtt_write(pkt, n) != 0) {
+    mqtt_disconnect();
+    return(1);
+  }
+  /* CONNACK: 0x20 2 <flags> <return code> */
+  while (got < 4) {
+    ssize_t r;
+
+    if (mqtt_wait(POLLIN) != 0 || (r = recv(sock, ack + got, 4 - got, 0)) <= 0) {
+      mqtt_disconnect();
+      return(1);
+    }
+    got += r;
+  }
+  if (ack[0] != MQTT_CONNACK || ack[3] != 0) {
+    fprintf(stderr, "MQTT broker %s:%s refused the connection (%d)\n", host, port, ack[3]);
+    mqtt_disconnect();
+    return(1);
+  }
+  ADD(stats.connects, 1);
+  return(0);
+}
+
+
+/* FUNCTION to set the broker "host:port" (port 1883 when not given) and the
+*  client id, the connection is made by the first flush
+*/
+int mqtt_open(const char *broker, const char *client_id)
+{
+  const char *colon;
+
+  if (broker[0] == '\0') {
+    return(1);
+  }
+  if ((colon = strrchr(broker, ':')) != NULL) {
+    snprintf(host, sizeof(host), "%.*s", (int)(colon - broker), broker);
+    snprintf(port, sizeof(port), "%s", colon + 1);
+  } else {
+    snprintf(host, sizeof(host), "%s", broker);
+    snprintf(port, sizeof(port), "1883");
+  }
+  snprintf(client, sizeof(client), "%s", client_id);
+  len = 0;
+  pending = 0;
+  next_connect = 0;
+  return(0);
+}
+
+
+/* FUNCTION to add a PUBLISH (QoS 0) to the buffer, returns 1 when the
+*  message does not fit
+*/
+int mqtt_publish(const char *topic, const char *payload, int retain)
+{
+  size_t tlen = strlen(topic), plen = strlen(payload), rem = 2 + tlen + plen;
+
+  if (1 + 4 + rem > sizeof(buf)) {
+    return(1);
+  }
+  if (len + 1 + 4 + rem > sizeof(buf)) {
+    mqtt_flush();
+  }
+  buf[len++] = MQTT_PUBLISH | (retain ? 1 : 0);
+  len += mqtt_length(buf + len, rem);
+  buf[len++] = tlen >> 8;
+  buf[len++] = tlen & 0xff;
+  memcpy(buf + len, topic, tlen);
+  len += tlen;
+  memcpy(buf + len, payload, plen);
+  len += plen;
+  pending++;
+  return(0);
+}
+
+
+/* FUNCTION to write the buffer to the broker, dropped when not connected */
+void mqtt_flush(void)
+{
+  if (len == 0) {
+    return;
+  }
+  /* a connection the broker closed meanwhile is made again right away */
+  if (sock >= 0 && mqtt_drain() != 0) {
+    next_connect = 0;
+  }
+  if (mqtt_connect() == 0 && mqtt_write(buf, len) == 0) {
+    ADD(stats.published, pending);
+  } else {
+    mqtt_disconnect();
+    ADD(stats.dropped, pending);
+  }
+  len = 0;
+  pending = 0;
+}
+
+
+/* FUNCTION to keep the connection alive, call it regularly */
+void mqtt_idle(void)
+{
+  unsigned char ping[2] = { MQTT_PINGREQ, 0 };
+
+  mqtt_flush();
+  if (sock < 0 || mqtt_drain() != 0) {
+    return;
+  }
+  if (time(NULL) - last_write >= MQTT_KEEPALIVE / 2 && mqtt_write(ping, 2) != 0) {
+    mqtt_disconnect();
+  }
+}
+
+
+void mqtt_get_stats(struct mqtt_stats *st)
+{
+  __atomic_load(&stats.published, &st->published, __ATOMIC_RELAXED);
+  __atomic_load(&stats.dropped, &st->dropped, __ATOMIC_RELAXED);
+  __atomic_load(&stats.connects, &st->connects, __ATOMIC_RELAXED);
+}
+
+
+void mqtt_close(void)
+{
+  unsigned char bye[2] = { MQTT_DISCONNECT, 0 };
+
+  mqtt_flush();
+  if (sock >= 0) {
+    mqtt_write(bye, 2);
+    mqtt_disconnect();
+  }
+}
@@ -0,0 +1,40 @@
+/*
+#################################################################################
+# mqtt.h - Minimal MQTT 3.1.1 publisher                                        #
+#                                                                               #
+# Publishes with QoS 0 to a broker (e.g. mosquitto). The PUBLISH packets are  #
+# collected in a buffer and written at once by mqtt_flush(). The connection   #
+# is made when needed and kept alive with PINGREQ. While the broker can not   #
+# be reached the packets are dropped (and counted). Only used from one thread. #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef MQTT_H
+#define MQTT_H
+
+#define MQTT_BUF_SIZE 8192      /* buffer for the packets to be written */
+#ifndef MQTT_KEEPALIVE          /* both shorter in outtest */
+#define MQTT_KEEPALIVE 60       /* keep alive (s) asked from the broker */
+#endif
+#define MQTT_TIMEOUT_MS 5000    /* max. wait for connect, CONNACK or a write */
+#ifndef MQTT_RETRY_WAIT
+#define MQTT_RETRY_WAIT 10      /* wait (s) after a failed connect */
+#endif
+
+struct mqtt_stats {
+  unsigned long published;  // messages written to the broker
+  unsigned long dropped;    // messages dropped (no connection)
+  unsigned long connects;   // connections made
+};
+
+int mqtt_open(const char *broker, const char *client_id);
+int mqtt_publish(const char *topic, const char *payload, int retain);
+void mqtt_flush(void);
+void mqtt_idle(void);
+void mqtt_get_stats(struct mqtt_stats *st);
+void mqtt_close(void);
+
+#endif
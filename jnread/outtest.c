@@ -0,0 +1,504 @@
+/*
+#################################################################################
+# outtest.c - Test of the UDP and MQTT exports                                  #
+#                                                                               #
+# Listens on 127.0.0.1 for UDP and runs a stub MQTT broker in a thread:         #
+# - udp.c: the lines are sent per datagram, a datagram when the next line does  #
+#   not fit and when flushed, no line split over two datagrams                  #
+# - mqtt.c: nothing written before the flush, CONNECT, the retain flag, the     #
+#   remaining length in 1 and 2 bytes, a flush when the buffer is full,         #
+#   PINGREQ after half the keep alive, a reconnect when the broker closed the   #
+#   connection, no connect within MQTT_RETRY_WAIT after a refused one,          #
+#   DISCONNECT at the close                                                     #
+# - the outputs of jnread: a log is replayed by ./jnread with --udp and --mqtt, #
+#   every series of it arrives as a line and as a retained topic, under the     #
+#   mqtt_topic of the config file                                               #
+# mqtt.c is built with a short MQTT_KEEPALIVE and MQTT_RETRY_WAIT for this.     #
+# Usage: outtest. Exits with 1 when a check fails. Takes about 5 s.             #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "udp.h"
+#include "mqtt.h"
+#include "testutil.h"
+
+#define STUB_PACKETS 64
+#define PAYLOAD_MAX 4096
+
+struct packet {
+  unsigned char type;       // first byte, with the flags
+  int lenbytes;             // bytes of the remaining length
+  int rem;                  // remaining length
+  char topic[64];           // PUBLISH only
+  int plen;
+  char payload[PAYLOAD_MAX];
+};
+
+/* what the stub broker saw */
+static struct {
+  volatile int fd;          // the connection, -1 when none
+  volatile int accepts;     // connections accepted
+  volatile int n;           // packets received
+  volatile int refuse;      // answer CONNECT with "not authorized"
+  volatile int hangup;      // close the connection
+  volatile int stop;
+  int level, flags, keepalive;
+  char client[24];          // of the last CONNECT
+  struct packet pk[STUB_PACKETS];
+} stub;
+
+
+static void stub_send(const unsigned char *p, size_t n)
+{
+  if (send(stub.fd, p, n, MSG_NOSIGNAL) < 0) {
+    perror("stub send");
+  }
+}
+
+
+/* FUNCTION to record and answer a complete packet, returns its length or 0
+*  when it is not complete yet
+*/
+static int stub_packet(const unsigned char *p, int have)
+{
+  unsigned char connack[4] = { 0x20, 2, 0, 0 }, pingresp[2] = { 0xd0, 0 };
+  struct packet *pk = &stub.pk[stub.n < STUB_PACKETS ? stub.n : STUB_PACKETS - 1];
+  const unsigned char *body;
+  int rem = 0, mul = 1, i = 1, clen;
+
+  do {
+    if (i >= have) {
+      return(0);
+    }
+    rem += (p[i] & 0x7f) * mul;
+    mul *= 128;
+  } while (p[i++] & 0x80);
+  if (i + rem > have) {
+    return(0);
+  }
+  body = p + i;
+  memset(pk, 0, sizeof(*pk));
+  pk->type = p[0];
+  pk->lenbytes = i - 1;
+  pk->rem = rem;
+  switch (p[0] & 0xf0) {
+  case 0x10:
+    /* "\0\4MQTT" <level> <flags> <keep alive> <client id length> <client id> */
+    stub.level = body[6];
+    stub.flags = body[7];
+    stub.keepalive = body[8] << 8 | body[9];
+    clen = body[10] << 8 | body[11];
+    snprintf(stub.client, sizeof(stub.client), "%.*s", clen, body + 12);
+    connack[3] = stub.refuse ? 5 : 0;
+    stub_send(connack, 4);
+    break;
+  case 0x30:
+    clen = body[0] << 8 | body[1];
+    snprintf(pk->topic, sizeof(pk->topic), "%.*s", clen, body + 2);
+    pk->plen = rem - 2 - clen;
+    snprintf(pk->payload, sizeof(pk->payload), "%.*s", pk->plen, body + 2 + clen);
+    break;
+  case 0xc0:
+    stub_send(pingresp, 2);
+    break;
+  }
+  stub.n++;
+  return(i + rem);
+}
+
+
+static void *stub_broker(void *arg)
+{
+  static unsigned char in[2 * MQTT_BUF_SIZE];
+  struct pollfd pfd;
+  int lfd = *(int *)arg, have = 0, n;
+
+  while (!stub.stop) {
+    if (stub.hangup) {
+      if (stub.fd >= 0) {
+        close(stub.fd);
+        stub.fd = -1;
+      }
+      stub.hangup = 0;
+    }
+    pfd.fd = stub.fd >= 0 ? stub.fd : lfd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 50) <= 0) {
+      continue;
+    }
+    if (stub.fd < 0) {
+      if ((stub.fd = accept(lfd, NULL, NULL)) >= 0) {
+        stub.accepts++;
+        have = 0;
+      }
+      continue;
+    }
+    if ((n = recv(stub.fd, in + have, sizeof(in) - have, 0)) <= 0) {
+      close(stub.fd);
+      stub.fd = -1;
+      continue;
+    }
+    have += n;
+    while ((n = stub_packet(in, have)) > 0) {
+      memmove(in, in + n, have - n);
+      have -= n;
+    }
+  }
+  if (stub.fd >= 0) {
+    close(stub.fd);
+  }
+  return(NULL);
+}
+
+
+/* FUNCTION to wait at most 2 s until the broker has n packets */
+static void wait_packets(int n)
+{
+  int i;
+
+  for (i = 0; i < 200 && stub.n < n; i++) {
+    pause_ms(10);
+  }
+}
+
+
+/* FUNCTION to let the broker close the connection and wait until it did */
+static void stub_hangup(void)
+{
+  int i;
+
+  stub.hangup = 1;
+  for (i = 0; i < 200 && stub.hangup; i++) {
+    pause_ms(10);
+  }
+  pause_ms(50);
+}
+
+
+/* FUNCTION to find a PUBLISH by its topic, NULL when not there */
+static const struct packet *published(const char *topic)
+{
+  int i;
+
+  for (i = 0; i < stub.n && i < STUB_PACKETS; i++) {
+    if ((stub.pk[i].type & 0xf0) == 0x30 && strcmp(stub.pk[i].topic, topic) == 0) {
+      return(&stub.pk[i]);
+    }
+  }
+  return(NULL);
+}
+
+
+/* FUNCTION to read the datagrams waiting, returns the no. of datagrams */
+static int receive(int ufd, char *text, size_t size, int *bad)
+{
+  size_t have = 0;
+  ssize_t n;
+  int count = 0;
+
+  text[0] = '\0';
+  while ((n = recv(ufd, text + have, size - 1 - have, MSG_DONTWAIT)) > 0) {
+    if (n > UDP_DATAGRAM || text[have + n - 1] != '\n') {
+      (*bad)++;
+    }
+    have += n;
+    text[have] = '\0';
+    count++;
+  }
+  return(count);
+}
+
+
+static int lines(const char *text)
+{
+  int n = 0;
+
+  for (; *text != '\0'; text++) {
+    n += (*text == '\n');
+  }
+  return(n);
+}
+
+
+static void test_udp(int ufd, const char *addr)
+{
+  static char text[8 * UDP_DATAGRAM];
+  struct udp_stats st;
+  int i, n, bad = 0;
+
+  check(udp_open(addr) == 0, "udp: opened", 0, 0);
+  udp_line("jnread,type=%c %s=%d %ld000000000", 'e', "electricity_power", 2607, 1792152000L);
+  udp_line("jnread,type=%c %s=%d %ld000000000", 'g', "gas", 80010, 1792152005L);
+  udp_line("jnread,type=%c %s=%d %ld000000000", 'w', "water", 50100, 1792152006L);
+  pause_ms(100);
+  n = receive(ufd, text, sizeof(text), &bad);
+  check(n == 0, "udp: nothing before the flush", n, 0);
+  udp_flush();
+  pause_ms(100);
+  n = receive(ufd, text, sizeof(text), &bad);
+  check(n == 1 && lines(text) == 3, "udp: one datagram with the lines", n, lines(text));
+  check(strncmp(text, "jnread,type=e electricity_power=2607 1792152000000000000\n", 57) == 0,
+        "udp: line protocol", strlen(text), 0);
+
+  /* 100 lines of 40 bytes: 35 fit in a datagram */
+  for (i = 0; i < 100; i++) {
+    udp_line("jnread,type=o outside_temperature=%05d", i);
+  }
+  pause_ms(100);
+  n = receive(ufd, text, sizeof(text), &bad);
+  check(n == 2 && lines(text) == 70, "udp: a datagram when the next line does not fit", n, lines(text));
+  udp_flush();
+  pause_ms(100);
+  n = receive(ufd, text, sizeof(text), &bad);
+  check(n == 1 && lines(text) == 30, "udp: the rest at the flush", n, lines(text));
+  check(bad == 0, "udp: no line split over datagrams", bad, 0);
+  udp_get_stats(&st);
+  check(st.lines == 103 && st.datagrams == 4 && st.failed == 0, "udp: lines, datagrams", st.lines, st.datagrams);
+  udp_close();
+}
+
+
+static void test_mqtt(const char *addr)
+{
+  static char payload[PAYLOAD_MAX];
+  const struct packet *p = stub.pk;
+  struct mqtt_stats st;
+  int n, accepts;
+
+  mqtt_open(addr, "outtest");
+  mqtt_publish("jnread/gas", "80010", 1);
+  mqtt_publish("jnread/note", "hello", 0);
+  pause_ms(100);
+  check(stub.accepts == 0 && stub.n == 0, "mqtt: no connection before the flush", stub.accepts, stub.n);
+  mqtt_flush();
+  wait_packets(3);
+  check(p[0].type == 0x10 && stub.level == 4 && (stub.flags & 2), "mqtt: CONNECT level 4, clean session", stub.level, stub.flags);
+  check(stub.keepalive == MQTT_KEEPALIVE && strcmp(stub.client, "outtest") == 0, "mqtt: keep alive, client id", stub.keepalive, MQTT_KEEPALIVE);
+  check(p[1].type == 0x31 && strcmp(p[1].topic, "jnread/gas") == 0 && strcmp(p[1].payload, "80010") == 0,
+        "mqtt: PUBLISH retained", p[1].type, 0x31);
+  check(p[2].type == 0x30 && strcmp(p[2].topic, "jnread/note") == 0 && strcmp(p[2].payload, "hello") == 0,
+        "mqtt: PUBLISH not retained", p[2].type, 0x30);
+
+  /* remaining length 2 + 1 + payload: 127, 128 and 4003 */
+  n = stub.n;
+  memset(payload, 'x', sizeof(payload));
+  payload[124] = '\0';
+  mqtt_publish("t", payload, 0);
+  payload[124] = 'x';
+  payload[125] = '\0';
+  mqtt_publish("t", payload, 0);
+  payload[125] = 'x';
+  payload[4000] = '\0';
+  mqtt_publish("t", payload, 0);
+  pause_ms(100);
+  check(stub.n == n, "mqtt: nothing written before the flush", stub.n - n, 0);
+  mqtt_flush();
+  wait_packets(n + 3);
+  check(p[n].lenbytes == 1 && p[n].rem == 127 && p[n].plen == 124, "mqtt: remaining length 127 in 1 byte", p[n].lenbytes, p[n].rem);
+  check(p[n + 1].lenbytes == 2 && p[n + 1].rem == 128 && p[n + 1].plen == 125, "mqtt: remaining length 128 in 2 bytes", p[n + 1].lenbytes, p[n + 1].rem);
+  check(p[n + 2].lenbytes == 2 && p[n + 2].rem == 4003 && strlen(p[n + 2].payload) == 4000,
+        "mqtt: remaining length 4003 in 2 bytes", p[n + 2].lenbytes, p[n + 2].rem);
+
+  /* the third does not fit in the buffer any more */
+  n = stub.n;
+  mqtt_publish("t", payload, 0);
+  mqtt_publish("t", payload, 0);
+  mqtt_publish("t", payload, 0);
+  wait_packets(n + 2);
+  pause_ms(100);
+  check(stub.n == n + 2, "mqtt: flushed when the buffer is full", stub.n - n, 2);
+  mqtt_flush();
+  wait_packets(n + 3);
+  check(stub.n == n + 3, "mqtt: the rest at the flush", stub.n - n, 3);
+
+  /* keep alive: a PINGREQ after half of it without writes */
+  n = stub.n;
+  mqtt_idle();
+  pause_ms(100);
+  check(stub.n == n, "mqtt: no PINGREQ right after a write", stub.n - n, 0);
+  sleep(MQTT_KEEPALIVE / 2);
+  mqtt_idle();
+  wait_packets(n + 1);
+  check(stub.n == n + 1 && p[n].type == 0xc0, "mqtt: PINGREQ after half the keep alive", stub.n - n, p[n].type);
+  pause_ms(100);
+  mqtt_idle();
+  mqtt_get_stats(&st);
+  check(stub.n == n + 1 && stub.accepts == 1 && st.connects == 1, "mqtt: PINGRESP read, connection kept", stub.accepts, st.connects);
+
+  /* the broker closes the connection */
+  stub_hangup();
+  n = stub.n;
+  accepts = stub.accepts;
+  mqtt_publish("jnread/gas", "80011", 1);
+  mqtt_flush();
+  wait_packets(n + 2);
+  mqtt_get_stats(&st);
+  check(stub.accepts == accepts + 1 && p[n].type == 0x10, "mqtt: reconnect after the broker closed", stub.accepts - accepts, st.connects);
+  check(p[n + 1].type == 0x31 && strcmp(p[n + 1].payload, "80011") == 0 && st.dropped == 0,
+        "mqtt: message after the reconnect, dropped", p[n + 1].type, st.dropped);
+
+  /* the broker refuses: dropped, no new connect until MQTT_RETRY_WAIT passed */
+  stub.refuse = 1;
+  stub_hangup();
+  accepts = stub.accepts;
+  mqtt_publish("jnread/gas", "80012", 1);
+  mqtt_flush();
+  mqtt_publish("jnread/gas", "80013", 1);
+  mqtt_flush();
+  mqtt_get_stats(&st);
+  check(stub.accepts == accepts + 1 && st.dropped == 2, "mqtt: refused, one connect, dropped", stub.accepts - accepts, st.dropped);
+  stub.refuse = 0;
+  sleep(MQTT_RETRY_WAIT);
+  n = stub.n;
+  mqtt_publish("jnread/gas", "80014", 1);
+  mqtt_flush();
+  wait_packets(n + 2);
+  mqtt_get_stats(&st);
+  check(p[n + 1].type == 0x31 && strcmp(p[n + 1].payload, "80014") == 0 && st.connects == 3,
+        "mqtt: connect after the retry wait", stub.accepts - accepts, st.connects);
+
+  n = stub.n;
+  mqtt_close();
+  wait_packets(n + 1);
+  check(p[n].type == 0xe0, "mqtt: DISCONNECT at the close", p[n].type, 0xe0);
+  check(st.published == 10 && st.dropped == 2, "mqtt: published, dropped", st.published, st.dropped);
+}
+
+
+/* FUNCTION to replay a short log with ./jnread to the listener and the
+*  stub broker, with a config of mqtt_topic topic when not NULL, returns the
+*  exit status of jnread
+*/
+static int replay(const char *udp, const char *broker, const char *topic)
+{
+  char dir[] = "/tmp/outtest.XXXXXX", log[64], conf[64], cmd[64];
+  FILE *fp;
+  pid_t pid;
+  int status = -1;
+
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return(-1);
+  }
+  snprintf(log, sizeof(log), "%s/all.log", dir);
+  if ((fp = fopen(log, "w")) == NULL) {
+    perror(log);
+    return(-1);
+  }
+  fprintf(fp, "16-10-26,12:00:00 e 2607 1200001\r\n16-10-26,12:00:05 g 80010 8001\r\n");
+  fclose(fp);
+  snprintf(conf, sizeof(conf), "%s/jnread.conf", dir);
+  if ((fp = fopen(conf, "w")) == NULL) {
+    perror(conf);
+    return(-1);
+  }
+  if (topic != NULL) {
+    fprintf(fp, "mqtt_topic = %s\n", topic);
+  }
+  fclose(fp);
+  if ((pid = fork()) == 0) {
+    execl("./jnread", "jnread", "-c", conf, "--replay", log, "--output", dir, "--stub-sinks",
+          "--udp", udp, "--mqtt", broker, (char *)NULL);
+    perror("./jnread");
+    _exit(127);
+  }
+  if (pid > 0) {
+    waitpid(pid, &status, 0);
+  }
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  if (system(cmd) != 0) {
+    fprintf(stderr, "Can't remove %s\n", dir);
+  }
+  return(status);
+}
+
+
+static void test_outputs(int ufd, const char *udp, const char *broker)
+{
+  static char text[8 * UDP_DATAGRAM];
+  const struct packet *p;
+  int status, bad = 0;
+
+  stub.n = 0;
+  status = replay(udp, broker, NULL);
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "outputs: replay by jnread", status, 0);
+  pause_ms(100);
+  receive(ufd, text, sizeof(text), &bad);
+  check(strstr(text, "jnread,type=e electricity_power=2607,electricity_energy=") != NULL,
+        "outputs: udp line of e", lines(text), 0);
+  check(strstr(text, "jnread,type=g gas=80010 1792152005000000000\n") != NULL, "outputs: udp line of g", lines(text), 0);
+  wait_packets(5);
+  check(strcmp(stub.client, "jnread") == 0, "outputs: mqtt client id", stub.n, 0);
+  p = published("jnread/electricity_power");
+  check(p != NULL && p->type == 0x31 && strcmp(p->payload, "2607") == 0, "outputs: mqtt electricity_power", p != NULL, 1);
+  check(published("jnread/electricity_energy") != NULL, "outputs: mqtt electricity_energy", stub.n, 0);
+  p = published("jnread/gas");
+  check(p != NULL && p->type == 0x31 && strcmp(p->payload, "80010") == 0, "outputs: mqtt gas", p != NULL, 1);
+
+  stub.n = 0;
+  status = replay(udp, broker, "home/meter");
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "outputs: replay with mqtt_topic", status, 0);
+  pause_ms(100);
+  receive(ufd, text, sizeof(text), &bad);
+  wait_packets(5);
+  p = published("home/meter/gas");
+  check(p != NULL && strcmp(p->payload, "80010") == 0 && published("jnread/gas") == NULL,
+        "outputs: mqtt topic of the config", p != NULL, 1);
+}
+
+
+int main(void)
+{
+  struct sockaddr_in sa, ua;
+  socklen_t len = sizeof(sa);
+  pthread_t broker;
+  char addr[32], uaddr[32];
+  int lfd, ufd, one = 1;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ua = sa;
+  if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+      setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+      bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(lfd, 8) < 0 ||
+      getsockname(lfd, (struct sockaddr *)&sa, &len) < 0) {
+    perror("stub broker");
+    return(1);
+  }
+  len = sizeof(ua);
+  if ((ufd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 || bind(ufd, (struct sockaddr *)&ua, sizeof(ua)) < 0 ||
+      getsockname(ufd, (struct sockaddr *)&ua, &len) < 0) {
+    perror("udp listener");
+    return(1);
+  }
+  stub.fd = -1;
+  pthread_create(&broker, NULL, stub_broker, &lfd);
+  snprintf(addr, sizeof(addr), "127.0.0.1:%d", ntohs(sa.sin_port));
+  snprintf(uaddr, sizeof(uaddr), "127.0.0.1:%d", ntohs(ua.sin_port));
+
+  test_udp(ufd, uaddr);
+  test_mqtt(addr);
+  test_outputs(ufd, uaddr, addr);
+
+  stub.stop = 1;
+  pthread_join(broker, NULL);
+  close(lfd);
+  close(ufd);
+  return(test_failed);
+}
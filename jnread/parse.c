@@ -0,0 +1,125 @@
+/*
+#################################################################################
+# parse.c - Parser of the lines the CentralNode prints on USB                  #
+#                                                                               #
+# See parse.h for the interface.                                                #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <string.h>
+
+#include "parse.h"
+
+#define MAX_DIGITS 10           /* a long on the JeeNode has 32 bits */
+#define COUNTER 2147483647L     /* max. of a counter (long on the JeeNode) */
+#define SENSOR 1023             /* max. of an analog sensor value */
+
+#define IS_END(c) ((c) == '\0' || (c) == '\r' || (c) == '\n')
+
+#define DESC(c) [(c) - 'a']
+
+/* the messages as printed by CentralNode.ino */
+static const struct msg_desc descs['z' - 'a' + 1] = {
+  /* appliance: power (W) */
+  DESC('a') = { " #", 1, { 0 }, { 100000 } },
+  /* light sensor */
+  DESC('b') = { " # # #", 3, { 0, 0, 0 }, { COUNTER, COUNTER, COUNTER } },
+  /* electricity: power (W), rotations (negative when the disc turns back) */
+  DESC('e') = { " # #", 2, { -100000, -COUNTER - 1 }, { 100000, COUNTER } },
+  /* gas: litres, rotations of the LS digit */
+  DESC('g') = { " # #", 2, { 0, 0 }, { COUNTER, COUNTER } },
+  /* inside temperature (0.1 degrees C) */
+  DESC('i') = { " #", 1, { -500 }, { 1000 } },
+  /* sensor settings: min-max of left, right, gas, water */
+  DESC('l') = { " min-max: L:#->#, R:#->#, G:#->#, W:#->#", 8,
+    { 0, 0, 0, 0, 0, 0, 0, 0 },
+    { SENSOR, SENSOR, SENSOR, SENSOR, SENSOR, SENSOR, SENSOR, SENSOR } },
+  /* outside temperature (0.1 degrees C) */
+  DESC('o') = { " #", 1, { -500 }, { 1000 } },
+  /* outside pressure (0.1 hPa) */
+  DESC('p') = { " #", 1, { 8000 }, { 11000 } },
+  /* solar: power (W), production today (Wh), runtime today (minutes) */
+  DESC('s') = { " # # #", 3, { 0, 0, 0 }, { 100000, 10000000, 1440 } },
+  /* time of the DCF77 clock: hh:mm  d-m-20yy */
+  DESC('t') = { " #:# #-#-20#", 5, { 0, 0, 1, 1, 0 }, { 23, 59, 31, 12, 99 } },
+  /* water: litres, rotations */
+  DESC('w') = { " # #", 2, { 0, 0 }, { COUNTER, COUNTER } },
+  /* adjusted trigger values of the water sensor */
+  DESC('x') = { " Adjusted water sensor trigger values: #->#", 2,
+    { 0, 0 }, { SENSOR, SENSOR } },
+  /* adjusted trigger values of the gas sensor */
+  DESC('y') = { " Adjusted gas sensor trigger values: #->#", 2,
+    { 0, 0 }, { SENSOR, SENSOR } },
+  /* adjusted trigger values of the electricity sensors */
+  DESC('z') = { " Adjusted electricity sensor trigger values: L:#-># R:#->#", 4,
+    { 0, 0, 0, 0 }, { SENSOR, SENSOR, SENSOR, SENSOR } }
+};
+
+
+/* FUNCTION to get the descriptor of a message type, NULL when unknown */
+const struct msg_desc *parse_desc(char type)
+{
+  if (type < 'a' || type > 'z' || descs[type - 'a'].layout == NULL) {
+    return(NULL);
+  }
+  return(&descs[type - 'a']);
+}
+
+
+/* FUNCTION to parse a line into m, returns PARSE_OK or the reason why the
+*  line is not a (correct) message. The type is set for every known type.
+*/
+int parse_line(const char *line, struct message *m)
+{
+  const struct msg_desc *d;
+  const char *p = line, *l;
+  long v;
+  int neg, digits;
+
+  memset(m, 0, sizeof(*m));
+  if ((d = parse_desc(*p)) == NULL) {
+    return(PARSE_UNKNOWN);
+  }
+  m->type = *p++;
+  for (l = d->layout; *l != '\0'; l++) {
+    switch (*l) {
+    case ' ':
+      if (*p != ' ' && *p != '\t') {
+        return(IS_END(*p) ? PARSE_MISSING : PARSE_SYNTAX);
+      }
+      while (*p == ' ' || *p == '\t') p++;
+      break;
+    case '#':
+      neg = (*p == '-');
+      p += neg;
+      v = 0;
+      for (digits = 0; *p >= '0' && *p <= '9'; digits++, p++) {
+        if (digits == MAX_DIGITS) {
+          return(PARSE_RANGE);
+        }
+        v = v * 10 + (*p - '0');
+      }
+      if (digits == 0) {
+        return(IS_END(*p) ? PARSE_MISSING : PARSE_SYNTAX);
+      }
+      v = neg ? -v : v;
+      if (v < d->min[m->n] || v > d->max[m->n]) {
+        return(PARSE_RANGE);
+      }
+      m->value[m->n++] = v;
+      break;
+    default:
+      if (*p != *l) {
+        return(IS_END(*p) ? PARSE_MISSING : PARSE_SYNTAX);
+      }
+      p++;
+    }
+  }
+  /* only spaces and the end of the line may follow */
+  while (*p == ' ' || *p == '\t') p++;
+  while (*p == '\r' || *p == '\n') p++;
+  return(*p == '\0' ? PARSE_OK : PARSE_SYNTAX);
+}
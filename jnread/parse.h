@@ -0,0 +1,47 @@
+/*
+#################################################################################
+# parse.h - Parser of the lines the CentralNode prints on USB                  #
+#                                                                               #
+# Every message type has a descriptor with the layout of the line after the   #
+# type character and the allowed range of every number in it. A line is      #
+# checked against the layout in place, without sscanf() or allocation:       #
+#   ' '  one or more spaces                                                     #
+#   '#'  a (negative) decimal number                                            #
+#   else the character itself                                                   #
+# Spaces and a CR/LF at the end of the line are allowed, nothing else.        #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#define MSG_TYPES "abegilopstwxyz"     /* message types known to jnread */
+#define MSG_MAX_VALUES 8
+
+/* results of parse_line() */
+#define PARSE_OK 0
+#define PARSE_UNKNOWN 1     /* not a message: empty, text or unknown type */
+#define PARSE_MISSING 2     /* the line ends before the last number */
+#define PARSE_SYNTAX 3      /* other text than the layout, or extra fields */
+#define PARSE_RANGE 4       /* a number is out of its range */
+
+struct msg_desc {
+  const char *layout;           // line after the type, NULL = unknown type
+  int n;                        // no. of numbers in the layout
+  long min[MSG_MAX_VALUES];
+  long max[MSG_MAX_VALUES];
+};
+
+struct message {
+  char type;
+  int n;                        // no. of values
+  long value[MSG_MAX_VALUES];   // the values not in the line are 0
+};
+
+const struct msg_desc *parse_desc(char type);
+int parse_line(const char *line, struct message *m);
+
+#endif
@@ -0,0 +1,333 @@
+/*
+#################################################################################
+# parsebench.c - Benchmark and fuzz driver for the USB line parser             #
+#                                                                               #
+# Checks first that lines as CentralNode.ino prints them are parsed right.    #
+# Benchmark: parses the measurements (a/e/g/i/o/p/s/w) and a mix of all      #
+#   message types with parse_line() and with the former                      #
+#   sscanf("%c %d %ld %ld") and prints the time per line.                    #
+# Fuzz (-f): mutates valid lines at random (flip, insert, delete, truncate,  #
+#   long digit runs) and checks that every result is consistent: a line that  #
+#   is OK has the right no. of values, all in range, and renders back to a    #
+#   line with the same values. Build with sanitizers (make fuzz) to also      #
+#   catch reads outside the line.                                              #
+#                                                                               #
+# Usage: parsebench [lines]                  (default 1000000)                 #
+#        parsebench -f [iterations] [seed]   (default 1000000, 1)              #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parse.h"
+
+#define LINE_SIZE 128
+#define N_LINES 4096            /* different lines in the benchmark */
+
+struct sample {
+  const char *line;
+  int result;
+  int n;
+  long value[MSG_MAX_VALUES];
+};
+
+/* lines as printed by CentralNode.ino (incl. the CR/LF of println) */
+static const struct sample samples[] = {
+  { "a 1234\r\n", PARSE_OK, 1, { 1234 } },
+  { "b 120 0 65535\r\n", PARSE_OK, 3, { 120, 0, 65535 } },
+  { "e 2607 1200001\r\n", PARSE_OK, 2, { 2607, 1200001 } },
+  { "e -250 1234\r\n", PARSE_OK, 2, { -250, 1234 } },
+  { "e -480 -12\r\n", PARSE_OK, 2, { -480, -12 } },
+  { "g 80010 8001\r\n", PARSE_OK, 2, { 80010, 8001 } },
+  { "w 50100 50100\r\n", PARSE_OK, 2, { 50100, 50100 } },
+  { "i 215 \r\n", PARSE_OK, 1, { 215 } },
+  { "o -35 \r\n", PARSE_OK, 1, { -35 } },
+  { "p 9987 \r\n", PARSE_OK, 1, { 9987 } },
+  { "s 2063 12340 487\r\n", PARSE_OK, 3, { 2063, 12340, 487 } },
+  { "t 9:05  16-10-2026\r\n", PARSE_OK, 5, { 9, 5, 16, 10, 26 } },
+  { "l min-max: L:120->870, R:110->860, G:300->700, W:200->650\r\n", PARSE_OK, 8,
+    { 120, 870, 110, 860, 300, 700, 200, 650 } },
+  { "x Adjusted water sensor trigger values: 210->640\r\n", PARSE_OK, 2, { 210, 640 } },
+  { "y Adjusted gas sensor trigger values: 310->690\r\n", PARSE_OK, 2, { 310, 690 } },
+  { "z Adjusted electricity sensor trigger values: L:125->865 R:115->855\r\n", PARSE_OK, 4,
+    { 125, 865, 115, 855 } },
+  { "e 2607\r\n", PARSE_MISSING, 0, { 0 } },
+  { "e 2607 \r\n", PARSE_MISSING, 0, { 0 } },
+  { "e 2607 12 7\r\n", PARSE_SYNTAX, 0, { 0 } },
+  { "e 26x7 12\r\n", PARSE_SYNTAX, 0, { 0 } },
+  { "e -100001 12\r\n", PARSE_RANGE, 0, { 0 } },
+  { "g 1 99999999999\r\n", PARSE_RANGE, 0, { 0 } },
+  { "p 120 \r\n", PARSE_RANGE, 0, { 0 } },
+  { "t 24:00  1-1-2026\r\n", PARSE_RANGE, 0, { 0 } },
+  { "\r\n", PARSE_UNKNOWN, 0, { 0 } },
+  { "[START recv]\r\n", PARSE_UNKNOWN, 0, { 0 } },
+  { "Wrong measurement payload type!\r\n", PARSE_UNKNOWN, 0, { 0 } },
+  { "Sending: Command= gtst, Value= 0\r\n", PARSE_UNKNOWN, 0, { 0 } }
+};
+
+static unsigned long seed = 1;
+
+static unsigned long rnd(void)
+{
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return(seed >> 33);
+}
+
+
+double now_ns()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+
+/* FUNCTION to render a message by its layout, returns the length */
+int render(char *buf, size_t size, const struct message *m)
+{
+  const struct msg_desc *d = parse_desc(m->type);
+  const char *l;
+  size_t len = 0;
+  int i = 0;
+
+  len += snprintf(buf, size, "%c", m->type);
+  for (l = d->layout; *l != '\0' && len < size; l++) {
+    if (*l == '#') {
+      len += snprintf(buf + len, size - len, "%ld", m->value[i++]);
+    } else {
+      buf[len++] = *l;
+    }
+  }
+  len += snprintf(buf + len, size - len, "\r\n");
+  return((int)len);
+}
+
+
+/* FUNCTION to make a valid line of a random type from types */
+int random_line(char *buf, size_t size, const char *types)
+{
+  const struct msg_desc *d;
+  struct message m;
+  long span;
+  int i;
+
+  memset(&m, 0, sizeof(m));
+  m.type = types[rnd() % strlen(types)];
+  d = parse_desc(m.type);
+  m.n = d->n;
+  for (i = 0; i < d->n; i++) {
+    span = d->max[i] - d->min[i];
+    /* mostly ordinary values, sometimes a limit */
+    switch (rnd() % 8) {
+    case 0:
+      m.value[i] = d->min[i];
+      break;
+    case 1:
+      m.value[i] = d->max[i];
+      break;
+    default:
+      m.value[i] = d->min[i] + (long)(rnd() % (span < 100000 ? span + 1 : 100000));
+    }
+  }
+  return(render(buf, size, &m));
+}
+
+
+/* FUNCTION to check the lines of CentralNode.ino, returns the no. of errors */
+int check_samples()
+{
+  struct message m;
+  int i, j, rc, errors = 0;
+
+  for (i = 0; i < (int)(sizeof(samples) / sizeof(samples[0])); i++) {
+    rc = parse_line(samples[i].line, &m);
+    if (rc != samples[i].result) {
+      fprintf(stderr, "Wrong result %d (not %d) for: %s", rc, samples[i].result, samples[i].line);
+      errors++;
+      continue;
+    }
+    if (rc != PARSE_OK) {
+      continue;
+    }
+    for (j = 0; j < MSG_MAX_VALUES; j++) {
+      if (m.n != samples[i].n || m.value[j] != samples[i].value[j]) {
+        fprintf(stderr, "Wrong values for: %s", samples[i].line);
+        errors++;
+        break;
+      }
+    }
+  }
+  return(errors);
+}
+
+
+/* FUNCTION to change a line at random, returns the new length */
+int mutate(char *buf, int len, int size)
+{
+  static const char interesting[] = " -0123456789:>,\r\n\t\0abz";
+  int pos = len > 0 ? (int)(rnd() % len) : 0;
+  int i, n;
+
+  switch (rnd() % 6) {
+  case 0:   // replace a byte
+    if (len > 0) {
+      buf[pos] = (rnd() % 2) ? (char)rnd() : interesting[rnd() % (sizeof(interesting) - 1)];
+    }
+    break;
+  case 1:   // insert a byte
+    if (len < size - 1) {
+      memmove(buf + pos + 1, buf + pos, len - pos);
+      buf[pos] = interesting[rnd() % (sizeof(interesting) - 1)];
+      len++;
+    }
+    break;
+  case 2:   // delete a byte
+    if (len > 0) {
+      memmove(buf + pos, buf + pos + 1, len - pos - 1);
+      len--;
+    }
+    break;
+  case 3:   // truncate
+    len = pos;
+    break;
+  case 4:   // a long run of digits
+    n = 1 + rnd() % 24;
+    if (len + n < size) {
+      memmove(buf + pos + n, buf + pos, len - pos);
+      for (i = 0; i < n; i++) {
+        buf[pos + i] = '0' + rnd() % 10;
+      }
+      len += n;
+    }
+    break;
+  default:  // flip a bit
+    if (len > 0) {
+      buf[pos] ^= 1 << (rnd() % 8);
+    }
+  }
+  buf[len] = '\0';
+  return(len);
+}
+
+
+/* FUNCTION to check one parse result, returns 1 when it is inconsistent */
+int check_result(const char *line, int rc, const struct message *m)
+{
+  const struct msg_desc *d;
+  struct message m2;
+  char again[LINE_SIZE * 2];
+  int i;
+
+  if (rc < PARSE_OK || rc > PARSE_RANGE) {
+    return(1);
+  }
+  if (rc != PARSE_OK) {
+    return(0);
+  }
+  if ((d = parse_desc(m->type)) == NULL || m->type != line[0] || m->n != d->n) {
+    return(1);
+  }
+  for (i = 0; i < MSG_MAX_VALUES; i++) {
+    if (i < d->n && (m->value[i] < d->min[i] || m->value[i] > d->max[i])) {
+      return(1);
+    }
+    if (i >= d->n && m->value[i] != 0) {
+      return(1);
+    }
+  }
+  render(again, sizeof(again), m);
+  return(parse_line(again, &m2) != PARSE_OK || memcmp(m, &m2, sizeof(m2)) != 0);
+}
+
+
+int fuzz(long iterations)
+{
+  static const char *result_name[] = { "ok", "unknown", "missing", "syntax", "range" };
+  unsigned long results[PARSE_RANGE + 1] = { 0 };
+  char buf[LINE_SIZE];
+  struct message m;
+  char *line;
+  long it;
+  int len, i, n, rc, errors = 0;
+
+  for (it = 0; it < iterations; it++) {
+    len = random_line(buf, sizeof(buf), MSG_TYPES);
+    n = (it % 16 == 0) ? 0 : 1 + rnd() % 4;   // some lines stay valid
+    for (i = 0; i < n; i++) {
+      len = mutate(buf, len, sizeof(buf));
+    }
+    /* a copy of exactly the right size, so a sanitizer sees every overread */
+    line = malloc(len + 1);
+    memcpy(line, buf, len + 1);
+    rc = parse_line(line, &m);
+    if ((n == 0 && rc != PARSE_OK) || check_result(line, rc, &m)) {
+      fprintf(stderr, "Inconsistent result %d for: %s\n", rc, line);
+      errors++;
+    }
+    free(line);
+    if (rc >= PARSE_OK && rc <= PARSE_RANGE) {
+      results[rc]++;
+    }
+  }
+  printf("fuzz: %ld lines, %d inconsistent results\n", iterations, errors);
+  for (i = 0; i <= PARSE_RANGE; i++) {
+    printf("  %-8s %10lu\n", result_name[i], results[i]);
+  }
+  return(errors);
+}
+
+
+/* FUNCTION to time both parsers on lines of the given types */
+void bench(long lines, const char *name, const char *types)
+{
+  static char buf[N_LINES][LINE_SIZE];
+  struct message m;
+  char type; int item2 = 0; long item3; long item4;
+  double t0, t_parse, t_sscanf;
+  long i, sum = 0;
+
+  for (i = 0; i < N_LINES; i++) {
+    random_line(buf[i], LINE_SIZE, types);
+  }
+
+  t0 = now_ns();
+  for (i = 0; i < lines; i++) {
+    sum += parse_line(buf[i % N_LINES], &m) + m.value[0];
+  }
+  t_parse = now_ns() - t0;
+
+  t0 = now_ns();
+  for (i = 0; i < lines; i++) {
+    sum += sscanf(buf[i % N_LINES], "%c %d %ld %ld", &type, &item2, &item3, &item4) + item2;
+  }
+  t_sscanf = now_ns() - t0;
+
+  printf("parse per line, %s (%ld lines, checksum %ld):\n", name, lines, sum & 0xff);
+  printf("  sscanf()     : %8.1f ns\n", t_sscanf / lines);
+  printf("  parse_line() : %8.1f ns\n", t_parse / lines);
+}
+
+
+int main(int argc, char *argv[])
+{
+  int errors;
+
+  if ((errors = check_samples()) != 0) {
+    fprintf(stderr, "%d lines of CentralNode.ino not parsed right\n", errors);
+    return(1);
+  }
+  if (argc > 1 && strcmp(argv[1], "-f") == 0) {
+    seed = (argc > 3) ? strtoul(argv[3], NULL, 10) : 1;
+    return(fuzz((argc > 2) ? atol(argv[2]) : 1000000) != 0);
+  }
+  bench((argc > 1) ? atol(argv[1]) : 1000000, "measurements", "aegiopsw");
+  bench((argc > 1) ? atol(argv[1]) : 1000000, "all types", MSG_TYPES);
+  return(0);
+}
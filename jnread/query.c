@@ -0,0 +1,314 @@
+/*
+#################################################################################
+# query.c - Queries on the history of all series (jnread query)                 #
+#                                                                               #
+# See query.h for the interface.                                                #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "query.h"
+#include "tsdb.h"
+#include "rollup.h"
+
+#define MAX_INTERVALS 1000000
+
+static const char *functions[] = {
+  "count", "min", "max", "avg", "sum", "first", "last", "delta", "all", NULL
+};
+enum { F_COUNT, F_MIN, F_MAX, F_AVG, F_SUM, F_FIRST, F_LAST, F_DELTA, F_ALL };
+
+static struct tsdb ts;
+static int decimals;            // of a value, from the scale of the series
+
+
+/* FUNCTION to parse a time, relative times are seconds before base.
+*  Returns 0 when done.
+*/
+static int parse_time(const char *s, time_t base, time_t *t)
+{
+  static const char *formats[] = { "%Y-%m-%d %H:%M:%S", "%Y-%m-%d %H:%M", "%Y-%m-%d", NULL };
+  struct tm tm;
+  const char *end;
+  char *p;
+  long n;
+  int i;
+
+  n = strtol(s, &p, 10);
+  if (p != s && *p == '\0') {
+    *t = (s[0] == '-') ? base + n : n;
+    return(0);
+  }
+  for (i = 0; formats[i] != NULL; i++) {
+    memset(&tm, 0, sizeof(tm));
+    if ((end = strptime(s, formats[i], &tm)) != NULL && *end == '\0') {
+      tm.tm_isdst = -1;
+      *t = mktime(&tm);
+      return(0);
+    }
+  }
+  return(1);
+}
+
+
+/* FUNCTION to parse an interval in seconds or with m/h/d, returns 0 when done */
+static int parse_interval(const char *s, long *step)
+{
+  char *p;
+
+  *step = strtol(s, &p, 10);
+  switch (*p) {
+  case 'm': *step *= 60; p++; break;
+  case 'h': *step *= 3600; p++; break;
+  case 'd': *step *= 86400; p++; break;
+  case 's': p++; break;
+  }
+  return(p == s || *p != '\0' || *step < 1);
+}
+
+
+static void print_time(time_t t)
+{
+  char buf[32];
+  struct tm tm;
+
+  localtime_r(&t, &tm);
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  fputs(buf, stdout);
+}
+
+static void print_sample(void *arg, time_t t, long v)
+{
+  print_time(t);
+  printf(" %.*f\n", decimals, (double)v / ts.scale);
+}
+
+
+/* FUNCTION to print the aggregates, f is one of functions[] */
+static void print_aggregates(const struct tsdb_agg *agg, long n, int f)
+{
+  double scale = ts.scale;
+  long i;
+
+  if (f == F_ALL) {
+    printf("# time count min max avg sum first last delta\n");
+  }
+  for (i = 0; i < n; i++) {
+    const struct tsdb_agg *a = &agg[i];
+
+    print_time(a->start);
+    if (a->count == 0 && f != F_COUNT) {
+      printf(f == F_ALL ? " 0 nan nan nan nan nan nan nan\n" : " nan\n");
+      continue;
+    }
+    switch (f) {
+    case F_COUNT: printf(" %ld\n", a->count); break;
+    case F_MIN: printf(" %.*f\n", decimals, a->min / scale); break;
+    case F_MAX: printf(" %.*f\n", decimals, a->max / scale); break;
+    case F_AVG: printf(" %.*f\n", decimals + 2, a->sum / scale / a->count); break;
+    case F_SUM: printf(" %.*f\n", decimals, a->sum / scale); break;
+    case F_FIRST: printf(" %.*f\n", decimals, a->first / scale); break;
+    case F_LAST: printf(" %.*f\n", decimals, a->last / scale); break;
+    case F_DELTA: printf(" %.*f\n", decimals, (a->last - a->first) / scale); break;
+    default:
+      printf(" %ld %.*f %.*f %.*f %.*f %.*f %.*f %.*f\n", a->count, decimals, a->min / scale,
+      decimals, a->max / scale, decimals + 2, a->sum / scale / a->count, decimals, a->sum / scale,
+      decimals, a->first / scale, decimals, a->last / scale, decimals, (a->last - a->first) / scale);
+    }
+  }
+}
+
+
+/* FUNCTION to print the rollup rows of a level from start to end, the
+*  decimals are those of the history of the series. Returns 0 when done.
+*/
+static int print_rollups(const char *base, int level, time_t start, time_t end)
+{
+  static struct rollup_row rows[44640];
+  struct rollup ro;
+  char path[512];
+  long scale, n, i;
+
+  decimals = 3;
+  if (tsdb_open(&ts, base, 0, 0) == 0) {
+    for (scale = ts.scale, decimals = 0; scale >= 10; scale /= 10) {
+      decimals++;
+    }
+    tsdb_close(&ts);
+  }
+  if (snprintf(path, sizeof(path), "%s.rollup", base) >= (int)sizeof(path)) {
+    fprintf(stderr, "Path too long: %s\n", base);
+    return(1);
+  }
+  if (rollup_open(&ro, path, 0, ROLLUP_READ) != 0) {
+    fprintf(stderr, "No rollups in %s\n", path);
+    return(1);
+  }
+  n = rollup_fetch(&ro, level, start, end, rows, sizeof(rows) / sizeof(rows[0]));
+  printf("# time count min max avg last inc\n");
+  for (i = 0; i < n; i++) {
+    print_time(rows[i].start);
+    printf(" %ld %.*f %.*f %.*f %.*f %.*f\n", rows[i].count, decimals, rows[i].min,
+    decimals, rows[i].max, decimals + 2, rows[i].sum / rows[i].count, decimals, rows[i].last,
+    decimals, rows[i].inc);
+  }
+  rollup_close(&ro);
+  return(0);
+}
+
+
+/* FUNCTION to list the series in dir, returns the no. of series */
+static int list_series(const char *dir)
+{
+  struct dirent *de;
+  char base[512];
+  size_t len;
+  long samples, i;
+  int n = 0;
+  DIR *d;
+
+  if ((d = opendir(dir)) == NULL) {
+    fprintf(stderr, "Can't open %s\n", dir);
+    return(0);
+  }
+  printf("# series samples blocks bytes first last\n");
+  while ((de = readdir(d)) != NULL) {
+    len = strlen(de->d_name);
+    if (len < 5 || strcmp(de->d_name + len - 4, ".tsi") != 0) {
+      continue;
+    }
+    snprintf(base, sizeof(base), "%s/%.*s", dir, (int)(len - 4), de->d_name);
+    if (tsdb_open(&ts, base, 0, 0) != 0) {
+      continue;
+    }
+    for (samples = 0, i = 0; i < ts.n_blocks; i++) {
+      samples += ts.index[i].n;
+    }
+    printf("%.*s %ld %ld %lu ", (int)(len - 4), de->d_name, samples, ts.n_blocks,
+    (unsigned long)(ts.index_size + ts.data_size));
+    if (ts.n_blocks > 0) {
+      print_time(ts.index[0].t_first);
+      putchar(' ');
+      print_time(ts.index[ts.n_blocks - 1].t_last);
+    } else {
+      printf("- -");
+    }
+    putchar('\n');
+    tsdb_close(&ts);
+    n++;
+  }
+  closedir(d);
+  return(n);
+}
+
+
+static void query_usage(void)
+{
+  fprintf(stderr, "Usage: jnread query [-d dir] [-s start] [-e end] [-a function] [-i interval] [-t time] <series>\n");
+  fprintf(stderr, "       jnread query [-d dir] [-s start] [-e end] -r level <series>\n");
+  fprintf(stderr, "       jnread query [-d dir] -l\n");
+  fprintf(stderr, "  levels: minute, hour, day, month\n");
+  fprintf(stderr, "  functions: count, min, max, avg, sum, first, last, delta, all\n");
+  fprintf(stderr, "  times: unix time, -<seconds> or \"yyyy-mm-dd[ hh:mm[:ss]]\"\n");
+}
+
+
+int query_main(int argc, char *argv[], const char *dir)
+{
+  struct tsdb_agg *agg;
+  char base[512];
+  char *start_arg = NULL, *end_arg = NULL, *at_arg = NULL;
+  time_t start, end, at, found;
+  long step = 0, scale, v, n;
+  int opt, f = -1, list = 0, level = -1, i;
+
+  while ((opt = getopt(argc, argv, "d:s:e:a:i:t:r:l")) != -1) {
+    switch (opt) {
+    case 'd': dir = optarg; break;
+    case 's': start_arg = optarg; break;
+    case 'e': end_arg = optarg; break;
+    case 't': at_arg = optarg; break;
+    case 'l': list = 1; break;
+    case 'a':
+      for (f = 0; functions[f] != NULL && strcmp(functions[f], optarg) != 0; f++);
+      if (functions[f] == NULL) {
+        query_usage();
+        return(1);
+      }
+      break;
+    case 'r':
+      if ((level = rollup_level(optarg)) < 0) {
+        query_usage();
+        return(1);
+      }
+      break;
+    case 'i':
+      if (parse_interval(optarg, &step) != 0) {
+        query_usage();
+        return(1);
+      }
+      break;
+    default:
+      query_usage();
+      return(1);
+    }
+  }
+  if (list) {
+    return(list_series(dir) == 0);
+  }
+  if (optind >= argc) {
+    query_usage();
+    return(1);
+  }
+
+  end = time(NULL);
+  if ((end_arg != NULL && parse_time(end_arg, end, &end) != 0) ||
+      parse_time(start_arg != NULL ? start_arg : "-86400", end, &start) != 0 ||
+      (at_arg != NULL && parse_time(at_arg, end, &at) != 0)) {
+    query_usage();
+    return(1);
+  }
+  snprintf(base, sizeof(base), "%s/%s", dir, argv[optind]);
+  if (level >= 0) {
+    return(print_rollups(base, level, start, end) != 0 || ferror(stdout));
+  }
+  if (tsdb_open(&ts, base, 0, 0) != 0) {
+    fprintf(stderr, "No history of %s in %s\n", argv[optind], dir);
+    return(1);
+  }
+  for (scale = ts.scale, decimals = 0; scale >= 10; scale /= 10) {
+    decimals++;
+  }
+
+  if (at_arg != NULL) {
+    if (tsdb_at(&ts, at, &found, &v) != 0) {
+      fprintf(stderr, "No sample of %s at or before %s\n", argv[optind], at_arg);
+      tsdb_close(&ts);
+      return(1);
+    }
+    print_sample(NULL, found, v);
+  } else if (f < 0) {
+    tsdb_scan(&ts, start, end, print_sample, NULL);
+  } else {
+    if ((agg = malloc(MAX_INTERVALS * sizeof(*agg))) == NULL) {
+      tsdb_close(&ts);
+      return(1);
+    }
+    n = tsdb_aggregate(&ts, start, end, step, agg, MAX_INTERVALS);
+    print_aggregates(agg, n, f);
+    free(agg);
+  }
+  i = ferror(stdout);
+  tsdb_close(&ts);
+  return(i != 0);
+}
@@ -0,0 +1,39 @@
+/*
+#################################################################################
+# query.h - Queries on the history of all series (jnread query)                 #
+#                                                                               #
+# Usage: jnread query [options] <series>                                        #
+#        jnread query [-d dir] -l                                               #
+#   -d <dir>       directory with the history (default HISTORY_DIR of jnread)   #
+#   -s <time>      start, default -1 day before the end                         #
+#   -e <time>      end (incl.), default now                                     #
+#   -a <function>  aggregate: count, min, max, avg, sum, first, last, delta     #
+#                  (last - first, for counters) or all                          #
+#   -i <interval>  an aggregate per interval, seconds or with m/h/d, e.g. 1h    #
+#                  (intervals start at a multiple of it in UTC), default one    #
+#                  aggregate over the whole range                               #
+#   -t <time>      the value at a time: the last sample at or before it         #
+#   -r <level>     the rollups of minute, hour, day or month from start to end: #
+#                  count min max avg last inc (the increase of a counter)       #
+#   -l             list the series with their samples, size and time range      #
+# A time is unix time, -<seconds> (relative, as for -s/-e) or local time as     #
+# "yyyy-mm-dd[ hh:mm[:ss]]". Without -a or -t every sample is printed.          #
+# Output is "yyyy-mm-dd hh:mm:ss <value>", with -a all the columns are          #
+# count min max avg sum first last delta; an interval without samples has       #
+# count 0 and nan for the values.                                               #
+# Example: the power at 14:00 last Tuesday                                      #
+#   jnread query -t "2026-10-13 14:00" electricity_power                        #
+# and the gas used per day in September                                         #
+#   jnread query -r day -s 2026-09-01 -e "2026-09-30 23:59" gas                 #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef QUERY_H
+#define QUERY_H
+
+int query_main(int argc, char *argv[], const char *dir);
+
+#endif
@@ -0,0 +1,329 @@
+/*
+#################################################################################
+# rollup.c - Minute, hour, day and month statistics of a series                 #
+#                                                                               #
+# See rollup.h for the interface.                                               #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rollup.h"
+
+#define ROLLUP_MAGIC "JNROL01"
+
+const long rollup_rows[ROLLUP_LEVELS] = { 31 * 1440, 5 * 366 * 24, 50 * 366, 100 * 12 };
+const char *rollup_level_name[ROLLUP_LEVELS] = { "minute", "hour", "day", "month" };
+
+
+/* FUNCTION to create a new file atomically, the rows are empty (zero) and
+*  not on disk until they are used
+*/
+static int rollup_create(const char *path, int kind)
+{
+  struct rollup_header hdr;
+  char tmp[512];
+  long rows = 0;
+  int fd, i;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, ROLLUP_MAGIC, sizeof(hdr.magic));
+  hdr.kind = kind;
+  for (i = 0; i < ROLLUP_LEVELS; i++) {
+    hdr.rows[i] = rollup_rows[i];
+    hdr.offset[i] = rows;
+    rows += rollup_rows[i];
+  }
+
+  snprintf(tmp, sizeof(tmp), "%s.new", path);
+  if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+    return(1);
+  }
+  if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+      ftruncate(fd, sizeof(hdr) + rows * sizeof(struct rollup_row)) != 0 || fsync(fd) != 0) {
+    close(fd);
+    unlink(tmp);
+    return(1);
+  }
+  close(fd);
+  if (rename(tmp, path) != 0) {
+    unlink(tmp);
+    return(1);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to open (and for writing, when missing, create) the file of a
+*  series, kind is only used for writing. Returns 0 when opened.
+*/
+int rollup_open(struct rollup *ro, const char *path, int kind, int mode)
+{
+  struct rollup_header *hdr;
+  struct stat st;
+  long rows = 0;
+  int i;
+
+  memset(ro, 0, sizeof(*ro));
+  ro->fd = -1;
+  ro->mode = mode;
+  ro->day_end = -1;
+  for (i = 0; i < ROLLUP_LEVELS; i++) {
+    ro->opened[i] = -1;
+  }
+  if (mode != ROLLUP_READ && access(path, F_OK) != 0 && rollup_create(path, kind) != 0) {
+    return(1);
+  }
+  if ((ro->fd = open(path, (mode == ROLLUP_READ ? O_RDONLY : O_RDWR) | O_CLOEXEC)) < 0) {
+    return(1);
+  }
+  if (fstat(ro->fd, &st) != 0 || (size_t)st.st_size < sizeof(struct rollup_header)) {
+    rollup_close(ro);
+    return(1);
+  }
+  ro->size = st.st_size;
+  hdr = mmap(NULL, ro->size, mode == ROLLUP_READ ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, ro->fd, 0);
+  if (hdr == MAP_FAILED) {
+    rollup_close(ro);
+    return(1);
+  }
+  ro->hdr = hdr;
+  ro->rows = (struct rollup_row *)(hdr + 1);
+
+  /* check the layout before trusting it */
+  if (memcmp(hdr->magic, ROLLUP_MAGIC, sizeof(hdr->magic)) != 0) {
+    rollup_close(ro);
+    return(1);
+  }
+  for (i = 0; i < ROLLUP_LEVELS; i++) {
+    if (hdr->rows[i] < 1 || hdr->offset[i] != rows) {
+      rollup_close(ro);
+      return(1);
+    }
+    rows += hdr->rows[i];
+  }
+  if (ro->size != sizeof(struct rollup_header) + rows * sizeof(struct rollup_row)) {
+    rollup_close(ro);
+    return(1);
+  }
+  /* the kind of the caller: older files have ROLLUP_COUNTER for a counter
+  *  that restarts
+  */
+  if (mode != ROLLUP_READ) {
+    hdr->kind = kind;
+  }
+  return(0);
+}
+
+
+/* FUNCTION to get the no. of a day in the calendar (days since 1-1-1970) */
+static long civil_day(long y, long m, long d)
+{
+  long era, yoe, doy;
+
+  y -= m <= 2;
+  era = (y >= 0 ? y : y - 399) / 400;
+  yoe = y - era * 400;
+  doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  return(era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468);
+}
+
+
+/* FUNCTION to set the local day and month of t, only computed at a new day */
+static void rollup_calendar(struct rollup *ro, time_t t)
+{
+  struct tm tm, day;
+
+  if (t >= ro->day_start && t < ro->day_end) {
+    return;
+  }
+  localtime_r(&t, &tm);
+  tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+  tm.tm_isdst = -1;
+  ro->day = civil_day(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+  ro->month = (tm.tm_year + 1900) * 12L + tm.tm_mon;
+  day = tm;
+  ro->day_start = mktime(&day);
+  day = tm;
+  day.tm_mday++;
+  ro->day_end = mktime(&day);
+  day = tm;
+  day.tm_mday = 1;
+  ro->month_start = mktime(&day);
+}
+
+
+/* FUNCTION to get the bucket of a level for t, the calendar must be set */
+static long rollup_bucket(const struct rollup *ro, int level, time_t t, long *start)
+{
+  switch (level) {
+  case RL_MINUTE:
+    *start = t / 60 * 60;
+    return(t / 60);
+  case RL_HOUR:
+    *start = t / 3600 * 3600;
+    return(t / 3600);
+  case RL_DAY:
+    *start = ro->day_start;
+    return(ro->day);
+  default:
+    *start = ro->month_start;
+    return(ro->month);
+  }
+}
+
+
+/* FUNCTION to get the increase of a counter since its last sample, a
+*  lower value is a decrease or, of ROLLUP_RESET, a counter that started
+*  again from 0
+*/
+static double rollup_increase(struct rollup *ro, time_t t, double value)
+{
+  long *last_t = &ro->hdr->last_t;
+  double *last = &ro->hdr->last_value;
+  double inc = 0;
+
+  if (ro->mode == ROLLUP_BACKFILL) {
+    last_t = &ro->prev_t;
+    last = &ro->prev_value;
+    /* the live state only moves forward */
+    if (t >= ro->hdr->last_t) {
+      ro->hdr->last_t = t;
+      ro->hdr->last_value = value;
+    }
+  }
+  if (t < *last_t) {
+    return(0);
+  }
+  if (*last_t > 0) {
+    inc = value - *last;
+    if (inc < 0 && ro->hdr->kind == ROLLUP_RESET) {
+      inc = value;
+    }
+  }
+  *last_t = t;
+  *last = value;
+  return(inc);
+}
+
+
+/* FUNCTION to add a sample at time t to the bucket of every level */
+void rollup_add(struct rollup *ro, time_t t, double value)
+{
+  struct rollup_row *row;
+  long bucket, start;
+  double inc = 0;
+  int i;
+
+  if (ro->hdr == NULL || ro->mode == ROLLUP_READ || isnan(value)) {
+    return;
+  }
+  if (ro->hdr->kind != ROLLUP_GAUGE) {
+    inc = rollup_increase(ro, t, value);
+  }
+  rollup_calendar(ro, t);
+  for (i = 0; i < ROLLUP_LEVELS; i++) {
+    bucket = rollup_bucket(ro, i, t, &start);
+    row = ro->rows + ro->hdr->offset[i] + bucket % ro->hdr->rows[i];
+    if (row->count > 0 && row->bucket > bucket) {
+      continue;   // the slot is in use by a newer bucket
+    }
+    if (row->count == 0 || row->bucket != bucket ||
+        (ro->mode == ROLLUP_BACKFILL && ro->opened[i] != bucket)) {
+      memset(row, 0, sizeof(*row));
+      row->bucket = bucket;
+      row->start = start;
+      row->min = row->max = value;
+      ro->opened[i] = bucket;
+    }
+    row->count++;
+    row->sum += value;
+    if (value < row->min) row->min = value;
+    if (value > row->max) row->max = value;
+    row->last = value;
+    row->inc += inc;
+  }
+}
+
+
+/* FUNCTION to get the rows of a level with a start from start to end,
+*  at most max, empty buckets are left out. Returns the no. of rows.
+*/
+long rollup_fetch(const struct rollup *ro, int level, time_t start, time_t end,
+  struct rollup_row *rows, long max)
+{
+  struct rollup cal;
+  const struct rollup_row *row;
+  long first, last, b, s, n = 0;
+
+  if (ro->hdr == NULL || level < 0 || level >= ROLLUP_LEVELS || end < start) {
+    return(0);
+  }
+  memset(&cal, 0, sizeof(cal));
+  cal.day_end = -1;
+  rollup_calendar(&cal, start);
+  first = rollup_bucket(&cal, level, start, &s);
+  if (s < start) {
+    first++;
+  }
+  rollup_calendar(&cal, end);
+  last = rollup_bucket(&cal, level, end, &s);
+  if (last - first >= ro->hdr->rows[level]) {
+    first = last - ro->hdr->rows[level] + 1;
+  }
+  for (b = first; b <= last && n < max; b++) {
+    row = ro->rows + ro->hdr->offset[level] + b % ro->hdr->rows[level];
+    if (row->count > 0 && row->bucket == b) {
+      rows[n++] = *row;
+    }
+  }
+  return(n);
+}
+
+
+/* FUNCTION to find a level by its name, returns the level or -1 */
+int rollup_level(const char *name)
+{
+  int i;
+
+  for (i = 0; i < ROLLUP_LEVELS; i++) {
+    if (strcmp(rollup_level_name[i], name) == 0) {
+      return(i);
+    }
+  }
+  return(-1);
+}
+
+
+/* FUNCTION to write the changed pages to disk now */
+void rollup_sync(struct rollup *ro)
+{
+  if (ro->hdr != NULL && ro->mode != ROLLUP_READ) {
+    msync(ro->hdr, ro->size, MS_ASYNC);
+  }
+}
+
+
+void rollup_close(struct rollup *ro)
+{
+  if (ro->hdr != NULL) {
+    if (ro->mode != ROLLUP_READ) {
+      msync(ro->hdr, ro->size, MS_SYNC);
+    }
+    munmap(ro->hdr, ro->size);
+    ro->hdr = NULL;
+  }
+  if (ro->fd >= 0) {
+    close(ro->fd);
+    ro->fd = -1;
+  }
+}
@@ -0,0 +1,100 @@
+/*
+#################################################################################
+# rollup.h - Minute, hour, day and month statistics of a series                 #
+#                                                                               #
+# One file per series, mapped in memory like the round robin archives: a       #
+# header and a ring of rows per level. A row is the bucket of a minute, an     #
+# hour, a (local) day or a month, found by its no. % rows, and holds the      #
+# count, min, max, sum and last value of the samples in it. Of a counter the  #
+# row also has the increase in the bucket: the usage of a day is the sum of   #
+# the increases of the samples in that day, no sample at midnight is needed.  #
+# A counter may go back (a meter that turns back on solar power): the         #
+# increase is negative then. Of a counter that restarts from 0 (ROLLUP_RESET, #
+# the solar production of today) a lower value is a restart instead, its      #
+# value is the increase.                                                      #
+# Every sample updates the row of each level right away, O(1): only the      #
+# calendar of a new day is computed (with localtime).                          #
+# A sample for a slot that holds a newer bucket (older than the retention)    #
+# is not used for that level.                                                   #
+# Backfill (ROLLUP_BACKFILL) recomputes the buckets from samples of a raw log:#
+# the first sample of a bucket in the run starts it again, so a log (in time  #
+# order) can be backfilled more than once. The increase of the first sample   #
+# is unknown, the usage from before it is not counted.                        #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <time.h>
+
+#define ROLLUP_LEVELS 4
+#define RL_MINUTE 0
+#define RL_HOUR 1
+#define RL_DAY 2
+#define RL_MONTH 3
+
+/* kinds of series */
+#define ROLLUP_GAUGE 0
+#define ROLLUP_COUNTER 1
+#define ROLLUP_RESET 2          /* a counter that restarts from 0 */
+
+/* modes of rollup_open() */
+#define ROLLUP_READ 0
+#define ROLLUP_LIVE 1
+#define ROLLUP_BACKFILL 2
+
+struct rollup_row {
+  long bucket;                  // no. of the minute/hour/day/month
+  long start;                   // start of the bucket (unix time)
+  long count;                   // samples, 0 = empty row
+  double min;
+  double max;
+  double sum;
+  double last;
+  double inc;                   // counter: the increase in the bucket
+};
+
+struct rollup_header {
+  char magic[8];
+  long kind;
+  long rows[ROLLUP_LEVELS];
+  long offset[ROLLUP_LEVELS];   // first row of the level
+  long last_t;                  // counter: time and value of the last sample
+  double last_value;
+};
+
+struct rollup {
+  int fd;
+  size_t size;
+  int mode;
+  struct rollup_header *hdr;
+  struct rollup_row *rows;
+  /* backfill: the bucket per level started in this run, the last sample */
+  long opened[ROLLUP_LEVELS];
+  long prev_t;
+  double prev_value;
+  /* the local day of the last sample */
+  long day;
+  long day_start;
+  long day_end;
+  long month;
+  long month_start;
+};
+
+/* 31 days of minutes, 5 years of hours, 50 years of days, 100 years of months */
+extern const long rollup_rows[ROLLUP_LEVELS];
+extern const char *rollup_level_name[ROLLUP_LEVELS];
+
+int rollup_open(struct rollup *ro, const char *path, int kind, int mode);
+void rollup_add(struct rollup *ro, time_t t, double value);
+long rollup_fetch(const struct rollup *ro, int level, time_t start, time_t end,
+  struct rollup_row *rows, long max);
+int rollup_level(const char *name);
+void rollup_sync(struct rollup *ro);
+void rollup_close(struct rollup *ro);
+
+#endif
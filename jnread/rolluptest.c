@@ -0,0 +1,235 @@
+/*
+#################################################################################
+# rolluptest.c - Test of the rollups of a gauge and of counters                 #
+#                                                                               #
+# In the time zone of the Netherlands (the clocks go forward on 29-03-2026),   #
+# with a sample every minute:                                                   #
+# - a gauge from 28-03 to 02-04: the local days have 24, 23 and 24 hours of    #
+#   samples and start at local midnight, March and April are split at the      #
+#   month boundary, an hour has 60 samples                                      #
+# - a counter that goes back for a while: the increase of a day is the last    #
+#   value of the day minus the last value of the day before, also negative     #
+# - a counter that restarts at midnight (ROLLUP_RESET): the lower value is a   #
+#   restart, the increase of a day is its last value                            #
+# - backfill, twice, of a log with two days before the live data and the live #
+#   data: the older days are added once, the increase at the start of the live #
+#   data is known now, the other live rows are unchanged, and the next live    #
+#   sample continues from the last live sample                                 #
+# Usage: rolluptest. Exits with 1 when a check fails.                          #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "rollup.h"
+#include "testutil.h"
+
+#define TZ_NL "CET-1CEST,M3.5.0,M10.5.0/3"
+#define MINUTE 60L
+#define HOUR 3600L
+
+static char dir[64];
+
+
+/* FUNCTION to get the local time of a date, hour 0 is midnight */
+static time_t local(int y, int m, int d, int h)
+{
+  struct tm tm;
+
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = y - 1900;
+  tm.tm_mon = m - 1;
+  tm.tm_mday = d;
+  tm.tm_hour = h;
+  tm.tm_isdst = -1;
+  return(mktime(&tm));
+}
+
+
+/* FUNCTION to open the file of a series in the test directory */
+static void open_file(struct rollup *ro, const char *name, int kind, int mode)
+{
+  char path[128];
+
+  snprintf(path, sizeof(path), "%s/%s.rol", dir, name);
+  if (rollup_open(ro, path, kind, mode) != 0) {
+    fprintf(stderr, "Can't open %s\n", path);
+    exit(1);
+  }
+}
+
+
+static void remove_file(const char *name)
+{
+  char path[128];
+
+  snprintf(path, sizeof(path), "%s/%s.rol", dir, name);
+  unlink(path);
+}
+
+
+/* the counter: +2 per minute, from 10:00 to 12:00 on 29-03 -1 per minute */
+static double counter_step(time_t t)
+{
+  if (t >= local(2026, 3, 29, 10) && t < local(2026, 3, 29, 12)) {
+    return(-1);
+  }
+  return(2);
+}
+
+
+static void test_gauge(void)
+{
+  struct rollup ro;
+  struct rollup_row rows[8];
+  time_t t, end = local(2026, 4, 2, 0);
+  long n;
+
+  open_file(&ro, "gauge", ROLLUP_GAUGE, ROLLUP_LIVE);
+  for (t = local(2026, 3, 28, 0); t < end; t += MINUTE) {
+    rollup_add(&ro, t, (double)(t % 7));
+  }
+  n = rollup_fetch(&ro, RL_DAY, local(2026, 3, 28, 0), local(2026, 3, 30, 0), rows, 8);
+  check(n == 3 && rows[0].count == 1440 && rows[1].count == 1380 && rows[2].count == 1440,
+        "gauge: minutes in 28-03, 29-03 (23 h), 30-03", n, rows[1].count);
+  check(n == 3 && rows[0].start == local(2026, 3, 28, 0) && rows[1].start == local(2026, 3, 29, 0) &&
+        rows[2].start == local(2026, 3, 30, 0) && rows[2].start - rows[1].start == 23 * HOUR,
+        "gauge: days start at local midnight", rows[2].start - rows[1].start, 23 * HOUR);
+  n = rollup_fetch(&ro, RL_MONTH, local(2026, 3, 1, 0), local(2026, 4, 1, 0), rows, 8);
+  check(n == 2 && rows[0].count == (local(2026, 4, 1, 0) - local(2026, 3, 28, 0)) / MINUTE &&
+        rows[1].count == 1440 && rows[1].start == local(2026, 4, 1, 0),
+        "gauge: march and april split at the month", rows[0].count, rows[1].count);
+  n = rollup_fetch(&ro, RL_HOUR, local(2026, 3, 29, 1), local(2026, 3, 29, 3), rows, 8);
+  check(n == 2 && rows[0].count == 60 && rows[1].count == 60 && rows[1].start - rows[0].start == HOUR,
+        "gauge: hours over the change", n, rows[0].count);
+  check(rows[0].min == 0 && rows[0].max == 6, "gauge: min, max of an hour", rows[0].min, rows[0].max);
+  rollup_close(&ro);
+  remove_file("gauge");
+}
+
+
+static void test_counters(void)
+{
+  struct rollup ro, rs;
+  struct rollup_row rows[4];
+  time_t t, end = local(2026, 3, 31, 0);
+  double v = 1000, today = 0, day_before = 0, last_28 = 0, last_29 = 0;
+  long n, i;
+
+  open_file(&ro, "counter", ROLLUP_COUNTER, ROLLUP_LIVE);
+  open_file(&rs, "reset", ROLLUP_RESET, ROLLUP_LIVE);
+  for (t = local(2026, 3, 28, 0); t < end; t += MINUTE) {
+    if (t == local(2026, 3, 29, 0) || t == local(2026, 3, 30, 0)) {
+      day_before = today;
+      today = 0;
+    }
+    v += counter_step(t);
+    today += 1;
+    rollup_add(&ro, t, v);
+    rollup_add(&rs, t, today);
+    if (t < local(2026, 3, 29, 0)) {
+      last_28 = v;
+    } else if (t < local(2026, 3, 30, 0)) {
+      last_29 = v;
+    }
+  }
+  /* the first sample has no increase */
+  n = rollup_fetch(&ro, RL_DAY, local(2026, 3, 28, 0), local(2026, 3, 30, 0), rows, 4);
+  check(n == 3 && rows[0].inc == last_28 - 1002 && rows[1].inc == last_29 - last_28 && rows[2].inc == v - last_29,
+        "counter: increase per day", rows[1].inc, last_29 - last_28);
+  n = rollup_fetch(&ro, RL_HOUR, local(2026, 3, 29, 10), local(2026, 3, 29, 11), rows, 4);
+  check(n == 2 && rows[0].inc == -60 && rows[1].inc == -60, "counter: decrease per hour", rows[0].inc, rows[1].inc);
+
+  n = rollup_fetch(&rs, RL_DAY, local(2026, 3, 28, 0), local(2026, 3, 30, 0), rows, 4);
+  for (i = 0; i < n && rows[i].inc >= 0; i++);
+  check(n == 3 && i == n, "reset: no negative increase at a restart", n, i);
+  check(n == 3 && rows[0].inc == 1440 - 1 && rows[1].inc == day_before && rows[2].inc == today,
+        "reset: increase of a day is its last value", rows[1].inc, day_before);
+  rollup_close(&ro);
+  rollup_close(&rs);
+  remove_file("counter");
+  remove_file("reset");
+}
+
+
+/* the counter of the backfill test: 2 per minute, 0 at the start of the live data */
+static double backfill_value(time_t t, time_t live_start)
+{
+  return((double)(t - live_start) / 30);
+}
+
+
+static void test_backfill(void)
+{
+  struct rollup ro;
+  struct rollup_row live[4], rows[4];
+  time_t t, live_start = local(2026, 3, 30, 0), live_end = local(2026, 3, 31, 12);
+  long n, run;
+
+  open_file(&ro, "backfill", ROLLUP_COUNTER, ROLLUP_LIVE);
+  for (t = live_start; t < live_end; t += MINUTE) {
+    rollup_add(&ro, t, backfill_value(t, live_start));
+  }
+  rollup_fetch(&ro, RL_DAY, live_start, live_end, live, 4);
+  rollup_close(&ro);
+
+  /* the log has the two days before and the live data */
+  for (run = 1; run <= 2; run++) {
+    open_file(&ro, "backfill", ROLLUP_COUNTER, ROLLUP_BACKFILL);
+    for (t = local(2026, 3, 28, 0); t < live_end; t += MINUTE) {
+      rollup_add(&ro, t, backfill_value(t, live_start));
+    }
+    rollup_close(&ro);
+  }
+
+  open_file(&ro, "backfill", ROLLUP_COUNTER, ROLLUP_READ);
+  n = rollup_fetch(&ro, RL_DAY, local(2026, 3, 28, 0), live_end, rows, 4);
+  check(n == 4 && rows[0].count == 1440 && rows[1].count == 1380,
+        "backfill twice: older days counted once", rows[0].count, rows[1].count);
+  check(n == 4 && rows[0].inc == 2 * 1439 && rows[1].inc == 2 * 1380,
+        "backfill: increase of the older days", rows[0].inc, rows[1].inc);
+  /* the first live sample had no increase, in the log it has */
+  check(n == 4 && rows[2].count == live[0].count && rows[2].inc == live[0].inc + 2,
+        "backfill: increase at the start of the live data", rows[2].inc, live[0].inc + 2);
+  check(n == 4 && memcmp(&rows[3], &live[1], sizeof(live[1])) == 0, "backfill: last live day the same", rows[3].inc, live[1].inc);
+  n = rollup_fetch(&ro, RL_MONTH, local(2026, 3, 1, 0), live_end, rows, 4);
+  check(n == 1 && rows[0].count == (live_end - local(2026, 3, 28, 0)) / MINUTE && rows[0].inc == 2 * (rows[0].count - 1),
+        "backfill: samples, increase of the month", rows[0].count, rows[0].inc);
+  rollup_close(&ro);
+
+  /* live goes on from its own last sample */
+  open_file(&ro, "backfill", ROLLUP_COUNTER, ROLLUP_LIVE);
+  rollup_add(&ro, live_end, backfill_value(live_end, live_start));
+  n = rollup_fetch(&ro, RL_DAY, local(2026, 3, 31, 0), live_end, rows, 4);
+  check(n == 1 && rows[0].inc == live[1].inc + 2, "backfill: live continues after it", rows[0].inc, live[1].inc + 2);
+  rollup_close(&ro);
+  remove_file("backfill");
+}
+
+
+int main(void)
+{
+  setenv("TZ", TZ_NL, 1);
+  tzset();
+  snprintf(dir, sizeof(dir), "/tmp/rolluptest.%d", (int)getpid());
+  mkdir(dir, 0755);
+  remove_file("gauge");
+  remove_file("counter");
+  remove_file("reset");
+  remove_file("backfill");
+
+  test_gauge();
+  test_counters();
+  test_backfill();
+
+  rmdir(dir);
+  return(test_failed);
+}
@@ -0,0 +1,241 @@
+/*
+#################################################################################
+# rra.c - Round robin archives for the measured series                         #
+#                                                                               #
+# See rra.h for the interface.                                                  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rra.h"
+
+#define RRA_MAGIC "JNRRA01"
+
+const struct rra_def rra_default[RRA_MAX_ARCHIVES] = {
+  { RRA_AVERAGE, 60, 1440 },   { RRA_MAX, 60, 1440 },
+  { RRA_AVERAGE, 600, 1008 },  { RRA_MAX, 600, 1008 },
+  { RRA_AVERAGE, 3600, 744 },  { RRA_MAX, 3600, 744 },
+  { RRA_AVERAGE, 86400, 732 }, { RRA_MAX, 86400, 732 }
+};
+
+
+/* FUNCTION to create a new archive file atomically, all rows unknown */
+static int rra_create(const char *path, const struct rra_def *defs, int n)
+{
+  struct rra_header hdr;
+  char tmp[512];
+  double nan_row = NAN;
+  long rows = 0, i;
+  FILE *fp;
+
+  if (n < 1 || n > RRA_MAX_ARCHIVES) {
+    return(1);
+  }
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, RRA_MAGIC, sizeof(hdr.magic));
+  hdr.n_archives = n;
+  for (i = 0; i < n; i++) {
+    if (defs[i].seconds < 1 || defs[i].rows < 1) {
+      return(1);
+    }
+    hdr.archive[i].cf = defs[i].cf;
+    hdr.archive[i].seconds = defs[i].seconds;
+    hdr.archive[i].rows = defs[i].rows;
+    hdr.archive[i].offset = rows;
+    hdr.archive[i].bucket = -1;
+    rows += defs[i].rows;
+  }
+
+  snprintf(tmp, sizeof(tmp), "%s.new", path);
+  if ((fp = fopen(tmp, "w")) == NULL) {
+    return(1);
+  }
+  fwrite(&hdr, sizeof(hdr), 1, fp);
+  for (i = 0; i < rows; i++) {
+    fwrite(&nan_row, sizeof(nan_row), 1, fp);
+  }
+  if (fflush(fp) != 0 || fsync(fileno(fp)) != 0 || ferror(fp)) {
+    fclose(fp);
+    unlink(tmp);
+    return(1);
+  }
+  fclose(fp);
+  if (rename(tmp, path) != 0) {
+    unlink(tmp);
+    return(1);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to open (and when missing create) an archive file,
+*  an existing file keeps its own archives, defs are only used to create.
+*  Returns 0 when opened.
+*/
+int rra_open(struct rra_file *rf, const char *path, const struct rra_def *defs, int n)
+{
+  struct rra_header *hdr;
+  struct stat st;
+  long rows = 0, i;
+
+  memset(rf, 0, sizeof(*rf));
+  rf->fd = -1;
+  if (access(path, F_OK) != 0 && rra_create(path, defs, n) != 0) {
+    return(1);
+  }
+  if ((rf->fd = open(path, O_RDWR | O_CLOEXEC)) < 0) {
+    return(1);
+  }
+  if (fstat(rf->fd, &st) != 0 || (size_t)st.st_size < sizeof(struct rra_header)) {
+    rra_close(rf);
+    return(1);
+  }
+  rf->size = st.st_size;
+  if ((hdr = mmap(NULL, rf->size, PROT_READ | PROT_WRITE, MAP_SHARED, rf->fd, 0)) == MAP_FAILED) {
+    rra_close(rf);
+    return(1);
+  }
+  rf->hdr = hdr;
+  rf->data = (double *)(hdr + 1);
+
+  /* check the layout before trusting it */
+  if (memcmp(hdr->magic, RRA_MAGIC, sizeof(hdr->magic)) != 0 ||
+      hdr->n_archives < 1 || hdr->n_archives > RRA_MAX_ARCHIVES) {
+    rra_close(rf);
+    return(1);
+  }
+  for (i = 0; i < hdr->n_archives; i++) {
+    if (hdr->archive[i].seconds < 1 || hdr->archive[i].rows < 1 || hdr->archive[i].offset != rows) {
+      rra_close(rf);
+      return(1);
+    }
+    rows += hdr->archive[i].rows;
+  }
+  if (rf->size != sizeof(struct rra_header) + rows * sizeof(double)) {
+    rra_close(rf);
+    return(1);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to add a sample at time t to all archives
+*  The row of t is updated right away, so it always holds the consolidated
+*  value of the samples so far. Rows skipped since the last sample become
+*  unknown. Samples older than the row being filled are ignored.
+*/
+void rra_update(struct rra_file *rf, time_t t, double value)
+{
+  struct rra_archive *a;
+  double *row;
+  long bucket, b, i;
+
+  if (rf->hdr == NULL || isnan(value)) {
+    return;
+  }
+  for (i = 0; i < rf->hdr->n_archives; i++) {
+    a = &rf->hdr->archive[i];
+    row = rf->data + a->offset;
+    bucket = t / a->seconds;
+    if (bucket < a->bucket) {
+      continue;
+    }
+    if (bucket > a->bucket) {
+      b = a->bucket < 0 || bucket - a->bucket > a->rows ? bucket - a->rows : a->bucket;
+      for (b++; b < bucket; b++) {
+        row[b % a->rows] = NAN;
+      }
+      a->bucket = bucket;
+      a->sum = 0;
+      a->count = 0;
+      a->max = value;
+    }
+    a->sum += value;
+    a->count++;
+    if (value > a->max) {
+      a->max = value;
+    }
+    row[bucket % a->rows] = a->cf == RRA_MAX ? a->max : a->sum / a->count;
+  }
+}
+
+
+/* FUNCTION to find the archive with cf and the given seconds per row,
+*  seconds 0 = the finest. Returns the archive or -1.
+*/
+int rra_find(const struct rra_file *rf, int cf, long seconds)
+{
+  int i, found = -1;
+
+  for (i = 0; i < rf->hdr->n_archives; i++) {
+    const struct rra_archive *a = &rf->hdr->archive[i];
+
+    if (a->cf != cf || (seconds != 0 && a->seconds != seconds)) {
+      continue;
+    }
+    if (found < 0 || a->seconds < rf->hdr->archive[found].seconds) {
+      found = i;
+    }
+  }
+  return(found);
+}
+
+
+/* FUNCTION to get the rows of an archive from start to end (times of the
+*  start of each row), at most max. Returns the no. of rows.
+*/
+long rra_fetch(const struct rra_file *rf, int archive, time_t start, time_t end,
+  time_t *times, double *values, long max)
+{
+  const struct rra_archive *a = &rf->hdr->archive[archive];
+  const double *row = rf->data + a->offset;
+  long b, first, n = 0;
+
+  if (a->bucket < 0) {
+    return(0);
+  }
+  first = start / a->seconds;
+  if (first <= a->bucket - a->rows) {
+    first = a->bucket - a->rows + 1;
+  }
+  for (b = first; b <= end / a->seconds && n < max; b++) {
+    times[n] = b * a->seconds;
+    values[n] = b <= a->bucket ? row[b % a->rows] : NAN;
+    n++;
+  }
+  return(n);
+}
+
+
+/* FUNCTION to write the changed pages to disk now */
+void rra_sync(struct rra_file *rf)
+{
+  if (rf->hdr != NULL) {
+    msync(rf->hdr, rf->size, MS_ASYNC);
+  }
+}
+
+
+void rra_close(struct rra_file *rf)
+{
+  if (rf->hdr != NULL) {
+    msync(rf->hdr, rf->size, MS_SYNC);
+    munmap(rf->hdr, rf->size);
+    rf->hdr = NULL;
+  }
+  if (rf->fd >= 0) {
+    close(rf->fd);
+    rf->fd = -1;
+  }
+}
@@ -0,0 +1,68 @@
+/*
+#################################################################################
+# rra.h - Round robin archives for the measured series                         #
+#                                                                               #
+# One file per series with a fixed size, like an rrd: a header followed by    #
+# the rows of all archives, mapped in memory. Every archive consolidates the  #
+# samples per row (AVERAGE or MAX) and holds the last <rows> rows, a row is   #
+# found by (time / seconds per row) % rows. Rows without samples are NaN.     #
+# An update only writes to memory, the kernel writes the pages back.          #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef RRA_H
+#define RRA_H
+
+#include <time.h>
+
+#define RRA_MAX_ARCHIVES 8
+
+/* consolidation functions */
+#define RRA_AVERAGE 0
+#define RRA_MAX 1
+
+struct rra_def {
+  int cf;
+  long seconds;             // time per row
+  long rows;
+};
+
+struct rra_archive {
+  int cf;
+  int pad;
+  long seconds;
+  long rows;
+  long offset;              // first row in the data
+  long bucket;              // time / seconds of the row being filled, -1 = none
+  double sum;               // samples of the row being filled
+  long count;
+  double max;
+};
+
+struct rra_header {
+  char magic[8];
+  long n_archives;
+  struct rra_archive archive[RRA_MAX_ARCHIVES];
+};
+
+struct rra_file {
+  int fd;
+  size_t size;
+  struct rra_header *hdr;
+  double *data;
+};
+
+/* 1 min for a day, 10 min for a week, 1 hour for a month, 1 day for two years */
+extern const struct rra_def rra_default[RRA_MAX_ARCHIVES];
+
+int rra_open(struct rra_file *rf, const char *path, const struct rra_def *defs, int n);
+void rra_update(struct rra_file *rf, time_t t, double value);
+long rra_fetch(const struct rra_file *rf, int archive, time_t start, time_t end, time_t *times, double *values, long max);
+int rra_find(const struct rra_file *rf, int cf, long seconds);
+void rra_sync(struct rra_file *rf);
+void rra_close(struct rra_file *rf);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+#################################################################################
+# rrafetch.c - Print the rows of a round robin archive file of jnread          #
+#                                                                               #
+# Usage: rrafetch [options] <file.rra> [AVERAGE|MAX]                           #
+#   -r <seconds>  seconds per row, default the finest archive                 #
+#   -s <time>     start, unix time or -<seconds> before the end (default -1 day) #
+#   -e <time>     end, unix time or -<seconds> before now (default now)        #
+#   -i            print the archives in the file                               #
+# Output is "<unix time>: <value>" per row, like rrdtool fetch.               #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rra.h"
+
+#define MAX_ROWS 100000
+
+
+int main(int argc, char *argv[])
+{
+  struct rra_file rf;
+  long seconds = 0, start = -86400, end = 0, n, i;
+  int opt, cf = RRA_AVERAGE, archive, info = 0;
+  time_t *times;
+  double *values;
+
+  while ((opt = getopt(argc, argv, "r:s:e:i")) != -1) {
+    switch (opt) {
+    case 'r': seconds = atol(optarg); break;
+    case 's': start = atol(optarg); break;
+    case 'e': end = atol(optarg); break;
+    case 'i': info = 1; break;
+    default:
+      fprintf(stderr, "Usage: %s [-r seconds] [-s start] [-e end] [-i] <file.rra> [AVERAGE|MAX]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "Usage: %s [-r seconds] [-s start] [-e end] [-i] <file.rra> [AVERAGE|MAX]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (optind + 1 < argc && strcmp(argv[optind + 1], "MAX") == 0) {
+    cf = RRA_MAX;
+  }
+  if (rra_open(&rf, argv[optind], NULL, 0) != 0) {
+    fprintf(stderr, "Can't open %s\n", argv[optind]);
+    exit(EXIT_FAILURE);
+  }
+
+  if (info) {
+    for (i = 0; i < rf.hdr->n_archives; i++) {
+      struct rra_archive *a = &rf.hdr->archive[i];
+
+      printf("%ld: %s %ld s x %ld rows, last row %ld\n", i, a->cf == RRA_MAX ? "MAX" : "AVERAGE",
+      a->seconds, a->rows, a->bucket < 0 ? 0 : a->bucket * a->seconds);
+    }
+    rra_close(&rf);
+    return(0);
+  }
+
+  if (end <= 0) {
+    end += time(NULL);
+  }
+  if (start <= 0) {
+    start += end;
+  }
+  if ((archive = rra_find(&rf, cf, seconds)) < 0) {
+    fprintf(stderr, "No %s archive with %ld s per row\n", cf == RRA_MAX ? "MAX" : "AVERAGE", seconds);
+    exit(EXIT_FAILURE);
+  }
+  times = malloc(MAX_ROWS * sizeof(time_t));
+  values = malloc(MAX_ROWS * sizeof(double));
+  n = rra_fetch(&rf, archive, start, end, times, values, MAX_ROWS);
+  for (i = 0; i < n; i++) {
+    if (isnan(values[i])) {
+      printf("%ld: nan\n", (long)times[i]);
+    } else {
+      printf("%ld: %.3f\n", (long)times[i], values[i]);
+    }
+  }
+  free(times);
+  free(values);
+  rra_close(&rf);
+  return(0);
+}
@@ -0,0 +1,323 @@
+/*
+#################################################################################
+# serial.c - Serial input from the JeeNode with line framing                   #
+#                                                                               #
+# Replaces the "stty" call with system() and the stdio fgets() on the port.   #
+# See serial.h for the interface.                                               #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial.h"
+#include "frame.h"
+
+#define RING_MASK (SERIAL_RING_SIZE - 1)
+
+
+/* FUNCTION to get the termios speed of a baud rate, B0 when not supported */
+static speed_t serial_speed(int baud)
+{
+  switch (baud) {
+  case 1200: return(B1200);
+  case 2400: return(B2400);
+  case 4800: return(B4800);
+  case 9600: return(B9600);
+  case 19200: return(B19200);
+  case 38400: return(B38400);
+  case 57600: return(B57600);
+  case 115200: return(B115200);
+  case 230400: return(B230400);
+  default: return(B0);
+  }
+}
+
+
+int serial_baud_ok(int baud)
+{
+  return(serial_speed(baud) != B0);
+}
+
+
+/* FUNCTION to open and configure the device (raw, 8N1, no flow control,
+*  DTR is not dropped on close so the JeeNode does not reset)
+*/
+static int serial_connect(struct serial *sp)
+{
+  struct termios tio;
+
+  if (!serial_baud_ok(sp->baud)) {
+    return(1);    // never opened at a wrong speed
+  }
+  if ((sp->fd = open(sp->device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC)) < 0) {
+    sp->next_open = time(NULL) + SERIAL_RETRY;
+    return(1);
+  }
+  if (tcgetattr(sp->fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(HUPCL | CRTSCTS | CSTOPB | PARENB);
+    tio.c_cflag |= CREAD | CLOCAL | CS8;
+    tio.c_iflag |= IGNBRK;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, serial_speed(sp->baud));
+    cfsetospeed(&tio, serial_speed(sp->baud));
+    tcsetattr(sp->fd, TCSANOW, &tio);
+  }
+  sp->head = sp->tail = sp->scanned = 0;
+  sp->discard = 0;
+  return(0);
+}
+
+
+static void serial_disconnect(struct serial *sp)
+{
+  if (sp->fd >= 0) {
+    close(sp->fd);
+    sp->fd = -1;
+  }
+  sp->next_open = time(NULL) + SERIAL_RETRY;
+}
+
+
+/* FUNCTION to open the device, returns 0 when opened now, 1 when not
+*  (serial_get_line() keeps trying) or SERIAL_BAD_BAUD for a rate the port
+*  can not be set to (the device is not opened then)
+*/
+int serial_open(struct serial *sp, const char *device, int baud)
+{
+  memset(sp, 0, sizeof(*sp));
+  snprintf(sp->device, sizeof(sp->device), "%s", device);
+  sp->baud = baud;
+  sp->fd = -1;
+  if (!serial_baud_ok(baud)) {
+    return(SERIAL_BAD_BAUD);
+  }
+  return(serial_connect(sp));
+}
+
+
+void serial_close(struct serial *sp)
+{
+  serial_disconnect(sp);
+}
+
+
+/* FUNCTION to decode the binary frame at the tail of the ring buffer
+*  Returns the length of the line, FRAME_MORE or FRAME_BAD (the sync byte is
+*  skipped then).
+*/
+static int serial_binary(struct serial *sp, char *line, int max)
+{
+  unsigned char buf[FRAME_MAX];
+  unsigned int avail = sp->head - sp->tail, i;
+  int len, used;
+
+  if (avail > FRAME_MAX) {
+    avail = FRAME_MAX;
+  }
+  for (i = 0; i < avail; i++) {
+    buf[i] = sp->ring[(sp->tail + i) & RING_MASK];
+  }
+  len = frame_decode(buf, avail, &used, line, max);
+  if (len == FRAME_MORE) {
+    return(len);
+  }
+  sp->tail += used;
+  if (len == FRAME_BAD) {
+    sp->bad_frames++;
+    return(len);
+  }
+  sp->frames++;
+  sp->lines++;
+  return(len);
+}
+
+
+/* FUNCTION to take one complete line from the ring buffer, ASCII or a
+*  binary frame (decoded to the same line)
+*  Returns the length of the line (incl. the newline) or 0 when there is none.
+*/
+static int serial_frame(struct serial *sp, char *line, int max)
+{
+  unsigned int p, len, i;
+  int rc;
+
+  for (p = sp->tail + sp->scanned; p != sp->head; p++) {
+    if ((unsigned char)sp->ring[p & RING_MASK] == FRAME_SYNC) {
+      if (p != sp->tail && !sp->discard) {
+        sp->broken++;   // a line without its end, followed by a frame
+      }
+      sp->tail = p;
+      sp->scanned = 0;
+      sp->discard = 0;
+      if ((rc = serial_binary(sp, line, max)) > 0) {
+        return(rc);
+      }
+      if (rc == FRAME_MORE) {
+        return(0);
+      }
+      /* bad frame: search on after the sync byte, the bytes up to the next
+      *  newline are no line
+      */
+      sp->discard = 1;
+      p = sp->tail - 1;
+      continue;
+    }
+    if (sp->ring[p & RING_MASK] != '\n') {
+      continue;
+    }
+    len = p + 1 - sp->tail;
+    if (sp->discard || len > (unsigned int)max - 1) {
+      /* the (rest of a) line that does not fit is dropped */
+      if (!sp->discard) {
+        sp->too_long++;
+      }
+      sp->discard = 0;
+      sp->tail = p + 1;
+      sp->scanned = 0;
+      continue;
+    }
+    for (i = 0; i < len; i++) {
+      line[i] = sp->ring[(sp->tail + i) & RING_MASK];
+    }
+    line[len] = '\0';
+    sp->tail = p + 1;
+    sp->scanned = 0;
+    sp->lines++;
+    return((int)len);
+  }
+  sp->scanned = sp->head - sp->tail;
+  if (sp->scanned == SERIAL_RING_SIZE) {
+    /* ring full without a newline: drop it and the rest of that line */
+    if (!sp->discard) {
+      sp->too_long++;
+    }
+    sp->discard = 1;
+    sp->tail = sp->head;
+    sp->scanned = 0;
+  }
+  return(0);
+}
+
+
+/* FUNCTION to read what the device has into the ring, disconnects when the
+*  device is gone
+*/
+static void serial_fill(struct serial *sp, short revents)
+{
+  unsigned int space, pos;
+  ssize_t n;
+
+  if (revents & (POLLERR | POLLNVAL) || (revents & POLLHUP && !(revents & POLLIN))) {
+    serial_disconnect(sp);
+    return;
+  }
+  /* read as much as fits in the ring (in at most two parts) */
+  while ((space = SERIAL_RING_SIZE - (sp->head - sp->tail)) > 0) {
+    pos = sp->head & RING_MASK;
+    if (space > SERIAL_RING_SIZE - pos) {
+      space = SERIAL_RING_SIZE - pos;
+    }
+    n = read(sp->fd, sp->ring + pos, space);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && errno == EAGAIN) {
+      break;
+    }
+    if (n <= 0) {
+      /* device gone (EIO/ENODEV/ENXIO or end of file) */
+      serial_disconnect(sp);
+      break;
+    }
+    sp->head += n;
+    sp->bytes += n;
+    if ((unsigned int)n < space) {
+      break;
+    }
+  }
+}
+
+
+/* FUNCTION to take the next line of the n devices, they take turns starting
+*  after *which, which is set to the device of the line
+*/
+static int serial_next(struct serial *sp, int n, char *line, int max, int *which)
+{
+  int i, k, len;
+
+  for (k = 1; k <= n; k++) {
+    i = (*which + k) % n;
+    if ((len = serial_frame(&sp[i], line, max)) > 0) {
+      *which = i;
+      return(len);
+    }
+  }
+  return(0);
+}
+
+
+/* FUNCTION to read one line from any of n devices with one poll() for all
+*  Waits at most timeout_ms for data. Returns the length of the line, with
+*  the device in *which, or 0 when there is no complete line yet (timeout,
+*  signal or all disconnected).
+*/
+int serial_poll(struct serial *sp, int n, char *line, int max, int *which, int timeout_ms)
+{
+  struct pollfd pfd[SERIAL_MAX_PORTS];
+  int port[SERIAL_MAX_PORTS];
+  int i, np = 0, len;
+
+  if (n > SERIAL_MAX_PORTS) {
+    n = SERIAL_MAX_PORTS;
+  }
+  if ((len = serial_next(sp, n, line, max, which)) > 0) {
+    return(len);
+  }
+  for (i = 0; i < n; i++) {
+    if (sp[i].fd < 0) {
+      if (time(NULL) < sp[i].next_open || serial_connect(&sp[i]) != 0) {
+        continue;
+      }
+      sp[i].reconnects++;
+    }
+    pfd[np].fd = sp[i].fd;
+    pfd[np].events = POLLIN;
+    port[np++] = i;
+  }
+  if (np == 0) {
+    poll(NULL, 0, timeout_ms);
+    return(0);
+  }
+  if (poll(pfd, np, timeout_ms) <= 0) {
+    return(0);    // timeout or signal
+  }
+  for (i = 0; i < np; i++) {
+    if (pfd[i].revents != 0) {
+      serial_fill(&sp[port[i]], pfd[i].revents);
+    }
+  }
+  return(serial_next(sp, n, line, max, which));
+}
+
+
+/* FUNCTION to read one line from the device
+*  Waits at most timeout_ms for data. Returns the length of the line or 0
+*  when there is no complete line yet (timeout, signal or disconnected).
+*/
+int serial_get_line(struct serial *sp, char *line, int max, int timeout_ms)
+{
+  int which = 0;
+
+  return(serial_poll(sp, 1, line, max, &which, timeout_ms));
+}
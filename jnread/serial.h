@@ -0,0 +1,53 @@
+/*
+#################################################################################
+# serial.h - Serial input from the JeeNode with line framing                   #
+#                                                                               #
+# The port is configured with termios and read non-blocking with poll() into    #
+# a ring buffer, from which complete lines are taken. Binary frames (see        #
+# frame.h) are recognised by their sync byte and decoded to the same lines.     #
+# When the device disappears (USB disconnect) it is closed and reopened as      #
+# soon as it is back. Works the same on a pty, which is used for testing at     #
+# high rates. serial_poll() reads several devices (JeeNodes on more ports) in   #
+# one loop: one poll() for all, the devices take turns in giving a line.        #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <time.h>
+
+#define SERIAL_RING_SIZE 4096   /* must be a power of 2 */
+#define SERIAL_RETRY 5          /* wait (s) between attempts to reopen */
+#define SERIAL_MAX_PORTS 8      /* devices read by one serial_poll() */
+#define SERIAL_BAD_BAUD 2       /* serial_open(): the rate is not supported */
+
+struct serial {
+  char device[128];
+  int baud;
+  int fd;
+  char ring[SERIAL_RING_SIZE];
+  unsigned int head;            // write position (free running)
+  unsigned int tail;            // read position (free running)
+  unsigned int scanned;         // bytes after tail known to have no newline
+  int discard;                  // skipping the rest of a too long line
+  time_t next_open;
+  unsigned long bytes;          // bytes read
+  unsigned long lines;          // complete lines returned
+  unsigned long too_long;       // lines discarded because they did not fit
+  unsigned long frames;         // binary frames decoded (also counted in lines)
+  unsigned long bad_frames;     // binary frames rejected (no. of fields, CRC)
+  unsigned long broken;         // lines without an end, cut off by a frame
+  unsigned long reconnects;     // no. of times the device was reopened
+};
+
+int serial_baud_ok(int baud);
+int serial_open(struct serial *sp, const char *device, int baud);
+int serial_get_line(struct serial *sp, char *line, int max, int timeout_ms);
+int serial_poll(struct serial *sp, int n, char *line, int max, int *which, int timeout_ms);
+void serial_close(struct serial *sp);
+
+#endif
@@ -0,0 +1,148 @@
+/*
+#################################################################################
+# serialtest.c - Test of the serial input on a pty pair                         #
+#                                                                               #
+# Opens the slave of a pty through a symlink with serial.c and writes to the   #
+# master:                                                                       #
+# - a line in parts: no line until its end arrived                             #
+# - a line too long for the buffer of the caller: dropped and counted, the     #
+#   next line is read                                                           #
+# - binary frames between text lines: the frames are decoded to their lines    #
+# - a hangup (the master is closed): the port is reopened when the symlink     #
+#   points to a new pty, the lines after it are read                            #
+# - a baud rate termios has no speed for is rejected                            #
+# Usage: serialtest. Exits with 1 when a check fails. Takes SERIAL_RETRY s.    #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pty.h>
+
+#include "serial.h"
+#include "frame.h"
+#include "testutil.h"
+
+#define LINE_MAX_LEN 128
+
+static char link_path[64];
+
+
+/* FUNCTION to create a pty and point the symlink to its slave */
+static int new_pty(void)
+{
+  char name[64];
+  int master, slave;
+
+  if (openpty(&master, &slave, name, NULL, NULL) != 0) {
+    perror("openpty");
+    exit(EXIT_FAILURE);
+  }
+  close(slave);   // the pty stays until the master is closed
+  unlink(link_path);
+  if (symlink(name, link_path) != 0) {
+    perror(link_path);
+    exit(EXIT_FAILURE);
+  }
+  return(master);
+}
+
+
+static void put(int master, const void *buf, size_t len)
+{
+  if (write(master, buf, len) != (ssize_t)len) {
+    perror("write pty");
+  }
+}
+
+
+/* FUNCTION to read the next line, waiting at most 1 s; "" when none */
+static const char *get(struct serial *sp)
+{
+  static char line[LINE_MAX_LEN];
+  int i;
+
+  for (i = 0; i < 10; i++) {
+    if (serial_get_line(sp, line, sizeof(line), 100) > 0) {
+      return(line);
+    }
+  }
+  return("");
+}
+
+
+int main(void)
+{
+  struct serial sp;
+  unsigned char frame[FRAME_MAX];
+  char text[2 * LINE_MAX_LEN];
+  long value[2] = { 2607, 1200001 };
+  long time[5] = { 12, 5, 16, 10, 26 };
+  const char *line;
+  int master, n, i;
+
+  snprintf(link_path, sizeof(link_path), "/tmp/serialtest.%d", (int)getpid());
+  master = new_pty();
+  check(serial_open(&sp, link_path, 57600) == 0, "pty opened", sp.fd >= 0, 1);
+
+  /* a line in parts */
+  put(master, "e 2607 ", 7);
+  line = get(&sp);
+  check(line[0] == '\0', "no line before its end", strlen(line), 0);
+  put(master, "1200001\r\n", 9);
+  line = get(&sp);
+  check(strcmp(line, "e 2607 1200001\r\n") == 0, "line from two parts", strlen(line), 16);
+
+  /* a line that does not fit, the next one does */
+  memset(text, 'x', sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\n';
+  put(master, text, sizeof(text));
+  put(master, "g 80010 8001\r\n", 14);
+  line = get(&sp);
+  check(strcmp(line, "g 80010 8001\r\n") == 0, "line after a too long line", strlen(line), 14);
+  check(sp.too_long == 1, "too long lines", sp.too_long, 1);
+
+  /* frames between text lines */
+  put(master, "i 215 \r\n", 8);
+  n = frame_encode(frame, 'e', 2, value, 2);
+  put(master, frame, n);
+  put(master, "o -35 \r\n", 8);
+  line = get(&sp);
+  check(strcmp(line, "i 215 \r\n") == 0, "text line before a frame", strlen(line), 8);
+  line = get(&sp);
+  check(strncmp(line, "e 2607 1200001", 14) == 0, "frame decoded to its line", strlen(line), 16);
+  line = get(&sp);
+  check(strcmp(line, "o -35 \r\n") == 0, "text line after a frame", strlen(line), 8);
+
+  /* the time frame as the CentralNode prints the time */
+  n = frame_encode(frame, 't', 0, time, 5);
+  put(master, frame, n);
+  line = get(&sp);
+  check(strcmp(line, "t 12:05  16-10-2026\r\n") == 0, "time frame decoded to its line", strlen(line), 21);
+  check(sp.frames == 2 && sp.bad_frames == 0, "frames, bad frames", sp.frames, sp.bad_frames);
+
+  /* hangup, the device comes back as another pty */
+  close(master);
+  line = get(&sp);
+  check(sp.fd < 0, "closed after the hangup", sp.fd, -1);
+  master = new_pty();
+  for (i = 0; i < 10 * (SERIAL_RETRY + 2) && sp.reconnects == 0; i++) {
+    serial_get_line(&sp, text, LINE_MAX_LEN, 100);
+  }
+  check(sp.reconnects == 1, "reconnects", sp.reconnects, 1);
+  put(master, "w 50100 50100\r\n", 15);
+  line = get(&sp);
+  check(strcmp(line, "w 50100 50100\r\n") == 0, "line after the reconnect", strlen(line), 15);
+  check(sp.lines == 7 && sp.broken == 0, "lines, broken lines", sp.lines, sp.broken);
+  serial_close(&sp);
+  close(master);
+
+  check(serial_open(&sp, link_path, 56000) == SERIAL_BAD_BAUD, "56000 baud rejected", sp.fd, -1);
+  unlink(link_path);
+  return(test_failed);
+}
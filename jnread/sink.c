@@ -0,0 +1,149 @@
+/*
+#################################################################################
+# sink.c - Output stages of jnread that run in their own thread                #
+#                                                                               #
+# See sink.h for the interface.                                                 #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "sink.h"
+
+
+/* FUNCTION to free the queue and the item buffers of a sink */
+static void sink_free(struct sink *s)
+{
+  spsc_free(&s->q);
+  free(s->item);
+  s->item = NULL;
+  free(s->latest);
+  s->latest = NULL;
+}
+
+
+static void *sink_thread(void *arg)
+{
+  struct sink *s = arg;
+  char *item = s->item;
+
+  for (;;) {
+    if (spsc_pop(&s->q, item, SINK_IDLE_MS) == 0) {
+      s->consume(item);
+      if (s->flush != NULL && spsc_depth(&s->q) == 0) {
+        s->flush();
+      }
+      continue;
+    }
+    if (__atomic_load_n(&s->stopping, __ATOMIC_ACQUIRE) && spsc_depth(&s->q) == 0) {
+      break;
+    }
+    if (s->idle != NULL) {
+      s->idle();
+    }
+  }
+  if (s->close != NULL) {
+    s->close();
+  }
+  return(NULL);
+}
+
+
+/* FUNCTION to start the thread of a sink, returns 0 when started */
+int sink_start(struct sink *s)
+{
+  sigset_t all, old;
+  int rc;
+
+  if (s->open != NULL && s->open() != 0) {
+    return(1);
+  }
+  if (spsc_init(&s->q, s->item_size, s->slots) != 0) {
+    return(1);
+  }
+  if ((s->item = malloc(s->item_size)) == NULL ||
+      (s->policy == SINK_LATEST && (s->latest = malloc(s->item_size)) == NULL)) {
+    sink_free(s);
+    return(1);
+  }
+  s->latest_pending = 0;
+  s->stopping = 0;
+  /* signals are handled by the main thread only */
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+  rc = pthread_create(&s->thread, NULL, sink_thread, s);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (rc != 0) {
+    sink_free(s);
+    return(1);
+  }
+  s->started = 1;
+  return(0);
+}
+
+
+#define INC(var) __atomic_store_n(&(var), (var) + 1, __ATOMIC_RELAXED)
+
+/* FUNCTION to give an item to a sink (from the processing thread) */
+void sink_put(struct sink *s, const void *item)
+{
+  if (!s->started) {
+    return;
+  }
+  switch (s->policy) {
+  case SINK_BLOCK:
+    while (spsc_push_wait(&s->q, item, SINK_IDLE_MS) != 0);
+    break;
+  case SINK_DROP:
+    if (spsc_push(&s->q, item) != 0) {
+      INC(s->q.full);
+      INC(s->q.dropped);
+    }
+    break;
+  case SINK_LATEST:
+    if (s->latest_pending) {
+      INC(s->q.dropped);
+      s->latest_pending = 0;
+    }
+    if (spsc_push(&s->q, item) != 0) {
+      INC(s->q.full);
+      memcpy(s->latest, item, s->item_size);
+      s->latest_pending = 1;
+    }
+    break;
+  }
+}
+
+
+/* FUNCTION to put a kept aside item (SINK_LATEST) in the queue when there
+*  is space now, call it when the processing thread is idle
+*/
+void sink_retry(struct sink *s)
+{
+  if (s->started && s->latest_pending && spsc_push(&s->q, s->latest) == 0) {
+    s->latest_pending = 0;
+  }
+}
+
+
+/* FUNCTION to let a sink handle all items it has, then stop its thread */
+void sink_stop(struct sink *s)
+{
+  if (!s->started) {
+    return;
+  }
+  if (s->latest_pending) {
+    while (spsc_push_wait(&s->q, s->latest, SINK_IDLE_MS) != 0);
+    s->latest_pending = 0;
+  }
+  __atomic_store_n(&s->stopping, 1, __ATOMIC_RELEASE);
+  spsc_wake(&s->q);
+  pthread_join(s->thread, NULL);
+  s->started = 0;
+  sink_free(s);
+}
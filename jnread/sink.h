@@ -0,0 +1,58 @@
+/*
+#################################################################################
+# sink.h - Output stages of jnread that run in their own thread                #
+#                                                                               #
+# The processing thread puts items for a sink in its spsc queue, the sink      #
+# thread takes them out and handles them, so a slow disk or network only      #
+# delays that sink. What happens when the queue is full depends on the sink:  #
+#   SINK_BLOCK   the producer waits for space, nothing is lost                 #
+#   SINK_DROP    the new item is dropped and counted                           #
+#   SINK_LATEST  only the newest item matters: it is kept aside and put in    #
+#                the queue as soon as there is space, older ones are dropped  #
+# A sink batches on its own: flush() is called when its queue has run empty, #
+# so a burst of items is written at once.                                     #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef SINK_H
+#define SINK_H
+
+#include <pthread.h>
+
+#include "spsc.h"
+
+#define SINK_BLOCK 0
+#define SINK_DROP 1
+#define SINK_LATEST 2
+
+#define SINK_IDLE_MS 1000       /* idle() is called after this long without items */
+
+struct sink {
+  const char *name;
+  int policy;
+  size_t item_size;
+  unsigned int slots;           // power of 2
+  void (*consume)(void *item);  // called in the sink thread for every item
+  void (*idle)(void);           // called in the sink thread when idle, may be NULL
+  int (*open)(void);            // called by sink_start(), nonzero: sink not used, may be NULL
+  void (*flush)(void);          // called in the sink thread when the queue is empty, may be NULL
+  void (*close)(void);          // called in the sink thread when it stops, may be NULL
+  /* set up by sink_start() */
+  struct spsc q;
+  char *item;                   // the item the sink thread handles
+  char *latest;                 // SINK_LATEST: newest item not yet in the queue
+  int latest_pending;
+  int stopping;
+  int started;
+  pthread_t thread;
+};
+
+int sink_start(struct sink *s);
+void sink_put(struct sink *s, const void *item);
+void sink_retry(struct sink *s);
+void sink_stop(struct sink *s);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+#################################################################################
+# sinktest.c - Test of the spsc queue and the policies of the sinks            #
+#                                                                               #
+# - spsc.c: a full queue is refused, the items come out in order, also when    #
+#   head and tail wrap around the unsigned int, and with a producer and a      #
+#   consumer thread                                                             #
+# - sink.c: with a consumer that is held, a full queue makes SINK_BLOCK wait   #
+#   (nothing lost), SINK_DROP drop the new items and SINK_LATEST keep only the #
+#   newest one aside; consumed and dropped items add up to the items put       #
+# Usage: sinktest. Exits with 1 when a check fails.                            #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "spsc.h"
+#include "sink.h"
+#include "testutil.h"
+
+#define SLOTS 4
+#define BURST 50                /* items put in a sink while it is held */
+#define STREAM 200000           /* items through the queue between two threads */
+
+/* what the consumer of the test sink saw */
+static struct {
+  volatile int hold;            // consume() waits while set
+  volatile int entered;         // consume() was called
+  volatile int n;               // items consumed
+  volatile int last;            // the last item consumed
+  volatile int out_of_order;
+  volatile int flushes;
+} seen;
+
+
+static void test_consume(void *item)
+{
+  int v = *(int *)item;
+
+  seen.entered = 1;
+  while (seen.hold) {
+    pause_ms(1);
+  }
+  if (seen.n > 0 && v <= seen.last) {
+    seen.out_of_order++;
+  }
+  seen.last = v;
+  seen.n++;
+}
+
+
+static void test_flush(void)
+{
+  seen.flushes++;
+}
+
+
+static void *release(void *arg)
+{
+  pause_ms(100);
+  seen.hold = 0;
+  return(NULL);
+}
+
+
+/* FUNCTION to put BURST items in a sink of the policy while its consumer
+*  is held on the first one, then let it go and stop the sink. SINK_BLOCK
+*  waits in sink_put(), its consumer is let go by another thread.
+*/
+static void burst(struct sink *s, unsigned long *dropped, unsigned long *full)
+{
+  pthread_t thread;
+  int i;
+
+  memset((void *)&seen, 0, sizeof(seen));
+  seen.hold = 1;
+  if (sink_start(s) != 0) {
+    check(0, "sink started", 0, 0);
+    return;
+  }
+  i = 0;
+  sink_put(s, &i);
+  while (!seen.entered) {
+    pause_ms(1);
+  }
+  if (s->policy == SINK_BLOCK) {
+    pthread_create(&thread, NULL, release, NULL);
+  }
+  for (i = 1; i < BURST; i++) {
+    sink_put(s, &i);
+  }
+  if (s->policy == SINK_BLOCK) {
+    pthread_join(thread, NULL);
+  }
+  *dropped = s->q.dropped;
+  *full = s->q.full;
+  seen.hold = 0;
+  sink_stop(s);
+}
+
+
+static void *producer(void *arg)
+{
+  struct spsc *q = arg;
+  unsigned int i;
+
+  for (i = 0; i < STREAM; i++) {
+    while (spsc_push_wait(q, &i, 100) != 0);
+  }
+  return(NULL);
+}
+
+
+static void test_spsc(void)
+{
+  struct spsc q;
+  pthread_t thread;
+  unsigned int v, i, bad;
+  int full;
+
+  spsc_init(&q, sizeof(v), SLOTS);
+  for (i = 0; i < SLOTS; i++) {
+    spsc_push(&q, &i);
+  }
+  full = spsc_push(&q, &i);
+  check(full == 1 && spsc_depth(&q) == SLOTS, "spsc: full queue refused, depth", full, spsc_depth(&q));
+  for (i = 0, bad = 0; i < SLOTS; i++) {
+    if (spsc_pop(&q, &v, 0) != 0 || v != i) {
+      bad++;
+    }
+  }
+  check(bad == 0 && spsc_pop(&q, &v, 0) == 1, "spsc: items in order, then empty", bad, spsc_depth(&q));
+
+  /* head and tail just before they wrap around */
+  q.head = q.tail = UINT_MAX - 2 * SLOTS;
+  for (i = 0, bad = 0; i < 100 * SLOTS; i++) {
+    if (spsc_push(&q, &i) != 0 || (i % 3 == 2 && spsc_push(&q, &i) != 0)) {
+      bad++;
+    }
+    while (spsc_depth(&q) > SLOTS / 2) {
+      spsc_pop(&q, &v, 0);
+    }
+  }
+  while (spsc_pop(&q, &v, 0) == 0);
+  check(bad == 0 && q.head == q.tail && q.head < SLOTS * 200, "spsc: head and tail wrapped around", bad, q.head);
+  spsc_free(&q);
+
+  spsc_init(&q, sizeof(v), SLOTS);
+  pthread_create(&thread, NULL, producer, &q);
+  for (i = 0, bad = 0; i < STREAM; i++) {
+    while (spsc_pop(&q, &v, 100) != 0);
+    if (v != i) {
+      bad++;
+    }
+  }
+  pthread_join(thread, NULL);
+  check(bad == 0 && spsc_depth(&q) == 0, "spsc: two threads, items out of order", bad, STREAM);
+  spsc_free(&q);
+}
+
+
+int main(void)
+{
+  struct sink s = {
+    .name = "test", .policy = SINK_BLOCK, .item_size = sizeof(int), .slots = SLOTS,
+    .consume = test_consume, .idle = NULL, .open = NULL, .flush = test_flush, .close = NULL,
+  };
+  unsigned long dropped, full;
+
+  test_spsc();
+
+  burst(&s, &dropped, &full);
+  check(seen.n == BURST && dropped == 0, "block: consumed, dropped", seen.n, dropped);
+  check(seen.out_of_order == 0 && seen.last == BURST - 1, "block: out of order, last", seen.out_of_order, seen.last);
+  check(full > 0 && seen.flushes > 0, "block: waited for space, flushes", full, seen.flushes);
+
+  /* the held item and SLOTS in the queue are consumed */
+  s.policy = SINK_DROP;
+  burst(&s, &dropped, &full);
+  check(seen.n == 1 + SLOTS && dropped == BURST - 1 - SLOTS, "drop: consumed, dropped", seen.n, dropped);
+  check(seen.n + dropped == BURST && seen.last == SLOTS, "drop: consumed + dropped, last", seen.n + dropped, seen.last);
+
+  /* and the newest item, kept aside until the end */
+  s.policy = SINK_LATEST;
+  burst(&s, &dropped, &full);
+  check(seen.n == 2 + SLOTS && dropped == BURST - 2 - SLOTS, "latest: consumed, dropped", seen.n, dropped);
+  check(seen.n + dropped == BURST && seen.last == BURST - 1, "latest: consumed + dropped, last", seen.n + dropped, seen.last);
+  check(seen.out_of_order == 0, "latest: out of order", seen.out_of_order, 0);
+
+  return(test_failed);
+}
@@ -0,0 +1,178 @@
+/*
+#################################################################################
+# snapshot.c - JSON snapshot of the actual values                               #
+#                                                                               #
+# See snapshot.h for the interface.                                             #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "httpd.h"
+
+#define HTTP_DATE "%a, %d %b %Y %H:%M:%S GMT"
+
+/* the newest snapshot, written by the html output, read by the http thread */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static char current[SNAPSHOT_SIZE];
+static size_t current_len = 0;
+static char etag[24];
+static time_t modified;
+
+
+/* FUNCTION to render the snapshot into buf, returns the length or -1 */
+int snapshot_render(char *buf, size_t size, const struct html_values *v, time_t t)
+{
+  int len;
+
+  len = snprintf(buf, size,
+  "{\"time\":%ld,\"watt\":%d,\"e_today\":%.3f,\"swatt\":%d,\"s_today\":%.3f,\"s_runtime\":%u,"
+  "\"g_today\":%.3f,\"w_today\":%u,\"itemperature\":%.1f,\"otemperature\":%.1f,\"opressure\":%.1f}\n",
+  (long)t, v->watt, v->e_today / 1000.0, v->swatt, v->s_today / 1000.0, v->s_runtime,
+  v->g_today / 1000.0, v->w_today, v->itemperature / 10.0, v->otemperature / 10.0,
+  v->opressure / 10.0);
+  if (len < 0 || (size_t)len >= size) {
+    return(-1);
+  }
+  return(len);
+}
+
+
+/* FUNCTION to write buf with one write to tmpfile and rename it */
+static int write_file(const char *tmpfile, const char *file, const char *buf, size_t len)
+{
+  size_t done = 0;
+  ssize_t n;
+  int fd;
+
+  if ((fd = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+    return(1);
+  }
+  while (done < len) {
+    n = write(fd, buf + done, len - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      close(fd);
+      unlink(tmpfile);
+      return(1);
+    }
+    done += n;
+  }
+  close(fd);
+  return(rename(tmpfile, file) != 0);
+}
+
+
+/* FUNCTION to make a new snapshot when a value or the minute changed since
+*  the last one (the date/time itself is not compared), the waiting clients
+*  of /current.json get it right away
+*/
+int snapshot_update(const char *tmpfile, const char *jsonfile, const struct html_values *v, time_t t)
+{
+  static struct html_values last;
+  static int made = 0;
+  struct html_values cmp;
+  char buf[SNAPSHOT_SIZE];
+  unsigned long hash = 14695981039346656037UL;
+  int len, i;
+
+  cmp = *v;
+  memcpy(cmp.datetime, last.datetime, sizeof(cmp.datetime));
+  if (made && memcmp(&cmp, &last, sizeof(cmp)) == 0) {
+    return(0);
+  }
+  if ((len = snapshot_render(buf, sizeof(buf), v, t)) < 0) {
+    return(1);
+  }
+  last = *v;
+  made = 1;
+  for (i = 0; i < len; i++) {
+    hash = (hash ^ (unsigned char)buf[i]) * 1099511628211UL;   // FNV-1a
+  }
+
+  pthread_mutex_lock(&lock);
+  memcpy(current, buf, len);
+  current_len = len;
+  snprintf(etag, sizeof(etag), "\"%016lx\"", hash);
+  modified = t;
+  pthread_mutex_unlock(&lock);
+  httpd_wake();
+  return(write_file(tmpfile, jsonfile, buf, len));
+}
+
+
+/* FUNCTION to serve /current.json, see snapshot.h */
+static void get_current(const struct httpd_req *req, struct httpd_resp *resp)
+{
+  char body[SNAPSHOT_SIZE], tag[24], value[64], date[40];
+  const char *p;
+  struct tm tm;
+  time_t t;
+  size_t len;
+  int wait = 0, unchanged = 0;
+
+  pthread_mutex_lock(&lock);
+  memcpy(body, current, current_len);
+  len = current_len;
+  memcpy(tag, etag, sizeof(tag));
+  t = modified;
+  pthread_mutex_unlock(&lock);
+
+  for (p = req->query; (p = strstr(p, "wait=")) != NULL; p++) {
+    if (p == req->query || p[-1] == '&') {
+      wait = atoi(p + 5);
+      break;
+    }
+  }
+  if (len == 0) {
+    /* no message yet */
+    if (wait > 0 && !req->timed_out) {
+      resp->wait = wait;
+      return;
+    }
+    resp->status = 404;
+    return;
+  }
+  if (httpd_header(req, "If-None-Match", value, sizeof(value)) != NULL) {
+    unchanged = (strcmp(value, tag) == 0);
+  } else if (httpd_header(req, "If-Modified-Since", value, sizeof(value)) != NULL) {
+    memset(&tm, 0, sizeof(tm));
+    p = strptime(value, HTTP_DATE, &tm);
+    unchanged = (p != NULL && *p == '\0' && timegm(&tm) >= t);
+  }
+  if (unchanged && wait > 0 && !req->timed_out) {
+    resp->wait = wait;
+    return;
+  }
+
+  gmtime_r(&t, &tm);
+  strftime(date, sizeof(date), HTTP_DATE, &tm);
+  snprintf(resp->headers, sizeof(resp->headers),
+  "ETag: %s\r\nLast-Modified: %s\r\nCache-Control: no-cache\r\n", tag, date);
+  resp->content_type = "application/json";
+  if (unchanged) {
+    resp->status = 304;
+    return;
+  }
+  httpd_printf(resp, "%.*s", (int)len, body);
+}
+
+
+/* FUNCTION to add /current.json to the stats endpoint (before it starts) */
+void snapshot_route(void)
+{
+  httpd_route("/current.json", get_current);
+}
@@ -0,0 +1,38 @@
+/*
+#################################################################################
+# snapshot.h - JSON snapshot of the actual values                               #
+#                                                                               #
+# The values of the html page as one compact JSON object, e.g.                  #
+#   {"time":1792130400,"watt":512,"e_today":12.345,"swatt":0,"s_today":4.390,   #
+#    "s_runtime":439,"g_today":8.689,"w_today":434,"itemperature":21.3,         #
+#    "otemperature":9.1,"opressure":1013.2}                                     #
+# in the units of the page (kWh, m3, L, minutes, degrees C, hPa), time is the   #
+# unix time of the message. snapshot_update() only makes a new snapshot when    #
+# a value or the minute changed; it is then written to a temporary file that    #
+# is renamed over the JSON file (for a web server next to the page) and kept    #
+# for /current.json of the stats endpoint:                                      #
+#   ETag           hash of the snapshot, If-None-Match gives 304                #
+#   Last-Modified  time of the snapshot, If-Modified-Since gives 304            #
+#   ?wait=<s>      long-poll: when the snapshot of the client (If-None-Match)   #
+#                  is still current, answer at the next snapshot or after at    #
+#                  most <s> (max. HTTPD_MAX_WAIT) seconds with 304              #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <time.h>
+
+#include "html.h"
+
+#define SNAPSHOT_SIZE 512
+
+int snapshot_render(char *buf, size_t size, const struct html_values *v, time_t t);
+int snapshot_update(const char *tmpfile, const char *jsonfile, const struct html_values *v, time_t t);
+void snapshot_route(void);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+#################################################################################
+# spsc.c - Lock-free queue with one producer and one consumer thread           #
+#                                                                               #
+# See spsc.h for the interface.                                                 #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spsc.h"
+
+#define LOAD(var, mo) __atomic_load_n(&(var), mo)
+#define STORE(var, val, mo) __atomic_store_n(&(var), val, mo)
+
+
+/* FUNCTION to set up a queue for n (a power of 2) items of slot bytes */
+int spsc_init(struct spsc *q, size_t slot, unsigned int n)
+{
+  pthread_condattr_t attr;
+
+  memset(q, 0, sizeof(*q));
+  if (n == 0 || (n & (n - 1)) != 0 || (q->buf = malloc(slot * n)) == NULL) {
+    return(1);
+  }
+  q->slot = slot;
+  q->mask = n - 1;
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&q->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  return(0);
+}
+
+
+/* FUNCTION to sleep until woken or timeout_ms passed (lock held) */
+static void spsc_sleep(struct spsc *q, int timeout_ms)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ts.tv_sec += timeout_ms / 1000;
+  ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  pthread_cond_timedwait(&q->cond, &q->lock, &ts);
+}
+
+
+/* FUNCTION to wake the other side when it sleeps (seq_cst: the head/tail
+*  store before it can not pass the load of the wait flag)
+*/
+static void spsc_signal(struct spsc *q, int *wait_flag)
+{
+  if (LOAD(*wait_flag, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&q->lock);
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+  }
+}
+
+
+/* FUNCTION to put an item in the queue (producer)
+*  Returns 0 when done, 1 when the queue is full
+*/
+int spsc_push(struct spsc *q, const void *item)
+{
+  unsigned int head = LOAD(q->head, __ATOMIC_RELAXED);
+
+  if (head - LOAD(q->tail, __ATOMIC_ACQUIRE) > q->mask) {
+    return(1);
+  }
+  memcpy(q->buf + (head & q->mask) * q->slot, item, q->slot);
+  STORE(q->head, head + 1, __ATOMIC_SEQ_CST);
+  STORE(q->pushed, q->pushed + 1, __ATOMIC_RELAXED);
+  spsc_signal(q, &q->empty_wait);
+  return(0);
+}
+
+
+/* FUNCTION to put an item in the queue, waiting at most timeout_ms for
+*  space (producer). Returns 0 when done, 1 when the queue stayed full.
+*  Counts the queue as full when it had to wait.
+*/
+int spsc_push_wait(struct spsc *q, const void *item, int timeout_ms)
+{
+  if (spsc_push(q, item) == 0) {
+    return(0);
+  }
+  STORE(q->full, q->full + 1, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&q->lock);
+  STORE(q->full_wait, 1, __ATOMIC_SEQ_CST);
+  if (LOAD(q->head, __ATOMIC_RELAXED) - LOAD(q->tail, __ATOMIC_SEQ_CST) > q->mask) {
+    spsc_sleep(q, timeout_ms);
+  }
+  STORE(q->full_wait, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&q->lock);
+  return(spsc_push(q, item));
+}
+
+
+/* FUNCTION to take the oldest item from the queue, waiting at most
+*  timeout_ms for one (consumer). Returns 0 when done, 1 when empty.
+*/
+int spsc_pop(struct spsc *q, void *item, int timeout_ms)
+{
+  unsigned int tail = LOAD(q->tail, __ATOMIC_RELAXED);
+
+  if (LOAD(q->head, __ATOMIC_ACQUIRE) == tail) {
+    if (timeout_ms <= 0) {
+      return(1);
+    }
+    pthread_mutex_lock(&q->lock);
+    STORE(q->empty_wait, 1, __ATOMIC_SEQ_CST);
+    if (LOAD(q->head, __ATOMIC_SEQ_CST) == tail) {
+      spsc_sleep(q, timeout_ms);
+    }
+    STORE(q->empty_wait, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&q->lock);
+    if (LOAD(q->head, __ATOMIC_ACQUIRE) == tail) {
+      return(1);
+    }
+  }
+  memcpy(item, q->buf + (tail & q->mask) * q->slot, q->slot);
+  STORE(q->tail, tail + 1, __ATOMIC_SEQ_CST);
+  spsc_signal(q, &q->full_wait);
+  return(0);
+}
+
+
+/* FUNCTION to give the no. of items in the queue (any thread) */
+unsigned int spsc_depth(const struct spsc *q)
+{
+  return(LOAD(q->head, __ATOMIC_RELAXED) - LOAD(q->tail, __ATOMIC_RELAXED));
+}
+
+
+/* FUNCTION to wake a sleeping consumer or producer, e.g. to stop it */
+void spsc_wake(struct spsc *q)
+{
+  pthread_mutex_lock(&q->lock);
+  pthread_cond_broadcast(&q->cond);
+  pthread_mutex_unlock(&q->lock);
+}
+
+
+void spsc_free(struct spsc *q)
+{
+  free(q->buf);
+  q->buf = NULL;
+  pthread_cond_destroy(&q->cond);
+  pthread_mutex_destroy(&q->lock);
+}
@@ -0,0 +1,43 @@
+/*
+#################################################################################
+# spsc.h - Lock-free queue with one producer and one consumer thread           #
+#                                                                               #
+# A ring of fixed size slots. Putting and taking an item only uses atomic      #
+# loads and stores of the head and tail, the mutex and condition variable are #
+# only used to sleep while the queue is empty (consumer) or full (producer).  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+struct spsc {
+  char *buf;
+  size_t slot;                  // size of an item
+  unsigned int mask;            // no. of slots - 1
+  unsigned int head __attribute__ ((aligned (64)));   // written by the producer
+  unsigned int tail __attribute__ ((aligned (64)));   // written by the consumer
+  int empty_wait __attribute__ ((aligned (64)));      // consumer sleeps
+  int full_wait;                // producer sleeps
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  unsigned long pushed;         // items put in the queue
+  unsigned long full;           // times the producer found the queue full (see sink.h)
+  unsigned long dropped;        // items the producer did not put (see sink.h)
+};
+
+int spsc_init(struct spsc *q, size_t slot, unsigned int n);
+int spsc_push(struct spsc *q, const void *item);
+int spsc_push_wait(struct spsc *q, const void *item, int timeout_ms);
+int spsc_pop(struct spsc *q, void *item, int timeout_ms);
+unsigned int spsc_depth(const struct spsc *q);
+void spsc_wake(struct spsc *q);
+void spsc_free(struct spsc *q);
+
+#endif
@@ -0,0 +1,413 @@
+/*
+#################################################################################
+# sse.c - Live stream of the readings to browsers (server-sent events)          #
+#                                                                               #
+# See sse.h for the interface.                                                  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "sse.h"
+
+#define GET(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#define INC(var) __atomic_store_n(&(var), GET(var) + 1, __ATOMIC_RELAXED)
+
+#define EV_LISTEN 0xffffffffUL  /* epoll data of the listening socket */
+#define EV_WAKE 0xfffffffeUL    /* and of the eventfd */
+
+/* states of a client */
+#define C_FREE 0
+#define C_REQUEST 1             // reading the request
+#define C_REPLY 2               // sending a reply, then closed
+#define C_STREAM 3              // sending events
+
+struct client {
+  int fd;
+  int state;
+  int want_out;                 // EPOLLOUT is set
+  time_t since;
+  size_t len;                   // request: read, reply/stream: to send from buf
+  size_t done;                  // sent from buf
+  unsigned long pos;            // stream: bytes of the ring sent
+  char buf[SSE_CLIENT_BUF];
+};
+
+static const char live_page[] =
+  "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>JJ Home live</title>"
+  "<style>body{font-family:Arial;background:#000066;color:#E8EEFD}"
+  "td{padding:2px 8px;border:1px solid #0DD3EA}</style></head>"
+  "<body><table id=\"t\"></table><script>"
+  "var t=document.getElementById(\"t\"),r={};"
+  "new EventSource(\"events\").onmessage=function(e){var d=JSON.parse(e.data),k,w;"
+  "for(k in d){if(k==\"time\"||k==\"type\")continue;w=r[k];"
+  "if(!w){w=r[k]=t.insertRow();w.insertCell().textContent=k;w.insertCell();w.insertCell();}"
+  "w.cells[1].textContent=d[k];w.cells[2].textContent=new Date(d.time*1000).toLocaleTimeString();}};"
+  "</script></body></html>";
+
+/* the ring and the last event per key, written by sse_publish() */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static char ring[SSE_RING_SIZE];
+static unsigned long head = 0;  // bytes ever written to the ring
+static char last[SSE_KEYS][SSE_EVENT_SIZE + 16];
+static time_t last_event;
+
+static struct client *clients;
+static struct sse_stats stats;
+static int listen_fd = -1;
+static int wake_fd = -1;
+static int epoll_fd = -1;
+static pthread_t thread;
+
+
+/* FUNCTION to add text to the ring, the lock is held */
+static void ring_add(const char *s, size_t len)
+{
+  size_t off, n;
+
+  while (len > 0) {
+    off = head % SSE_RING_SIZE;
+    n = (len < SSE_RING_SIZE - off) ? len : SSE_RING_SIZE - off;
+    memcpy(ring + off, s, n);
+    head += n;
+    s += n;
+    len -= n;
+  }
+  last_event = time(NULL);
+}
+
+
+/* FUNCTION to send a reading (JSON) to all clients, from any thread; the last
+*  reading of every key (e.g. of every meter) is kept for new clients
+*/
+void sse_publish(int key, const char *data)
+{
+  char event[SSE_EVENT_SIZE + 16];
+  uint64_t one = 1;
+  int len;
+
+  if (listen_fd < 0 || key < 0 || key >= SSE_KEYS) {
+    return;
+  }
+  len = snprintf(event, sizeof(event), "data: %s\n\n", data);
+  if (len < 0 || (size_t)len >= sizeof(event)) {
+    return;
+  }
+  pthread_mutex_lock(&lock);
+  ring_add(event, len);
+  memcpy(last[key], event, len + 1);
+  pthread_mutex_unlock(&lock);
+  INC(stats.events);
+  if (write(wake_fd, &one, sizeof(one)) < 0) {
+    return;   // the counter is full: a wake is pending already
+  }
+}
+
+
+void sse_get_stats(struct sse_stats *st)
+{
+  st->clients = GET(stats.clients);
+  st->connects = GET(stats.connects);
+  st->rejected = GET(stats.rejected);
+  st->lagged = GET(stats.lagged);
+  st->events = GET(stats.events);
+}
+
+
+static void client_close(struct client *c)
+{
+  if (c->state == C_STREAM) {
+    __atomic_store_n(&stats.clients, GET(stats.clients) - 1, __ATOMIC_RELAXED);
+  }
+  close(c->fd);   // also removes it from the epoll set
+  c->fd = -1;
+  c->state = C_FREE;
+}
+
+
+/* FUNCTION to wait for the client to be writable, or not */
+static void client_want_out(struct client *c, int want)
+{
+  struct epoll_event ev;
+
+  if (c->want_out == want) {
+    return;
+  }
+  ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+  ev.data.u64 = c - clients;
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+  c->want_out = want;
+}
+
+
+/* FUNCTION to send what the client has to get: first from its buffer,
+*  when streaming then from the ring. Returns 1 when it was closed.
+*/
+static int client_send(struct client *c)
+{
+  unsigned long end;
+  size_t off, n;
+  ssize_t sent;
+
+  while (c->done < c->len) {
+    sent = send(c->fd, c->buf + c->done, c->len - c->done, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0 && (errno == EAGAIN || errno == EINTR)) {
+      client_want_out(c, 1);
+      return(0);
+    }
+    if (sent <= 0) {
+      client_close(c);
+      return(1);
+    }
+    c->done += sent;
+  }
+  if (c->state == C_REPLY) {
+    client_close(c);
+    return(1);
+  }
+
+  pthread_mutex_lock(&lock);
+  end = head;
+  if (end - c->pos > SSE_RING_SIZE) {
+    pthread_mutex_unlock(&lock);
+    INC(stats.lagged);
+    client_close(c);
+    return(1);
+  }
+  while (c->pos < end) {
+    off = c->pos % SSE_RING_SIZE;
+    n = (end - c->pos < SSE_RING_SIZE - off) ? end - c->pos : SSE_RING_SIZE - off;
+    sent = send(c->fd, ring + off, n, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0 && (errno == EAGAIN || errno == EINTR)) {
+      break;
+    }
+    if (sent <= 0) {
+      pthread_mutex_unlock(&lock);
+      client_close(c);
+      return(1);
+    }
+    c->pos += sent;
+  }
+  pthread_mutex_unlock(&lock);
+  client_want_out(c, c->pos < end);
+  return(0);
+}
+
+
+/* FUNCTION to answer a complete request */
+static void client_request(struct client *c)
+{
+  char method[8], path[128];
+  size_t len;
+  int i;
+
+  c->done = 0;
+  if (sscanf(c->buf, "%7s %127s", method, path) != 2 || strcmp(method, "GET") != 0) {
+    c->len = snprintf(c->buf, sizeof(c->buf), "HTTP/1.1 400 Bad Request\r\n"
+    "Content-Length: 0\r\nConnection: close\r\n\r\n");
+    c->state = C_REPLY;
+  } else if (strcmp(path, "/events") == 0) {
+    /* the headers, then the last reading of every key, then the ring */
+    c->len = snprintf(c->buf, sizeof(c->buf), "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+    "Access-Control-Allow-Origin: *\r\nConnection: keep-alive\r\n\r\nretry: 3000\n\n");
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < SSE_KEYS; i++) {
+      len = strlen(last[i]);
+      if (len > 0 && c->len + len < sizeof(c->buf)) {
+        memcpy(c->buf + c->len, last[i], len);
+        c->len += len;
+      }
+    }
+    c->pos = head;
+    pthread_mutex_unlock(&lock);
+    c->state = C_STREAM;
+    INC(stats.connects);
+    INC(stats.clients);
+  } else if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0) {
+    c->len = snprintf(c->buf, sizeof(c->buf), "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/html; charset=utf-8\r\nContent-Length: %zu\r\n"
+    "Connection: close\r\n\r\n%s", sizeof(live_page) - 1, live_page);
+    c->state = C_REPLY;
+  } else {
+    c->len = snprintf(c->buf, sizeof(c->buf), "HTTP/1.1 404 Not Found\r\n"
+    "Content-Length: 0\r\nConnection: close\r\n\r\n");
+    c->state = C_REPLY;
+  }
+  client_send(c);
+}
+
+
+/* FUNCTION to handle input of a client: the request, later only a close */
+static void client_read(struct client *c)
+{
+  char scratch[256];
+  ssize_t n;
+
+  if (c->state != C_REQUEST) {
+    n = read(c->fd, scratch, sizeof(scratch));
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+      client_close(c);
+    }
+    return;
+  }
+  n = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+  if (n <= 0) {
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+      return;
+    }
+    client_close(c);
+    return;
+  }
+  c->len += n;
+  c->buf[c->len] = '\0';
+  if (strstr(c->buf, "\r\n\r\n") != NULL) {
+    client_request(c);
+  } else if (c->len == sizeof(c->buf) - 1) {
+    client_close(c);    // request too big
+  }
+}
+
+
+static void accept_clients(time_t now)
+{
+  struct epoll_event ev;
+  int fd, i;
+
+  while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    for (i = 0; i < SSE_MAX_CLIENTS && clients[i].state != C_FREE; i++);
+    if (i == SSE_MAX_CLIENTS) {
+      INC(stats.rejected);
+      close(fd);
+      continue;
+    }
+    clients[i].fd = fd;
+    clients[i].state = C_REQUEST;
+    clients[i].want_out = 0;
+    clients[i].since = now;
+    clients[i].len = 0;
+    clients[i].done = 0;
+    ev.events = EPOLLIN;
+    ev.data.u64 = i;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      client_close(&clients[i]);
+    }
+  }
+}
+
+
+static void *sse_loop(void *arg)
+{
+  struct epoll_event events[64];
+  uint64_t count;
+  time_t now;
+  int i, n, wake;
+
+  for (;;) {
+    n = epoll_wait(epoll_fd, events, 64, 1000);
+    now = time(NULL);
+    wake = 0;
+    for (i = 0; i < n; i++) {
+      if (events[i].data.u64 == EV_LISTEN) {
+        accept_clients(now);
+      } else if (events[i].data.u64 == EV_WAKE) {
+        while (read(wake_fd, &count, sizeof(count)) > 0);
+        wake = 1;
+      } else {
+        struct client *c = &clients[events[i].data.u64];
+
+        if (c->state == C_FREE) {
+          continue;   // closed by an earlier event
+        }
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+          client_read(c);
+        }
+        if (c->state != C_FREE && c->state != C_REQUEST && (events[i].events & EPOLLOUT)) {
+          client_send(c);
+        }
+      }
+    }
+
+    /* a comment when it has been quiet, so dead clients are found */
+    pthread_mutex_lock(&lock);
+    if (now - last_event >= SSE_PING) {
+      ring_add(": ping\n\n", 8);
+      wake = 1;
+    }
+    pthread_mutex_unlock(&lock);
+
+    for (i = 0; i < SSE_MAX_CLIENTS; i++) {
+      struct client *c = &clients[i];
+
+      if (c->state == C_STREAM && wake) {
+        /* also those that wait to be writable: too far behind is closed */
+        client_send(c);
+      } else if ((c->state == C_REQUEST || c->state == C_REPLY) && now - c->since > SSE_TIMEOUT) {
+        client_close(c);
+      }
+    }
+  }
+  return(NULL);
+}
+
+
+/* FUNCTION to start the server on addr:port, returns 0 when started */
+int sse_start(const char *addr, int port)
+{
+  struct sockaddr_in sin;
+  struct epoll_event ev;
+  int i, on = 1;
+
+  if ((clients = calloc(SSE_MAX_CLIENTS, sizeof(*clients))) == NULL) {
+    return(1);
+  }
+  for (i = 0; i < SSE_MAX_CLIENTS; i++) {
+    clients[i].fd = -1;
+  }
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(port);
+  if (inet_pton(AF_INET, addr, &sin.sin_addr) != 1) {
+    return(1);
+  }
+  if ((listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+    return(1);
+  }
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(listen_fd, (struct sockaddr *)&sin, sizeof(sin)) != 0 || listen(listen_fd, 64) != 0 ||
+      (wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 ||
+      (epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    close(listen_fd);
+    listen_fd = -1;
+    return(1);
+  }
+  ev.events = EPOLLIN;
+  ev.data.u64 = EV_LISTEN;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+  ev.data.u64 = EV_WAKE;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+  last_event = time(NULL);
+  if (pthread_create(&thread, NULL, sse_loop, NULL) != 0) {
+    close(listen_fd);
+    listen_fd = -1;
+    return(1);
+  }
+  pthread_detach(thread);
+  return(0);
+}
@@ -0,0 +1,46 @@
+/*
+#################################################################################
+# sse.h - Live stream of the readings to browsers (server-sent events)          #
+#                                                                               #
+# A small HTTP server in its own thread with an epoll loop:                     #
+#   /events  text/event-stream, a "data: <json>" event for every reading as     #
+#            it arrives; a new client first gets the last reading of every      #
+#            key (every meter)                                                  #
+#   /        a page that shows the readings live (EventSource)                  #
+# Every event is written once into a shared ring of SSE_RING_SIZE bytes and     #
+# every client only has its position in the ring, so sending to hundreds of     #
+# clients costs no copies and a client has a fixed budget: SSE_CLIENT_BUF       #
+# for its request, the headers and the last readings. A client that is more     #
+# than the ring behind (too slow) is disconnected, the browser reconnects by    #
+# itself. A comment is sent after SSE_PING seconds without events, so dead      #
+# connections are found.                                                        #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef SSE_H
+#define SSE_H
+
+#define SSE_MAX_CLIENTS 512     /* connections at the same time */
+#define SSE_CLIENT_BUF 4096     /* memory per client for the request & headers */
+#define SSE_RING_SIZE 65536     /* events not yet sent to every client */
+#define SSE_EVENT_SIZE 160      /* max. size of the data of an event */
+#define SSE_KEYS 32             /* last readings kept for new clients */
+#define SSE_PING 15             /* s without events before a comment is sent */
+#define SSE_TIMEOUT 5           /* s to send a request or get a reply */
+
+struct sse_stats {
+  unsigned long clients;        // streaming now
+  unsigned long connects;       // streams started
+  unsigned long rejected;       // connections over SSE_MAX_CLIENTS
+  unsigned long lagged;         // clients disconnected for being too slow
+  unsigned long events;         // events published
+};
+
+int sse_start(const char *addr, int port);
+void sse_publish(int key, const char *data);
+void sse_get_stats(struct sse_stats *st);
+
+#endif
@@ -0,0 +1,249 @@
+/*
+#################################################################################
+# ssetest.c - Test of the live stream with many local clients                   #
+#                                                                               #
+# Starts sse.c on 127.0.0.1, connects IDLE_CLIENTS clients to /events that      #
+# only read, and one client with a small receive buffer that never reads.       #
+# Events are published in batches, after each batch the readers read until     #
+# they have it all:                                                             #
+# - every reader gets every event, in order, none is disconnected              #
+# - the client that never reads falls more than the ring behind and is         #
+#   disconnected as lagged, the others are not affected                         #
+# The socket buffers of the slow client take a few MB before it is behind, so   #
+# the readers get some GB over the loopback.                                    #
+# Usage: ssetest. Exits with 1 when a check fails. Takes about 10 s.           #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "sse.h"
+#include "testutil.h"
+
+#define IDLE_CLIENTS 400
+#define BATCH 100               /* events per batch */
+#define MAX_BATCHES 500         /* give up when the slow client is still there */
+#define PAD "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+
+struct reader {
+  int fd;
+  int closed;
+  long last;                    // seq of the last event
+  long out_of_order;
+  int have;
+  char buf[1024];               // an event not complete yet
+};
+
+static struct reader readers[IDLE_CLIENTS];
+
+
+/* FUNCTION to connect to /events, rcvbuf > 0 sets the receive buffer */
+static int connect_events(int port, int rcvbuf)
+{
+  static const char request[] = "GET /events HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+  struct sockaddr_in sa;
+  int fd;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    perror("socket");
+    exit(EXIT_FAILURE);
+  }
+  if (rcvbuf > 0) {
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  }
+  if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 ||
+      send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != sizeof(request) - 1) {
+    perror("connect");
+    exit(EXIT_FAILURE);
+  }
+  return(fd);
+}
+
+
+/* FUNCTION to take the complete events "data: {"seq":<n>,...}\n\n" from
+*  what a reader got, the headers and other events are skipped
+*/
+static void reader_scan(struct reader *r)
+{
+  char *p = r->buf, *end;
+  long seq;
+
+  r->buf[r->have] = '\0';
+  while ((end = strstr(p, "\n\n")) != NULL) {
+    if (sscanf(p, "data: {\"seq\":%ld", &seq) == 1) {
+      if (seq != r->last + 1) {
+        r->out_of_order++;
+      }
+      r->last = seq;
+    }
+    p = end + 2;
+  }
+  r->have -= p - r->buf;
+  memmove(r->buf, p, r->have);
+}
+
+
+/* FUNCTION to read until every reader has event seq, at most 5 s; returns
+*  the no. of readers that have it
+*/
+static int read_all(long seq)
+{
+  static struct pollfd pfd[IDLE_CLIENTS];
+  struct reader *r;
+  time_t deadline = time(NULL) + 5;
+  int i, n, done;
+  ssize_t got;
+
+  while (time(NULL) < deadline) {
+    for (i = 0, n = 0; i < IDLE_CLIENTS; i++) {
+      if (readers[i].closed || readers[i].last >= seq) {
+        continue;
+      }
+      pfd[n].fd = readers[i].fd;
+      pfd[n].events = POLLIN;
+      n++;
+    }
+    if (n == 0) {
+      break;
+    }
+    if (poll(pfd, n, 100) <= 0) {
+      continue;
+    }
+    for (i = 0; i < n; i++) {
+      if (pfd[i].revents == 0) {
+        continue;
+      }
+      for (r = readers; r->fd != pfd[i].fd; r++);
+      got = recv(r->fd, r->buf + r->have, sizeof(r->buf) - 1 - r->have, MSG_DONTWAIT);
+      if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+        r->closed = 1;
+        continue;
+      }
+      if (got > 0) {
+        r->have += got;
+        reader_scan(r);
+      }
+    }
+  }
+  for (i = 0, done = 0; i < IDLE_CLIENTS; i++) {
+    done += !readers[i].closed && readers[i].last >= seq;
+  }
+  return(done);
+}
+
+
+/* FUNCTION to read what the slow client got, returns 1 when it was closed */
+static int drained_to_close(int fd)
+{
+  char buf[4096];
+  ssize_t got;
+  struct pollfd pfd;
+  int i;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  for (i = 0; i < 1000; i++) {
+    if (poll(&pfd, 1, 100) <= 0) {
+      return(0);
+    }
+    if ((got = recv(fd, buf, sizeof(buf), 0)) <= 0) {
+      return(1);
+    }
+  }
+  return(0);
+}
+
+
+int main(void)
+{
+  struct sockaddr_in sa;
+  socklen_t len = sizeof(sa);
+  struct sse_stats st;
+  struct rlimit rl;
+  char data[SSE_EVENT_SIZE];
+  long seq = 0, out_of_order = 0;
+  int fd, port, slow, i, b, have = 0;
+
+  /* two fds per client in this process */
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < 2 * IDLE_CLIENTS + 64) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+
+  /* a free port */
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+      getsockname(fd, (struct sockaddr *)&sa, &len) < 0) {
+    perror("port");
+    return(1);
+  }
+  port = ntohs(sa.sin_port);
+  close(fd);
+  if (sse_start("127.0.0.1", port) != 0) {
+    fprintf(stderr, "Cannot start the live stream on port %d\n", port);
+    return(1);
+  }
+
+  for (i = 0; i < IDLE_CLIENTS; i++) {
+    readers[i].fd = connect_events(port, 0);
+  }
+  slow = connect_events(port, 4096);
+  for (i = 0; i < 500; i++) {
+    sse_get_stats(&st);
+    if (st.clients == IDLE_CLIENTS + 1) {
+      break;
+    }
+    pause_ms(10);
+  }
+  check(st.clients == IDLE_CLIENTS + 1 && st.rejected == 0, "clients streaming, rejected", st.clients, st.rejected);
+
+  /* batches until the slow client is dropped, and a few more */
+  for (b = 0; b < MAX_BATCHES; b++) {
+    for (i = 0; i < BATCH; i++) {
+      snprintf(data, sizeof(data), "{\"seq\":%ld,\"pad\":\"%s\"}", ++seq, PAD);
+      sse_publish(i % SSE_KEYS, data);
+    }
+    have = read_all(seq);
+    if (have < IDLE_CLIENTS) {
+      break;
+    }
+    sse_get_stats(&st);
+    if (st.lagged > 0 && b >= 10) {
+      break;
+    }
+  }
+  sse_get_stats(&st);
+  check(st.lagged == 1, "slow client dropped as lagged", st.lagged, 1);
+  check(have == IDLE_CLIENTS, "readers with every event", have, IDLE_CLIENTS);
+  for (i = 0; i < IDLE_CLIENTS; i++) {
+    out_of_order += readers[i].out_of_order;
+  }
+  check(out_of_order == 0, "events missed or out of order", out_of_order, 0);
+  check(st.clients == IDLE_CLIENTS && st.events == (unsigned long)seq, "clients streaming, events", st.clients, st.events);
+  check(drained_to_close(slow), "slow client closed by the server", seq, b);
+
+  for (i = 0; i < IDLE_CLIENTS; i++) {
+    close(readers[i].fd);
+  }
+  close(slow);
+  return(test_failed);
+}
@@ -0,0 +1,38 @@
+/*
+#################################################################################
+# testutil.h - Checks and pauses shared by the tests of make check             #
+#                                                                               #
+# check() prints PASS or FAIL with the two values it compared and remembers a  #
+# failure; a test returns test_failed from main().                              #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+#include <stdio.h>
+#include <time.h>
+
+static int test_failed = 0;
+
+
+static inline void check(int ok, const char *what, long a, long b)
+{
+  printf("%s  %-48s %ld %ld\n", ok ? "PASS" : "FAIL", what, a, b);
+  if (!ok) {
+    test_failed = 1;
+  }
+}
+
+
+static inline void pause_ms(long ms)
+{
+  struct timespec pause = { ms / 1000, (ms % 1000) * 1000000L };
+
+  nanosleep(&pause, NULL);
+}
+
+#endif
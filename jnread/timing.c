@@ -0,0 +1,122 @@
+/*
+#################################################################################
+# timing.c - Time measurement per stage of the line processing                 #
+#                                                                               #
+# See timing.h for the interface.                                               #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+
+#include "timing.h"
+
+struct histogram stage_hist[ST_COUNT];
+int timing_enabled = 1;
+
+const char *stage_name[ST_COUNT] = {
+  "read", "line", "parse", "log", "checkpoint", "html", "domoticz", "rrd", "udp", "mqtt",
+  "history", "sse", "latency"
+};
+
+/* stages that are part of ST_LINE, the others run in their own thread */
+static const int in_line[ST_COUNT] = {
+  [ST_PARSE] = 1
+};
+
+
+/* FUNCTION to find the histogram bucket of a duration */
+static int hist_index(long ns)
+{
+  int e;
+
+  if (ns < 4) {
+    return(ns < 0 ? 0 : (int)ns);
+  }
+  e = 63 - __builtin_clzl((unsigned long)ns);
+  if ((e - 1) * HIST_SUB >= HIST_BUCKETS) {
+    return(HIST_BUCKETS - 1);
+  }
+  return((e - 1) * HIST_SUB + (int)((ns >> (e - 2)) & (HIST_SUB - 1)));
+}
+
+
+/* FUNCTION to give the highest duration that falls in a bucket */
+static long hist_upper(int idx)
+{
+  int e, sub;
+
+  if (idx < HIST_SUB) {
+    return(idx);
+  }
+  e = idx / HIST_SUB + 1;
+  sub = idx % HIST_SUB;
+  return(((long)(HIST_SUB + sub) << (e - 2)) + (1L << (e - 2)) - 1);
+}
+
+
+/* single writer per stage: a relaxed load + store is enough (no lock) */
+#define INC(var, n) __atomic_store_n(&(var), __atomic_load_n(&(var), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+
+void timing_add(int stage, long ns)
+{
+  struct histogram *h = &stage_hist[stage];
+
+  INC(h->bucket[hist_index(ns)], 1);
+  INC(h->sum, ns);
+  INC(h->count, 1);
+}
+
+
+/* FUNCTION to give the p-th percentile (0-100) of a histogram in ns */
+long timing_percentile(const struct histogram *h, double p)
+{
+  unsigned long count, want, seen = 0;
+  int i;
+
+  if ((count = __atomic_load_n(&h->count, __ATOMIC_RELAXED)) == 0) {
+    return(0);
+  }
+  want = (unsigned long)(count * p / 100.0);
+  if (want >= count) {
+    want = count - 1;
+  }
+  for (i = 0; i < HIST_BUCKETS; i++) {
+    seen += __atomic_load_n(&h->bucket[i], __ATOMIC_RELAXED);
+    if (seen > want) {
+      return(hist_upper(i));
+    }
+  }
+  return(hist_upper(HIST_BUCKETS - 1));
+}
+
+
+/* FUNCTION to print throughput, latency and the time spent per stage */
+void timing_report(FILE *fp, long lines, double secs)
+{
+  const struct histogram *line = &stage_hist[ST_LINE];
+  double busy = (double)line->sum;
+  int i;
+
+  fprintf(fp, "lines: %ld in %.3f s, %.0f lines/sec\n", lines, secs, secs > 0 ? lines / secs : 0);
+  fprintf(fp, "per line: avg %.2f us, p50 %.2f us, p99 %.2f us\n",
+  line->count ? (double)line->sum / line->count / 1000 : 0,
+  timing_percentile(line, 50) / 1000.0, timing_percentile(line, 99) / 1000.0);
+  fprintf(fp, "%-12s %10s %10s %10s %10s %7s\n", "stage", "count", "avg us", "p50 us", "p99 us", "% line");
+  for (i = 0; i < ST_COUNT; i++) {
+    const struct histogram *h = &stage_hist[i];
+
+    if (h->count == 0) {
+      continue;
+    }
+    fprintf(fp, "%-12s %10lu %10.2f %10.2f %10.2f", stage_name[i], h->count,
+    (double)h->sum / h->count / 1000, timing_percentile(h, 50) / 1000.0, timing_percentile(h, 99) / 1000.0);
+    if (!in_line[i] || busy == 0) {
+      fprintf(fp, "\n");
+    } else {
+      fprintf(fp, " %6.1f%%\n", 100 * (double)h->sum / busy);
+    }
+  }
+}
@@ -0,0 +1,67 @@
+/*
+#################################################################################
+# timing.h - Time measurement per stage of the line processing                 #
+#                                                                               #
+# Every stage keeps a count, a total and a histogram of its durations. The     #
+# histogram has 4 buckets per power of 2 (max. 19% error) from 1 ns to ~18 min. #
+# Each stage is measured by one thread only, the values are stored with       #
+# relaxed atomics so other threads (the stats endpoint) can read them.        #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+#include <time.h>
+
+enum stage {
+  ST_READ,          // get_usb_line() (incl. waiting for data), reader thread
+  ST_LINE,          // processing of one line, processing thread
+  ST_PARSE,         // parse_line() of the line, part of ST_LINE
+  ST_LOG,           // writing ALL_LOG, log thread
+  ST_CHECKPOINT,    // writing ACTUAL_LOG, checkpoint thread
+  ST_HTML,          // writing the html page, html thread
+  ST_DOMOTICZ,      // queueing the Domoticz updates, domoticz thread
+  ST_RRD,           // the round robin archives & RRD update, rrd thread
+  ST_UDP,           // line protocol export, udp thread
+  ST_MQTT,          // MQTT publishing, mqtt thread
+  ST_HISTORY,       // the time-series stores, history thread
+  ST_SSE,           // the live stream of readings, sse thread
+  ST_LATENCY,       // from reading a line until it is processed
+  ST_COUNT
+};
+
+#define HIST_SUB 4
+#define HIST_BUCKETS (40 * HIST_SUB)
+
+struct histogram {
+  unsigned long count;
+  unsigned long sum;        // ns
+  unsigned long bucket[HIST_BUCKETS];
+};
+
+extern struct histogram stage_hist[ST_COUNT];
+extern const char *stage_name[ST_COUNT];
+extern int timing_enabled;
+
+static inline long timing_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec * 1000000000L + ts.tv_nsec);
+}
+
+/* Measure the time from TIMING_START(t) to TIMING_STOP(t, stage) */
+#define TIMING_START(t) long t = timing_enabled ? timing_now() : 0
+#define TIMING_STOP(t, st) do { if (timing_enabled) timing_add(st, timing_now() - (t)); } while (0)
+
+void timing_add(int stage, long ns);
+long timing_percentile(const struct histogram *h, double p);
+void timing_report(FILE *fp, long lines, double secs);
+
+#endif
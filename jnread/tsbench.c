@@ -0,0 +1,177 @@
+/*
+#################################################################################
+# tsbench.c - Benchmark of the time-series store of the history                 #
+#                                                                               #
+# Writes years of power samples every 10 s (as the SensorNode sends them) to    #
+# a new store in <dir>, then times queries like "jnread query" does: the        #
+# value at a time, aggregates over a day, a month and all years, per hour       #
+# of a month and per day of all years, and the samples of an hour. Every        #
+# aggregate is checked against the sum of the samples by tsdb_scan().           #
+#                                                                               #
+# Usage: tsbench <dir> [years]     (default 3)                                  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tsdb.h"
+
+#define INTERVAL 10             /* s between samples */
+#define START 1577836800L       /* 01-01-2020 */
+#define DAY 86400L
+#define QUERIES 20              /* of every kind, at random times */
+
+static struct tsdb ts;
+static unsigned long seed = 1;
+
+static unsigned long rnd(void)
+{
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return(seed >> 33);
+}
+
+
+double now_ms()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec * 1e3 + ts.tv_nsec / 1e6);
+}
+
+
+struct sum {
+  long count;
+  long sum;
+};
+
+static void add_sample(void *arg, time_t t, long v)
+{
+  struct sum *s = arg;
+
+  s->count++;
+  s->sum += v;
+}
+
+
+/* FUNCTION to time QUERIES aggregates of span seconds per step,
+*  returns the no. of aggregates that differ from the samples
+*/
+int bench_aggregate(const char *name, long span, long step, long last)
+{
+  static struct tsdb_agg agg[100000];
+  struct sum s;
+  double t0, t_agg = 0, t_scan = 0;
+  time_t start;
+  long n, i, count, sum;
+  int q, errors = 0;
+
+  for (q = 0; q < QUERIES; q++) {
+    start = START + (span < last - START ? (long)(rnd() % (last - START - span)) : 0);
+    t0 = now_ms();
+    n = tsdb_aggregate(&ts, start, start + span - 1, step, agg, 100000);
+    t_agg += now_ms() - t0;
+    for (count = sum = 0, i = 0; i < n; i++) {
+      count += agg[i].count;
+      sum += agg[i].sum;
+    }
+    memset(&s, 0, sizeof(s));
+    t0 = now_ms();
+    tsdb_scan(&ts, start, start + span - 1, add_sample, &s);
+    t_scan += now_ms() - t0;
+    if (count != s.count || sum != s.sum) {
+      errors++;
+    }
+  }
+  printf("  %-26s %8.3f ms  (all samples: %8.3f ms)\n", name, t_agg / QUERIES, t_scan / QUERIES);
+  return(errors);
+}
+
+
+int main(int argc, char *argv[])
+{
+  char base[512];
+  double t0, secs;
+  long years, samples, i, v = 1000, found_v;
+  time_t t, found, last;
+  struct sum s;
+  int q, errors = 0;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <dir> [years]\n", argv[0]);
+    return(1);
+  }
+  years = (argc > 2) ? atol(argv[2]) : 3;
+  mkdir(argv[1], 0755);
+  /* always a new store */
+  snprintf(base, sizeof(base), "%s/electricity_power.tsd", argv[1]);
+  unlink(base);
+  snprintf(base, sizeof(base), "%s/electricity_power.tsi", argv[1]);
+  unlink(base);
+  snprintf(base, sizeof(base), "%s/electricity_power", argv[1]);
+
+  /* write: a random walk of the power, now and then a jump */
+  if (tsdb_open(&ts, base, 1, 1) != 0) {
+    fprintf(stderr, "Can't create %s\n", base);
+    return(1);
+  }
+  samples = years * 365 * DAY / INTERVAL;
+  t0 = now_ms();
+  for (i = 0; i < samples; i++) {
+    v += (long)(rnd() % 41) - 20;
+    if (rnd() % 100 == 0) v = 100 + rnd() % 3000;
+    if (v < 0) v = 0;
+    tsdb_append(&ts, START + i * INTERVAL + (long)(rnd() % 3), v);
+  }
+  tsdb_close(&ts);
+  secs = (now_ms() - t0) / 1e3;
+  last = START + samples * INTERVAL;
+
+  if (tsdb_open(&ts, base, 0, 0) != 0) {
+    fprintf(stderr, "Can't open %s\n", base);
+    return(1);
+  }
+  printf("time-series store, %ld years, %ld samples:\n", years, samples);
+  printf("  write                      %8.1f ns per sample\n", secs * 1e9 / samples);
+  printf("  size                       %8.2f bytes per sample (%ld blocks)\n",
+  (double)(ts.index_size + ts.data_size) / samples, ts.n_blocks);
+
+  /* the value at a time */
+  t0 = now_ms();
+  for (q = 0; q < QUERIES; q++) {
+    t = START + (long)(rnd() % (last - START));
+    if (tsdb_at(&ts, t, &found, &found_v) != 0 || found > t || t - found > INTERVAL + 2) {
+      errors++;
+    }
+  }
+  printf("  value at a time            %8.3f ms\n", (now_ms() - t0) / QUERIES);
+
+  errors += bench_aggregate("aggregate of a day", DAY, 0, last);
+  errors += bench_aggregate("aggregate of a month", 30 * DAY, 0, last);
+  errors += bench_aggregate("aggregate of all years", last - START, 0, last);
+  errors += bench_aggregate("per hour of a month", 30 * DAY, 3600, last);
+  errors += bench_aggregate("per day of all years", last - START, DAY, last);
+
+  t0 = now_ms();
+  for (q = 0; q < QUERIES; q++) {
+    t = START + (long)(rnd() % (last - START - 3600));
+    memset(&s, 0, sizeof(s));
+    tsdb_scan(&ts, t, t + 3599, add_sample, &s);
+  }
+  printf("  samples of an hour         %8.3f ms\n", (now_ms() - t0) / QUERIES);
+  tsdb_close(&ts);
+
+  if (errors != 0) {
+    fprintf(stderr, "%d queries with a wrong result\n", errors);
+    return(1);
+  }
+  return(0);
+}
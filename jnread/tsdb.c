@@ -0,0 +1,480 @@
+/*
+#################################################################################
+# tsdb.c - Columnar time-series store for the history of all series             #
+#                                                                               #
+# See tsdb.h for the interface.                                                 #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tsdb.h"
+
+#define TSDB_MAGIC "JNTSI01"
+#define VARINT_MAX 10           /* bytes of a 64 bit varint */
+
+static struct tsdb_stats stats;
+
+#define ADD(var, n) __atomic_store_n(&(var), (var) + (n), __ATOMIC_RELAXED)
+
+
+/* FUNCTIONs for the varints, zigzag maps small negative values to small
+*  positive ones (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...)
+*/
+static int put_varint(unsigned char *p, unsigned long u)
+{
+  int len = 0;
+
+  while (u >= 0x80) {
+    p[len++] = (u & 0x7f) | 0x80;
+    u >>= 7;
+  }
+  p[len++] = u;
+  return(len);
+}
+
+static const unsigned char *get_varint(const unsigned char *p, const unsigned char *end, unsigned long *u)
+{
+  int shift;
+
+  *u = 0;
+  for (shift = 0; p < end && shift < 7 * VARINT_MAX; shift += 7) {
+    *u |= (unsigned long)(*p & 0x7f) << shift;
+    if ((*p++ & 0x80) == 0) {
+      return(p);
+    }
+  }
+  return(NULL);
+}
+
+#define ZIGZAG(v) (((unsigned long)(v) << 1) ^ (unsigned long)((v) >> 63))
+#define UNZIGZAG(u) ((long)((u) >> 1) ^ -(long)((u) & 1))
+
+
+/* FUNCTION to cut off what the writer left without a record (a crash
+*  between writing the data and the index), returns 0 when done
+*/
+static int tsdb_recover(struct tsdb *ts, off_t index_size)
+{
+  struct tsdb_block b;
+  struct stat st;
+  long n;
+
+  if (fstat(ts->fd, &st) != 0) {
+    return(1);
+  }
+  n = (index_size - (off_t)sizeof(struct tsdb_header)) / (off_t)sizeof(b);
+  for (; n > 0; n--) {
+    if (pread(ts->ifd, &b, sizeof(b), sizeof(struct tsdb_header) + (n - 1) * sizeof(b)) == sizeof(b) &&
+        b.offset + b.t_bytes + b.v_bytes <= st.st_size) {
+      break;
+    }
+  }
+  ts->index_end = sizeof(struct tsdb_header) + n * sizeof(b);
+  ts->data_end = n > 0 ? b.offset + b.t_bytes + b.v_bytes : 0;
+  ts->last_t = n > 0 ? b.t_last : -1;
+  if (ftruncate(ts->ifd, ts->index_end) != 0 || ftruncate(ts->fd, ts->data_end) != 0) {
+    return(1);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to map the files for reading, only the records with all their
+*  data in the file are used. Returns 0 when done.
+*/
+static int tsdb_map(struct tsdb *ts, off_t index_size)
+{
+  const struct tsdb_block *b;
+  struct stat st;
+  void *map;
+
+  if (fstat(ts->fd, &st) != 0) {
+    return(1);
+  }
+  ts->n_blocks = (index_size - (off_t)sizeof(struct tsdb_header)) / (off_t)sizeof(struct tsdb_block);
+  if (ts->n_blocks > 0) {
+    ts->index_size = index_size;
+    if ((map = mmap(NULL, ts->index_size, PROT_READ, MAP_SHARED, ts->ifd, 0)) == MAP_FAILED) {
+      ts->index_size = 0;
+      return(1);
+    }
+    ts->index = (const struct tsdb_block *)((const char *)map + sizeof(struct tsdb_header));
+  }
+  if (st.st_size > 0) {
+    ts->data_size = st.st_size;
+    if ((map = mmap(NULL, ts->data_size, PROT_READ, MAP_SHARED, ts->fd, 0)) == MAP_FAILED) {
+      ts->data_size = 0;
+      return(1);
+    }
+    ts->data = map;
+  }
+  for (b = ts->index + ts->n_blocks - 1; ts->n_blocks > 0; b--, ts->n_blocks--) {
+    if (b->offset >= 0 && b->offset + b->t_bytes + b->v_bytes <= (long)ts->data_size) {
+      break;
+    }
+  }
+  return(0);
+}
+
+
+/* FUNCTION to open the store <base>.tsd/<base>.tsi, for writing it is
+*  created when missing (scale is only used then), for reading it must
+*  exist. Returns 0 when opened.
+*/
+int tsdb_open(struct tsdb *ts, const char *base, long scale, int writing)
+{
+  struct tsdb_header hdr;
+  struct stat st;
+  char path[512];
+  int flags = writing ? O_RDWR | O_CREAT : O_RDONLY;
+
+  /* the samples of the block are last and need no clearing */
+  memset(ts, 0, sizeof(*ts) - sizeof(ts->t) - sizeof(ts->v));
+  ts->fd = ts->ifd = -1;
+  ts->last_t = -1;
+  ts->writing = writing;
+  snprintf(path, sizeof(path), "%s.tsi", base);
+  if ((ts->ifd = open(path, flags | O_CLOEXEC, 0644)) < 0 || fstat(ts->ifd, &st) != 0) {
+    tsdb_close(ts);
+    return(1);
+  }
+  if (st.st_size == 0 && writing && scale > 0) {
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TSDB_MAGIC, sizeof(hdr.magic));
+    hdr.scale = scale;
+    if (pwrite(ts->ifd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+      tsdb_close(ts);
+      return(1);
+    }
+    st.st_size = sizeof(hdr);
+  } else if (pread(ts->ifd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+             memcmp(hdr.magic, TSDB_MAGIC, sizeof(hdr.magic)) != 0 || hdr.scale < 1) {
+    tsdb_close(ts);
+    return(1);
+  }
+  ts->scale = hdr.scale;
+  snprintf(path, sizeof(path), "%s.tsd", base);
+  if ((ts->fd = open(path, flags | O_CLOEXEC, 0644)) < 0 ||
+      (writing ? tsdb_recover(ts, st.st_size) : tsdb_map(ts, st.st_size)) != 0) {
+    tsdb_close(ts);
+    return(1);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to add a sample, returns 1 when it is not added (older than
+*  the last sample, or the store is not open for writing)
+*/
+int tsdb_append(struct tsdb *ts, time_t t, double value)
+{
+  if (ts->ifd < 0 || !ts->writing || isnan(value)) {
+    return(1);
+  }
+  if (t < ts->last_t) {
+    ADD(stats.rejected, 1);
+    return(1);
+  }
+  if (ts->n == 0) {
+    ts->started = time(NULL);
+  }
+  ts->t[ts->n] = t;
+  ts->v[ts->n] = llround(value * ts->scale);
+  ts->n++;
+  ts->last_t = t;
+  ADD(stats.samples, 1);
+  if (ts->n == TSDB_BLOCK) {
+    tsdb_flush(ts);
+  }
+  return(0);
+}
+
+
+/* FUNCTION to write the block being filled: the columns, then the record */
+void tsdb_flush(struct tsdb *ts)
+{
+  unsigned char buf[2 * TSDB_BLOCK * VARINT_MAX];
+  struct tsdb_block b;
+  int len = 0, i;
+
+  if (ts->n == 0 || ts->ifd < 0) {
+    return;
+  }
+  memset(&b, 0, sizeof(b));
+  b.t_first = ts->t[0];
+  b.t_last = ts->t[ts->n - 1];
+  b.v_first = ts->v[0];
+  b.v_last = ts->v[ts->n - 1];
+  b.min = b.max = ts->v[0];
+  for (i = 0; i < ts->n; i++) {
+    if (ts->v[i] < b.min) b.min = ts->v[i];
+    if (ts->v[i] > b.max) b.max = ts->v[i];
+    b.sum += ts->v[i];
+  }
+  for (i = 1; i < ts->n; i++) {
+    len += put_varint(buf + len, ts->t[i] - ts->t[i - 1]);
+  }
+  b.t_bytes = len;
+  for (i = 1; i < ts->n; i++) {
+    len += put_varint(buf + len, ZIGZAG(ts->v[i] - ts->v[i - 1]));
+  }
+  b.v_bytes = len - b.t_bytes;
+  b.offset = ts->data_end;
+  b.n = ts->n;
+  ts->n = 0;
+
+  if (pwrite(ts->fd, buf, len, ts->data_end) != len ||
+      pwrite(ts->ifd, &b, sizeof(b), ts->index_end) != sizeof(b)) {
+    ADD(stats.failed, 1);
+    return;
+  }
+  ts->data_end += len;
+  ts->index_end += sizeof(b);
+  ADD(stats.blocks, 1);
+  ADD(stats.bytes, len + sizeof(b));
+}
+
+
+/* FUNCTION to write the block being filled when it was started at least
+*  TSDB_FLUSH_INTERVAL ago, so a quiet series is on disk in time
+*/
+void tsdb_flush_due(struct tsdb *ts, time_t now)
+{
+  if (ts->n > 0 && now - ts->started >= TSDB_FLUSH_INTERVAL) {
+    tsdb_flush(ts);
+  }
+}
+
+
+void tsdb_close(struct tsdb *ts)
+{
+  if (ts->writing) {
+    tsdb_flush(ts);
+  }
+  if (ts->index_size > 0) {
+    munmap((char *)ts->index - sizeof(struct tsdb_header), ts->index_size);
+  }
+  if (ts->data_size > 0) {
+    munmap((void *)ts->data, ts->data_size);
+  }
+  if (ts->fd >= 0) {
+    close(ts->fd);
+  }
+  if (ts->ifd >= 0) {
+    close(ts->ifd);
+  }
+  ts->fd = ts->ifd = -1;
+  ts->index = NULL;
+  ts->data = NULL;
+  ts->n_blocks = 0;
+  ts->index_size = ts->data_size = 0;
+}
+
+
+/* FUNCTION to decode a block into t and v (TSDB_BLOCK each),
+*  returns the no. of samples or -1 when the block is corrupt
+*/
+static int tsdb_decode(const struct tsdb *ts, const struct tsdb_block *b, long *t, long *v)
+{
+  const unsigned char *p, *end;
+  unsigned long u;
+  int i;
+
+  if (b->n < 1 || b->n > TSDB_BLOCK || b->t_bytes < 0 || b->v_bytes < 0 || b->offset < 0 ||
+      b->offset + b->t_bytes + b->v_bytes > (long)ts->data_size) {
+    return(-1);
+  }
+  t[0] = b->t_first;
+  v[0] = b->v_first;
+  p = ts->data + b->offset;
+  end = p + b->t_bytes;
+  for (i = 1; i < b->n; i++) {
+    if ((p = get_varint(p, end, &u)) == NULL) {
+      return(-1);
+    }
+    t[i] = t[i - 1] + (long)u;
+  }
+  p = ts->data + b->offset + b->t_bytes;
+  end = p + b->v_bytes;
+  for (i = 1; i < b->n; i++) {
+    if ((p = get_varint(p, end, &u)) == NULL) {
+      return(-1);
+    }
+    v[i] = v[i - 1] + UNZIGZAG(u);
+  }
+  return(b->n);
+}
+
+
+/* FUNCTION to find the first block that ends at or after t */
+static long tsdb_find(const struct tsdb *ts, time_t t)
+{
+  long lo = 0, hi = ts->n_blocks, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (ts->index[mid].t_last < t) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return(lo);
+}
+
+
+/* FUNCTION to call fn for every sample from start to end (incl.),
+*  returns the no. of samples
+*/
+long tsdb_scan(const struct tsdb *ts, time_t start, time_t end,
+  void (*fn)(void *arg, time_t t, long v), void *arg)
+{
+  long t[TSDB_BLOCK], v[TSDB_BLOCK];
+  long i, count = 0;
+  int j, n;
+
+  for (i = tsdb_find(ts, start); i < ts->n_blocks && ts->index[i].t_first <= end; i++) {
+    n = tsdb_decode(ts, &ts->index[i], t, v);
+    for (j = 0; j < n; j++) {
+      if (t[j] >= start && t[j] <= end) {
+        fn(arg, t[j], v[j]);
+        count++;
+      }
+    }
+  }
+  return(count);
+}
+
+
+static void agg_sample(struct tsdb_agg *a, long t, long v)
+{
+  if (a->count++ == 0) {
+    a->t_first = t;
+    a->first = a->min = a->max = v;
+  }
+  if (v < a->min) a->min = v;
+  if (v > a->max) a->max = v;
+  a->sum += v;
+  a->t_last = t;
+  a->last = v;
+}
+
+static void agg_block(struct tsdb_agg *a, const struct tsdb_block *b)
+{
+  if (a->count == 0) {
+    a->t_first = b->t_first;
+    a->first = b->v_first;
+    a->min = b->min;
+    a->max = b->max;
+  }
+  if (b->min < a->min) a->min = b->min;
+  if (b->max > a->max) a->max = b->max;
+  a->count += b->n;
+  a->sum += b->sum;
+  a->t_last = b->t_last;
+  a->last = b->v_last;
+}
+
+
+/* FUNCTION to aggregate the samples from start to end (incl.), per interval
+*  of step seconds (intervals start at a multiple of step, the first and
+*  last only have the samples in the range) or, with step 0, over the whole
+*  range. Returns the no. of intervals in agg, at most max.
+*/
+long tsdb_aggregate(const struct tsdb *ts, time_t start, time_t end, long step,
+  struct tsdb_agg *agg, long max)
+{
+  const struct tsdb_block *b;
+  long t[TSDB_BLOCK], v[TSDB_BLOCK];
+  long first = 0, n_agg = 1, i, k, next;
+  int j, n;
+
+  if (end < start || max < 1) {
+    return(0);
+  }
+  if (step > 0) {
+    first = start / step;
+    n_agg = end / step - first + 1;
+    if (n_agg > max) {
+      n_agg = max;
+      end = (first + n_agg) * step - 1;
+    }
+  }
+  memset(agg, 0, n_agg * sizeof(*agg));
+  for (i = 0; i < n_agg; i++) {
+    agg[i].start = step > 0 ? (first + i) * step : start;
+  }
+
+  for (i = tsdb_find(ts, start); i < ts->n_blocks && ts->index[i].t_first <= end; i++) {
+    b = &ts->index[i];
+    /* a block in one interval: its record is enough */
+    if (b->t_first >= start && b->t_last <= end &&
+        (step <= 0 || b->t_first / step == b->t_last / step)) {
+      agg_block(&agg[step > 0 ? b->t_first / step - first : 0], b);
+      continue;
+    }
+    /* the samples are in time order: only divide at a new interval */
+    n = tsdb_decode(ts, b, t, v);
+    for (k = 0, next = step > 0 ? 0 : end + 1, j = 0; j < n; j++) {
+      if (t[j] < start || t[j] > end) {
+        continue;
+      }
+      if (t[j] >= next) {
+        k = t[j] / step - first;
+        next = (first + k + 1) * step;
+      }
+      agg_sample(&agg[k], t[j], v[j]);
+    }
+  }
+  return(n_agg);
+}
+
+
+/* FUNCTION to get the last sample at or before t, returns 0 when found */
+int tsdb_at(const struct tsdb *ts, time_t t, time_t *found, long *v)
+{
+  long tt[TSDB_BLOCK], vv[TSDB_BLOCK];
+  long lo = 0, hi = ts->n_blocks, mid;
+  int j;
+
+  /* the last block that starts at or before t */
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (ts->index[mid].t_first <= t) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    return(1);
+  }
+  for (j = tsdb_decode(ts, &ts->index[lo - 1], tt, vv) - 1; j >= 0; j--) {
+    if (tt[j] <= t) {
+      *found = tt[j];
+      *v = vv[j];
+      return(0);
+    }
+  }
+  return(1);
+}
+
+
+void tsdb_get_stats(struct tsdb_stats *st)
+{
+  __atomic_load(&stats.samples, &st->samples, __ATOMIC_RELAXED);
+  __atomic_load(&stats.rejected, &st->rejected, __ATOMIC_RELAXED);
+  __atomic_load(&stats.blocks, &st->blocks, __ATOMIC_RELAXED);
+  __atomic_load(&stats.bytes, &st->bytes, __ATOMIC_RELAXED);
+  __atomic_load(&stats.failed, &st->failed, __ATOMIC_RELAXED);
+}
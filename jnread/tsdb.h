@@ -0,0 +1,113 @@
+/*
+#################################################################################
+# tsdb.h - Columnar time-series store for the history of all series             #
+#                                                                               #
+# Every series has an append-only store of two files: <name>.tsd with the       #
+# data and <name>.tsi with the index. Samples are collected in a block of at    #
+# most TSDB_BLOCK samples, which is written as two columns when it is full or   #
+# tsdb_flush() is called:                                                       #
+#   times   varint of the delta to the previous time                            #
+#   values  zigzag varint of the delta to the previous value                    #
+# (the first sample of a block is in its index record). Values are stored as    #
+# integers in 1/scale units (scale 10 for 0.1 degrees), so sums are exact.      #
+# The index has a record per block with its time range, count, first, last,     #
+# min, max and sum and where its data is. The records are in time order, so     #
+# a range is found by binary search and an aggregate only decodes the blocks    #
+# at the edges of the range (or of an interval), the others use the record.     #
+# The data of a block is written before its record and a reader only uses       #
+# records with complete data; the writer cuts off data without a record         #
+# when it opens the store. Samples older than the last one are rejected.        #
+# A store is written by one thread, readers open it read-only and see the       #
+# blocks written until then.                                                    #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef TSDB_H
+#define TSDB_H
+
+#include <time.h>
+
+#define TSDB_BLOCK 1024         /* max. samples per block */
+#define TSDB_FLUSH_INTERVAL 300 /* s, tsdb_flush_due() writes an older block */
+
+struct tsdb_header {
+  char magic[8];
+  long scale;                   // stored value = value * scale
+  long reserved[2];
+};
+
+/* index record of a block, values in 1/scale units */
+struct tsdb_block {
+  long t_first;
+  long t_last;
+  long v_first;
+  long v_last;
+  long min;
+  long max;
+  long sum;
+  long offset;                  // of the times column in the data file
+  int n;                        // no. of samples
+  int t_bytes;                  // size of the times column
+  int v_bytes;                  // size of the values column (after the times)
+  int pad;
+};
+
+struct tsdb {
+  int fd;                       // data file
+  int ifd;                      // index file
+  int writing;
+  long scale;
+  /* reading: the files mapped as they were when opened */
+  const struct tsdb_block *index;
+  long n_blocks;
+  size_t index_size;
+  const unsigned char *data;
+  size_t data_size;
+  /* writing: the block being filled */
+  long data_end;
+  long index_end;
+  long last_t;                  // time of the last sample, -1 = none
+  time_t started;               // when the first sample of the block came
+  int n;
+  long t[TSDB_BLOCK];
+  long v[TSDB_BLOCK];
+};
+
+/* aggregate of an interval, values in 1/scale units */
+struct tsdb_agg {
+  long start;                   // start of the interval
+  long count;                   // 0 = no samples, the values are 0
+  long t_first;
+  long t_last;
+  long first;
+  long last;
+  long min;
+  long max;
+  long sum;
+};
+
+struct tsdb_stats {
+  unsigned long samples;        // samples added
+  unsigned long rejected;       // samples older than the last one
+  unsigned long blocks;         // blocks written
+  unsigned long bytes;          // bytes of data written
+  unsigned long failed;         // blocks that could not be written
+};
+
+int tsdb_open(struct tsdb *ts, const char *base, long scale, int writing);
+int tsdb_append(struct tsdb *ts, time_t t, double value);
+void tsdb_flush(struct tsdb *ts);
+void tsdb_flush_due(struct tsdb *ts, time_t now);
+void tsdb_close(struct tsdb *ts);
+
+long tsdb_scan(const struct tsdb *ts, time_t start, time_t end,
+  void (*fn)(void *arg, time_t t, long v), void *arg);
+long tsdb_aggregate(const struct tsdb *ts, time_t start, time_t end, long step,
+  struct tsdb_agg *agg, long max);
+int tsdb_at(const struct tsdb *ts, time_t t, time_t *found, long *v);
+void tsdb_get_stats(struct tsdb_stats *st);
+
+#endif
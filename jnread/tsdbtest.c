@@ -0,0 +1,219 @@
+/*
+#################################################################################
+# tsdbtest.c - Test of the range queries of the time-series store              #
+#                                                                               #
+# Writes a sample every 10 s from 28-03-2026 to 02-04-2026 in the time zone    #
+# of the Netherlands (the clocks go forward on 29-03), with a flush in the    #
+# middle of a block and a sample older than the last one. The store is opened #
+# again for reading and every query is compared with the samples themselves:  #
+# - aggregates of the local days before, on and after the change (24, 23 and  #
+#   24 hours) and of March up to the month boundary                             #
+# - per hour over midnight and the change, per day from midnight to midnight  #
+# - the samples of a range that starts and ends inside a block                  #
+# - the value at a time between two samples and before the first one           #
+# Usage: tsdbtest. Exits with 1 when a check fails.                            #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tsdb.h"
+#include "testutil.h"
+
+#define TZ_NL "CET-1CEST,M3.5.0,M10.5.0/3"
+#define INTERVAL 10             /* s between samples */
+#define SCALE 10
+#define HOUR 3600L
+#define DAY 86400L
+
+static time_t first_t;          // time of the first sample
+static long n_samples;
+
+
+/* FUNCTION to get the local time of a date, hour 0 is midnight */
+static time_t local(int y, int m, int d, int h)
+{
+  struct tm tm;
+
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = y - 1900;
+  tm.tm_mon = m - 1;
+  tm.tm_mday = d;
+  tm.tm_hour = h;
+  tm.tm_isdst = -1;
+  return(mktime(&tm));
+}
+
+
+/* the samples: a saw tooth with negative values, in 1/SCALE units */
+static long sample_v(long i)
+{
+  return((i * 37) % 2000 - 500);
+}
+
+
+/* FUNCTION to aggregate the samples from start to end (incl.) directly */
+static void expect(time_t start, time_t end, struct tsdb_agg *a)
+{
+  long i, t, v;
+
+  memset(a, 0, sizeof(*a));
+  for (i = 0; i < n_samples; i++) {
+    t = first_t + i * INTERVAL;
+    v = sample_v(i);
+    if (t < start || t > end) {
+      continue;
+    }
+    if (a->count++ == 0) {
+      a->t_first = t;
+      a->first = a->min = a->max = v;
+    }
+    if (v < a->min) a->min = v;
+    if (v > a->max) a->max = v;
+    a->sum += v;
+    a->t_last = t;
+    a->last = v;
+  }
+}
+
+
+static int same(const struct tsdb_agg *a, const struct tsdb_agg *b)
+{
+  return(a->count == b->count && a->sum == b->sum && a->min == b->min && a->max == b->max &&
+         a->first == b->first && a->last == b->last && a->t_first == b->t_first && a->t_last == b->t_last);
+}
+
+
+/* FUNCTION to check the aggregate of a range, with the expected no. of samples */
+static void check_range(struct tsdb *ts, const char *what, time_t start, time_t end, long count)
+{
+  struct tsdb_agg got, want;
+
+  tsdb_aggregate(ts, start, end, 0, &got, 1);
+  expect(start, end, &want);
+  check(same(&got, &want) && got.count == count, what, got.count, count);
+}
+
+
+struct sum {
+  long count;
+  long sum;
+};
+
+static void add_sample(void *arg, time_t t, long v)
+{
+  struct sum *s = arg;
+
+  s->count++;
+  s->sum += v;
+}
+
+
+int main(void)
+{
+  static struct tsdb ts;
+  struct tsdb_agg agg[48], want;
+  struct tsdb_stats st;
+  struct sum s;
+  char dir[64], base[128];
+  time_t start, end, found;
+  long i, n, bad, v;
+
+  setenv("TZ", TZ_NL, 1);
+  tzset();
+  snprintf(dir, sizeof(dir), "/tmp/tsdbtest.%d", (int)getpid());
+  mkdir(dir, 0755);
+  snprintf(base, sizeof(base), "%s/electricity_power", dir);
+
+  first_t = local(2026, 3, 28, 0);
+  n_samples = (local(2026, 4, 2, 0) - first_t) / INTERVAL;
+  if (tsdb_open(&ts, base, SCALE, 1) != 0) {
+    fprintf(stderr, "Can't create %s\n", base);
+    return(1);
+  }
+  for (i = 0; i < n_samples; i++) {
+    tsdb_append(&ts, first_t + i * INTERVAL, (double)sample_v(i) / SCALE);
+    if (i == n_samples / 2) {
+      tsdb_flush(&ts);
+      check(tsdb_append(&ts, first_t, 1.0) == 1, "older sample rejected", 1, 0);
+    }
+  }
+  tsdb_close(&ts);
+  tsdb_get_stats(&st);
+  check(st.samples == (unsigned long)n_samples && st.rejected == 1, "samples, rejected", st.samples, st.rejected);
+
+  if (tsdb_open(&ts, base, 0, 0) != 0) {
+    fprintf(stderr, "Can't open %s\n", base);
+    return(1);
+  }
+  /* full blocks and the rest on both sides of the flush */
+  n = (n_samples / 2 + 1 + TSDB_BLOCK - 1) / TSDB_BLOCK + (n_samples - n_samples / 2 - 1 + TSDB_BLOCK - 1) / TSDB_BLOCK;
+  check(ts.scale == SCALE && ts.n_blocks == n, "scale, blocks", ts.scale, ts.n_blocks);
+
+  /* local days: 29-03 has 23 hours */
+  check_range(&ts, "day before the change", local(2026, 3, 28, 0), local(2026, 3, 29, 0) - 1, DAY / INTERVAL);
+  check_range(&ts, "day of the change (23 h)", local(2026, 3, 29, 0), local(2026, 3, 30, 0) - 1, 23 * HOUR / INTERVAL);
+  check_range(&ts, "day after the change", local(2026, 3, 30, 0), local(2026, 3, 31, 0) - 1, DAY / INTERVAL);
+  check_range(&ts, "march, up to the month boundary", local(2026, 3, 1, 0), local(2026, 4, 1, 0) - 1,
+              (local(2026, 4, 1, 0) - first_t) / INTERVAL);
+  check_range(&ts, "over the month boundary", local(2026, 3, 31, 23), local(2026, 4, 1, 1) - 1, 2 * HOUR / INTERVAL);
+
+  /* per hour from 22:00 to 04:00 over midnight and the change: 5 hours */
+  start = local(2026, 3, 28, 22);
+  end = local(2026, 3, 29, 4) - 1;
+  n = tsdb_aggregate(&ts, start, end, HOUR, agg, 48);
+  for (i = 0, bad = 0; i < n; i++) {
+    expect(agg[i].start, agg[i].start + HOUR - 1, &want);
+    want.start = agg[i].start;
+    if (!same(&agg[i], &want) || agg[i].count != HOUR / INTERVAL) {
+      bad++;
+    }
+  }
+  check(n == 5 && bad == 0, "per hour over midnight and the change", n, bad);
+
+  /* per day (UTC) of a range from local midnight to midnight: the first
+  *  and the last interval only have the samples in the range
+  */
+  start = local(2026, 3, 29, 0);
+  end = local(2026, 3, 31, 0) - 1;
+  n = tsdb_aggregate(&ts, start, end, DAY, agg, 48);
+  for (i = 0, bad = 0, v = 0; i < n; i++) {
+    expect(agg[i].start < start ? start : agg[i].start,
+           agg[i].start + DAY - 1 > end ? end : agg[i].start + DAY - 1, &want);
+    if (agg[i].count != want.count || agg[i].sum != want.sum || agg[i].min != want.min || agg[i].max != want.max) {
+      bad++;
+    }
+    v += agg[i].count;
+  }
+  check(n == 3 && bad == 0 && v == 47 * HOUR / INTERVAL, "per day, cut at the range", n, bad);
+
+  /* a range inside blocks */
+  start = first_t + 12345;
+  end = first_t + 3 * DAY + 54321;
+  memset(&s, 0, sizeof(s));
+  tsdb_scan(&ts, start, end, add_sample, &s);
+  expect(start, end, &want);
+  check(s.count == want.count && s.sum == want.sum, "samples of a range inside blocks", s.count, want.count);
+
+  start = local(2026, 3, 29, 3);
+  n = tsdb_at(&ts, start + 15, &found, &v);
+  check(n == 0 && found == start + 10 && v == sample_v((found - first_t) / INTERVAL),
+        "value between two samples", found - start, 10);
+  check(tsdb_at(&ts, first_t - 1, &found, &v) == 1, "no value before the first sample", 1, 1);
+  tsdb_close(&ts);
+
+  snprintf(base, sizeof(base), "%s/electricity_power.tsd", dir);
+  unlink(base);
+  snprintf(base, sizeof(base), "%s/electricity_power.tsi", dir);
+  unlink(base);
+  rmdir(dir);
+  return(test_failed);
+}
@@ -0,0 +1,120 @@
+/*
+#################################################################################
+# udp.c - Export of measurements as line protocol over UDP                     #
+#                                                                               #
+# See udp.h for the interface.                                                  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "udp.h"
+
+static int sock = -1;
+static char buf[UDP_DATAGRAM];
+static size_t len = 0;
+static struct udp_stats stats;
+
+#define INC(var) __atomic_store_n(&(var), (var) + 1, __ATOMIC_RELAXED)
+
+
+/* FUNCTION to set up the socket for target "host:port", returns 0 when done */
+int udp_open(const char *target)
+{
+  struct addrinfo hints, *res, *ai;
+  char host[128], port[16];
+  const char *colon;
+
+  if ((colon = strrchr(target, ':')) == NULL) {
+    return(1);
+  }
+  snprintf(host, sizeof(host), "%.*s", (int)(colon - target), target);
+  snprintf(port, sizeof(port), "%s", colon + 1);
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  if (getaddrinfo(host, port, &hints, &res) != 0) {
+    return(1);
+  }
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    if ((sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)) < 0) {
+      continue;
+    }
+    /* connected: send() is enough and errors are reported */
+    if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    close(sock);
+    sock = -1;
+  }
+  freeaddrinfo(res);
+  len = 0;
+  return(sock < 0);
+}
+
+
+/* FUNCTION to add a line (without the newline) to the datagram,
+*  returns 1 when the line was too long
+*/
+int udp_line(const char *fmt, ...)
+{
+  char line[UDP_DATAGRAM];
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+  va_end(ap);
+  if (n < 0 || n >= (int)sizeof(line) - 1) {
+    return(1);
+  }
+  line[n++] = '\n';
+  if (len + n > sizeof(buf)) {
+    udp_flush();
+  }
+  memcpy(buf + len, line, n);
+  len += n;
+  INC(stats.lines);
+  return(0);
+}
+
+
+/* FUNCTION to send the collected lines */
+void udp_flush(void)
+{
+  if (len == 0 || sock < 0) {
+    return;
+  }
+  if (send(sock, buf, len, 0) == (ssize_t)len) {
+    INC(stats.datagrams);
+  } else {
+    INC(stats.failed);    // e.g. nobody listening (ECONNREFUSED)
+  }
+  len = 0;
+}
+
+
+void udp_get_stats(struct udp_stats *st)
+{
+  __atomic_load(&stats.lines, &st->lines, __ATOMIC_RELAXED);
+  __atomic_load(&stats.datagrams, &st->datagrams, __ATOMIC_RELAXED);
+  __atomic_load(&stats.failed, &st->failed, __ATOMIC_RELAXED);
+}
+
+
+void udp_close(void)
+{
+  udp_flush();
+  if (sock >= 0) {
+    close(sock);
+    sock = -1;
+  }
+}
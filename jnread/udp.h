@@ -0,0 +1,33 @@
+/*
+#################################################################################
+# udp.h - Export of measurements as line protocol over UDP                     #
+#                                                                               #
+# Lines like "jnread,type=e electricity_power=1234 1792119089000000000" (the  #
+# format of InfluxDB/Telegraf) are collected in a datagram that is sent when  #
+# it is full or udp_flush() is called, so a burst of messages costs only a    #
+# few packets. Only used from one thread.                                     #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef UDP_H
+#define UDP_H
+
+#define UDP_DATAGRAM 1400       /* max. size of a datagram (fits in one frame) */
+
+struct udp_stats {
+  unsigned long lines;      // lines added
+  unsigned long datagrams;  // datagrams sent
+  unsigned long failed;     // datagrams that could not be sent
+};
+
+int udp_open(const char *target);
+int udp_line(const char *fmt, ...)
+  __attribute__ ((format (printf, 1, 2)));
+void udp_flush(void);
+void udp_get_stats(struct udp_stats *st);
+void udp_close(void);
+
+#endif
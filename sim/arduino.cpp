@@ -0,0 +1,481 @@
+/*
+#################################################################################
+# arduino.cpp - Arduino, JeeLib and library calls of the host simulation        #
+#                                                                               #
+# The stand-ins of include/: every call acts on the node that runs (sim_node)   #
+# and takes the modeled time of the ATmega328 (see sim.h). Values of sensors    #
+# come from the hooks of the world around the node.                             #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include "Arduino.h"
+#include "JeeLib.h"
+#include "Metro.h"
+#include "EEPROM.h"
+#include "avr/wdt.h"
+#include "DallasTemperature.h"
+#include "PortsBMP085.h"
+#include "PortsLCD.h"
+#include "GLCD_ST7565.h"
+#include "StopWatch.h"
+#include "Soladin_uart.h"
+#include "EmonLib.h"
+#include "sim.h"
+
+#define COST_LCD_CHAR_US 600
+#define COST_GLCD_REFRESH_US 9000
+#define COST_DS18B20_US 750000
+#define COST_BMP085_TEMP_US 4500
+#define COST_SOLADIN_US 30000           /* query and answer at 9600 baud */
+#define COST_SOLADIN_TIMEOUT_US 200000  /* no answer */
+#define COST_EMON_SAMPLE_US 60          /* float math per sample of calcIrms() */
+
+volatile uint8_t PCICR, PCMSK2, MCUCR;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2;
+volatile uint8_t ADMUX, ADCSRA;
+volatile uint16_t ADC;
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+static double sensor(enum sim_sensor s)
+{
+  if (sim_node == NULL || sim_node->sensor == NULL) {
+    return(0);
+  }
+  return(sim_node->sensor(sim_node, s));
+}
+
+
+/* Arduino core */
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (sim_node != NULL && pin < SIM_PINS) {
+    sim_node->pin[pin] = value != 0;
+  }
+  sim_spend(COST_DIGI_US);
+}
+
+int digitalRead(uint8_t pin)
+{
+  sim_spend(COST_DIGI_US);
+  if (sim_node == NULL || pin >= SIM_PINS) {
+    return(LOW);
+  }
+  return(sim_node->pin[pin]);
+}
+
+/* the input is sampled at the start of the conversion */
+int analogRead(uint8_t pin)
+{
+  int value = 0;
+
+  if (pin >= 14) {
+    pin -= 14;
+  }
+  if (sim_node != NULL && sim_node->analog != NULL) {
+    value = sim_node->analog(sim_node, pin);
+  }
+  sim_spend(COST_ANAREAD_US);
+  return(value);
+}
+
+unsigned long millis(void)
+{
+  return(sim_millis());
+}
+
+unsigned long micros(void)
+{
+  if (sim_node == NULL) {
+    return((uint32_t)(sim_millis0 * 1000UL));
+  }
+  return((uint32_t)(sim_node->now + sim_millis0 * 1000ULL));
+}
+
+void delay(unsigned long ms)
+{
+  sim_spend((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  sim_spend(us);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+  return((x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min);
+}
+
+
+size_t Print::write(const uint8_t *buf, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    write(buf[i]);
+  }
+  return(len);
+}
+
+size_t Print::print(long n, int base)
+{
+  char buf[72];
+
+  if (base == 10) {
+    snprintf(buf, sizeof(buf), "%ld", n);
+    return(write(buf));
+  }
+  return(print((unsigned long)n, base));
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  char buf[72], *p = &buf[sizeof(buf) - 1];
+
+  if (base < 2) {
+    base = 10;
+  }
+  *p = '\0';
+  do {
+    *--p = "0123456789ABCDEF"[n % base];
+    n /= base;
+  } while (n > 0);
+  return(write(p));
+}
+
+size_t Print::print(double n, int digits)
+{
+  char buf[72];
+
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return(write(buf));
+}
+
+int HardwareSerial::available(void)
+{
+  return(sim_serial_available());
+}
+
+int HardwareSerial::read(void)
+{
+  return(sim_serial_read());
+}
+
+void HardwareSerial::flush(void)
+{
+  if (sim_node != NULL && sim_node->ser_until > sim_node->now) {
+    sim_spend(sim_node->ser_until - sim_node->now);
+  }
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  sim_serial_write(c);
+  return(1);
+}
+
+
+/* avr/wdt.h */
+void wdt_enable(int timeout)
+{
+  if (sim_node != NULL) {
+    sim_node->wdt_ms = 15L << timeout;
+    sim_node->wdt_last = sim_node->now;
+  }
+}
+
+void wdt_disable(void)
+{
+  if (sim_node != NULL) {
+    sim_node->wdt_ms = 0;
+  }
+}
+
+void wdt_reset(void)
+{
+  if (sim_node != NULL) {
+    sim_node->wdt_last = sim_node->now;
+  }
+}
+
+
+/* EEPROM.h */
+uint8_t EEPROMClass::read(int address)
+{
+  if (sim_node == NULL) {
+    return(0xFF);
+  }
+  return(sim_node->eeprom[address % SIM_EEPROM]);
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+  if (sim_node != NULL) {
+    sim_node->eeprom[address % SIM_EEPROM] = value;
+    sim_node->eeprom_writes++;
+  }
+  sim_spend(COST_EEPROM_WRITE_US);
+}
+
+
+/* Metro.h: catches up as Metro does */
+Metro::Metro(unsigned long interval_millis) : autoreset(0)
+{
+  interval(interval_millis);
+  reset();
+}
+
+Metro::Metro(unsigned long interval_millis, uint8_t autoreset) : autoreset(autoreset)
+{
+  interval(interval_millis);
+  reset();
+}
+
+void Metro::interval(unsigned long interval_millis)
+{
+  this->interval_millis = interval_millis;
+  period = interval_millis;
+}
+
+void Metro::reset(void)
+{
+  previous_millis = millis();
+}
+
+char Metro::check(void)
+{
+  uint32_t now = millis();
+
+  if (interval_millis == 0) {
+    previous_millis = now;
+    fired(0);
+    return(1);
+  }
+  if (now - previous_millis >= interval_millis) {
+    fired(now - previous_millis - interval_millis);
+    if (autoreset) {
+      previous_millis = now;
+    } else {
+      previous_millis += interval_millis;
+    }
+    return(1);
+  }
+  return(0);
+}
+
+uint32_t Metro::sim_remaining(void)
+{
+  uint32_t d = (uint32_t)millis() - previous_millis;
+
+  return(d >= interval_millis ? 0 : interval_millis - d);
+}
+
+
+/* JeeLib.h */
+uint8_t rf12_initialize(uint8_t id, uint8_t band, uint8_t group)
+{
+  if (sim_node != NULL) {
+    sim_node->rf_id = id & RF12_HDR_MASK;
+    sim_node->rf_band = band;
+    sim_node->rf_group = group;
+    sim_node->rx_on = 0;
+  }
+  return(id);
+}
+
+uint8_t rf12_recvDone(void)
+{
+  return(sim_rf_recv());
+}
+
+uint8_t rf12_canSend(void)
+{
+  return(sim_node != NULL && sim_node->now >= sim_node->tx_until);
+}
+
+void rf12_sendStart(uint8_t hdr, const void *ptr, uint8_t len)
+{
+  sim_rf_send(hdr, ptr, len);
+}
+
+/* waits for the channel (rf12_sendStart() does too in the simulation) */
+void rf12_sendNow(uint8_t hdr, const void *ptr, uint8_t len)
+{
+  sim_rf_send(hdr, ptr, len);
+}
+
+void rf12_sendWait(uint8_t mode)
+{
+  (void)mode;
+  if (sim_node != NULL && sim_node->tx_until > sim_node->now) {
+    sim_spend(sim_node->tx_until - sim_node->now);
+  }
+}
+
+byte MilliTimer::poll(word ms)
+{
+  byte ready = 0;
+
+  if (armed) {
+    word remain = next - millis();
+    if (remain <= 60000) {
+      return(0);
+    }
+    ready = -remain;
+    fired(ready - 1);
+  }
+  set(ms);
+  return(ready);
+}
+
+word MilliTimer::remaining(void) const
+{
+  word remain = armed ? next - millis() : 0;
+
+  return(remain <= 60000 ? remain : 0);
+}
+
+void MilliTimer::set(word ms)
+{
+  armed = ms != 0;
+  if (armed) {
+    next = millis() + ms - 1;
+  }
+}
+
+uint32_t MilliTimer::sim_remaining(void)
+{
+  word remain;
+
+  if (!armed) {
+    return(UINT32_MAX);
+  }
+  remain = next - millis();
+  return(remain <= 60000 ? remain + 1 : 0);
+}
+
+
+/* the libraries of the sensors and displays */
+void DallasTemperature::requestTemperatures(void)
+{
+  sim_spend(COST_DS18B20_US);
+}
+
+float DallasTemperature::getTempCByIndex(uint8_t index)
+{
+  (void)index;
+  if (sim_node == NULL || sim_node->sensor == NULL) {
+    return(85.0);               // the power-on value of a DS18B20
+  }
+  return(sensor(SIM_DS18B20));
+}
+
+uint16_t BMP085::measure(uint8_t type)
+{
+  sim_spend(type == TEMP ? COST_BMP085_TEMP_US : 4500 + (3000 << oversampling) - 3000);
+  return(0);
+}
+
+void BMP085::calculate(int16_t &tval, int32_t &pval)
+{
+  tval = (int16_t)sensor(SIM_BMP085_TEMP);
+  pval = (int32_t)sensor(SIM_BMP085_PRES);
+}
+
+size_t LiquidCrystalI2C::write(uint8_t c)
+{
+  (void)c;
+  sim_spend(COST_LCD_CHAR_US);
+  return(1);
+}
+
+void GLCD_ST7565::refresh(void)
+{
+  sim_spend(COST_GLCD_REFRESH_US);
+}
+
+unsigned long StopWatch::now(void)
+{
+  switch (_res) {
+  case MICROS:
+    return(micros());
+  case SECONDS:
+    return(millis() / 1000);
+  default:
+    return(millis());
+  }
+}
+
+void StopWatch::start(void)
+{
+  if (_state == RESET || _state == STOPPED) {
+    unsigned long t = now();
+    _state = RUNNING;
+    _starttime += t - _stoptime;
+    _stoptime = t;
+  }
+}
+
+void StopWatch::stop(void)
+{
+  if (_state == RUNNING) {
+    _state = STOPPED;
+    _stoptime = now();
+  }
+}
+
+unsigned long StopWatch::elapsed(void)
+{
+  if (_state == RUNNING) {
+    return(now() - _starttime);
+  }
+  return(_stoptime - _starttime);
+}
+
+boolean Soladin::query(uint8_t cmd, int day)
+{
+  double w = sensor(SIM_SOLAR_W);
+
+  (void)day;
+  if (w <= 0) {
+    sim_spend(COST_SOLADIN_TIMEOUT_US);
+    return(false);
+  }
+  sim_spend(COST_SOLADIN_US);
+  switch (cmd) {
+  case DVS:
+    Flag = 0;
+    Gridpower = (uint16_t)w;
+    PVvolt = 700;                               // 0.1 V
+    PVamp = (uint16_t)(w / 0.93 / 70 * 100);    // 0.01 A
+    if (PVamp == 0) PVamp = 1;
+    Gridvolt = 230;
+    Gridfreq = 5000;                            // 0.01 Hz
+    DeviceTemp = (int16_t)(25 + w / 30);
+    Totalpower = 150000 + (uint32_t)(sensor(SIM_SOLAR_WH) / 10);
+    TotalOperaTime = 40000 * 60 + (uint32_t)sensor(SIM_SOLAR_MIN);
+    break;
+  case HSD:
+    Gridoutput = (uint16_t)(sensor(SIM_SOLAR_WH) / 10);        // 0.01 kWh
+    DailyOpTm = (uint8_t)(sensor(SIM_SOLAR_MIN) / 5);
+    break;
+  }
+  return(true);
+}
+
+double EnergyMonitor::calcIrms(unsigned int NUMBER_OF_SAMPLES)
+{
+  sim_spend((uint64_t)NUMBER_OF_SAMPLES * (COST_ANAREAD_US + COST_EMON_SAMPLE_US));
+  Irms = sensor(SIM_CT_IRMS);
+  return(Irms);
+}
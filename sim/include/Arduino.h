@@ -0,0 +1,83 @@
+// Arduino.h - stand-in of the Arduino core for the host simulation (see sim.h)
+//
+// Only what the sketches use. The calls act on the node that runs and take
+// the modeled time of an ATmega328 at 16 MHz.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "avr/pgmspace.h"
+#include "avr/io.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#define ISR(vector, ...) void isr_##vector(void)
+#define cli()
+#define sei()
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+inline boolean isAlpha(int c) { return isalpha(c) != 0; }
+inline boolean isDigit(int c) { return isdigit(c) != 0; }
+
+class Print {
+public:
+  virtual size_t write(uint8_t c) = 0;
+  size_t write(const uint8_t *buf, size_t len);
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+  size_t println(void) { return write("\r\n"); }
+  template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+  template <typename T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  int available(void);
+  int read(void);
+  void flush(void);
+  size_t write(uint8_t c);
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
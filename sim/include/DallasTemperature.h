@@ -0,0 +1,20 @@
+// DallasTemperature.h - stand-in for the host simulation: a DS18B20 with
+// the temperature of the world around the node, a conversion at 12 bits
+// blocks for 750 ms as in the library
+
+#ifndef DallasTemperature_h
+#define DallasTemperature_h
+
+#include <stdint.h>
+
+#include "OneWire.h"
+
+class DallasTemperature {
+public:
+  DallasTemperature(OneWire *wire) { (void)wire; }
+  void begin(void) {}
+  void requestTemperatures(void);
+  float getTempCByIndex(uint8_t index);
+};
+
+#endif
@@ -0,0 +1,17 @@
+// EEPROM.h - stand-in for the host simulation: the EEPROM of the node that
+// runs, a write takes 3.4 ms
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+
+class EEPROMClass {
+public:
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,16 @@
+// EmonLib.h - stand-in of the EmonLib library for the host simulation: the
+// current of the world around the node, every sample is an analog read
+
+#ifndef EmonLib_h
+#define EmonLib_h
+
+#include "Arduino.h"
+
+class EnergyMonitor {
+public:
+  void current(unsigned int inPinI, double ICAL) { (void)inPinI; (void)ICAL; }
+  double calcIrms(unsigned int NUMBER_OF_SAMPLES);
+  double Irms;
+};
+
+#endif
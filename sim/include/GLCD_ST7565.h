@@ -0,0 +1,27 @@
+// GLCD_ST7565.h - stand-in for the host simulation: the display is not
+// drawn, a refresh takes 9 ms
+
+#ifndef GLCD_ST7565_H
+#define GLCD_ST7565_H
+
+#include "Arduino.h"
+
+#define BLACK 0
+#define WHITE 1
+
+class GLCD_ST7565 {
+public:
+  void begin(uint8_t contrast = 0x18) { (void)contrast; }
+  void clear(void) {}
+  void refresh(void);
+  void backLight(uint8_t level) { (void)level; }
+  void setFont(const uint8_t *font) { (void)font; }
+  void drawString(uint8_t x, uint8_t y, const char *s) { (void)x; (void)y; (void)s; }
+  void drawString_P(uint8_t x, uint8_t y, const char *s) { (void)x; (void)y; (void)s; }
+  void drawLine(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, uint8_t color)
+    { (void)x0; (void)y0; (void)x1; (void)y1; (void)color; }
+  void drawCircle(uint8_t x, uint8_t y, uint8_t r, uint8_t color)
+    { (void)x; (void)y; (void)r; (void)color; }
+};
+
+#endif
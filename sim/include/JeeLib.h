@@ -0,0 +1,91 @@
+// JeeLib.h - stand-in of JeeLib for the host simulation (see sim.h)
+//
+// Ports map on the pins of the node (port n: DIO = pin n+3, AIO = analog
+// n-1), the RF12 driver on the simulated RF bus. Payloads are host structs,
+// so they are larger than on the ATmega, the airtime uses their host size.
+
+#ifndef JeeLib_h
+#define JeeLib_h
+
+#include "Arduino.h"
+#include "sim.h"
+
+#define RF12_433MHZ 1
+#define RF12_868MHZ 2
+#define RF12_915MHZ 3
+
+#define RF12_MAXDATA SIM_RF_MAX
+#define RF12_HDR_CTL 0x80
+#define RF12_HDR_DST SIM_HDR_DST
+#define RF12_HDR_ACK 0x20
+#define RF12_HDR_MASK SIM_HDR_MASK
+
+#define rf12_buf (sim_node->rf_raw + 5)
+#define rf12_grp rf12_buf[0]
+#define rf12_hdr rf12_buf[1]
+#define rf12_len rf12_buf[2]
+#define rf12_data (rf12_buf + 3)
+#define rf12_crc (sim_node->rf_crc)
+
+#define RF12_WANTS_ACK ((rf12_hdr & RF12_HDR_ACK) && !(rf12_hdr & RF12_HDR_CTL))
+#define RF12_ACK_REPLY (rf12_hdr & RF12_HDR_DST ? RF12_HDR_CTL : \
+            RF12_HDR_CTL | RF12_HDR_DST | (rf12_hdr & RF12_HDR_MASK))
+
+uint8_t rf12_initialize(uint8_t id, uint8_t band, uint8_t group = 0xD4);
+uint8_t rf12_recvDone(void);
+uint8_t rf12_canSend(void);
+void rf12_sendStart(uint8_t hdr, const void *ptr, uint8_t len);
+void rf12_sendNow(uint8_t hdr, const void *ptr, uint8_t len);
+void rf12_sendWait(uint8_t mode);
+
+class Port {
+protected:
+  uint8_t portNum;
+public:
+  Port(uint8_t num) : portNum(num) {}
+  void mode(uint8_t value) const { pinMode(portNum + 3, value); }
+  uint8_t digiRead(void) const { return digitalRead(portNum + 3); }
+  void digiWrite(uint8_t value) const { digitalWrite(portNum + 3, value); }
+  void mode2(uint8_t value) const { pinMode(portNum + 13, value); }
+  uint16_t anaRead(void) const { return analogRead(portNum - 1); }
+  uint8_t digiRead2(void) const { return digitalRead(portNum + 13); }
+  void digiWrite2(uint8_t value) const { digitalWrite(portNum + 13, value); }
+};
+
+class PortI2C : public Port {
+public:
+  enum { KHZMAX = 1, KHZ400 = 2, KHZ100 = 9 };
+  PortI2C(uint8_t num, uint8_t rate = KHZMAX) : Port(num) { (void)rate; }
+};
+
+class DeviceI2C {
+public:
+  DeviceI2C(const PortI2C &port, uint8_t addr) { (void)port; (void)addr; }
+};
+
+class UartPlug : public DeviceI2C {
+public:
+  UartPlug(PortI2C &port, uint8_t addr) : DeviceI2C(port, addr) {}
+  void begin(long baud) { (void)baud; }
+};
+
+class MilliTimer : public SimTimer {
+  word next;
+  byte armed;
+public:
+  MilliTimer() : armed(0) {}
+  byte poll(word ms = 0);
+  word remaining(void) const;
+  byte idle(void) const { return !armed; }
+  void set(word ms);
+  void restart(void) { armed = 0; }
+  uint32_t sim_remaining(void);
+};
+
+class Sleepy {
+public:
+  static void watchdogEvent(void) {}
+  static byte loseSomeTime(word msecs) { delay(msecs); return 1; }
+};
+
+#endif
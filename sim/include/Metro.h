@@ -0,0 +1,28 @@
+// Metro.h - stand-in of the Metro library for the host simulation
+//
+// As Metro: check() is true once per interval, a late check() catches up
+// (the next one is due an interval after the previous due time). It also
+// keeps how late it fired, for the stats of the simulation.
+
+#ifndef Metro_h
+#define Metro_h
+
+#include <stdint.h>
+
+#include "sim.h"
+
+class Metro : public SimTimer {
+public:
+  Metro(unsigned long interval_millis);
+  Metro(unsigned long interval_millis, uint8_t autoreset);
+  void interval(unsigned long interval_millis);
+  char check(void);
+  void reset(void);
+  void restart(void) { reset(); }
+  uint32_t sim_remaining(void);
+private:
+  uint32_t previous_millis, interval_millis;
+  uint8_t autoreset;
+};
+
+#endif
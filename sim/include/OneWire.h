@@ -0,0 +1,13 @@
+// OneWire.h - stand-in of the OneWire library for the host simulation
+
+#ifndef OneWire_h
+#define OneWire_h
+
+#include <stdint.h>
+
+class OneWire {
+public:
+  OneWire(uint8_t pin) { (void)pin; }
+};
+
+#endif
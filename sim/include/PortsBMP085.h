@@ -0,0 +1,19 @@
+// PortsBMP085.h - stand-in for the host simulation: a BMP085 with the
+// temperature and pressure of the world around the node
+
+#ifndef PortsBMP085_h
+#define PortsBMP085_h
+
+#include "JeeLib.h"
+
+class BMP085 : public DeviceI2C {
+  uint8_t oversampling;
+public:
+  enum { TEMP, PRES };
+  BMP085(PortI2C &port, uint8_t os = 0) : DeviceI2C(port, 0x77), oversampling(os) {}
+  void getCalibData(void) {}
+  uint16_t measure(uint8_t type);
+  void calculate(int16_t &tval, int32_t &pval);
+};
+
+#endif
@@ -0,0 +1,20 @@
+// PortsLCD.h - stand-in for the host simulation: an LCD on an I2C expander,
+// a character takes 0.6 ms
+
+#ifndef PortsLCD_h
+#define PortsLCD_h
+
+#include "JeeLib.h"
+
+class LiquidCrystalI2C : public Print {
+public:
+  LiquidCrystalI2C(const PortI2C &port, uint8_t addr = 0x24) { (void)port; (void)addr; }
+  void begin(uint8_t cols, uint8_t rows) { (void)cols; (void)rows; }
+  void backlight(void) {}
+  void noBacklight(void) {}
+  void setCursor(uint8_t col, uint8_t row) { (void)col; (void)row; }
+  size_t write(uint8_t c);
+  using Print::write;
+};
+
+#endif
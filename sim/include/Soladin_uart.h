@@ -0,0 +1,27 @@
+// Soladin_uart.h - stand-in for the host simulation: a Soladin 600 that
+// delivers the power of the sun in the world, it does not answer (after
+// a timeout) when there is no sun
+
+#ifndef Soladin_uart_h
+#define Soladin_uart_h
+
+#include "JeeLib.h"
+
+#define PRB 0xC1
+#define DVS 0xB6
+#define FWI 0xB4
+#define HSD 0x9A
+#define RHM 0x97
+
+class Soladin {
+public:
+  void begin(UartPlug *uart) { (void)uart; }
+  boolean query(uint8_t cmd, int day = 0);
+  uint16_t Flag, PVvolt, PVamp, Gridfreq, Gridvolt, Gridpower;
+  uint32_t Totalpower, TotalOperaTime;
+  int16_t DeviceTemp;
+  uint8_t DailyOpTm;
+  uint16_t Gridoutput;
+};
+
+#endif
@@ -0,0 +1,25 @@
+// StopWatch.h - stand-in of the StopWatch library for the host simulation
+
+#ifndef StopWatch_h
+#define StopWatch_h
+
+#include "Arduino.h"
+
+class StopWatch {
+public:
+  enum State { RESET, RUNNING, STOPPED };
+  enum Resolution { MILLIS, MICROS, SECONDS };
+  StopWatch(enum Resolution res = MILLIS) : _res(res), _state(RESET), _starttime(0), _stoptime(0) {}
+  void start(void);
+  void stop(void);
+  void reset(void) { _state = RESET; _starttime = _stoptime = 0; }
+  unsigned long elapsed(void);
+  enum State state(void) { return _state; }
+private:
+  unsigned long now(void);
+  enum Resolution _res;
+  enum State _state;
+  unsigned long _starttime, _stoptime;
+};
+
+#endif
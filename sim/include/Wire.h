@@ -0,0 +1,6 @@
+// Wire.h - stand-in of the Wire library for the host simulation
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#endif
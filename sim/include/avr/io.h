@@ -0,0 +1,38 @@
+// avr/io.h - stand-in for the host simulation: the registers the sketches
+// touch are plain variables, shared by the nodes
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t PCICR, PCMSK2, MCUCR;
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2;
+extern volatile uint8_t ADMUX, ADCSRA;
+extern volatile uint16_t ADC;
+
+#define PCIE2 2
+#define PCINT20 4
+#define PCINT21 5
+#define PCINT22 6
+#define PCINT23 7
+#define ISC00 0
+#define ISC01 1
+
+#define WGM21 1
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define OCIE2A 1
+
+#define REFS0 6
+#define ADEN 7
+#define ADSC 6
+#define ADIE 3
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+
+#endif
@@ -0,0 +1,22 @@
+// avr/wdt.h - stand-in for the host simulation: the simulation counts the
+// resets the watchdog would have done
+
+#ifndef WDT_H
+#define WDT_H
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+#define WDTO_4S 8
+#define WDTO_8S 9
+
+void wdt_enable(int timeout);
+void wdt_disable(void);
+void wdt_reset(void);
+
+#endif
@@ -0,0 +1,10 @@
+// utility/font_4x6.h - stand-in for the host simulation, the font is not drawn
+
+#ifndef font_4x6_h
+#define font_4x6_h
+
+#include <stdint.h>
+
+static const uint8_t font_4x6[] = { 0 };
+
+#endif
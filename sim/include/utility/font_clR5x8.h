@@ -0,0 +1,10 @@
+// utility/font_clR5x8.h - stand-in for the host simulation, the font is not drawn
+
+#ifndef font_clR5x8_h
+#define font_clR5x8_h
+
+#include <stdint.h>
+
+static const uint8_t font_clR5x8[] = { 0 };
+
+#endif
@@ -0,0 +1,10 @@
+// utility/font_helvB10.h - stand-in for the host simulation, the font is not drawn
+
+#ifndef font_helvB10_h
+#define font_helvB10_h
+
+#include <stdint.h>
+
+static const uint8_t font_helvB10[] = { 0 };
+
+#endif
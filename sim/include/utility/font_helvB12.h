@@ -0,0 +1,10 @@
+// utility/font_helvB12.h - stand-in for the host simulation, the font is not drawn
+
+#ifndef font_helvB12_h
+#define font_helvB12_h
+
+#include <stdint.h>
+
+static const uint8_t font_helvB12[] = { 0 };
+
+#endif
@@ -0,0 +1,10 @@
+// utility/font_helvB18.h - stand-in for the host simulation, the font is not drawn
+
+#ifndef font_helvB18_h
+#define font_helvB18_h
+
+#include <stdint.h>
+
+static const uint8_t font_helvB18[] = { 0 };
+
+#endif
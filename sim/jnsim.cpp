@@ -0,0 +1,269 @@
+/*
+#################################################################################
+# jnsim.cpp - Host simulation of the JeeNode sketches                           #
+#                                                                               #
+# Runs the sketches of the nodes together in the world of world.h for a         #
+# number of days of virtual time, then reports per node how busy it was,        #
+# how late its timers fired and what the radio did, and checks:                 #
+# - the counts of the meters in the SensorNode against the world, and that      #
+#   its sample ring never ran full                                              #
+# - the counts the CentralNode printed against the SensorNode (without loss)    #
+# - no watchdog resets, only lines the parser of jnread accepts, the DCF77      #
+#   time in the 't' lines                                                       #
+# Usage: jnsim [options], see usage(). Exits with 1 when a check fails.         #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "world.h"
+
+#define US_DAY (86400ULL * 1000000)
+
+static int failed = 0;
+
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [options]\n", prog);
+  fprintf(stderr, "  -d days     virtual time to run (1, may be a fraction)\n");
+  fprintf(stderr, "  -s seed     of the random world (1)\n");
+  fprintf(stderr, "  -p W        mean base load (300)\n");
+  fprintf(stderr, "  -x W        peak power of the solar panels (0)\n");
+  fprintf(stderr, "  -g l        gas per day (2500)\n");
+  fprintf(stderr, "  -w l        water per day (120)\n");
+  fprintf(stderr, "  -A value    sunlight on the meter sensors at noon, in reading units (0)\n");
+  fprintf(stderr, "  -D %%        contrast of the marks lost per week (0)\n");
+  fprintf(stderr, "  -N value    noise on the sensors, +/- reading units (6)\n");
+  fprintf(stderr, "  -l %%        chance a packet is lost per receiver (0)\n");
+  fprintf(stderr, "  -m ms       millis() at the start (0), 4294000000 wraps after 16 min\n");
+  fprintf(stderr, "  -c s:text   text on the serial input of the CentralNode at s seconds\n");
+  fprintf(stderr, "  -n nodes    nodes to run, comma separated (all: SensorNode,CentralNode,\n");
+  fprintf(stderr, "              GLCDNode,SolarNode,ApplianceNode)\n");
+  fprintf(stderr, "  -o file     log of the USB lines of the CentralNode (jnread ALL_LOG format)\n");
+  fprintf(stderr, "  -t n        tolerance of the count checks (1)\n");
+  fprintf(stderr, "  -b          measure the host time of the sketches\n");
+  fprintf(stderr, "  -v          print the USB lines of the CentralNode\n");
+  exit(EXIT_FAILURE);
+}
+
+static void check(int ok, const char *what, long a, long b)
+{
+  printf("%s  %-40s %ld %ld\n", ok ? "PASS" : "FAIL", what, a, b);
+  if (!ok) {
+    failed = 1;
+  }
+}
+
+static int on(const char *name)
+{
+  struct sim_node *n = sim_find(name);
+
+  return(n != NULL && n->on);
+}
+
+
+/* FUNCTION to select the nodes to run from a comma separated list */
+static void select_nodes(char *list)
+{
+  char *name;
+  int i;
+
+  for (i = 0; i < sim_n_nodes; i++) {
+    sim_nodes[i]->on = 0;
+  }
+  for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+    for (i = 0; i < sim_n_nodes; i++) {
+      if (strcasecmp(sim_nodes[i]->name, name) == 0) {
+        sim_nodes[i]->on = 1;
+        break;
+      }
+    }
+    if (i == sim_n_nodes) {
+      fprintf(stderr, "Unknown node %s\n", name);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+
+/* FUNCTION to print what the nodes did */
+static void report_nodes(uint64_t until)
+{
+  struct sim_node *n;
+  SimTimer *t;
+  int i, j;
+
+  printf("%-14s %10s %10s %6s %9s %6s %6s %6s %7s %4s\n", "node", "loops", "sleeps",
+         "busy%", "max ms", "sent", "recv", "lost", "eeprom", "wdt");
+  for (i = 0; i < sim_n_nodes; i++) {
+    n = sim_nodes[i];
+    if (!n->on) {
+      continue;
+    }
+    printf("%-14s %10lu %10lu %6.2f %9.1f %6lu %6lu %6lu %7lu %4lu\n", n->name, n->loops,
+           n->sleeps, 100.0 * n->busy / until, n->loop_max / 1000.0, n->rf_sent,
+           n->rf_recv, n->rf_lost, n->eeprom_writes, n->wdt_resets);
+    for (j = 0; j < n->n_timers; j++) {
+      t = n->timer[j];
+      if (t->period == 0 && t->fires == 0) {
+        continue;
+      }
+      printf("  timer %9lu ms: %9lu fires, %7lu ms max late, %lu intervals lost\n",
+             (unsigned long)t->period, t->fires, (unsigned long)t->late_max, t->late_slots);
+    }
+    if (sim_bench && n->loops > 0) {
+      printf("  host %.1f ns per loop()\n", (double)n->host_ns / n->loops);
+    }
+  }
+}
+
+/* FUNCTION to print the world and run the checks */
+static void report_checks(uint64_t until, int tolerance, int gtst)
+{
+  long e, g, w, pulses;
+  unsigned long lost, late;
+  int c, waiting;
+
+  if (truth.power_ws > 0) {
+    printf("power reported: mean error %.1f W, %.1f%% of the mean power\n",
+           truth.power_err_ws / (until / 1e6),
+           100 * truth.power_err_ws / truth.power_ws);
+  }
+  if (on("CentralNode")) {
+    printf("usb: %lu lines,", usb.lines);
+    for (c = 0; c < 26; c++) {
+      if (usb.msgs[c] > 0) {
+        printf(" %c %lu", 'a' + c, usb.msgs[c]);
+      }
+    }
+    printf(", counts missed: e %lu g %lu w %lu\n", usb.e_missed, usb.g_missed, usb.w_missed);
+  }
+
+  if (on("SensorNode")) {
+    sensor_counts(&e, &g, &w);
+    check(labs(e - truth.e_rotations) <= tolerance, "electricity rotations (node, world)",
+          e, truth.e_rotations);
+    check(labs(g - truth.g_rotations) <= tolerance, "gas rotations (node, world)",
+          g, truth.g_rotations);
+    check(labs(w - truth.w_rotations) <= tolerance, "water rotations (node, world)",
+          w, truth.w_rotations);
+    sensor_samples(&lost, &late, &waiting);
+    pulses = labs(e) + g + w;
+    printf("SensorNode samples: %lu late for loop(), %.2f per pulse, %d most waiting\n",
+           late, pulses > 0 ? (double)late / pulses : 0, waiting);
+    check(lost == 0, "SensorNode samples lost", lost, 0);
+    check(late * 2 <= (unsigned long)pulses, "SensorNode samples late, max 1 per 2 pulses", late, pulses);
+    if (on("CentralNode") && sim_rf_loss == 0) {
+      check(labs(usb.e_count - e) <= tolerance, "electricity count on USB (usb, node)",
+            usb.e_count, e);
+      check(labs(usb.g_count - g) <= tolerance, "gas count on USB (usb, node)",
+            usb.g_count, g);
+      check(labs(usb.w_count - w) <= tolerance, "water count on USB (usb, node)",
+            usb.w_count, w);
+    }
+  }
+  for (c = 0; c < sim_n_nodes; c++) {
+    if (sim_nodes[c]->on && sim_nodes[c]->wdt_ms > 0) {
+      check(sim_nodes[c]->wdt_resets == 0, sim_nodes[c]->name, sim_nodes[c]->wdt_resets, 0);
+    }
+  }
+  if (on("CentralNode")) {
+    check(usb.bad == 0, "USB lines rejected by jnread", usb.bad, 0);
+    check(usb.t_bad == 0 && (usb.t_ok > 0 || until < 180000000ULL),
+          "DCF77 time lines (ok, wrong)", usb.t_ok, usb.t_bad);
+    if (gtst) {
+      check(usb.msgs['l' - 'a'] > 0, "sensor settings after gtst", usb.msgs['l' - 'a'], 0);
+    }
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  struct world_param p = { 300, 0, 2500, 120, 0, 0, 6, 0 };
+  struct timespec t0, t1;
+  struct sim_node *central;
+  double days = 1, secs;
+  uint64_t until, t;
+  char *nodes = NULL, *log = NULL, *s;
+  const char *cmd[SIM_MAX_INPUT];
+  double cmd_s[SIM_MAX_INPUT];
+  int n_cmd = 0, gtst = 0, tolerance = 1, opt, i;
+  unsigned long seed = 1;
+
+  while ((opt = getopt(argc, argv, "d:s:p:x:g:w:A:D:N:l:m:c:n:o:t:bvh")) != -1) {
+    switch (opt) {
+    case 'd': days = atof(optarg); break;
+    case 's': seed = strtoul(optarg, NULL, 10); break;
+    case 'p': p.base_w = atof(optarg); break;
+    case 'x': p.solar_w = atof(optarg); break;
+    case 'g': p.gas_l = atof(optarg); break;
+    case 'w': p.water_l = atof(optarg); break;
+    case 'A': p.ambient = atof(optarg); break;
+    case 'D': p.ageing = atof(optarg); break;
+    case 'N': p.noise = atof(optarg); break;
+    case 'l': sim_rf_loss = atof(optarg) / 100; break;
+    case 'm': sim_millis0 = strtoul(optarg, NULL, 10); break;
+    case 'c':
+      if ((s = strchr(optarg, ':')) == NULL || n_cmd == SIM_MAX_INPUT) usage(argv[0]);
+      cmd_s[n_cmd] = atof(optarg);
+      cmd[n_cmd++] = s + 1;
+      if (strstr(s + 1, "gtst") != NULL) gtst = 1;
+      break;
+    case 'n': nodes = optarg; break;
+    case 'o': log = optarg; break;
+    case 't': tolerance = atoi(optarg); break;
+    case 'b': sim_bench = 1; break;
+    case 'v': p.verbose = 1; break;
+    default: usage(argv[0]);
+    }
+  }
+  if (optind < argc || days <= 0) {
+    usage(argv[0]);
+  }
+  if (nodes != NULL) {
+    select_nodes(nodes);
+  }
+  if ((central = sim_find("CentralNode")) != NULL) {
+    for (i = 0; i < n_cmd; i++) {
+      sim_add_input(central, (uint64_t)(cmd_s[i] * 1e6), cmd[i]);
+    }
+  }
+  if (log != NULL && (world_log = fopen(log, "w")) == NULL) {
+    perror(log);
+    exit(EXIT_FAILURE);
+  }
+
+  sim_srand(seed);
+  world_init(&p);
+  until = (uint64_t)(days * US_DAY);
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  sim_start();
+  for (t = US_DAY; t < until; t += US_DAY) {
+    sim_run(t);
+    if (p.verbose) printf("day %lu done\n", (unsigned long)(t / US_DAY));
+  }
+  sim_run(until);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  world_finish(until);
+  if (world_log != NULL) {
+    fclose(world_log);
+  }
+
+  secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+  printf("%.2f days in %.2f s (%.0f x real time)\n", days, secs,
+         secs > 0 ? days * 86400 / secs : 0);
+  report_nodes(until);
+  report_checks(until, tolerance, gtst);
+  return(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,93 @@
+#################################################################################
+# long32.awk - Copy of a sketch with the long of the ATmega                     #
+#                                                                               #
+# Writes the sketch with (unsigned) long as (u)int32_t and a #line 1 in front,  #
+# so the messages of the compiler are on the sketch itself. Only the code is    #
+# changed: comments, strings and character constants are copied as they are,   #
+# and long long stays.                                                          #
+# Usage: awk -v file=<sketch> -f long32.awk <sketch>                            #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+
+BEGIN {
+  printf("#line 1 \"%s\"\n", file)
+  comment = 0          # in a /* */ comment
+}
+
+# the words of a piece of code, long as int32_t
+function code(s,    out, w) {
+  out = ""
+  while (match(s, /[A-Za-z_][A-Za-z_0-9]*/)) {
+    w = substr(s, RSTART, RLENGTH)
+    out = out substr(s, 1, RSTART - 1)
+    s = substr(s, RSTART + RLENGTH)
+    if (w == "unsigned" && match(s, /^[ \t]+long/) && !match(s, /^[ \t]+long[ \t]+long/) &&
+        !match(s, /^[ \t]+long[A-Za-z_0-9]/)) {
+      match(s, /^[ \t]+long/)
+      s = substr(s, RLENGTH + 1)
+      w = "uint32_t"
+    } else if (w == "long" && match(s, /^[ \t]+long([^A-Za-z_0-9]|$)/)) {
+      match(s, /^[ \t]+long/)
+      s = substr(s, RLENGTH + 1)
+      w = "long long"
+    } else if (w == "long") {
+      w = "int32_t"
+    }
+    out = out w
+  }
+  return out s
+}
+
+# the length of the string or character constant at the start of s, up to
+# its closing quote or the end of the line
+function quoted(s,    n, c) {
+  for (n = 2; n <= length(s); n++) {
+    c = substr(s, n, 1)
+    if (c == "\\") {
+      n++
+    } else if (c == substr(s, 1, 1)) {
+      return n
+    }
+  }
+  return length(s)
+}
+
+{
+  line = $0
+  out = ""
+  piece = ""
+  while (line != "") {
+    c = substr(line, 1, 1)
+    if (comment) {
+      if (substr(line, 1, 2) == "*/") {
+        out = out "*/"
+        line = substr(line, 3)
+        comment = 0
+      } else {
+        out = out c
+        line = substr(line, 2)
+      }
+    } else if (substr(line, 1, 2) == "//") {
+      out = out code(piece) line
+      piece = ""
+      line = ""
+    } else if (substr(line, 1, 2) == "/*") {
+      out = out code(piece) "/*"
+      piece = ""
+      line = substr(line, 3)
+      comment = 1
+    } else if (c == "\"" || c == "'") {
+      # a string or character constant up to its closing quote
+      n = quoted(line)
+      out = out code(piece) substr(line, 1, n)
+      line = substr(line, n + 1)
+      piece = ""
+    } else {
+      piece = piece c
+      line = substr(line, 2)
+    }
+  }
+  print out code(piece)
+}
@@ -0,0 +1,21 @@
+/*
+#################################################################################
+# node_appliance.cpp - ApplianceNode.ino in the host simulation (see sketch.h)  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include "sketch.h"
+
+static struct sim_node node;
+static int constructed = sim_construct(&node, "ApplianceNode");
+
+#define int int16_t
+namespace ApplianceNode {
+#include "gen/ApplianceNode/ApplianceNode.ino"
+}
+#undef int
+
+static int declared = sim_sketch(&node, ApplianceNode::setup, ApplianceNode::loop, world_appliance);
@@ -0,0 +1,23 @@
+/*
+#################################################################################
+# node_central.cpp - CentralNode.ino in the host simulation (see sketch.h)      #
+#                                                                               #
+# DCF77Clock.cpp is in node_dcf77.cpp: it counts milliseconds in an int.        #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include "sketch.h"
+
+static struct sim_node node;
+static int constructed = sim_construct(&node, "CentralNode");
+
+#define int int16_t
+namespace CentralNode {
+#include "gen/CentralNode/CentralNode.ino"
+}
+#undef int
+
+static int declared = sim_sketch(&node, CentralNode::setup, CentralNode::loop, world_central);
@@ -0,0 +1,24 @@
+/*
+#################################################################################
+# node_dcf77.cpp - DCF77Clock.cpp of the CentralNode in the host simulation     #
+#                                                                               #
+# Compiled with the int of the host: the library keeps the time of the last     #
+# flank of the signal in an int and subtracts it from millis(). That works      #
+# when the subtraction has the size of the int: 16 bits on the ATmega, 32       #
+# bits here, not with a 16-bit int and the 32-bit arithmetic of the host.       #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include "sketch.h"
+
+namespace CentralNode {
+#include "gen/CentralNode/DCF77Clock.cpp"
+}
+
+void central_pcint2(void)
+{
+  CentralNode::isr_PCINT2_vect();
+}
@@ -0,0 +1,24 @@
+/*
+#################################################################################
+# node_glcd.cpp - GLCDNode.ino in the host simulation (see sketch.h)            #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include "sketch.h"
+
+static struct sim_node node;
+static int constructed = sim_construct(&node, "GLCDNode");
+
+/* as on the ATmega, the 60000 ms of the backlight is -5536 in an int and
+*  60000 again for MilliTimer::set()
+*/
+#define int int16_t
+namespace GLCDNode {
+#include "gen/GLCDNode/GLCDNode.ino"
+}
+#undef int
+
+static int declared = sim_sketch(&node, GLCDNode::setup, GLCDNode::loop, world_glcd);
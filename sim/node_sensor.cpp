@@ -0,0 +1,61 @@
+/*
+#################################################################################
+# node_sensor.cpp - SensorNode.ino in the host simulation (see sketch.h)        #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include "sketch.h"
+
+static struct sim_node node;
+static int constructed = sim_construct(&node, "SensorNode");
+
+#define int int16_t
+namespace SensorNode {
+#include "gen/SensorNode/SensorNode.ino"
+}
+#undef int
+
+static int declared = sim_sketch(&node, SensorNode::setup, SensorNode::loop, world_sensor);
+
+void sensor_counts(long *e, long *g, long *w)
+{
+  *e = SensorNode::e_rotations;
+  *g = SensorNode::g_rotations;
+  *w = SensorNode::w_rotations;
+}
+
+static int max_waiting = 0;
+static unsigned long delayed = 0;
+
+void sensor_samples(unsigned long *lost, unsigned long *late, int *waiting)
+{
+  *lost = SensorNode::samplesLost;
+  *late = delayed;
+  *waiting = max_waiting;
+}
+
+void sensor_timer2(void)
+{
+  SensorNode::isr_TIMER2_COMPA_vect();
+}
+
+void sensor_adc(void)
+{
+  uint8_t head = SensorNode::sampleHead;
+  int n;
+
+  SensorNode::isr_ADC_vect();
+  if (SensorNode::sampleHead == head) {
+    return;                     // not the last channel of the scan
+  }
+  n = (SensorNode::sampleHead - SensorNode::sampleTail) & (SAMPLE_RING - 1);
+  if (n > max_waiting) {
+    max_waiting = n;
+  }
+  if (n > 1) {
+    delayed++;                  // the previous sample still waits for loop()
+  }
+}
@@ -0,0 +1,24 @@
+/*
+#################################################################################
+# node_solar.cpp - SolarNode.ino in the host simulation (see sketch.h)          #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include "sketch.h"
+
+static struct sim_node node;
+static int constructed = sim_construct(&node, "SolarNode");
+
+/* the sketch has its own EXIT_SUCCESS and EXIT_FAILURE */
+#undef EXIT_SUCCESS
+#undef EXIT_FAILURE
+#define int int16_t
+namespace SolarNode {
+#include "gen/SolarNode/SolarNode.ino"
+}
+#undef int
+
+static int declared = sim_sketch(&node, SolarNode::setup, SolarNode::loop, world_solar);
@@ -0,0 +1,505 @@
+/*
+#################################################################################
+# sim.cpp - Host simulation of the JeeNodes: virtual clock, RF bus and nodes    #
+#                                                                               #
+# See sim.h for the interface.                                                  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+
+struct sim_node *sim_node = NULL;
+struct sim_node *sim_nodes[SIM_MAX_NODES];
+int sim_n_nodes = 0;
+uint32_t sim_millis0 = 0;
+double sim_rf_loss = 0;
+int sim_bench = 0;
+
+static struct sim_packet air[SIM_AIR];          // the last packets on the bus
+static unsigned long air_seq = 0;
+static uint64_t rnd_state = 88172645463325252ULL;
+
+
+void sim_srand(unsigned long seed)
+{
+  sim_srand_r(&rnd_state, seed);
+}
+
+void sim_srand_r(uint64_t *state, unsigned long seed)
+{
+  *state = 88172645463325252ULL ^ ((uint64_t)seed * 0x9E3779B97F4A7C15ULL);
+  if (*state == 0) {
+    *state = 1;
+  }
+}
+
+/* uniform in [0, 1) */
+double sim_rand(void)
+{
+  return(sim_rand_r(&rnd_state));
+}
+
+/* the same of a stream of its own */
+double sim_rand_r(uint64_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return((*state >> 11) * (1.0 / 9007199254740992.0));
+}
+
+
+/* FUNCTIONs to declare the nodes: sim_construct() before the globals of a
+*  sketch are constructed (their timers register with it), sim_sketch()
+*  after them
+*/
+int sim_construct(struct sim_node *n, const char *name)
+{
+  n->name = name;
+  n->on = 1;
+  if (sim_n_nodes < SIM_MAX_NODES) {
+    sim_nodes[sim_n_nodes++] = n;
+  }
+  sim_node = n;
+  return(0);
+}
+
+int sim_sketch(struct sim_node *n, void (*setup)(void), void (*loop)(void),
+               void (*attach)(struct sim_node *n))
+{
+  n->setup = setup;
+  n->loop = loop;
+  n->attach = attach;
+  sim_node = NULL;
+  return(0);
+}
+
+struct sim_node *sim_find(const char *name)
+{
+  int i;
+
+  for (i = 0; i < sim_n_nodes; i++) {
+    if (strcmp(sim_nodes[i]->name, name) == 0) {
+      return(sim_nodes[i]);
+    }
+  }
+  return(NULL);
+}
+
+
+SimTimer::SimTimer() : node(sim_node), period(0), fires(0), late_slots(0), late_max(0)
+{
+  if (node != NULL && node->n_timers < SIM_MAX_TIMERS) {
+    node->timer[node->n_timers++] = this;
+  }
+}
+
+void SimTimer::fired(uint32_t late)
+{
+  fires++;
+  if (late > late_max) {
+    late_max = late;
+  }
+  if (period > 0 && late >= period) {
+    late_slots++;
+  }
+  if (node != NULL) {
+    node->active = 1;
+  }
+}
+
+
+void sim_add_irq(struct sim_node *n, uint64_t first,
+                 uint64_t (*fire)(struct sim_node *n, uint64_t t, void *arg), void *arg)
+{
+  if (n->n_irqs < SIM_MAX_IRQS) {
+    n->irq[n->n_irqs].next = first;
+    n->irq[n->n_irqs].fire = fire;
+    n->irq[n->n_irqs].arg = arg;
+    n->n_irqs++;
+  }
+}
+
+void sim_add_input(struct sim_node *n, uint64_t t, const char *s)
+{
+  if (n->n_input < SIM_MAX_INPUT) {
+    n->input[n->n_input].t = t;
+    n->input[n->n_input].s = s;
+    n->n_input++;
+  }
+}
+
+
+/* FUNCTION to move the clock of a node to time t, the interrupts due
+*  before run on the way
+*/
+static void sim_advance(struct sim_node *n, uint64_t t)
+{
+  struct sim_irq *q;
+  int i;
+
+  while (!n->in_irq) {
+    q = NULL;
+    for (i = 0; i < n->n_irqs; i++) {
+      if (n->irq[i].next <= t && (q == NULL || n->irq[i].next < q->next)) {
+        q = &n->irq[i];
+      }
+    }
+    if (q == NULL) {
+      break;
+    }
+    if (q->next > n->now) {
+      n->now = q->next;
+    }
+    n->in_irq = 1;
+    q->next = q->fire(n, n->now, q->arg);
+    n->in_irq = 0;
+    n->active = 1;
+  }
+  if (t > n->now) {
+    n->now = t;
+  }
+  if (n->wdt_ms > 0 && n->now - n->wdt_last > (uint64_t)n->wdt_ms * 1000) {
+    n->wdt_resets++;            // the sketch would have been reset
+    n->wdt_last = n->now;
+  }
+}
+
+/* the running node is busy for us */
+void sim_spend(uint64_t us)
+{
+  if (sim_node != NULL) {
+    sim_advance(sim_node, sim_node->now + us);
+  }
+}
+
+uint32_t sim_millis(void)
+{
+  if (sim_node == NULL) {
+    return(sim_millis0);
+  }
+  return((uint32_t)(sim_node->now / 1000 + sim_millis0));
+}
+
+
+/* FUNCTION to put a packet on the bus, from the running node */
+void sim_rf_send(uint8_t hdr, const void *data, uint8_t len)
+{
+  struct sim_node *n = sim_node, *m;
+  struct sim_packet *p, *q;
+  uint64_t t;
+  int i, j, again;
+
+  if (n == NULL || n->rf_id == 0) {
+    return;
+  }
+  if (len > SIM_RF_MAX) {
+    len = SIM_RF_MAX;
+  }
+  /* wait for the previous transmission and while the channel is busy */
+  t = n->now > n->tx_until ? n->now : n->tx_until;
+  do {
+    again = 0;
+    for (i = 0; i < SIM_AIR; i++) {
+      q = &air[i];
+      if (q->seq != 0 && q->group == n->rf_group && q->band == n->rf_band &&
+          q->start <= t && t < q->end) {
+        t = q->end;
+        again = 1;
+      }
+    }
+  } while (again);
+  sim_spend(t - n->now + COST_RF_START_US);
+
+  p = &air[++air_seq % SIM_AIR];
+  p->seq = air_seq;
+  p->start = n->now;
+  p->end = p->start + (uint64_t)(len + RF12_OVERHEAD) * RF12_BYTE_US;
+  p->group = n->rf_group;
+  p->band = n->rf_band;
+  p->hdr = (hdr & SIM_HDR_DST) ? hdr : (uint8_t)((hdr & ~SIM_HDR_MASK) | n->rf_id);
+  p->len = len;
+  p->bad = 0;
+  memcpy(p->data, data, len);
+  /* a packet started later by a node that was behind collides with it */
+  for (i = 0; i < SIM_AIR; i++) {
+    q = &air[i];
+    if (q != p && q->seq != 0 && q->group == p->group && q->band == p->band &&
+        q->start < p->end && p->start < q->end) {
+      q->bad = p->bad = 1;
+    }
+  }
+  n->tx_until = p->end;
+  n->rx_on = 0;
+  n->rf_sent++;
+
+  for (i = 0; i < sim_n_nodes; i++) {
+    m = sim_nodes[i];
+    if (m == n || !m->on || !m->rx_used || m->rf_group != p->group || m->rf_band != p->band) {
+      continue;
+    }
+    if ((p->hdr & SIM_HDR_DST) && (p->hdr & SIM_HDR_MASK) != m->rf_id) {
+      continue;
+    }
+    if (sim_rf_loss > 0 && sim_rand() < sim_rf_loss) {
+      m->rf_lost++;
+      continue;
+    }
+    if (m->rx_n == SIM_RX_QUEUE) {
+      m->rf_lost++;
+      continue;
+    }
+    /* in the order of the start times: a node that blocked for a while
+    *  in its loop() ran ahead of the others and sent its packets early
+    */
+    for (j = m->rx_n++; j > 0; j--) {
+      q = &air[m->rx[(m->rx_head + j - 1) % SIM_RX_QUEUE] % SIM_AIR];
+      if (q->start <= p->start) {
+        break;
+      }
+      m->rx[(m->rx_head + j) % SIM_RX_QUEUE] = m->rx[(m->rx_head + j - 1) % SIM_RX_QUEUE];
+    }
+    m->rx[(m->rx_head + j) % SIM_RX_QUEUE] = p->seq;
+    /* a sleeping receiver wakes when the packet is in */
+    if (m->sleep_until != 0 && p->end < m->sleep_until) {
+      m->sleep_until = p->end > m->now ? p->end : m->now;
+    }
+  }
+}
+
+/* FUNCTION rf12_recvDone() of the running node */
+int sim_rf_recv(void)
+{
+  struct sim_node *n = sim_node;
+  struct sim_packet *p;
+
+  if (n == NULL || n->rf_id == 0) {
+    return(0);
+  }
+  n->rx_used = 1;
+  if (!n->rx_on) {
+    n->rx_on = 1;
+    n->rx_armed = n->now > n->tx_until ? n->now : n->tx_until;
+    n->active = 1;
+    return(0);
+  }
+  while (n->rx_n > 0) {
+    p = &air[n->rx[n->rx_head] % SIM_AIR];
+    if (p->seq != n->rx[n->rx_head] || p->start < n->rx_armed) {
+      n->rx_head = (n->rx_head + 1) % SIM_RX_QUEUE;     // not listening when it started
+      n->rx_n--;
+      n->rf_lost++;
+      continue;
+    }
+    if (p->end > n->now) {
+      return(0);                // still coming in
+    }
+    n->rx_head = (n->rx_head + 1) % SIM_RX_QUEUE;
+    n->rx_n--;
+    n->rf_raw[5] = p->group;
+    n->rf_raw[6] = p->hdr;
+    n->rf_raw[7] = p->len;
+    memcpy(&n->rf_raw[8], p->data, p->len);
+    n->rf_crc = p->bad;
+    n->rx_on = 0;
+    n->rf_recv++;
+    n->active = 1;
+    return(1);
+  }
+  return(0);
+}
+
+/* time the first packet for the node is in, SIM_NEVER = none */
+static uint64_t sim_rf_next(struct sim_node *n)
+{
+  struct sim_packet *p;
+  int i;
+
+  if (!n->rx_on) {
+    return(SIM_NEVER);
+  }
+  for (i = 0; i < n->rx_n; i++) {
+    p = &air[n->rx[(n->rx_head + i) % SIM_RX_QUEUE] % SIM_AIR];
+    if (p->seq == n->rx[(n->rx_head + i) % SIM_RX_QUEUE] && p->start >= n->rx_armed) {
+      return(p->end);
+    }
+  }
+  return(SIM_NEVER);
+}
+
+
+/* FUNCTION to write a character on the serial port of the running node,
+*  blocking while the transmit buffer is full. Complete lines go to the
+*  line hook of the node.
+*/
+void sim_serial_write(uint8_t c)
+{
+  struct sim_node *n = sim_node;
+
+  if (n == NULL) {
+    return;
+  }
+  if (n->ser_until < n->now) {
+    n->ser_until = n->now;
+  }
+  if (n->ser_until - n->now > (uint64_t)SERIAL_TX_BUF * SERIAL_CHAR_US) {
+    sim_spend(n->ser_until - n->now - SERIAL_TX_BUF * SERIAL_CHAR_US);
+  }
+  n->ser_until += SERIAL_CHAR_US;
+  if (c == '\n') {
+    n->ser_line[n->ser_len] = '\0';
+    if (n->line != NULL) {
+      n->line(n, n->ser_line);
+    }
+    n->ser_len = 0;
+  } else if (c != '\r' && n->ser_len < SIM_LINE - 1) {
+    n->ser_line[n->ser_len++] = c;
+  }
+}
+
+int sim_serial_available(void)
+{
+  struct sim_node *n = sim_node;
+
+  if (n == NULL || n->input_pos >= n->n_input || n->input[n->input_pos].t > n->now) {
+    return(0);
+  }
+  return((int)strlen(n->input[n->input_pos].s) - n->input_off);
+}
+
+int sim_serial_read(void)
+{
+  struct sim_node *n = sim_node;
+  int c;
+
+  if (sim_serial_available() <= 0) {
+    return(-1);
+  }
+  c = (unsigned char)n->input[n->input_pos].s[n->input_off++];
+  if (n->input[n->input_pos].s[n->input_off] == '\0') {
+    n->input_pos++;
+    n->input_off = 0;
+  }
+  n->active = 1;
+  return(c);
+}
+
+
+/* FUNCTION to put a node to sleep until its first deadline */
+static void sim_sleep(struct sim_node *n, uint64_t until)
+{
+  uint64_t t = until, d, now_ms = n->now / 1000;
+  int i;
+
+  for (i = 0; i < n->n_timers; i++) {
+    d = (now_ms + n->timer[i]->sim_remaining()) * 1000;
+    if (d < t) t = d;
+  }
+  for (i = 0; i < n->n_irqs; i++) {
+    if (n->irq[i].next < t) t = n->irq[i].next;
+  }
+  if ((d = sim_rf_next(n)) < t) t = d;
+  if (n->input_pos < n->n_input && n->input[n->input_pos].t < t) {
+    t = n->input[n->input_pos].t;
+  }
+  if (t > n->now) {
+    n->sleep_until = t;
+    n->sleeps++;
+  }
+}
+
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/* FUNCTION to boot the nodes: their world is attached, the timers are
+*  reset to millis() at the boot and setup() runs
+*/
+void sim_start(void)
+{
+  struct sim_node *n;
+  int i, j;
+
+  for (i = 0; i < sim_n_nodes; i++) {
+    n = sim_nodes[i];
+    if (!n->on) {
+      continue;
+    }
+    sim_node = n;
+    if (n->attach != NULL) {
+      n->attach(n);
+    }
+    for (j = 0; j < n->n_timers; j++) {
+      n->timer[j]->restart();
+    }
+    n->setup();
+  }
+  sim_node = NULL;
+}
+
+/* FUNCTION to run the nodes until time until, the node that is furthest
+*  behind runs its loop() first
+*/
+void sim_run(uint64_t until)
+{
+  struct sim_node *n;
+  uint64_t start, t0 = 0, key, nkey;
+  int i;
+
+  for (;;) {
+    n = NULL;
+    nkey = SIM_NEVER;
+    for (i = 0; i < sim_n_nodes; i++) {
+      if (!sim_nodes[i]->on) continue;
+      key = sim_nodes[i]->sleep_until != 0 ? sim_nodes[i]->sleep_until : sim_nodes[i]->now;
+      if (key < nkey) {
+        n = sim_nodes[i];
+        nkey = key;
+      }
+    }
+    if (n == NULL || nkey >= until) {
+      break;
+    }
+    sim_node = n;
+    if (n->sleep_until != 0) {
+      sim_advance(n, n->sleep_until);
+      n->sleep_until = 0;
+    }
+    n->active = 0;
+    start = n->now;
+    if (sim_bench) t0 = host_ns();
+    sim_spend(COST_LOOP_US);
+    n->loop();
+    if (sim_bench) n->host_ns += host_ns() - t0;
+    n->loops++;
+    n->busy += n->now - start;
+    if (n->now - start > n->loop_max) {
+      n->loop_max = n->now - start;
+    }
+    if (!n->active) {
+      sim_sleep(n, until);
+    }
+  }
+  /* the nodes stop at the same time */
+  for (i = 0; i < sim_n_nodes; i++) {
+    n = sim_nodes[i];
+    if (n->on && n->now < until) {
+      sim_node = n;
+      sim_advance(n, until);
+      n->sleep_until = 0;
+    }
+  }
+  sim_node = NULL;
+}
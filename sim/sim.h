@@ -0,0 +1,180 @@
+/*
+#################################################################################
+# sim.h - Host simulation of the JeeNodes: virtual clock, RF bus and nodes      #
+#                                                                               #
+# Every sketch is compiled natively in its own namespace against stand-ins of   #
+# the Arduino and JeeLib calls (see include/). A node has its own virtual       #
+# clock in us that only moves by the modeled cost of what the sketch does:      #
+# a fixed cost per loop(), blocking calls (analog reads, delay(), EEPROM        #
+# writes, a full serial buffer, ...) and waiting for the radio. A loop()        #
+# that did nothing (no timer expired, no packet, no interrupt) puts the node    #
+# to sleep until its next deadline, so idle time costs nothing on the host.     #
+# The node with the lowest clock runs next, so the nodes see each other's       #
+# packets in time order.                                                        #
+#                                                                               #
+# RF bus: a packet is on the air for its modeled airtime. rf12_sendNow()        #
+# waits while another packet is on the air. A receiver gets a packet when       #
+# its radio was listening when the packet started (re-armed by                  #
+# rf12_recvDone() after the previous one was read and after its own             #
+# transmissions), overlapping packets arrive with a bad CRC.                    #
+# Interrupts are sources with a next time, they run during blocking calls       #
+# and wake a sleeping node.                                                     #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#define SIM_MAX_NODES 8
+#define SIM_MAX_TIMERS 16
+#define SIM_MAX_IRQS 4
+#define SIM_MAX_INPUT 16
+#define SIM_RX_QUEUE 8
+#define SIM_AIR 64              /* packets kept on the bus */
+#define SIM_PINS 20             /* digital 0-13, analog 14-19 (A0-A5) */
+#define SIM_EEPROM 1024
+#define SIM_RF_MAX 66           /* RF12_MAXDATA */
+#define SIM_HDR_DST 0x40        /* RF12_HDR_DST */
+#define SIM_HDR_MASK 0x1F       /* RF12_HDR_MASK */
+#define SIM_LINE 256
+#define SIM_NEVER UINT64_MAX
+
+/* Modeled cost (us) of an ATmega328 at 16 MHz */
+#define COST_LOOP_US 8          /* a call of loop() and its Metro checks */
+#define COST_ANAREAD_US 112     /* analogRead(), 13 ADC clocks at 125 kHz */
+#define COST_DIGI_US 4          /* digitalRead/Write() */
+#define COST_ISR_US 5           /* a short ISR with its entry and exit */
+#define COST_EEPROM_WRITE_US 3400
+#define COST_RF_START_US 60     /* rf12_sendStart(), the rest is interrupt driven */
+#define RF12_BYTE_US 163        /* 49.26 kbit/s */
+#define RF12_OVERHEAD 9         /* preamble, sync, header, length, CRC, tail */
+#define SERIAL_CHAR_US 174      /* 57600 baud */
+#define SERIAL_TX_BUF 64        /* HardwareSerial transmit buffer */
+
+/* a Metro or MilliTimer of a sketch, registered with the node that is
+*  constructed so a sleeping node wakes when it expires
+*/
+class SimTimer {
+public:
+  SimTimer();
+  virtual void restart() = 0;                   // at the boot of the node
+  virtual uint32_t sim_remaining() = 0;         // ms until it expires
+  void fired(uint32_t late);                    // late (ms) after its time
+  struct sim_node *node;
+  uint32_t period;              // interval (ms), for the stats
+  unsigned long fires;
+  unsigned long late_slots;     // fired a whole interval or more too late
+  uint32_t late_max;
+};
+
+struct sim_node;
+
+/* an interrupt source: fire() runs the ISR at time t and returns the next time */
+struct sim_irq {
+  uint64_t next;
+  uint64_t (*fire)(struct sim_node *n, uint64_t t, void *arg);
+  void *arg;
+};
+
+struct sim_packet {
+  unsigned long seq;
+  uint64_t start, end;
+  int group, band;
+  uint8_t hdr, len, bad;
+  uint8_t data[SIM_RF_MAX];
+};
+
+/* hooks of the world around a node (see world.h) */
+enum sim_sensor {
+  SIM_DS18B20,                  // temperature (C)
+  SIM_BMP085_TEMP,              // temperature (0.1 C)
+  SIM_BMP085_PRES,              // pressure (Pa)
+  SIM_CT_IRMS,                  // current (A)
+  SIM_SOLAR_W,                  // power of the inverter (W), 0 = no sun
+  SIM_SOLAR_WH,                 // its energy today (Wh)
+  SIM_SOLAR_MIN,                // its operating time today (min)
+};
+
+struct sim_node {
+  const char *name;
+  void (*setup)(void);
+  void (*loop)(void);
+  void (*attach)(struct sim_node *n);           // the world of the node
+  int on;                       // part of this run
+  uint64_t now;                 // virtual time (us)
+  uint64_t sleep_until;         // asleep until this time, 0 = awake
+  int active;                   // the loop() did something
+  int in_irq;
+  SimTimer *timer[SIM_MAX_TIMERS];
+  int n_timers;
+  struct sim_irq irq[SIM_MAX_IRQS];
+  int n_irqs;
+  /* io */
+  uint8_t pin[SIM_PINS];
+  int (*analog)(struct sim_node *n, int channel);
+  double (*sensor)(struct sim_node *n, enum sim_sensor s);
+  void (*line)(struct sim_node *n, const char *line);  // printed on Serial
+  uint8_t eeprom[SIM_EEPROM];
+  unsigned long eeprom_writes;
+  /* rf12 */
+  int rf_id, rf_band, rf_group; // set by rf12_initialize(), 0 = off
+  alignas(8) uint8_t rf_raw[SIM_RF_MAX + 13];   // rf12_buf = rf_raw + 5, so rf12_data is aligned
+  uint16_t rf_crc;
+  int rx_used;                  // rf12_recvDone() is called
+  int rx_on;                    // listening since rx_armed
+  uint64_t rx_armed, tx_until;
+  unsigned long rx[SIM_RX_QUEUE];               // seq of the packets for this node
+  int rx_head, rx_n;
+  unsigned long rf_sent, rf_recv, rf_lost;
+  /* serial */
+  uint64_t ser_until;           // the transmit buffer is empty at this time
+  char ser_line[SIM_LINE];
+  int ser_len;
+  struct { uint64_t t; const char *s; } input[SIM_MAX_INPUT];
+  int n_input, input_pos, input_off;
+  /* watchdog */
+  long wdt_ms;                  // 0 = off
+  uint64_t wdt_last;
+  unsigned long wdt_resets;
+  /* stats */
+  unsigned long loops, sleeps;
+  uint64_t busy, loop_max;      // us in loop()
+  uint64_t host_ns;             // host time in loop(), with sim_bench
+};
+
+extern struct sim_node *sim_node;               // the node that runs (or is constructed)
+extern struct sim_node *sim_nodes[SIM_MAX_NODES];
+extern int sim_n_nodes;
+extern uint32_t sim_millis0;                    // millis() at the boot of the nodes
+extern double sim_rf_loss;                      // chance a packet is lost per receiver
+extern int sim_bench;                           // measure the host time of loop()
+
+int sim_construct(struct sim_node *n, const char *name);
+int sim_sketch(struct sim_node *n, void (*setup)(void), void (*loop)(void),
+               void (*attach)(struct sim_node *n));
+struct sim_node *sim_find(const char *name);
+void sim_add_irq(struct sim_node *n, uint64_t first,
+                 uint64_t (*fire)(struct sim_node *n, uint64_t t, void *arg), void *arg);
+void sim_add_input(struct sim_node *n, uint64_t t, const char *s);
+
+void sim_spend(uint64_t us);
+uint32_t sim_millis(void);
+void sim_rf_send(uint8_t hdr, const void *data, uint8_t len);
+int sim_rf_recv(void);
+void sim_serial_write(uint8_t c);
+int sim_serial_available(void);
+int sim_serial_read(void);
+
+void sim_start(void);
+void sim_run(uint64_t until);
+void sim_srand(unsigned long seed);
+double sim_rand(void);
+void sim_srand_r(uint64_t *state, unsigned long seed);
+double sim_rand_r(uint64_t *state);
+
+#endif
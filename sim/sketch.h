@@ -0,0 +1,49 @@
+/*
+#################################################################################
+# sketch.h - Stand-ins included before a sketch of the host simulation          #
+#                                                                               #
+# A node wrapper includes this file, declares its node and then includes        #
+# the sketch in its own namespace. The headers are in first, so the             #
+# #include lines of the sketch find them included already and the Arduino       #
+# and JeeLib calls stay outside the namespace. An int is 16 bits and a long     #
+# 32 bits on the ATmega: the wrappers compile the sketches with int as          #
+# int16_t, and include copies made by the Makefile with long as int32_t, so     #
+# the payloads and the EEPROM layout have the sizes of the sketch and           #
+# millis() - t wraps in 32 bits as on the nodes. An expression of ints is       #
+# still computed in the 32 bits of the host, only what is stored is 16 bits.    #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include "Arduino.h"
+#include "avr/pgmspace.h"
+#include "avr/io.h"
+#include "avr/wdt.h"
+#include "util/crc16.h"
+#include "JeeLib.h"
+#include "Metro.h"
+#include "EEPROM.h"
+#include "OneWire.h"
+#include "DallasTemperature.h"
+#include "PortsBMP085.h"
+#include "PortsLCD.h"
+#include "Wire.h"
+#include "GLCD_ST7565.h"
+#include "StopWatch.h"
+#include "Soladin_uart.h"
+#include "EmonLib.h"
+#include "utility/font_4x6.h"
+#include "utility/font_clR5x8.h"
+#include "utility/font_helvB10.h"
+#include "utility/font_helvB12.h"
+#include "utility/font_helvB18.h"
+
+#include "sim.h"
+#include "world.h"
+
+#endif
@@ -0,0 +1,534 @@
+/*
+#################################################################################
+# world.cpp - The house around the simulated JeeNodes                           #
+#                                                                               #
+# See world.h for the interface.                                                #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "util/crc16.h"
+#include "avr/io.h"
+#include "world.h"
+
+extern "C" {
+#include "parse.h"
+}
+
+#define DISC_ROT_KWH 600        /* rotations of the electricity meter per kWh */
+#define GAS_L_ROT 10            /* litres of gas per rotation of the LS digit */
+#define WATER_L_ROT 1
+#define TAP_L_H 480             /* flow of a tap (l/h) */
+#define TAP_MIN_L 2
+#define TAP_MAX_L 40
+#define BURNER_DUTY 0.3         /* mean fraction of the time the burner is on */
+
+/* position of the marks on the meters (fraction of a rotation) */
+#define E_MARK_HW 0.025         /* half width of the mark on the disc */
+#define E_RIGHT_OFFSET 0.03     /* the right sensor sees the mark after the left one */
+#define G_MIRROR_HW 0.04
+#define W_MIRROR_HW 0.05
+#define SPOT_HW 0.008           /* half width of the light spot of a sensor */
+#define POS0 0.5                /* the meters start between two marks */
+
+/* sensor readings (0-1023) away from and at the marks, as the thresholds in
+*  EEPROM expect them (see SensorNode.ino)
+*/
+#define E_BASE 350
+#define E_CONTRAST 400          /* the mark reflects less, higher reading */
+#define G_BASE 620
+#define G_CONTRAST -470         /* the mirror reflects more, lower reading */
+#define W_BASE 600
+#define W_CONTRAST -420
+static const int16_t sensor_eeprom[8] = { 500, 675, 500, 675, 225, 470, 255, 450 };
+#define SENSOR_EEPROM_ADDR 0x60
+
+#define DCF_PIN 5               /* JeeNode port 2 DIO */
+#define MCU_MHZ 16
+#define MCU_POLL_US 2000        /* Timer2 is looked at until it runs */
+#define MCU_MAX_SCAN 8          /* conversions per compare match */
+
+#define US_S 1000000ULL
+#define US_MIN (60 * US_S)
+#define US_H 3600e6
+
+struct world_param world;
+struct world_truth truth;
+struct world_usb usb;
+FILE *world_log = NULL;
+
+static uint64_t events;         // random stream of the loads, the burner and the taps
+static time_t epoch0;           // local time at the start (Monday 12-10-2026 00:00)
+
+/* state of the meters */
+static struct {
+  uint64_t t;                   // time of the state (us)
+  double e_pos, g_pos, w_pos;   // rotations
+  double load;                  // W
+  uint64_t load_until;
+  int burner;
+  uint64_t burner_until;
+  uint64_t tap_from, tap_until; // the next (or current) tap
+  double reported;              // last power (W) printed by the CentralNode
+} st;
+
+
+/* the events of the world draw from a stream of their own: a sketch that
+*  reads its sensors more or less often (noise) sees the same day
+*/
+static double rnd(double lo, double hi)
+{
+  return(lo + (hi - lo) * sim_rand_r(&events));
+}
+
+static double noise(void)
+{
+  return(world.noise * (2 * sim_rand() - 1));
+}
+
+static double hour_of_day(uint64_t t)
+{
+  return(fmod(t / US_H, 24));
+}
+
+/* FUNCTION sunlight 0-1: 7:00 to 19:00, highest at 13:00 */
+static double sun(uint64_t t)
+{
+  double h = hour_of_day(t);
+
+  if (h <= 7 || h >= 19) {
+    return(0);
+  }
+  return(sin(M_PI * (h - 7) / 12));
+}
+
+static double solar_w(uint64_t t)
+{
+  return(world.solar_w * sun(t));
+}
+
+/* FUNCTION of the world time t (us) to local time */
+static void local_time(uint64_t t, struct tm *tm)
+{
+  time_t s = epoch0 + (time_t)(t / US_S);
+
+  gmtime_r(&s, tm);
+}
+
+
+/* FUNCTIONs to switch the load, the burner and the taps */
+static void next_load(void)
+{
+  if (rnd(0, 1) < 0.1) {        // an appliance: kettle, oven, washing machine
+    st.load = world.base_w * rnd(0.6, 1.4) + rnd(1000, 2500);
+    st.load_until = st.t + (uint64_t)rnd(1, 5) * US_MIN;
+  } else {
+    st.load = world.base_w * rnd(0.6, 1.4);
+    st.load_until = st.t + (uint64_t)(rnd(1, 19) * US_MIN);
+  }
+}
+
+static void next_burner(void)
+{
+  double p = BURNER_DUTY * (1 + 0.5 * cos(2 * M_PI * (hour_of_day(st.t) - 7) / 24));
+
+  st.burner = world.gas_l > 0 && rnd(0, 1) < p;
+  st.burner_until = st.t + (uint64_t)(rnd(5, 35) * US_MIN);
+}
+
+static void next_tap(void)
+{
+  double mean_s, l;
+
+  if (world.water_l <= 0) {
+    st.tap_from = st.tap_until = SIM_NEVER;
+    return;
+  }
+  mean_s = 86400.0 * (TAP_MIN_L + TAP_MAX_L) / 2 / world.water_l;
+  l = rnd(TAP_MIN_L, TAP_MAX_L);
+  st.tap_from = st.t + (uint64_t)(-log(1 - rnd(0, 1)) * mean_s * US_S);
+  st.tap_until = st.tap_from + (uint64_t)(l / TAP_L_H * US_H);
+}
+
+
+/* FUNCTION to move the meters to time t */
+static void advance(uint64_t t)
+{
+  uint64_t end;
+  double dt, net;
+
+  while (st.t < t) {
+    end = t;
+    if (end > st.t + US_S) end = st.t + US_S;   // the sun moves
+    if (end > st.load_until) end = st.load_until;
+    if (end > st.burner_until) end = st.burner_until;
+    if (st.tap_from > st.t && end > st.tap_from) end = st.tap_from;
+    if (st.tap_until > st.t && end > st.tap_until) end = st.tap_until;
+    dt = end - st.t;
+
+    net = st.load - solar_w(st.t);
+    st.e_pos += net * DISC_ROT_KWH / 3.6e12 * dt;
+    truth.power_err_ws += fabs(st.reported - net) * dt / 1e6;
+    truth.power_ws += fabs(net) * dt / 1e6;
+    if (st.burner) {
+      st.g_pos += world.gas_l / (24 * BURNER_DUTY) / GAS_L_ROT / US_H * dt;
+    }
+    if (st.t >= st.tap_from && st.t < st.tap_until) {
+      st.w_pos += (double)TAP_L_H / WATER_L_ROT / US_H * dt;
+    }
+
+    st.t = end;
+    if (st.t >= st.load_until) next_load();
+    if (st.t >= st.burner_until) next_burner();
+    if (st.t >= st.tap_until) next_tap();
+  }
+}
+
+
+/* FUNCTION reading of a reflective sensor at position pos of a meter */
+static int reflect(double pos, double hw, double base, double contrast)
+{
+  double d = fabs(pos - floor(pos + 0.5));
+  double cover = (hw + SPOT_HW - d) / (2 * SPOT_HW);
+  double weeks = sim_node->now / (7 * 24 * US_H);
+  double v;
+
+  if (cover < 0) cover = 0;
+  if (cover > 1) cover = 1;
+  contrast *= 1 - world.ageing / 100 * weeks > 0 ? 1 - world.ageing / 100 * weeks : 0;
+  v = base + contrast * cover - world.ambient * sun(sim_node->now);
+  v += noise();
+  if (v < 0) v = 0;
+  if (v > 1023) v = 1023;
+  return((int)(v + 0.5));
+}
+
+/* the count of a sketch at position pos: it counts when the mark arrives */
+static long rotations(double pos, double hw)
+{
+  return((long)(floor(pos + hw) - floor(POS0 + hw)));
+}
+
+
+/* FUNCTIONs of the SensorNode: 1 left, 2 right, 3 gas, 4 water */
+static int sensor_analog(struct sim_node *n, int channel)
+{
+  advance(n->now);
+  switch (channel) {
+  case 0:
+    return(reflect(st.e_pos, E_MARK_HW, E_BASE, E_CONTRAST));
+  case 1:
+    return(reflect(st.e_pos - E_RIGHT_OFFSET, E_MARK_HW, E_BASE, E_CONTRAST));
+  case 2:
+    return(reflect(st.g_pos, G_MIRROR_HW, G_BASE, G_CONTRAST));
+  case 3:
+    return(reflect(st.w_pos, W_MIRROR_HW, W_BASE, W_CONTRAST));
+  }
+  return(0);
+}
+
+/* FUNCTION of the Timer2 and the ADC of the SensorNode: Timer2 in CTC mode
+*  runs its ISR every (OCR2A + 1) prescaled clocks, a conversion started
+*  with ADSC runs the ADC ISR when it is done. On the ATmega a conversion
+*  takes 104 us at a 125 kHz ADC clock, here the conversions the ISRs
+*  start run right after each other at the compare match: the sketch gets
+*  its scan some 0.4 ms early, the same every time, and the node does not
+*  wake for every conversion.
+*/
+static uint64_t sensor_mcu_fire(struct sim_node *n, uint64_t t, void *arg)
+{
+  static const int prescale[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+  int p = prescale[TCCR2B & 7], i;
+
+  (void)arg;
+  if (p == 0 || !(TCCR2A & _BV(WGM21)) || !(TIMSK2 & _BV(OCIE2A))) {
+    return(t + MCU_POLL_US);    // not set up (yet)
+  }
+  sensor_timer2();
+  sim_spend(COST_ISR_US);
+  for (i = 0; i < MCU_MAX_SCAN && (ADCSRA & _BV(ADEN)) && (ADCSRA & _BV(ADSC)); i++) {
+    ADC = n->analog(n, ADMUX & 0x0F);
+    ADCSRA &= ~_BV(ADSC);
+    if (ADCSRA & _BV(ADIE)) {
+      sensor_adc();
+      sim_spend(COST_ISR_US);
+    }
+  }
+  return(t + (uint64_t)(OCR2A + 1) * p / MCU_MHZ);
+}
+
+void world_sensor(struct sim_node *n)
+{
+  uint16_t crc = ~0;
+  int i;
+
+  /* the trigger values in EEPROM, with their CRC */
+  for (i = 0; i < 8; i++) {
+    n->eeprom[SENSOR_EEPROM_ADDR + 2 * i] = sensor_eeprom[i] & 0xFF;
+    n->eeprom[SENSOR_EEPROM_ADDR + 2 * i + 1] = (sensor_eeprom[i] >> 8) & 0xFF;
+  }
+  for (i = 0; i < 16; i++) {
+    crc = _crc16_update(crc, n->eeprom[SENSOR_EEPROM_ADDR + i]);
+  }
+  n->eeprom[SENSOR_EEPROM_ADDR + 16] = crc & 0xFF;
+  n->eeprom[SENSOR_EEPROM_ADDR + 17] = crc >> 8;
+  n->analog = sensor_analog;
+  sim_add_irq(n, MCU_POLL_US, sensor_mcu_fire, NULL);
+}
+
+
+/* FUNCTIONs of the DCF77 signal: a pulse at the start of every second but
+*  the last of the minute, 100 ms for a 0 and 200 ms for a 1. The bits of
+*  a minute are the time of the next minute.
+*/
+static int dcf_bit(uint64_t t, int sec)
+{
+  static uint8_t bits[60];
+  static uint64_t minute = SIM_NEVER;
+  struct tm tm;
+  int i, p;
+
+  if (t / US_MIN != minute) {
+    minute = t / US_MIN;
+    local_time((minute + 1) * US_MIN, &tm);
+    memset(bits, 0, sizeof(bits));
+    if (tm.tm_mon >= 3 && tm.tm_mon <= 9) bits[17] = 1;         // CEST (April-October)
+    else bits[18] = 1;                                          // CET
+    bits[20] = 1;
+    for (i = 0; i < 7; i++) bits[21 + i] = ((tm.tm_min % 10) | (tm.tm_min / 10) << 4) >> i & 1;
+    for (i = 0; i < 6; i++) bits[29 + i] = ((tm.tm_hour % 10) | (tm.tm_hour / 10) << 4) >> i & 1;
+    for (i = 0; i < 6; i++) bits[36 + i] = ((tm.tm_mday % 10) | (tm.tm_mday / 10) << 4) >> i & 1;
+    for (i = 0; i < 3; i++) bits[42 + i] = (tm.tm_wday == 0 ? 7 : tm.tm_wday) >> i & 1;
+    for (i = 0; i < 5; i++) bits[45 + i] = (((tm.tm_mon + 1) % 10) | ((tm.tm_mon + 1) / 10) << 4) >> i & 1;
+    for (i = 0; i < 8; i++) bits[50 + i] = ((tm.tm_year % 10) | (tm.tm_year / 10 % 10) << 4) >> i & 1;
+    for (p = 0, i = 21; i < 28; i++) p ^= bits[i];
+    bits[28] = p;
+    for (p = 0, i = 29; i < 35; i++) p ^= bits[i];
+    bits[35] = p;
+    for (p = 0, i = 36; i < 58; i++) p ^= bits[i];
+    bits[58] = p;
+  }
+  return(bits[sec]);
+}
+
+static uint64_t dcf_fire(struct sim_node *n, uint64_t t, void *arg)
+{
+  int *high = (int *)arg;
+  uint64_t s;
+
+  *high = !*high;
+  n->pin[DCF_PIN] = *high;
+  if ((PCICR & _BV(PCIE2)) && (PCMSK2 & _BV(PCINT21))) {
+    central_pcint2();
+  }
+  if (*high) {
+    return(t + (dcf_bit(t, (int)(t / US_S % 60)) ? 200000 : 100000));
+  }
+  s = t / US_S + 1;
+  if (s % 60 == 59) {
+    s++;
+  }
+  return(s * US_S);
+}
+
+
+/* FUNCTIONs of the CentralNode */
+static double central_sensor(struct sim_node *n, enum sim_sensor s)
+{
+  double outside = 8 + 5 * sin(2 * M_PI * (hour_of_day(n->now) - 9) / 24)
+                   + 2 * sin(2 * M_PI * n->now / (5 * 24 * US_H));
+
+  switch (s) {
+  case SIM_DS18B20:
+    return(outside);
+  case SIM_BMP085_TEMP:
+    return(10 * outside);
+  case SIM_BMP085_PRES:
+    return(101300 + 800 * sin(2 * M_PI * n->now / (3 * 24 * US_H)));
+  default:
+    return(0);
+  }
+}
+
+/* FUNCTION to check a line of the counts of a meter */
+static void count(long v, long *last, unsigned long *missed)
+{
+  if (v > *last + 1) {
+    *missed += v - *last - 1;
+  }
+  *last = v;
+}
+
+/* FUNCTION to check a 't' line against the time of the world, it may be
+*  printed up to 2 s into the minute
+*/
+static void check_time(const struct message *m, uint64_t t)
+{
+  struct tm now, before;
+
+  local_time(t, &now);
+  local_time(t > 2 * US_S ? t - 2 * US_S : 0, &before);
+  if ((m->value[0] == now.tm_hour && m->value[1] == now.tm_min &&
+       m->value[2] == now.tm_mday && m->value[3] == now.tm_mon + 1 &&
+       m->value[4] == now.tm_year % 100) ||
+      (m->value[0] == before.tm_hour && m->value[1] == before.tm_min &&
+       m->value[2] == before.tm_mday && m->value[3] == before.tm_mon + 1 &&
+       m->value[4] == before.tm_year % 100)) {
+    usb.t_ok++;
+  } else {
+    usb.t_bad++;
+  }
+}
+
+static void central_line(struct sim_node *n, const char *line)
+{
+  struct message m;
+  struct tm tm;
+  char ts[32];
+  int rc;
+
+  usb.lines++;
+  if (world_log != NULL) {
+    local_time(n->now, &tm);
+    strftime(ts, sizeof(ts), "%d-%m-%y,%H:%M:%S", &tm);
+    fprintf(world_log, "%s %s\n", ts, line);
+  }
+  if (world.verbose) {
+    printf("%10.3f %s\n", n->now / 1e6, line);
+  }
+  rc = parse_line(line, &m);
+  if (rc == PARSE_UNKNOWN) {
+    return;                     // text, jnread skips it
+  }
+  if (rc != PARSE_OK) {
+    if (usb.bad++ < 10) {
+      fprintf(stderr, "%.3f s: jnread rejects \"%s\" (%d)\n", n->now / 1e6, line, rc);
+    }
+    return;
+  }
+  usb.msgs[m.type - 'a']++;
+  switch (m.type) {
+  case 'e':
+    advance(n->now);
+    st.reported = m.value[0];
+    count(m.value[1], &usb.e_count, &usb.e_missed);
+    break;
+  case 'g':
+    count(m.value[1], &usb.g_count, &usb.g_missed);
+    break;
+  case 'w':
+    count(m.value[1], &usb.w_count, &usb.w_missed);
+    break;
+  case 't':
+    check_time(&m, n->now);
+    break;
+  }
+}
+
+void world_central(struct sim_node *n)
+{
+  static int dcf_high = 0;
+
+  n->sensor = central_sensor;
+  n->line = central_line;
+  sim_add_irq(n, US_S, dcf_fire, &dcf_high);
+}
+
+
+/* FUNCTIONs of the GLCDNode: inside temperature, LDR on port 3 */
+static double glcd_sensor(struct sim_node *n, enum sim_sensor s)
+{
+  if (s == SIM_DS18B20) {
+    return(20.5 + 0.5 * sin(2 * M_PI * (hour_of_day(n->now) - 18) / 24));
+  }
+  return(0);
+}
+
+static int glcd_analog(struct sim_node *n, int channel)
+{
+  if (channel == 2) {
+    return((int)(400 * sun(n->now) + 20 + noise()));
+  }
+  return(0);
+}
+
+void world_glcd(struct sim_node *n)
+{
+  n->sensor = glcd_sensor;
+  n->analog = glcd_analog;
+}
+
+
+/* FUNCTIONs of the SolarNode: the Soladin, its counters of today */
+static double solar_sensor(struct sim_node *n, enum sim_sensor s)
+{
+  double h = hour_of_day(n->now), x;
+
+  switch (s) {
+  case SIM_SOLAR_W:
+    return(solar_w(n->now) >= 1 ? floor(solar_w(n->now)) : 0);
+  case SIM_SOLAR_WH:
+    x = h <= 7 ? 0 : h >= 19 ? 12 : h - 7;
+    return(world.solar_w * 12 / M_PI * (1 - cos(M_PI * x / 12)));
+  case SIM_SOLAR_MIN:
+    x = h <= 7 ? 0 : h >= 19 ? 12 : h - 7;
+    return(world.solar_w > 0 ? 60 * x : 0);
+  default:
+    return(0);
+  }
+}
+
+void world_solar(struct sim_node *n)
+{
+  n->sensor = solar_sensor;
+}
+
+
+/* FUNCTIONs of the ApplianceNode: a fridge, 15 min on and 30 min off */
+static double appliance_sensor(struct sim_node *n, enum sim_sensor s)
+{
+  if (s == SIM_CT_IRMS) {
+    return(n->now % (45 * US_MIN) < 15 * US_MIN ? 0.6 : 0.02);
+  }
+  return(0);
+}
+
+void world_appliance(struct sim_node *n)
+{
+  n->sensor = appliance_sensor;
+}
+
+
+/* FUNCTION to start the world */
+void world_init(const struct world_param *p)
+{
+  struct tm tm;
+
+  world = *p;
+  sim_srand_r(&events, (unsigned long)(sim_rand() * 4294967296.0));
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = 2026 - 1900;
+  tm.tm_mon = 9;
+  tm.tm_mday = 12;
+  epoch0 = timegm(&tm);
+  memset(&st, 0, sizeof(st));
+  st.e_pos = st.g_pos = st.w_pos = POS0;
+  next_load();
+  next_burner();
+  next_tap();
+}
+
+/* FUNCTION to bring the truth to the end time t */
+void world_finish(uint64_t t)
+{
+  advance(t);
+  truth.e_rotations = rotations(st.e_pos, E_MARK_HW);
+  truth.g_rotations = rotations(st.g_pos, G_MIRROR_HW);
+  truth.w_rotations = rotations(st.w_pos, W_MIRROR_HW);
+}
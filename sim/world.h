@@ -0,0 +1,81 @@
+/*
+#################################################################################
+# world.h - The house around the simulated JeeNodes                             #
+#                                                                               #
+# A model of what the sensors of the nodes see, driven by the virtual clock:    #
+# - the electricity meter: a disc with a mark, 600 rotations per kWh, seen      #
+#   by two reflective sensors; the power is a base load with appliances         #
+#   switching on and off, minus the solar power (the disc turns back when       #
+#   the panels deliver more than the house uses)                                #
+# - the gas meter (10 l per rotation, the burner of the heating switches on     #
+#   and off) and the water meter (1 l per rotation, taps of 2-40 l)             #
+# - the sun, outside and inside temperature, the pressure, the Soladin          #
+#   inverter, a fridge on the CT sensor and the DCF77 time signal               #
+# Sensor readings have noise, sunlight on the sensors (ambient) lowers          #
+# them and the marks can fade (ageing). The world keeps the truth: the          #
+# rotations of the meters and the error of the power the CentralNode            #
+# reports.                                                                      #
+# The CentralNode's USB lines are parsed with the parser of jnread and can      #
+# be logged in the format of its ALL_LOG, for jnread --replay.                  #
+#                                                                               #
+# This program is free software and is available under the terms of            #
+# the GNU General Public License.                                               #
+#################################################################################
+*/
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdio.h>
+
+#include "sim.h"
+
+struct world_param {
+  double base_w;                // mean base load (W)
+  double solar_w;               // peak power of the panels (W), 0 = none
+  double gas_l;                 // gas per day (l)
+  double water_l;               // water per day (l)
+  double ambient;               // sunlight on the sensors at noon (reading units)
+  double ageing;                // contrast of the marks lost per week (%)
+  double noise;                 // noise on the sensors, +/- (reading units)
+  int verbose;                  // print the USB lines
+};
+
+struct world_truth {
+  long e_rotations, g_rotations, w_rotations;   // since the start
+  double power_err_ws;          // integral of |reported - true power| (Ws)
+  double power_ws;              // integral of |true power| (Ws)
+};
+
+/* what the CentralNode printed */
+struct world_usb {
+  unsigned long lines, bad;     // bad: a message the parser of jnread rejects
+  unsigned long msgs[26];       // per type letter
+  long e_count, g_count, w_count;               // last counts received
+  unsigned long e_missed, g_missed, w_missed;   // counts skipped (lost packets)
+  unsigned long t_ok, t_bad;    // 't' lines with the right/wrong time
+};
+
+extern struct world_param world;
+extern struct world_truth truth;
+extern struct world_usb usb;
+extern FILE *world_log;         // log of the USB lines, NULL = none
+
+void world_init(const struct world_param *p);
+void world_finish(uint64_t t);
+
+/* attach functions of the nodes (the world around each sketch) */
+void world_sensor(struct sim_node *n);
+void world_central(struct sim_node *n);
+void world_glcd(struct sim_node *n);
+void world_solar(struct sim_node *n);
+void world_appliance(struct sim_node *n);
+
+/* exported by the node wrappers */
+void sensor_counts(long *e, long *g, long *w);  // counters of the SensorNode sketch
+void sensor_samples(unsigned long *lost, unsigned long *late, int *max_waiting);  // its sample ring
+void sensor_timer2(void);                       // Timer2 compare match ISR of the SensorNode
+void sensor_adc(void);                          // ADC conversion complete ISR of the SensorNode
+void central_pcint2(void);                      // DCF77 pin change ISR of the CentralNode
+
+#endif